@@ -0,0 +1,168 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include "conet/result.h"
+#include "conet/http_client.h"
+
+// Runs against an in-process beast server, keep-alive against a new connection per request,
+// and co_request_all() with and without pipelining.
+// usage: http_client_benchmark [request_number]
+
+namespace {
+
+boost::asio::awaitable<void> session(boost::asio::ip::tcp::socket socket)
+{
+    boost::beast::flat_buffer buffer;
+    while (true)
+    {
+        boost::system::error_code ec;
+        boost::beast::http::request<boost::beast::http::string_body> req;
+        co_await boost::beast::http::async_read(socket, buffer, req, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec)
+            break;
+
+        boost::beast::http::response<boost::beast::http::string_body> rsp(boost::beast::http::status::ok, req.version());
+        rsp.keep_alive(req.keep_alive());
+        rsp.body() = "hello";
+        rsp.prepare_payload();
+        co_await boost::beast::http::async_write(socket, rsp, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec || !req.keep_alive())
+            break;
+    }
+
+    boost::system::error_code ec;
+    socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+}
+
+boost::asio::awaitable<void> listen(boost::asio::ip::tcp::acceptor &acceptor)
+{
+    while (true)
+    {
+        boost::system::error_code ec;
+        auto socket = co_await acceptor.async_accept(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec)
+            break;
+
+        socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+        boost::asio::co_spawn(acceptor.get_executor(), session(std::move(socket)), boost::asio::detached);
+    }
+}
+
+// max_idle_per_host zero closes every connection after its request, like the client did before pooling
+void run(const std::string &name, unsigned short port, int request_number, int max_idle_per_host)
+{
+    const int worker_number = 16;
+
+    boost::asio::io_context io_context;
+    conet::HttpClient http_client(io_context);
+    auto options = http_client.connection_pool().options();
+    options.max_connection_per_host = worker_number;
+    options.max_idle_per_host = max_idle_per_host;
+    http_client.connection_pool().set_options(options);
+
+    auto url = "127.0.0.1:" + std::to_string(port) + "/";
+    int finished_number = 0;
+    int fail_number = 0;
+    auto worker = [&] () -> boost::asio::awaitable<void>
+        {
+            for (int i=0; i<request_number / worker_number; ++i)
+            {
+                auto get_result = co_await http_client.co_get(url);
+                if (!get_result)
+                    ++fail_number;
+            }
+
+            if (++finished_number == worker_number)
+                http_client.connection_pool().close();
+        };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i=0; i<worker_number; ++i)
+    {
+        boost::asio::co_spawn(io_context, worker(), boost::asio::detached);
+    }
+    io_context.run();
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto stats = http_client.connection_pool().stats();
+    std::cout << name << ": " << request_number / seconds << " request/s"
+        << " fail_number:" << fail_number
+        << " created_number:" << stats.created_number
+        << " reused_number:" << stats.reused_number << std::endl;
+}
+
+// batches of co_request_all(), pipeline_depth one sends a request per round trip
+void run_all(const std::string &name, unsigned short port, int request_number, int pipeline_depth)
+{
+    const int batch_size = 1000;
+
+    boost::asio::io_context io_context;
+    conet::HttpClient http_client(io_context);
+    auto options = http_client.options();
+    options.pipeline_depth = pipeline_depth;
+    http_client.set_options(options);
+
+    std::vector<conet::HttpRequest> requests(batch_size);
+    for (auto &request : requests)
+    {
+        request.url = "127.0.0.1:" + std::to_string(port) + "/";
+    }
+
+    int fail_number = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            for (int i=0; i<request_number / batch_size; ++i)
+            {
+                auto results = co_await http_client.co_request_all(requests);
+                for (const auto &request_result : results)
+                {
+                    if (!request_result)
+                        ++fail_number;
+                }
+            }
+
+            http_client.connection_pool().close();
+        };
+
+    auto start = std::chrono::steady_clock::now();
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto stats = http_client.connection_pool().stats();
+    std::cout << name << ": " << request_number / seconds << " request/s"
+        << " fail_number:" << fail_number
+        << " created_number:" << stats.created_number
+        << " reused_number:" << stats.reused_number << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int request_number = argc > 1 ? std::stoi(argv[1]) : 20000;
+
+    // the server has its own thread, like a real server would
+    boost::asio::io_context server_io_context;
+    boost::asio::ip::tcp::acceptor acceptor(server_io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    auto port = acceptor.local_endpoint().port();
+    boost::asio::co_spawn(server_io_context, listen(acceptor), boost::asio::detached);
+    std::thread server_thread([&server_io_context] { server_io_context.run(); });
+
+    run("new_connection", port, request_number, 0);
+    run("keep_alive", port, request_number, 16);
+    run_all("request_all", port, request_number, 1);
+    run_all("request_all_pipelined", port, request_number, 16);
+
+    boost::asio::post(server_io_context, [&acceptor] { acceptor.close(); });
+    server_io_context.stop();
+    server_thread.join();
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include "conet/result.h"
+#include "conet/histogram.h"
+#include "conet/http_server.h"
+
+// wrk-style load against loopback: keep-alive connections, each sending its next request
+// as soon as the response arrives, for a fixed duration.
+// usage: http_server_benchmark [server_thread_number] [connection_number] [seconds]
+
+namespace {
+
+struct LoadStats
+{
+    conet::Histogram latency_us;
+    std::atomic_uint64_t error_number{0};
+};
+
+boost::asio::awaitable<void> connection(unsigned short port, std::chrono::steady_clock::time_point deadline, LoadStats &load_stats)
+{
+    auto executor = co_await boost::asio::this_coro::executor;
+    boost::beast::tcp_stream stream(executor);
+    boost::system::error_code ec;
+    co_await stream.async_connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), port), boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    if (ec)
+    {
+        ++load_stats.error_number;
+        co_return;
+    }
+    stream.socket().set_option(boost::asio::ip::tcp::no_delay(true), ec);
+
+    boost::beast::http::request<boost::beast::http::empty_body> req(boost::beast::http::verb::get, "/users/42", 11);
+    req.set(boost::beast::http::field::host, "127.0.0.1");
+    boost::beast::flat_buffer buffer;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        auto start = std::chrono::steady_clock::now();
+        co_await boost::beast::http::async_write(stream, req, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec)
+        {
+            ++load_stats.error_number;
+            break;
+        }
+
+        boost::beast::http::response<boost::beast::http::string_body> rsp;
+        co_await boost::beast::http::async_read(stream, buffer, rsp, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec || rsp.result() != boost::beast::http::status::ok)
+        {
+            ++load_stats.error_number;
+            break;
+        }
+
+        load_stats.latency_us.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int server_thread_number = argc > 1 ? std::stoi(argv[1]) : 2;
+    int connection_number = argc > 2 ? std::stoi(argv[2]) : 64;
+    int seconds = argc > 3 ? std::stoi(argv[3]) : 5;
+
+    // one io_context per server thread, kept running until close while it has no connection yet
+    std::vector<std::unique_ptr<boost::asio::io_context>> io_context_group;
+    std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_guard_group;
+    std::vector<boost::asio::any_io_executor> executors;
+    for (int i=0; i<server_thread_number; ++i)
+    {
+        io_context_group.push_back(std::make_unique<boost::asio::io_context>(1));
+        work_guard_group.push_back(boost::asio::make_work_guard(*io_context_group.back()));
+        executors.push_back(io_context_group.back()->get_executor());
+    }
+
+    conet::HttpServer http_server(executors);
+    http_server.route(boost::beast::http::verb::get, "/users/:id",
+        [] (const conet::HttpServerRequest &req, conet::HttpServerResponse &rsp, const conet::HttpRouteParams &params) -> boost::asio::awaitable<conet::result<void>>
+        {
+            rsp.set(boost::beast::http::field::content_type, "text/plain");
+            rsp.body() = params.get("id");
+            co_return RESULT_SUCCESS;
+        });
+    auto listen_result = http_server.listen("127.0.0.1", 0);
+    if (!listen_result)
+    {
+        LOG(ERROR) << listen_result.error_info();
+        return 1;
+    }
+    http_server.start();
+
+    std::vector<std::thread> thread_group;
+    for (auto &io_context : io_context_group)
+    {
+        thread_group.emplace_back([&io_context] { io_context->run(); });
+    }
+
+    // the load generator has its own thread, like wrk
+    boost::asio::io_context client_io_context(1);
+    LoadStats load_stats;
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::seconds(seconds);
+    for (int i=0; i<connection_number; ++i)
+    {
+        boost::asio::co_spawn(client_io_context, connection(http_server.port(), deadline, load_stats), boost::asio::detached);
+    }
+    client_io_context.run();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    http_server.close();
+    work_guard_group.clear();
+    for (auto &t : thread_group)
+    {
+        t.join();
+    }
+
+    auto stats = http_server.stats();
+    std::cout << "server_thread_number:" << server_thread_number
+        << " connection_number:" << connection_number
+        << " seconds:" << seconds << std::endl;
+    std::cout << "request/s:" << load_stats.latency_us.count() / elapsed
+        << " error_number:" << load_stats.error_number
+        << " accepted_number:" << stats.accepted_number << std::endl;
+    std::cout << "latency_us p50:" << load_stats.latency_us.percentile(50)
+        << " p99:" << load_stats.latency_us.percentile(99)
+        << " max:" << load_stats.latency_us.max() << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "conet/result.h"
+#include "conet/mysql_bulk_insert.h"
+#include "conet/mysql_bulk_load.h"
+#include "conet/mysql_client.h"
+#include "conet/mysql_client_pool.h"
+#include "conet/mysql_fake_server.h"
+#include "conet/sharded_mysql_client_pool.h"
+
+// Runs against the in-process MysqlFakeServer, no MySQL server is needed.
+// usage: mysql_client_benchmark [query_number]
+
+namespace {
+
+const std::string host = "127.0.0.1";
+
+double elapsed_seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void print_histogram(const std::string &name, const conet::Histogram &histogram)
+{
+    std::cout << "  " << name
+        << " count:" << histogram.count()
+        << " p50_us:" << histogram.percentile(50)
+        << " p99_us:" << histogram.percentile(99)
+        << " max_us:" << histogram.max() << std::endl;
+}
+
+// sequential round trips on one connection
+boost::asio::awaitable<conet::result<void>> throughput(unsigned short port, int query_number)
+{
+    conet::MysqlClient mysql_client;
+    RESULT_CO_CHECK(co_await mysql_client.connect(host, port, "root", "", "test"));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i=0; i<query_number; ++i)
+    {
+        RESULT_CO_CHECK(co_await mysql_client.query("select 1"));
+    }
+    auto seconds = elapsed_seconds(start);
+
+    std::cout << "throughput: " << query_number / seconds << " query/s, "
+        << seconds * 1e6 / query_number << " us/query" << std::endl;
+    co_return RESULT_SUCCESS;
+}
+
+// cost of one more row, the one row query is the baseline.
+// mysql_fake_server runs on the same thread, so its options can be changed between queries.
+boost::asio::awaitable<conet::result<void>> per_row(conet::MysqlFakeServer &mysql_fake_server, int query_number)
+{
+    conet::MysqlClient mysql_client;
+    RESULT_CO_CHECK(co_await mysql_client.connect(host, mysql_fake_server.port(), "root", "", "test"));
+
+    double baseline_us = 0;
+    for (std::size_t row_number : {1, 10, 100, 1000, 10000})
+    {
+        auto options = mysql_fake_server.options();
+        options.row_number = row_number;
+        options.column_number = 4;
+        options.value_size = 16;
+        mysql_fake_server.set_options(options);
+
+        int n = std::max(10, query_number / static_cast<int>(row_number));
+        auto start = std::chrono::steady_clock::now();
+        for (int i=0; i<n; ++i)
+        {
+            RESULT_CO_CHECK(co_await mysql_client.query("select * from t"));
+        }
+        auto us = elapsed_seconds(start) * 1e6 / n;
+        if (row_number == 1)
+            baseline_us = us;
+
+        std::cout << "per_row: rows:" << row_number << " " << us << " us/query";
+        if (row_number > 1)
+            std::cout << ", " << (us - baseline_us) / (row_number - 1) << " us/row";
+        std::cout << std::endl;
+    }
+
+    mysql_client.close();
+    mysql_fake_server.close();
+
+    co_return RESULT_SUCCESS;
+}
+
+// many coroutines sharing few connections
+// the pool outlives io_context.run(), close() finishes asynchronously
+boost::asio::awaitable<conet::result<void>> pool_contention(
+    boost::asio::io_context &io_context,
+    conet::MysqlClientPool &mysql_client_pool,
+    unsigned short port,
+    int query_number)
+{
+    const int limit_max_number = 4;
+    const int worker_number = 64;
+
+    RESULT_CO_CHECK(co_await mysql_client_pool.init(host, port, "root", "", "test", limit_max_number, limit_max_number));
+
+    int finished_number = 0;
+    int fail_number = 0;
+    boost::asio::steady_timer done_timer(io_context, std::chrono::steady_clock::time_point::max());
+
+    auto worker = [&] () -> boost::asio::awaitable<void>
+        {
+            for (int i=0; i<query_number / worker_number; ++i)
+            {
+                auto get_result = co_await mysql_client_pool.get();
+                if (!get_result)
+                {
+                    ++fail_number;
+                    continue;
+                }
+
+                auto query_result = co_await get_result.value()->query("select 1");
+                if (!query_result)
+                    ++fail_number;
+            }
+
+            if (++finished_number == worker_number)
+                done_timer.cancel();
+        };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i=0; i<worker_number; ++i)
+    {
+        boost::asio::co_spawn(io_context, worker(), boost::asio::detached);
+    }
+
+    boost::system::error_code ec;
+    co_await done_timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    auto seconds = elapsed_seconds(start);
+
+    auto stats = mysql_client_pool.stats();
+    std::cout << "pool_contention: connections:" << limit_max_number << " workers:" << worker_number
+        << " " << query_number / seconds << " query/s"
+        << " fail_number:" << fail_number
+        << " created_number:" << stats.created_number << std::endl;
+    print_histogram("acquire_wait", mysql_client_pool.acquire_wait_histogram());
+
+    mysql_client_pool.close();
+    co_return RESULT_SUCCESS;
+}
+
+// the same rows through multi-row INSERT statements and through LOAD DATA LOCAL INFILE
+boost::asio::awaitable<conet::result<void>> bulk_load(unsigned short port, int row_number)
+{
+    std::vector<std::string> columns = {"id", "name", "value"};
+    auto make_row = [] (int i) -> std::vector<std::optional<std::string>>
+        {
+            return {std::to_string(i), "name" + std::to_string(i), std::string(32, 'v')};
+        };
+
+    conet::MysqlClient mysql_client;
+    RESULT_CO_CHECK(co_await mysql_client.connect(host, port, "root", "", "test"));
+
+    auto start = std::chrono::steady_clock::now();
+    conet::MysqlBulkInsertBuilder builder(mysql_client, "t", columns);
+    for (int i=0; i<row_number; ++i)
+    {
+        RESULT_CO_CHECK(builder.add_row(make_row(i)));
+    }
+    for (const auto &sql : builder.statements())
+    {
+        RESULT_CO_CHECK(co_await mysql_client.query(sql));
+    }
+    auto insert_seconds = elapsed_seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    conet::MysqlBulkLoader loader("t", columns);
+    RESULT_CO_CHECK(loader.start(host, port, "root", "", "test"));
+    for (int i=0; i<row_number; ++i)
+    {
+        RESULT_CO_CHECK(co_await loader.add_row(make_row(i)));
+    }
+    RESULT_CO_CHECK(co_await loader.finish());
+    auto load_seconds = elapsed_seconds(start);
+
+    std::cout << "bulk_load: rows:" << row_number
+        << " insert " << row_number / insert_seconds << " row/s,"
+        << " load_data " << row_number / load_seconds << " row/s,"
+        << " speedup:" << insert_seconds / load_seconds << std::endl;
+    co_return RESULT_SUCCESS;
+}
+
+// one shard per thread
+void sharded_pool_contention(unsigned short port, int query_number)
+{
+    const int thread_number = 4;
+    const int worker_number_per_thread = 16;
+
+    std::vector<std::unique_ptr<boost::asio::io_context>> io_context_group;
+    std::vector<boost::asio::any_io_executor> executors;
+    std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_guard_group;
+    for (int i=0; i<thread_number; ++i)
+    {
+        io_context_group.push_back(std::make_unique<boost::asio::io_context>(1));
+        executors.push_back(io_context_group.back()->get_executor());
+        work_guard_group.push_back(boost::asio::make_work_guard(*io_context_group.back()));
+    }
+
+    conet::ShardedMysqlClientPool mysql_client_pool(executors);
+    std::atomic_int finished_number = 0;
+    std::atomic_int fail_number = 0;
+    std::chrono::steady_clock::time_point start;
+
+    auto worker = [&] () -> boost::asio::awaitable<void>
+        {
+            for (int i=0; i<query_number / (thread_number * worker_number_per_thread); ++i)
+            {
+                auto get_result = co_await mysql_client_pool.get();
+                if (!get_result)
+                {
+                    ++fail_number;
+                    continue;
+                }
+
+                auto query_result = co_await get_result.value()->query("select 1");
+                if (!query_result)
+                    ++fail_number;
+            }
+
+            if (++finished_number == thread_number * worker_number_per_thread)
+            {
+                mysql_client_pool.close();
+                for (auto &work_guard : work_guard_group)
+                {
+                    work_guard.reset();
+                }
+            }
+        };
+
+    auto init = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init(host, port, "root", "", "test", 2, 2);
+            if (!init_result)
+            {
+                LOG(INFO) << init_result.error_info();
+                for (auto &work_guard : work_guard_group)
+                {
+                    work_guard.reset();
+                }
+                co_return;
+            }
+
+            start = std::chrono::steady_clock::now();
+            for (auto &io_context : io_context_group)
+            {
+                for (int i=0; i<worker_number_per_thread; ++i)
+                {
+                    boost::asio::co_spawn(*io_context, worker(), boost::asio::detached);
+                }
+            }
+        };
+
+    boost::asio::co_spawn(*io_context_group.front(), init(), boost::asio::detached);
+
+    std::vector<std::thread> thread_group;
+    for (auto &io_context : io_context_group)
+    {
+        thread_group.emplace_back([&io_context] { io_context->run(); });
+    }
+    for (auto &t : thread_group)
+    {
+        t.join();
+    }
+
+    auto seconds = elapsed_seconds(start);
+    auto stats = mysql_client_pool.stats();
+    std::cout << "sharded_pool_contention: threads:" << thread_number
+        << " connections:" << thread_number * 2
+        << " workers:" << thread_number * worker_number_per_thread
+        << " " << query_number / seconds << " query/s"
+        << " fail_number:" << fail_number
+        << " steal_number:" << mysql_client_pool.steal_number()
+        << " created_number:" << stats.created_number << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int query_number = argc > 1 ? std::stoi(argv[1]) : 20000;
+
+    // the query phases are printed at the end
+    conet::MysqlStatisticsOptions statistics_options;
+    statistics_options.is_enabled = true;
+    conet::MysqlStatistics::instance().set_options(statistics_options);
+
+    // the fake server has its own thread, like a real server would
+    boost::asio::io_context server_io_context;
+    auto server_work_guard = boost::asio::make_work_guard(server_io_context);
+    conet::MysqlFakeServer mysql_fake_server(server_io_context);
+    auto listen_result = mysql_fake_server.listen(host, 0);
+    if (!listen_result)
+    {
+        LOG(ERROR) << listen_result.error_info();
+        return 1;
+    }
+    mysql_fake_server.start();
+    std::thread server_thread([&server_io_context] { server_io_context.run(); });
+
+    boost::asio::io_context io_context;
+    conet::MysqlFakeServer row_fake_server(io_context);
+    auto row_listen_result = row_fake_server.listen(host, 0);
+    if (!row_listen_result)
+    {
+        LOG(ERROR) << row_listen_result.error_info();
+        return 1;
+    }
+    row_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    auto f = [&] () -> boost::asio::awaitable<conet::result<void>>
+        {
+            RESULT_CO_CHECK(co_await throughput(mysql_fake_server.port(), query_number));
+            RESULT_CO_CHECK(co_await per_row(row_fake_server, query_number));
+            RESULT_CO_CHECK(co_await pool_contention(io_context, mysql_client_pool, mysql_fake_server.port(), query_number));
+            RESULT_CO_CHECK(co_await bulk_load(mysql_fake_server.port(), query_number * 10));
+            co_return RESULT_SUCCESS;
+        };
+
+    boost::asio::co_spawn(io_context,
+        f(),
+        [](std::exception_ptr e, conet::result<void> result)
+        {
+            if (result.has_error())
+            {
+                LOG(INFO) << result.error_info();
+            }
+        });
+    io_context.run();
+
+    sharded_pool_contention(mysql_fake_server.port(), query_number);
+
+    std::cout << "query phases:" << std::endl;
+    auto &statistics = conet::MysqlStatistics::instance();
+    print_histogram("total", statistics.total_histogram());
+    for (std::size_t i=0; i<conet::mysql_query_phase_count; ++i)
+    {
+        auto phase = static_cast<conet::MysqlQueryPhase>(i);
+        print_histogram(conet::to_string(phase), statistics.phase_histogram(phase));
+    }
+
+    mysql_fake_server.close();
+    server_work_guard.reset();
+    server_thread.join();
+
+    return 0;
+}
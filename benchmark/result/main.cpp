@@ -0,0 +1,113 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "conet/result.h"
+
+// The success path of result<T> for a value without default constructor, like TcpClient from
+// TcpServer::accept(), against the unique_ptr box it used to be stored in. Counts allocations
+// through the global operator new. The error path is measured too, build with
+// -DCONET_DISABLE_ERROR_TRAIL to see it without the trail.
+// usage: result_benchmark [iteration_number]
+
+namespace {
+
+std::atomic_uint64_t allocation_number{0};
+
+struct Connection
+{
+    explicit Connection(int fd) : fd(fd) {}
+    int fd;
+    char buffer[64] = {};
+};
+
+// the previous storage of Result<T> for non-default-initializable T
+struct BoxedResult
+{
+    explicit BoxedResult(Connection &&x) : value(std::make_unique<Connection>(std::move(x))) {}
+    conet::result<void> base;
+    std::unique_ptr<Connection> value;
+};
+
+__attribute__((noinline)) conet::result<Connection> make_result(int fd)
+{
+    return Connection(fd);
+}
+
+__attribute__((noinline)) BoxedResult make_boxed(int fd)
+{
+    return BoxedResult(Connection(fd));
+}
+
+conet::result<int> forward_result(int fd)
+{
+    RESULT_AUTO(connection, make_result(fd));
+    return connection.fd;
+}
+
+// an error passing through four RESULT_CHECK hops, what a downstream outage costs per request
+__attribute__((noinline)) conet::result<void> fail(int depth)
+{
+    if (depth == 0)
+    {
+        boost::system::error_code ec(1, boost::system::generic_category());
+        return ec;
+    }
+    RESULT_CHECK(fail(depth - 1));
+    return {};
+}
+
+template<typename F>
+void run(const std::string &name, int iteration_number, F &&f)
+{
+    std::uint64_t checksum = 0;
+    auto allocation_begin = allocation_number.load();
+    auto begin = std::chrono::steady_clock::now();
+    for (int i=0; i<iteration_number; ++i)
+    {
+        checksum += f(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    auto allocations = allocation_number.load() - allocation_begin;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    std::cout << name << ": " << static_cast<double>(ns) / iteration_number << " ns/op, "
+        << static_cast<double>(allocations) / iteration_number << " allocations/op"
+        << " checksum " << checksum << std::endl;
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    ++allocation_number;
+    if (void *p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char *argv[])
+{
+    int iteration_number = argc > 1 ? std::stoi(argv[1]) : 10000000;
+
+    run("unique_ptr", iteration_number, [] (int i) { return make_boxed(i).value->fd; });
+    run("in_place", iteration_number, [] (int i) { return make_result(i).value().fd; });
+    run("in_place RESULT_AUTO", iteration_number, [] (int i) { return forward_result(i).value(); });
+    run("error 4 hops", iteration_number, [] (int i) { return fail(4).error_info().trail().size(); });
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "conet/metrics.h"
+#include "conet/runtime.h"
+
+// Scaling of a Runtime from 1 to N reactors, against one io_context run by the same number of
+// threads. Every coroutine does a little work and yields to its executor. Every 32nd step it
+// awaits a no-op on the next reactor, or on the shared io_context for the baseline.
+// usage: runtime_benchmark [max_reactor_number] [coroutine_number_per_reactor] [seconds]
+
+namespace {
+
+struct Load
+{
+    std::chrono::steady_clock::time_point deadline;
+    conet::Counter step_number;
+    std::atomic_int running_number{0};
+    // keeps work() from being optimized out
+    std::atomic_uint64_t seed{0};
+    std::promise<void> done;
+};
+
+std::uint64_t work(std::uint64_t seed)
+{
+    for (int i=0; i<64; ++i)
+    {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    return seed;
+}
+
+boost::asio::awaitable<int> remote_step()
+{
+    co_return 0;
+}
+
+// runtime is null for the shared io_context
+boost::asio::awaitable<void> worker(conet::Runtime *runtime, std::size_t index, Load &load)
+{
+    auto executor = co_await boost::asio::this_coro::executor;
+    std::uint64_t seed = index;
+    for (std::uint64_t step=1; ; ++step)
+    {
+        seed = work(seed);
+        if (step % 32 == 0 && runtime != nullptr)
+            co_await runtime->run_on((index + 1) % runtime->size(), remote_step());
+        else if (step % 32 == 0)
+            co_await boost::asio::co_spawn(executor, remote_step(), boost::asio::use_awaitable);
+        else
+            co_await boost::asio::post(executor, boost::asio::use_awaitable);
+        load.step_number.add();
+
+        if (step % 64 == 0 && std::chrono::steady_clock::now() >= load.deadline)
+            break;
+    }
+
+    load.seed ^= seed;
+    if (--load.running_number == 0)
+        load.done.set_value();
+}
+
+double run_runtime(std::size_t reactor_number, int coroutine_number, int seconds)
+{
+    conet::RuntimeOptions options;
+    options.reactor_number = reactor_number;
+    options.pin_threads = true;
+    conet::Runtime runtime(options);
+    auto start_result = runtime.start();
+    if (!start_result)
+    {
+        std::cerr << start_result.error_info() << std::endl;
+        return 0;
+    }
+
+    Load load;
+    load.running_number = static_cast<int>(reactor_number) * coroutine_number;
+    load.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    for (std::size_t i=0; i<reactor_number; ++i)
+    {
+        for (int j=0; j<coroutine_number; ++j)
+        {
+            boost::asio::co_spawn(runtime.executor(i), worker(&runtime, i, load), boost::asio::detached);
+        }
+    }
+    load.done.get_future().get();
+    return static_cast<double>(load.step_number.value()) / seconds;
+}
+
+double run_shared_io_context(std::size_t thread_number, int coroutine_number, int seconds)
+{
+    boost::asio::io_context io_context(static_cast<int>(thread_number));
+
+    Load load;
+    load.running_number = static_cast<int>(thread_number) * coroutine_number;
+    load.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    for (std::size_t i=0; i<thread_number; ++i)
+    {
+        for (int j=0; j<coroutine_number; ++j)
+        {
+            boost::asio::co_spawn(io_context, worker(nullptr, i, load), boost::asio::detached);
+        }
+    }
+
+    std::vector<std::thread> thread_group;
+    for (std::size_t i=0; i<thread_number; ++i)
+    {
+        thread_group.emplace_back([&io_context] { io_context.run(); });
+    }
+    for (auto &t : thread_group)
+    {
+        t.join();
+    }
+    return static_cast<double>(load.step_number.value()) / seconds;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::size_t max_reactor_number = argc > 1 ? std::stoul(argv[1]) : std::max(std::thread::hardware_concurrency(), 1u);
+    int coroutine_number = argc > 2 ? std::stoi(argv[2]) : 16;
+    int seconds = argc > 3 ? std::stoi(argv[3]) : 2;
+
+    std::cout << "max_reactor_number:" << max_reactor_number
+        << " coroutine_number_per_reactor:" << coroutine_number
+        << " seconds:" << seconds << std::endl;
+
+    // powers of two, then max_reactor_number
+    std::vector<std::size_t> reactor_number_group;
+    for (std::size_t n=1; n<max_reactor_number; n*=2)
+    {
+        reactor_number_group.push_back(n);
+    }
+    reactor_number_group.push_back(max_reactor_number);
+
+    for (auto n : reactor_number_group)
+    {
+        auto runtime_steps = run_runtime(n, coroutine_number, seconds);
+        auto shared_steps = run_shared_io_context(n, coroutine_number, seconds);
+        std::cout << "reactor_number:" << n
+            << " runtime step/s:" << runtime_steps
+            << " shared_io_context step/s:" << shared_steps << std::endl;
+    }
+
+    return 0;
+}
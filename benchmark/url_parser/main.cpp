@@ -0,0 +1,85 @@
+#include <chrono>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "conet/url_parser.h"
+
+// UrlParser against the std::regex parser it replaced, on the urls TcpClient and HttpClient see.
+// usage: url_parser_benchmark [iteration_number]
+
+namespace {
+
+struct RegexUrl
+{
+    std::string protocol;
+    std::string host;
+    std::string port;
+    std::string path;
+};
+
+bool regex_parse(const std::string &url, RegexUrl &regex_url)
+{
+    std::regex regex(R"##((?:(\w+):\/\/)?([^:\/]+):?(\d+)?(\/.*)?)##");
+    std::smatch smatch;
+    if (!std::regex_match(url, smatch, regex))
+        return false;
+
+    regex_url.protocol = smatch[1].str();
+    regex_url.host = smatch[2].str();
+    regex_url.port = smatch[3].str();
+    regex_url.path = smatch[4].str();
+    return true;
+}
+
+template<typename F>
+void run(const std::string &name, const std::vector<std::string> &urls, int iteration_number, F &&f)
+{
+    std::size_t checksum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i=0; i<iteration_number; ++i)
+    {
+        for (const auto &url : urls)
+        {
+            checksum += f(url);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    std::cout << name << ": " << ns / (static_cast<double>(iteration_number) * urls.size()) << " ns/url"
+        << " checksum " << checksum << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int iteration_number = argc > 1 ? std::stoi(argv[1]) : 100000;
+
+    std::vector<std::string> urls = {
+        "127.0.0.1:3306",
+        "http://127.0.0.1:8080/users/42",
+        "http://api.example.com/v1/items?limit=100&offset=200",
+        "localhost",
+    };
+
+    run("regex", urls, iteration_number, [] (const std::string &url)
+        {
+            RegexUrl regex_url;
+            if (!regex_parse(url, regex_url))
+                return std::size_t(0);
+            return regex_url.host.size() + regex_url.port.size();
+        });
+
+    run("url_parser", urls, iteration_number, [] (const std::string &url)
+        {
+            conet::UrlParser url_parser;
+            if (!url_parser.parse(url))
+                return std::size_t(0);
+            return url_parser.host().size() + url_parser.port().size();
+        });
+
+    return 0;
+}
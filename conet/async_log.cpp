@@ -0,0 +1,345 @@
+#include "async_log.h"
+
+#include <charconv>
+
+namespace conet {
+
+namespace {
+
+void write_to_glog(const AsyncLogSite &site, std::string_view message)
+{
+    google::LogMessage(site.file(), site.line(), site.severity()).stream() << message;
+}
+
+} // namespace
+
+bool AsyncLogSite::allow()
+{
+    auto &async_log = AsyncLog::global();
+    const auto &options = async_log.options();
+    if (options.max_per_second == 0)
+        return true;
+
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    auto window = window_.load(std::memory_order_relaxed);
+    if (window != now && window_.compare_exchange_strong(window, now, std::memory_order_relaxed))
+        window_count_.store(0, std::memory_order_relaxed);
+
+    auto count = window_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (count <= options.max_per_second)
+        return true;
+    if (options.sample_every > 0 && (count - options.max_per_second) % options.sample_every == 0)
+        return true;
+
+    suppressed_number_.fetch_add(1, std::memory_order_relaxed);
+    async_log.suppressed_number_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void AsyncLogRecord::clear()
+{
+    for (std::size_t i=0; i<error_info_number; ++i)
+    {
+        error_infos[i] = ErrorInfo();
+    }
+    site = nullptr;
+    suppressed_number = 0;
+    is_truncated = false;
+    arg_number = 0;
+    error_info_number = 0;
+    text_size = 0;
+}
+
+void AsyncLogRecord::format(std::string &out) const
+{
+    char buffer[64];
+    for (std::size_t i=0; i<arg_number; ++i)
+    {
+        const auto &arg = args[i];
+        switch (arg.type)
+        {
+        case ArgType::int64:
+        {
+            auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), arg.int64);
+            out.append(buffer, ptr);
+            break;
+        }
+        case ArgType::uint64:
+        {
+            auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), arg.uint64);
+            out.append(buffer, ptr);
+            break;
+        }
+        case ArgType::floating:
+        {
+            auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), arg.floating);
+            out.append(buffer, ptr);
+            break;
+        }
+        case ArgType::boolean:
+            out.push_back(arg.boolean ? '1' : '0');
+            break;
+        case ArgType::character:
+            out.push_back(arg.character);
+            break;
+        case ArgType::text:
+            out.append(text.data() + arg.text.offset, arg.text.size);
+            break;
+        case ArgType::error_info:
+        {
+            std::stringstream ss;
+            ss << error_infos[arg.error_info_index];
+            out += ss.str();
+            break;
+        }
+        }
+    }
+
+    if (is_truncated)
+        out += "...";
+    if (suppressed_number > 0)
+        out += " (suppressed " + std::to_string(suppressed_number) + ")";
+}
+
+AsyncLogLine::AsyncLogLine(AsyncLogSite &site) :
+    site_(site)
+{
+    auto &async_log = AsyncLog::global();
+    if (!async_log.is_running())
+    {
+        // an operator<< may log too, nothing is shared with other lines
+        stream_.emplace();
+        suppressed_number_ = site.take_suppressed_number();
+        return;
+    }
+
+    auto &ring = async_log.ring();
+    auto head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ring.records.size())
+    {
+        async_log.dropped_number_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    record_ = &ring.records[head % ring.records.size()];
+    head_ = &ring.head;
+    next_head_ = head + 1;
+
+    record_->site = &site;
+    record_->suppressed_number = site.take_suppressed_number();
+}
+
+AsyncLogLine::~AsyncLogLine()
+{
+    if (stream_)
+    {
+        if (suppressed_number_ > 0)
+            *stream_ << " (suppressed " << suppressed_number_ << ")";
+        AsyncLog::global().write(site_, stream_->view());
+        return;
+    }
+
+    if (record_ != nullptr)
+        head_->store(next_head_, std::memory_order_release);
+}
+
+AsyncLogRecord::Arg* AsyncLogLine::add_arg(AsyncLogRecord::ArgType type)
+{
+    if (record_->arg_number >= AsyncLogRecord::max_arg_number)
+    {
+        record_->is_truncated = true;
+        return nullptr;
+    }
+
+    auto &arg = record_->args[record_->arg_number++];
+    arg.type = type;
+    return &arg;
+}
+
+void AsyncLogLine::add_text(std::string_view value)
+{
+    auto size = std::min(value.size(), AsyncLogRecord::max_text_size - record_->text_size);
+    if (size < value.size())
+        record_->is_truncated = true;
+    if (size == 0)
+        return;
+
+    auto arg = add_arg(AsyncLogRecord::ArgType::text);
+    if (arg == nullptr)
+        return;
+
+    std::copy_n(value.data(), size, record_->text.data() + record_->text_size);
+    arg->text.offset = record_->text_size;
+    arg->text.size = size;
+    record_->text_size += size;
+}
+
+void AsyncLogLine::add_error_info(const ErrorInfo &error_info)
+{
+    if (record_->error_info_number >= AsyncLogRecord::max_error_info_number)
+    {
+        record_->is_truncated = true;
+        return;
+    }
+
+    auto arg = add_arg(AsyncLogRecord::ArgType::error_info);
+    if (arg == nullptr)
+        return;
+
+    arg->error_info_index = record_->error_info_number;
+    record_->error_infos[record_->error_info_number++] = error_info;
+}
+
+AsyncLog::AsyncLog() :
+    write_function_(write_to_glog)
+{
+
+}
+
+AsyncLog::~AsyncLog()
+{
+    stop();
+}
+
+AsyncLog& AsyncLog::global()
+{
+    static AsyncLog async_log;
+    return async_log;
+}
+
+void AsyncLog::set_write_function(WriteFunctionType write_function)
+{
+    write_function_ = write_function ? std::move(write_function) : write_to_glog;
+}
+
+void AsyncLog::start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (is_running())
+        return;
+
+    is_stopping_ = false;
+    writer_ = std::thread([this] { run(); });
+    is_running_.store(true, std::memory_order_release);
+}
+
+void AsyncLog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!is_running())
+            return;
+
+        is_running_.store(false, std::memory_order_release);
+        is_stopping_ = true;
+    }
+    condition_.notify_all();
+    writer_.join();
+}
+
+void AsyncLog::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!is_running())
+        return;
+
+    auto request = ++flush_request_;
+    condition_.notify_all();
+    condition_.wait(lock, [this, request] { return flush_done_ >= request; });
+}
+
+AsyncLogStats AsyncLog::stats() const
+{
+    AsyncLogStats stats;
+    stats.written_number = written_number_.load(std::memory_order_relaxed);
+    stats.suppressed_number = suppressed_number_.load(std::memory_order_relaxed);
+    stats.dropped_number = dropped_number_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+AsyncLog::RingHolder::~RingHolder()
+{
+    if (ring)
+        ring->is_closed.store(true, std::memory_order_release);
+}
+
+AsyncLog::Ring& AsyncLog::ring()
+{
+    thread_local RingHolder ring_holder;
+    if (ring_holder.ring == nullptr)
+    {
+        ring_holder.ring = std::make_shared<Ring>(std::max<std::size_t>(options_.ring_size, 1));
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(ring_holder.ring);
+    }
+    return *ring_holder.ring;
+}
+
+void AsyncLog::write(AsyncLogRecord &record, std::string &buffer)
+{
+    buffer.clear();
+    record.format(buffer);
+    write(*record.site, buffer);
+    record.clear();
+}
+
+void AsyncLog::write(const AsyncLogSite &site, std::string_view message)
+{
+    write_function_(site, message);
+    written_number_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::size_t AsyncLog::drain()
+{
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings = rings_;
+    }
+
+    std::string buffer;
+    std::size_t written_number = 0;
+    for (auto &ring : rings)
+    {
+        // read is_closed first, a thread that exits after it may still have published records
+        bool is_closed = ring->is_closed.load(std::memory_order_acquire);
+        auto tail = ring->tail.load(std::memory_order_relaxed);
+        auto head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail)
+        {
+            write(ring->records[tail % ring->records.size()], buffer);
+            ring->tail.store(tail + 1, std::memory_order_release);
+            ++written_number;
+        }
+
+        if (is_closed)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::erase(rings_, ring);
+        }
+    }
+
+    return written_number;
+}
+
+void AsyncLog::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        auto request = flush_request_;
+        bool is_stopping = is_stopping_;
+        lock.unlock();
+        drain();
+        lock.lock();
+
+        // flushes requested while stopping are answered by the last drain
+        flush_done_ = is_stopping ? flush_request_ : request;
+        condition_.notify_all();
+        if (is_stopping)
+            break;
+
+        condition_.wait_for(lock, options_.flush_interval, [this] { return is_stopping_ || flush_request_ != flush_done_; });
+    }
+}
+
+} // namespace conet
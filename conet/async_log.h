@@ -0,0 +1,294 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "error_info.h"
+
+// Like LOG(severity) for hot paths: each call site can be rate-limited, and once AsyncLog::global() is
+// started the arguments are captured into a per-thread ring buffer and formatted by a writer thread.
+// Arguments are not evaluated when the message is suppressed.
+//     ASYNC_LOG(WARNING) << "http handler fail. target:" << path << " " << r.error_info();
+#define ASYNC_LOG(severity) \
+    if (static conet::AsyncLogSite async_log_site(__FILE__, __LINE__, google::GLOG_ ## severity); !async_log_site.allow()) \
+    { \
+    } \
+    else \
+        conet::AsyncLogLine(async_log_site)
+
+namespace conet {
+
+struct AsyncLogOptions
+{
+    // records per thread. a full ring drops new records instead of blocking.
+    std::size_t ring_size = 256;
+    // messages each call site writes per second, zero is unlimited
+    std::uint32_t max_per_second = 0;
+    // over the limit every sample_every-th message still goes through, zero suppresses all
+    std::uint32_t sample_every = 0;
+    std::chrono::milliseconds flush_interval = std::chrono::milliseconds(50);
+};
+
+struct AsyncLogStats
+{
+    std::uint64_t written_number;
+    // rate-limited at the call site
+    std::uint64_t suppressed_number;
+    // the ring of the thread was full
+    std::uint64_t dropped_number;
+};
+
+class AsyncLogSite
+{
+public:
+    AsyncLogSite(const char *file, int line, google::LogSeverity severity) :
+        file_(file),
+        line_(line),
+        severity_(severity)
+    {
+    }
+
+    // counts the message against the rate limit, false when it is suppressed
+    bool allow();
+
+    const char* file() const { return file_; }
+    int line() const { return line_; }
+    google::LogSeverity severity() const { return severity_; }
+
+    // messages suppressed since the last one written
+    std::uint32_t take_suppressed_number() { return suppressed_number_.exchange(0, std::memory_order_relaxed); }
+
+private:
+    const char *file_;
+    int line_;
+    google::LogSeverity severity_;
+    std::atomic_int64_t window_{-1};
+    std::atomic_uint32_t window_count_{0};
+    std::atomic_uint32_t suppressed_number_{0};
+};
+
+// One message with its arguments in binary form, formatted when written.
+struct AsyncLogRecord
+{
+    static constexpr std::size_t max_arg_number = 16;
+    static constexpr std::size_t max_text_size = 256;
+    static constexpr std::size_t max_error_info_number = 2;
+
+    enum class ArgType : std::uint8_t
+    {
+        int64,
+        uint64,
+        floating,
+        boolean,
+        character,
+        text,
+        error_info,
+    };
+
+    struct Arg
+    {
+        ArgType type;
+        union
+        {
+            std::int64_t int64;
+            std::uint64_t uint64;
+            double floating;
+            bool boolean;
+            char character;
+            struct
+            {
+                std::uint16_t offset;
+                std::uint16_t size;
+            } text;
+            std::uint8_t error_info_index;
+        };
+    };
+
+    void clear();
+    void format(std::string &out) const;
+
+    AsyncLogSite *site = nullptr;
+    std::uint32_t suppressed_number = 0;
+    bool is_truncated = false;
+    std::uint8_t arg_number = 0;
+    std::uint8_t error_info_number = 0;
+    std::uint16_t text_size = 0;
+    std::array<Arg, max_arg_number> args;
+    // ErrorInfo is captured by reference count, its formatting is the expensive part
+    std::array<ErrorInfo, max_error_info_number> error_infos;
+    std::array<char, max_text_size> text;
+};
+
+class AsyncLogLine
+{
+public:
+    explicit AsyncLogLine(AsyncLogSite &site);
+    ~AsyncLogLine();
+
+    AsyncLogLine(const AsyncLogLine &) = delete;
+    AsyncLogLine& operator=(const AsyncLogLine &) = delete;
+
+    template<typename T>
+    AsyncLogLine& operator<<(const T &value)
+    {
+        if (stream_)
+        {
+            *stream_ << value;
+            return *this;
+        }
+        if (record_ == nullptr)
+            return *this;
+
+        using ValueType = std::remove_cvref_t<T>;
+        if constexpr (std::is_same_v<ValueType, bool>)
+        {
+            if (auto arg = add_arg(AsyncLogRecord::ArgType::boolean))
+                arg->boolean = value;
+        }
+        else if constexpr (std::is_same_v<ValueType, char>)
+        {
+            if (auto arg = add_arg(AsyncLogRecord::ArgType::character))
+                arg->character = value;
+        }
+        else if constexpr (std::is_integral_v<ValueType> && std::is_signed_v<ValueType>)
+        {
+            if (auto arg = add_arg(AsyncLogRecord::ArgType::int64))
+                arg->int64 = value;
+        }
+        else if constexpr (std::is_integral_v<ValueType>)
+        {
+            if (auto arg = add_arg(AsyncLogRecord::ArgType::uint64))
+                arg->uint64 = value;
+        }
+        else if constexpr (std::is_floating_point_v<ValueType>)
+        {
+            if (auto arg = add_arg(AsyncLogRecord::ArgType::floating))
+                arg->floating = value;
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+        {
+            add_text(std::string_view(value));
+        }
+        else if constexpr (std::is_same_v<ValueType, ErrorInfo>)
+        {
+            add_error_info(value);
+        }
+        else
+        {
+            std::stringstream ss;
+            ss << value;
+            add_text(ss.str());
+        }
+        return *this;
+    }
+
+private:
+    AsyncLogRecord::Arg* add_arg(AsyncLogRecord::ArgType type);
+    void add_text(std::string_view value);
+    void add_error_info(const ErrorInfo &error_info);
+
+    AsyncLogSite &site_;
+    AsyncLogRecord *record_ = nullptr;
+    // the ring slot is published by storing next_head_ into head_
+    std::atomic_uint64_t *head_ = nullptr;
+    std::uint64_t next_head_ = 0;
+    // until AsyncLog::start() the message is formatted in place, without the limits of a record
+    std::optional<std::ostringstream> stream_;
+    std::uint32_t suppressed_number_ = 0;
+};
+
+// Owns the per-thread rings and the writer thread. Until start() messages are written synchronously.
+class AsyncLog
+{
+public:
+    using WriteFunctionType = std::function<void(const AsyncLogSite &site, std::string_view message)>;
+
+    ~AsyncLog();
+
+    AsyncLog(const AsyncLog &) = delete;
+    AsyncLog& operator=(const AsyncLog &) = delete;
+
+    // used by ASYNC_LOG
+    static AsyncLog& global();
+
+    // call before logging starts, the options are read without a lock
+    void set_options(const AsyncLogOptions &options) { options_ = options; }
+    const AsyncLogOptions& options() const { return options_; }
+    // replaces google::LogMessage as the destination, for tests. an empty function restores it.
+    // call while stopped.
+    void set_write_function(WriteFunctionType write_function);
+
+    void start();
+    // writes what is left and joins the writer
+    void stop();
+    // waits until the records logged before the call are written
+    void flush();
+
+    AsyncLogStats stats() const;
+
+private:
+    friend class AsyncLogSite;
+    friend class AsyncLogLine;
+
+    AsyncLog();
+
+    struct Ring
+    {
+        explicit Ring(std::size_t size) : records(size) {}
+
+        std::vector<AsyncLogRecord> records;
+        // written by the owning thread
+        std::atomic_uint64_t head{0};
+        // written by the writer thread
+        std::atomic_uint64_t tail{0};
+        std::atomic_bool is_closed{false};
+    };
+
+    struct RingHolder
+    {
+        ~RingHolder();
+        std::shared_ptr<Ring> ring;
+    };
+
+    bool is_running() const { return is_running_.load(std::memory_order_acquire); }
+    // the ring of the calling thread, registered on first use
+    Ring& ring();
+    void write(AsyncLogRecord &record, std::string &buffer);
+    void write(const AsyncLogSite &site, std::string_view message);
+    // returns the number of records written
+    std::size_t drain();
+    void run();
+
+    AsyncLogOptions options_;
+    WriteFunctionType write_function_;
+    std::atomic_bool is_running_{false};
+    std::thread writer_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool is_stopping_ = false;
+    std::uint64_t flush_request_ = 0;
+    std::uint64_t flush_done_ = 0;
+    std::vector<std::shared_ptr<Ring>> rings_;
+
+    std::atomic_uint64_t written_number_{0};
+    std::atomic_uint64_t suppressed_number_{0};
+    std::atomic_uint64_t dropped_number_{0};
+};
+
+} // namespace conet
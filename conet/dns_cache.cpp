@@ -0,0 +1,202 @@
+#include "dns_cache.h"
+
+#include <charconv>
+
+#include "error.h"
+
+namespace conet {
+
+static std::optional<unsigned short> parse_port(const std::string &service)
+{
+    unsigned short port = 0;
+    auto [ptr, ec] = std::from_chars(service.data(), service.data() + service.size(), port);
+    if (ec != std::errc() || ptr != service.data() + service.size() || service.empty())
+        return std::nullopt;
+    return port;
+}
+
+DnsCache::DnsCache(const DnsCacheOptions &options) :
+    options_(options),
+    resolve_function_(system_resolve),
+    single_flight_(mutex_),
+    hit_number_(0),
+    negative_hit_number_(0),
+    miss_number_(0),
+    coalesced_number_(0),
+    numeric_number_(0)
+{
+
+}
+
+DnsCache& DnsCache::global()
+{
+    static DnsCache dns_cache;
+    return dns_cache;
+}
+
+void DnsCache::set_options(const DnsCacheOptions &options)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+}
+
+void DnsCache::set_resolve_function(ResolveFunctionType resolve_function)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    resolve_function_ = std::move(resolve_function);
+    entry_group_.clear();
+}
+
+boost::asio::awaitable<result<DnsCache::EndpointsType>> DnsCache::resolve(const std::string &host, const std::string &service)
+{
+    if (auto endpoint = parse_numeric(host, service))
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++numeric_number_;
+        }
+
+        EndpointsType endpoints(1, *endpoint);
+        co_return endpoints;
+    }
+
+    auto key = host + ":" + service;
+    SingleFlight<EndpointsType>::FlightPtr flight;
+    bool is_leader = false;
+    ResolveFunctionType resolve_function;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entry_group_.find(key);
+        if (it != entry_group_.end())
+        {
+            if (Clock::now() < it->second.expire_time)
+            {
+                if (it->second.value)
+                    ++hit_number_;
+                else
+                    ++negative_hit_number_;
+                co_return it->second.value;
+            }
+            entry_group_.erase(it);
+        }
+
+        flight = single_flight_.join(key, is_leader);
+        if (is_leader)
+            ++miss_number_;
+        else
+            ++coalesced_number_;
+        resolve_function = resolve_function_;
+    }
+
+    if (!is_leader)
+        co_return co_await single_flight_.wait(std::move(flight));
+
+    SingleFlight<EndpointsType>::Leader leader(single_flight_, key, flight);
+    auto resolve_result = co_await resolve_function(host, service);
+    if (!resolve_result)
+        resolve_result.error_info().add_pair("host", key);
+    leader.finish(resolve_result, [&] (auto &) { insert(key, resolve_result); });
+
+    co_return resolve_result;
+}
+
+void DnsCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry_group_.clear();
+}
+
+DnsCacheStats DnsCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    DnsCacheStats stats;
+    stats.hit_number = hit_number_;
+    stats.negative_hit_number = negative_hit_number_;
+    stats.miss_number = miss_number_;
+    stats.coalesced_number = coalesced_number_;
+    stats.numeric_number = numeric_number_;
+    stats.entry_number = entry_group_.size();
+    return stats;
+}
+
+DnsCache::ResolveFunctionType DnsCache::make_hosts_resolve_function(HostsType hosts)
+{
+    return [hosts = std::move(hosts)] (const std::string &host, const std::string &service) -> boost::asio::awaitable<result<EndpointsType>>
+        {
+            auto it = hosts.find(host);
+            auto port = parse_port(service);
+            if (it == hosts.end() || !port)
+            {
+                boost::system::error_code error_code;
+                static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+                error_code.assign(boost::asio::error::host_not_found, boost::asio::error::get_netdb_category(), &loc);
+                co_return error_code;
+            }
+
+            EndpointsType endpoints;
+            for (const auto &address : it->second)
+            {
+                endpoints.emplace_back(address, *port);
+            }
+            co_return endpoints;
+        };
+}
+
+std::optional<boost::asio::ip::tcp::endpoint> DnsCache::parse_numeric(const std::string &host, const std::string &service)
+{
+    auto port = parse_port(service);
+    if (!port)
+        return std::nullopt;
+
+    boost::system::error_code ec;
+    auto address = boost::asio::ip::make_address(host, ec);
+    if (ec)
+        return std::nullopt;
+
+    return boost::asio::ip::tcp::endpoint(address, *port);
+}
+
+// with the mutex held
+void DnsCache::insert(const std::string &key, const result<EndpointsType> &r)
+{
+    auto ttl = r ? options_.ttl : options_.negative_ttl;
+    if (ttl.count() <= 0)
+        return;
+
+    auto now = Clock::now();
+    if (entry_group_.size() >= options_.max_entry_number)
+    {
+        std::erase_if(entry_group_, [now] (const auto &p) { return p.second.expire_time <= now; });
+    }
+    // still full of live entries, any of them goes
+    if (entry_group_.size() >= options_.max_entry_number && !entry_group_.empty())
+    {
+        entry_group_.erase(entry_group_.begin());
+    }
+    entry_group_.erase(key);
+    entry_group_.emplace(key, Entry{r, now + ttl});
+}
+
+boost::asio::awaitable<result<DnsCache::EndpointsType>> DnsCache::system_resolve(const std::string &host, const std::string &service)
+{
+    boost::system::error_code ec;
+    boost::asio::ip::tcp::resolver resolver(co_await boost::asio::this_coro::executor);
+    auto results = co_await resolver.async_resolve(host, service, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    if (ec)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(ec.value(), ec.category(), &loc);
+        co_return error_code;
+    }
+
+    EndpointsType endpoints;
+    for (const auto &entry : results)
+    {
+        endpoints.push_back(entry.endpoint());
+    }
+    co_return endpoints;
+}
+
+} // namespace conet
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "result.h"
+#include "single_flight.h"
+
+namespace conet {
+
+struct DnsCacheOptions
+{
+    // the system resolver does not report the record TTL
+    std::chrono::milliseconds ttl = std::chrono::seconds(60);
+    // failures are remembered too, reconnect storms to a bad host do not reach the resolver. zero disables.
+    std::chrono::milliseconds negative_ttl = std::chrono::seconds(5);
+    std::size_t max_entry_number = 4096;
+};
+
+struct DnsCacheStats
+{
+    std::uint64_t hit_number;
+    std::uint64_t negative_hit_number;
+    std::uint64_t miss_number;
+    std::uint64_t coalesced_number;
+    // numeric host and port, resolved without lookup
+    std::uint64_t numeric_number;
+    std::size_t entry_number;
+};
+
+// Cache of host:service resolutions shared between threads. Concurrent misses of the same key
+// wait for the first lookup instead of starting their own.
+class DnsCache
+{
+public:
+    using EndpointsType = std::vector<boost::asio::ip::tcp::endpoint>;
+    using ResolveFunctionType = std::function<boost::asio::awaitable<result<EndpointsType>>(const std::string &host, const std::string &service)>;
+    using HostsType = std::unordered_map<std::string, std::vector<boost::asio::ip::address>>;
+
+    DnsCache(const DnsCacheOptions &options = {});
+
+    DnsCache(const DnsCache &) = delete;
+    DnsCache& operator=(const DnsCache &) = delete;
+
+    // used by TcpClient and HttpConnectionPool unless they are given another one
+    static DnsCache& global();
+
+    void set_options(const DnsCacheOptions &options);
+    // replaces the system resolver (tcp::resolver), see make_hosts_resolve_function()
+    void set_resolve_function(ResolveFunctionType resolve_function);
+
+    boost::asio::awaitable<result<EndpointsType>> resolve(const std::string &host, const std::string &service);
+
+    void clear();
+    DnsCacheStats stats() const;
+
+    // looks up a fixed table, for tests. the service has to be a port number.
+    static ResolveFunctionType make_hosts_resolve_function(HostsType hosts);
+    // the endpoint of an IP address and a port number
+    static std::optional<boost::asio::ip::tcp::endpoint> parse_numeric(const std::string &host, const std::string &service);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        result<EndpointsType> value;
+        Clock::time_point expire_time;
+    };
+
+    void insert(const std::string &key, const result<EndpointsType> &r);
+    static boost::asio::awaitable<result<EndpointsType>> system_resolve(const std::string &host, const std::string &service);
+
+    mutable std::mutex mutex_;
+    DnsCacheOptions options_;
+    ResolveFunctionType resolve_function_;
+    std::unordered_map<std::string, Entry> entry_group_;
+    SingleFlight<EndpointsType> single_flight_;
+    std::uint64_t hit_number_;
+    std::uint64_t negative_hit_number_;
+    std::uint64_t miss_number_;
+    std::uint64_t coalesced_number_;
+    std::uint64_t numeric_number_;
+};
+
+} // namespace conet
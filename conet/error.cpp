@@ -61,6 +61,16 @@ const char* mysql_category_impl::name() const noexcept
 
 std::string mysql_category_impl::message(int ev) const
 {
+    switch (ev)
+    {
+    case acquire_timeout:
+        return "acquire_timeout";
+    case pool_closed:
+        return "pool_closed";
+    case statement_not_executed:
+        return "statement_not_executed";
+    }
+
     return "conet.mysql error";
 }
 
@@ -39,7 +39,9 @@ const boost::system::error_category& network_category();
 
 enum mysql_errors
 {
-
+    acquire_timeout = -1,
+    pool_closed = -2,
+    statement_not_executed = -3,
 };
 
 class mysql_category_impl : public boost::system::error_category
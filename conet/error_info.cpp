@@ -10,119 +10,252 @@ static int64_t result_get_unique_error_id()
     return ++id;
 }
 
-ErrorInfo::ErrorInfo() :
-    error_id_(0)
+ErrorInfo::ErrorInfo(const boost::system::error_code &error_code) :
+    context_(new Context)
 {
+    context_->error_id = result_get_unique_error_id();
+    context_->error_code = error_code;
 }
 
-ErrorInfo::ErrorInfo(const boost::system::error_code &error_code) :
-    error_id_(result_get_unique_error_id()),
-    error_code_(error_code)
+ErrorInfo::ErrorInfo(boost::system::error_code &&error_code) :
+    context_(new Context)
 {
+    context_->error_id = result_get_unique_error_id();
+    context_->error_code = std::move(error_code);
 }
 
-ErrorInfo::ErrorInfo(boost::system::error_code &&error_code) :
-    error_id_(result_get_unique_error_id()),
-    error_code_(std::move(error_code))
+ErrorInfo::ErrorInfo(const ErrorInfo &other) noexcept :
+    context_(other.context_)
 {
+    if (context_ != nullptr)
+        context_->reference_number.fetch_add(1, std::memory_order_relaxed);
 }
 
-bool ErrorInfo::has_error() const
+ErrorInfo::ErrorInfo(ErrorInfo &&other) noexcept :
+    context_(std::exchange(other.context_, nullptr))
 {
-    return error_id_ != 0;
+}
+
+ErrorInfo& ErrorInfo::operator=(const ErrorInfo &other) noexcept
+{
+    if (context_ != other.context_)
+    {
+        release();
+        context_ = other.context_;
+        if (context_ != nullptr)
+            context_->reference_number.fetch_add(1, std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+ErrorInfo& ErrorInfo::operator=(ErrorInfo &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        context_ = std::exchange(other.context_, nullptr);
+    }
+    return *this;
+}
+
+ErrorInfo::~ErrorInfo()
+{
+    release();
+}
+
+const boost::system::error_code& ErrorInfo::error_code() const
+{
+    static const boost::system::error_code success;
+    return context_ != nullptr ? context_->error_code : success;
+}
+
+const std::string& ErrorInfo::error_message() const
+{
+    static const std::string empty;
+    return context_ != nullptr ? context_->error_message : empty;
+}
+
+const ErrorInfo::PairsType& ErrorInfo::pairs() const
+{
+    static const PairsType empty;
+    return context_ != nullptr ? context_->pairs : empty;
+}
+
+ErrorInfo::TrailType ErrorInfo::trail() const
+{
+    if (context_ == nullptr)
+        return {};
+    return TrailType(context_->trail.data(), context_->trail_size);
+}
+
+ErrorInfo& ErrorInfo::add_trail(const boost::source_location *location)
+{
+    auto &context = mutable_context();
+    if (context.trail_size < max_trail_size)
+        context.trail[context.trail_size++] = location;
+    else
+        ++context.dropped_trail_number;
+    return *this;
 }
 
 ErrorInfo& ErrorInfo::set_error_message(const std::string &error_message)
 {
-    error_message_ = error_message;
+    mutable_context().error_message = error_message;
     return *this;
 }
 
 ErrorInfo& ErrorInfo::set_error_message(std::string &&error_message)
 {
-    error_message_ = std::move(error_message);
+    mutable_context().error_message = std::move(error_message);
     return *this;
 }
 
+ErrorInfo::Context& ErrorInfo::mutable_context()
+{
+    if (context_ == nullptr)
+    {
+        context_ = new Context;
+    }
+    else if (context_->reference_number.load(std::memory_order_acquire) > 1)
+    {
+        auto context = new Context;
+        context->error_id = context_->error_id;
+        context->error_code = context_->error_code;
+        context->error_message = context_->error_message;
+        context->pairs = context_->pairs;
+        context->trail = context_->trail;
+        context->trail_size = context_->trail_size;
+        context->dropped_trail_number = context_->dropped_trail_number;
+        release();
+        context_ = context;
+    }
+    return *context_;
+}
+
+void ErrorInfo::release() noexcept
+{
+    if (context_ != nullptr && context_->reference_number.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete context_;
+    context_ = nullptr;
+}
+
+// index of each value among the values of its key, -1 for a key with a single value
+static std::vector<int> pair_indexes(const ErrorInfo::PairsType &pairs)
+{
+    std::vector<int> indexes(pairs.size(), -1);
+    for (std::size_t i=0; i<pairs.size(); ++i)
+    {
+        if (indexes[i] >= 0)
+            continue;
+
+        int index = 0;
+        for (std::size_t j=i+1; j<pairs.size(); ++j)
+        {
+            if (pairs[j].first == pairs[i].first)
+                indexes[j] = ++index;
+        }
+        if (index > 0)
+            indexes[i] = 0;
+    }
+    return indexes;
+}
+
 std::string ErrorInfo::beautiful_output() const
 {
     std::stringstream ss;
+    const auto &error_code = this->error_code();
 
     // error_id
-    ss << "error_id: " << error_id_;
+    ss << "error_id: " << error_id();
 
     // error_code
-    ss << "\nerror_num: " << error_code_.value()
-        << "\nerror_name: " << error_code_.message()
-        << "\nerror_category: " << error_code_.category().name();
-    if (error_code_.has_location())
+    ss << "\nerror_num: " << error_code.value()
+        << "\nerror_name: " << error_code.message()
+        << "\nerror_category: " << error_code.category().name();
+    if (error_code.has_location())
     {
-        ss << "\nlocation: " << error_code_.location().file_name() << ":" << error_code_.location().line()
-            << "\nfunction: " << error_code_.location().function_name();
+        ss << "\nlocation: " << error_code.location().file_name() << ":" << error_code.location().line()
+            << "\nfunction: " << error_code.location().function_name();
     }
-    
+
     // error_message
-    if (!error_message_.empty())
+    if (!error_message().empty())
     {
-        ss << "\nerror_message: " << error_message_ << "\n";
+        ss << "\nerror_message: " << error_message() << "\n";
     }
 
     // pairs
-    for (const auto &p : pairs_)
+    const auto &pairs = this->pairs();
+    auto indexes = pair_indexes(pairs);
+    for (std::size_t i=0; i<pairs.size(); ++i)
     {
-        if (p.second.size() == 1)
-            ss << "\n" << p.first << ": " << p.second[0];
+        if (indexes[i] < 0)
+            ss << "\n" << pairs[i].first << ": " << pairs[i].second;
         else
-        {
-            int index = 0;
-            for (const auto &v : p.second)
-            {
-                ss << "\n" << p.first << "[" << index << "]: " << v;
-                ++index;
-            }
-        }
+            ss << "\n" << pairs[i].first << "[" << indexes[i] << "]: " << pairs[i].second;
+    }
+
+    // trail
+    auto trail = this->trail();
+    for (std::size_t i=0; i<trail.size(); ++i)
+    {
+        ss << "\ncallstack";
+        if (trail.size() > 1)
+            ss << "[" << i << "]";
+        ss << ": " << trail[i]->file_name() << ":" << trail[i]->line();
     }
+    if (dropped_trail_number() > 0)
+        ss << "\ncallstack_dropped: " << dropped_trail_number();
 
     return ss.str();
 }
 
 std::ostream& operator<<(std::ostream &os, const ErrorInfo &other)
 {
+    const auto &error_code = other.error_code();
+
     // error_id
-    os << "[error_id=" << other.error_id_;
+    os << "[error_id=" << other.error_id();
 
     // error_code
-    os << ",error_num=" << other.error_code_.value()
-        << ",error_name=" << other.error_code_.message()
-        << ",error_category=" << other.error_code_.category().name();
-    if (other.error_code_.has_location())
+    os << ",error_num=" << error_code.value()
+        << ",error_name=" << error_code.message()
+        << ",error_category=" << error_code.category().name();
+    if (error_code.has_location())
     {
-        os << ",line=" << other.error_code_.location().line()
-            << ",file=" << other.error_code_.location().file_name()
-            << ",function=" << other.error_code_.location().function_name();
+        os << ",line=" << error_code.location().line()
+            << ",file=" << error_code.location().file_name()
+            << ",function=" << error_code.location().function_name();
     }
 
     // error_message
-    if (!other.error_message_.empty())
+    if (!other.error_message().empty())
     {
-        os << ",error_message=" << other.error_message_;
+        os << ",error_message=" << other.error_message();
     }
 
     // pairs
-    for (const auto &p : other.pairs_)
+    const auto &pairs = other.pairs();
+    auto indexes = pair_indexes(pairs);
+    for (std::size_t i=0; i<pairs.size(); ++i)
     {
-        if (p.second.size() == 1)
-            os << "," << p.first << ": " << p.second[0];
+        if (indexes[i] < 0)
+            os << "," << pairs[i].first << ": " << pairs[i].second;
         else
-        {
-            int index = 0;
-            for (const auto &v : p.second)
-            {
-                os << "," << p.first << "[" << index << "]: " << v;
-                ++index;
-            }
-        }
+            os << "," << pairs[i].first << "[" << indexes[i] << "]: " << pairs[i].second;
+    }
+
+    // trail
+    auto trail = other.trail();
+    for (std::size_t i=0; i<trail.size(); ++i)
+    {
+        os << ",callstack";
+        if (trail.size() > 1)
+            os << "[" << i << "]";
+        os << ": " << trail[i]->file_name() << ":" << trail[i]->line();
     }
+    if (other.dropped_trail_number() > 0)
+        os << ",callstack_dropped: " << other.dropped_trail_number();
     os << "]";
 
     return os;
@@ -1,73 +1,118 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <cstdint>
-#include <map>
 #include <string>
+#include <string_view>
+#include <span>
 #include <sstream>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <boost/assert/source_location.hpp>
 #include <boost/system.hpp>
 
 namespace conet {
 
+// A success is a null pointer. The error code, message and pairs of a failure live in one
+// block allocated when the error is created, shared by copies and copied before a change.
 class ErrorInfo
 {
 public:
-    ErrorInfo();
+    // in insertion order, a key may repeat
+    using PairsType = std::vector<std::pair<std::string, std::string>>;
+    // locations an error passed through, see RESULT_CHECK
+    using TrailType = std::span<const boost::source_location *const>;
+
+    static constexpr std::size_t max_trail_size = 16;
+
+    ErrorInfo() noexcept = default;
     ErrorInfo(const boost::system::error_code &error_code);
     ErrorInfo(boost::system::error_code &&error_code);
+    ErrorInfo(const ErrorInfo &other) noexcept;
+    ErrorInfo(ErrorInfo &&other) noexcept;
+    ErrorInfo& operator=(const ErrorInfo &other) noexcept;
+    ErrorInfo& operator=(ErrorInfo &&other) noexcept;
+    ~ErrorInfo();
 
-    bool has_error() const;
-    std::uint64_t error_id() const { return error_id_; }
-    const boost::system::error_code& error_code() const { return error_code_; }
-    const std::string& error_message() const { return error_message_; }
-    const std::map<std::string, std::vector<std::string>>& pairs() const { return pairs_; }
+    bool has_error() const { return context_ != nullptr && context_->error_id != 0; }
+    std::uint64_t error_id() const { return context_ != nullptr ? context_->error_id : 0; }
+    const boost::system::error_code& error_code() const;
+    const std::string& error_message() const;
+    const PairsType& pairs() const;
+    TrailType trail() const;
+    // locations past max_trail_size, only counted
+    std::uint32_t dropped_trail_number() const { return context_ != nullptr ? context_->dropped_trail_number : 0; }
 
     ErrorInfo& set_error_message(const std::string &error_message);
     ErrorInfo& set_error_message(std::string &&error_message);
 
+    // strings and arithmetic values are appended directly, other types through operator<<
     template<typename T>
-    ErrorInfo& add_pair(const std::string &key, const T &value)
+    ErrorInfo& add_pair(std::string_view key, T &&value)
     {
-        if constexpr (std::is_same_v<T, std::string>)
+        using ValueType = std::remove_cvref_t<T>;
+
+        auto &pairs = mutable_context().pairs;
+        if constexpr (std::is_same_v<ValueType, std::string>)
         {
-            pairs_[key].emplace_back(value);
+            pairs.emplace_back(key, std::forward<T>(value));
         }
-        else
+        else if constexpr (std::is_convertible_v<T, std::string_view>)
         {
-            std::stringstream ss;
-            ss << value;
-            pairs_[key].emplace_back(ss.str());
+            pairs.emplace_back(key, std::string_view(value));
         }
-
-        return *this;
-    }
-
-    template<typename T>
-    ErrorInfo& add_pair(const std::string &key, T &&value)
-    {
-        if constexpr (std::is_same_v<T, std::string>)
+        else if constexpr (std::is_same_v<ValueType, bool>)
+        {
+            pairs.emplace_back(key, value ? "1" : "0");
+        }
+        else if constexpr (std::is_same_v<ValueType, char>)
+        {
+            pairs.emplace_back(key, std::string(1, value));
+        }
+        else if constexpr (std::is_integral_v<ValueType> || std::is_floating_point_v<ValueType>)
         {
-            pairs_[key].emplace_back(std::forward<T>(value));
+            char buffer[64];
+            auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            pairs.emplace_back(key, std::string_view(buffer, ptr - buffer));
         }
         else
         {
             std::stringstream ss;
             ss << std::forward<T>(value);
-            pairs_[key].emplace_back(ss.str());
+            pairs.emplace_back(key, ss.str());
         }
 
         return *this;
     }
 
+    // location must outlive the error, a static one is rendered only when the error is printed
+    ErrorInfo& add_trail(const boost::source_location *location);
+
     friend std::ostream& operator<<(std::ostream &os, const ErrorInfo &other);
     std::string beautiful_output() const;
 
 private:
-    std::uint64_t error_id_;
-    boost::system::error_code error_code_;
-    std::string error_message_;
-    std::map<std::string, std::vector<std::string>> pairs_;
+    struct Context
+    {
+        std::atomic_uint32_t reference_number{1};
+        std::uint64_t error_id = 0;
+        boost::system::error_code error_code;
+        std::string error_message;
+        PairsType pairs;
+        std::array<const boost::source_location*, max_trail_size> trail;
+        std::uint32_t trail_size = 0;
+        std::uint32_t dropped_trail_number = 0;
+    };
+
+    // the context of this ErrorInfo alone, created or copied on demand
+    Context& mutable_context();
+    void release() noexcept;
+
+    Context *context_ = nullptr;
 };
 
 } // namespace conet
@@ -0,0 +1,129 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace conet {
+
+void Histogram::record(std::uint64_t value)
+{
+    buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    auto current_max = max_.load(std::memory_order_relaxed);
+    while (current_max < value && !max_.compare_exchange_weak(current_max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void Histogram::reset()
+{
+    for (auto &bucket : buckets_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    for (std::size_t i=0; i<bucket_count; ++i)
+    {
+        auto n = other.buckets_[i].load(std::memory_order_relaxed);
+        if (n != 0)
+            buckets_[i].fetch_add(n, std::memory_order_relaxed);
+    }
+    count_.fetch_add(other.count(), std::memory_order_relaxed);
+    sum_.fetch_add(other.sum(), std::memory_order_relaxed);
+
+    auto value = other.max();
+    auto current_max = max_.load(std::memory_order_relaxed);
+    while (current_max < value && !max_.compare_exchange_weak(current_max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+std::uint64_t Histogram::count() const
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::sum() const
+{
+    return sum_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::max() const
+{
+    return max_.load(std::memory_order_relaxed);
+}
+
+double Histogram::mean() const
+{
+    auto n = count();
+    if (n == 0)
+        return 0;
+    return static_cast<double>(sum()) / n;
+}
+
+std::uint64_t Histogram::percentile(double p) const
+{
+    auto n = count();
+    if (n == 0)
+        return 0;
+
+    auto rank = static_cast<std::uint64_t>(p / 100 * n);
+    if (rank >= n)
+        rank = n - 1;
+
+    std::uint64_t seen = 0;
+    for (std::size_t i=0; i<bucket_count; ++i)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen > rank)
+            return std::min(bucket_upper_bound(i), max());
+    }
+
+    return max();
+}
+
+std::vector<std::pair<std::uint64_t, std::uint64_t>> Histogram::buckets() const
+{
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> ret;
+    for (std::size_t i=0; i<bucket_count; ++i)
+    {
+        auto n = buckets_[i].load(std::memory_order_relaxed);
+        if (n != 0)
+            ret.emplace_back(bucket_upper_bound(i), n);
+    }
+    return ret;
+}
+
+std::size_t Histogram::bucket_index(std::uint64_t value)
+{
+    if (value < sub_bucket_count)
+        return static_cast<std::size_t>(value);
+
+    // the top sub_bucket_bits + 1 bits select the bucket
+    std::size_t shift = std::bit_width(value) - 1 - sub_bucket_bits;
+    std::size_t mantissa = static_cast<std::size_t>(value >> shift);
+    return (shift + 1) * sub_bucket_count + mantissa - sub_bucket_count;
+}
+
+std::uint64_t Histogram::bucket_upper_bound(std::size_t index)
+{
+    if (index < sub_bucket_count)
+        return index;
+
+    std::size_t shift = index / sub_bucket_count - 1;
+    std::uint64_t mantissa = index % sub_bucket_count + sub_bucket_count;
+    if (mantissa + 1 == 2 * sub_bucket_count && shift + sub_bucket_bits + 1 >= 64)
+        return std::numeric_limits<std::uint64_t>::max();
+    return ((mantissa + 1) << shift) - 1;
+}
+
+} // namespace conet
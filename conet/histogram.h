@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace conet {
+
+// Lock-free HDR-style histogram. Values below 2^sub_bucket_bits are exact,
+// above that every power of two is split into 2^sub_bucket_bits linear buckets,
+// the relative error is below 1/2^sub_bucket_bits.
+class Histogram
+{
+public:
+    static constexpr std::size_t sub_bucket_bits = 4;
+    static constexpr std::size_t sub_bucket_count = std::size_t(1) << sub_bucket_bits;
+    static constexpr std::size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+    Histogram() = default;
+    Histogram(const Histogram &) = delete;
+    Histogram& operator=(const Histogram &) = delete;
+
+    void record(std::uint64_t value);
+    void reset();
+    // adds the values recorded in other
+    void merge(const Histogram &other);
+
+    std::uint64_t count() const;
+    std::uint64_t sum() const;
+    std::uint64_t max() const;
+    double mean() const;
+
+    // upper bound of the bucket which contains the p-th percentile. p in [0, 100]
+    std::uint64_t percentile(double p) const;
+
+    // non-empty buckets as (upper bound, count)
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> buckets() const;
+
+private:
+    static std::size_t bucket_index(std::uint64_t value);
+    static std::uint64_t bucket_upper_bound(std::size_t index);
+
+    std::array<std::atomic_uint64_t, bucket_count> buckets_{};
+    std::atomic_uint64_t count_{0};
+    std::atomic_uint64_t sum_{0};
+    std::atomic_uint64_t max_{0};
+};
+
+} // namespace conet
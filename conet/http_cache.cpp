@@ -0,0 +1,255 @@
+#include "http_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+namespace conet {
+
+static std::string_view to_string_view(boost::beast::string_view s)
+{
+    return std::string_view(s.data(), s.size());
+}
+
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+        s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+        s.remove_suffix(1);
+    return s;
+}
+
+static bool iequals(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+        [] (char x, char y) { return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y)); });
+}
+
+static std::size_t entry_size(const std::string &key, const HttpCache::ResponseType &rsp)
+{
+    std::size_t size = key.capacity() + rsp.body().size();
+    for (const auto &field : rsp)
+    {
+        size += field.name_string().size() + field.value().size();
+    }
+    return size;
+}
+
+HttpCache::HttpCache(RequestFunctionType request_function, const HttpCacheOptions &options) :
+    request_function_(std::move(request_function)),
+    options_(options),
+    single_flight_(mutex_),
+    memory_size_(0),
+    hit_number_(0),
+    miss_number_(0),
+    coalesced_number_(0),
+    revalidated_number_(0),
+    evicted_number_(0)
+{
+
+}
+
+boost::asio::awaitable<result<HttpCache::ResultType>> HttpCache::co_get(const std::string &url)
+{
+    ResultType stale;
+    SingleFlight<ResultType>::FlightPtr flight;
+    bool is_leader = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entry_group_.find(url);
+        if (it != entry_group_.end())
+        {
+            auto entry_it = it->second;
+            if (Clock::now() < entry_it->expire_time)
+            {
+                ++hit_number_;
+                lru_.splice(lru_.begin(), lru_, entry_it);
+                co_return entry_it->value;
+            }
+            stale = entry_it->value;
+        }
+
+        flight = single_flight_.join(url, is_leader);
+        if (is_leader)
+            ++miss_number_;
+        else
+            ++coalesced_number_;
+    }
+
+    if (!is_leader)
+        co_return co_await single_flight_.wait(std::move(flight));
+
+    SingleFlight<ResultType>::Leader leader(single_flight_, url, flight);
+    auto load_result = co_await load(url, stale);
+    leader.finish(load_result);
+
+    RESULT_CO_CHECK(load_result, r.error_info().add_pair("url", url));
+    co_return load_result;
+}
+
+void HttpCache::invalidate(const std::string &url)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entry_group_.find(url);
+    if (it != entry_group_.end())
+        erase(it->second);
+}
+
+void HttpCache::invalidate_all()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    entry_group_.clear();
+    memory_size_ = 0;
+}
+
+HttpCacheStats HttpCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    HttpCacheStats stats;
+    stats.hit_number = hit_number_;
+    stats.miss_number = miss_number_;
+    stats.coalesced_number = coalesced_number_;
+    stats.revalidated_number = revalidated_number_;
+    stats.evicted_number = evicted_number_;
+    stats.entry_number = entry_group_.size();
+    stats.memory_size = memory_size_;
+    return stats;
+}
+
+HttpCacheControl HttpCache::parse_cache_control(std::string_view value)
+{
+    HttpCacheControl control;
+    while (!value.empty())
+    {
+        auto pos = value.find(',');
+        auto directive = trim(value.substr(0, pos));
+        value = pos == std::string_view::npos ? std::string_view() : value.substr(pos + 1);
+
+        auto equal_pos = directive.find('=');
+        auto name = trim(directive.substr(0, equal_pos));
+        if (iequals(name, "no-store"))
+        {
+            control.no_store = true;
+        }
+        else if (iequals(name, "no-cache"))
+        {
+            control.no_cache = true;
+        }
+        else if (iequals(name, "max-age") && equal_pos != std::string_view::npos)
+        {
+            auto argument = trim(directive.substr(equal_pos + 1));
+            if (argument.size() >= 2 && argument.front() == '"' && argument.back() == '"')
+                argument = argument.substr(1, argument.size() - 2);
+
+            std::int64_t seconds = 0;
+            auto [ptr, ec] = std::from_chars(argument.data(), argument.data() + argument.size(), seconds);
+            if (ec == std::errc() && ptr == argument.data() + argument.size() && seconds >= 0)
+                control.max_age = std::chrono::seconds(seconds);
+        }
+    }
+
+    return control;
+}
+
+boost::asio::awaitable<result<HttpCache::ResultType>> HttpCache::load(const std::string &url, const ResultType &stale)
+{
+    HttpRequest request;
+    request.url = url;
+    if (stale)
+    {
+        auto etag = stale->find(boost::beast::http::field::etag);
+        if (etag != stale->end())
+            request.headers.set(boost::beast::http::field::if_none_match, etag->value());
+        auto last_modified = stale->find(boost::beast::http::field::last_modified);
+        if (last_modified != stale->end())
+            request.headers.set(boost::beast::http::field::if_modified_since, last_modified->value());
+    }
+
+    RESULT_CO_AUTO(rsp, co_await request_function_(request));
+
+    if (stale && rsp.result() == boost::beast::http::status::not_modified)
+    {
+        // the 304 tells the new freshness, or the cached response does
+        auto ttl = rsp.find(boost::beast::http::field::cache_control) != rsp.end() ? freshness(rsp.base()) : freshness(stale->base());
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++revalidated_number_;
+        if (ttl)
+            insert(Entry{url, stale, Clock::now() + *ttl, entry_size(url, *stale)});
+        co_return stale;
+    }
+
+    auto value = std::make_shared<const ResponseType>(std::move(rsp));
+    if (value->result() == boost::beast::http::status::ok)
+    {
+        auto ttl = freshness(value->base());
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ttl)
+        {
+            insert(Entry{url, value, Clock::now() + *ttl, entry_size(url, *value)});
+        }
+        else
+        {
+            auto it = entry_group_.find(url);
+            if (it != entry_group_.end())
+                erase(it->second);
+        }
+    }
+
+    co_return value;
+}
+
+// nullopt when the response must not be cached. a response without freshness is kept only
+// when it can be revalidated.
+std::optional<std::chrono::milliseconds> HttpCache::freshness(const ResponseType::header_type &header) const
+{
+    auto control = parse_cache_control(to_string_view(header[boost::beast::http::field::cache_control]));
+    if (control.no_store)
+        return std::nullopt;
+
+    std::chrono::milliseconds ttl = options_.default_ttl;
+    if (control.no_cache)
+        ttl = std::chrono::milliseconds::zero();
+    else if (control.max_age)
+        ttl = *control.max_age;
+
+    bool has_validator = header.find(boost::beast::http::field::etag) != header.end() ||
+        header.find(boost::beast::http::field::last_modified) != header.end();
+    if (ttl.count() <= 0 && !has_validator)
+        return std::nullopt;
+
+    return ttl;
+}
+
+void HttpCache::insert(Entry &&entry)
+{
+    auto it = entry_group_.find(entry.key);
+    if (it != entry_group_.end())
+        erase(it->second);
+
+    if (entry.size > options_.memory_budget)
+        return;
+
+    while (!lru_.empty() && memory_size_ + entry.size > options_.memory_budget)
+    {
+        erase(std::prev(lru_.end()));
+        ++evicted_number_;
+    }
+
+    memory_size_ += entry.size;
+    lru_.push_front(std::move(entry));
+    entry_group_[lru_.front().key] = lru_.begin();
+}
+
+void HttpCache::erase(std::list<Entry>::iterator it)
+{
+    memory_size_ -= it->size;
+    entry_group_.erase(it->key);
+    lru_.erase(it);
+}
+
+} // namespace conet
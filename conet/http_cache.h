@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include "http_client.h"
+#include "single_flight.h"
+
+namespace conet {
+
+struct HttpCacheOptions
+{
+    std::size_t memory_budget = 64 * 1024 * 1024;
+    // freshness of responses without max-age. zero revalidates them on every get.
+    std::chrono::milliseconds default_ttl = std::chrono::milliseconds::zero();
+};
+
+struct HttpCacheStats
+{
+    std::uint64_t hit_number;
+    std::uint64_t miss_number;
+    std::uint64_t coalesced_number;
+    // stale entries confirmed by 304 Not Modified
+    std::uint64_t revalidated_number;
+    std::uint64_t evicted_number;
+    std::size_t entry_number;
+    std::size_t memory_size;
+};
+
+struct HttpCacheControl
+{
+    bool no_store = false;
+    bool no_cache = false;
+    std::optional<std::chrono::seconds> max_age;
+};
+
+// Read-through cache of GET responses in front of HttpClient.
+// A 200 response is fresh for its Cache-Control max-age. A stale entry with ETag or Last-Modified is
+// revalidated with If-None-Match / If-Modified-Since, a 304 keeps the cached response. Responses are
+// immutable and shared between callers. Concurrent misses of the same url wait for the first request.
+class HttpCache
+{
+public:
+    using ResponseType = boost::beast::http::response<boost::beast::http::string_body>;
+    using ResultType = std::shared_ptr<const ResponseType>;
+    using RequestFunctionType = std::function<boost::asio::awaitable<result<ResponseType>>(const HttpRequest &request)>;
+
+    template<typename Executor>
+    HttpCache(HttpClient<Executor> &http_client, const HttpCacheOptions &options = {}) :
+        HttpCache([&http_client] (const HttpRequest &request) { return http_client.co_request(request); }, options)
+    {
+    }
+
+    HttpCache(RequestFunctionType request_function, const HttpCacheOptions &options = {});
+
+    HttpCache(const HttpCache &) = delete;
+    HttpCache& operator=(const HttpCache &) = delete;
+
+    // responses other than 200 are returned but not cached
+    boost::asio::awaitable<result<ResultType>> co_get(const std::string &url);
+
+    void invalidate(const std::string &url);
+    void invalidate_all();
+
+    HttpCacheStats stats() const;
+
+    // unknown directives are ignored
+    static HttpCacheControl parse_cache_control(std::string_view value);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::string key;
+        ResultType value;
+        Clock::time_point expire_time;
+        std::size_t size;
+    };
+
+    boost::asio::awaitable<result<ResultType>> load(const std::string &url, const ResultType &stale);
+    std::optional<std::chrono::milliseconds> freshness(const ResponseType::header_type &header) const;
+
+    void insert(Entry &&entry);
+    void erase(std::list<Entry>::iterator it);
+
+    RequestFunctionType request_function_;
+    HttpCacheOptions options_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> entry_group_;
+    SingleFlight<ResultType> single_flight_;
+    std::size_t memory_size_;
+    std::uint64_t hit_number_;
+    std::uint64_t miss_number_;
+    std::uint64_t coalesced_number_;
+    std::uint64_t revalidated_number_;
+    std::uint64_t evicted_number_;
+};
+
+} // namespace conet
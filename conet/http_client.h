@@ -4,6 +4,13 @@
 #include <optional>
 #include <memory>
 #include <chrono>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include <cerrno>
+#include <limits>
+#include <string_view>
+#include <unistd.h>
 
 #include <boost/asio.hpp>
 #include <boost/beast/core.hpp>
@@ -14,57 +21,88 @@
 
 #include "url_parser.h"
 #include "error.h"
+#include "http_connection_pool.h"
 
 namespace conet {
 
+struct HttpRequest
+{
+    boost::beast::http::verb method = boost::beast::http::verb::get;
+    std::string url;
+    // Host and User-Agent are filled in when missing
+    boost::beast::http::fields headers;
+    std::string body;
+};
+
+struct HttpClientOptions
+{
+    // requests sent on one connection before reading the responses, used by co_request_all().
+    // only idempotent requests are pipelined, and only on connections that answered HTTP/1.1 keep-alive.
+    // one disables pipelining.
+    int pipeline_depth = 1;
+    // largest piece of body handed to a HttpBodySink, the memory used by a streamed response
+    std::size_t stream_buffer_size = 64 * 1024;
+};
+
+// receives a streamed response body piece by piece, a failed result aborts the response
+using HttpBodySink = std::function<boost::asio::awaitable<result<void>>(std::string_view data)>;
+
+// writes the body to fd, e.g. an opened file. the writes are blocking, meant for local files and pipes.
+inline HttpBodySink make_fd_body_sink(int fd)
+{
+    return [fd] (std::string_view data) -> boost::asio::awaitable<result<void>>
+        {
+            while (!data.empty())
+            {
+                auto n = ::write(fd, data.data(), data.size());
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+
+                    boost::system::error_code error_code;
+                    static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+                    error_code.assign(errno, boost::system::system_category(), &loc);
+                    co_return error_code;
+                }
+                data.remove_prefix(static_cast<std::size_t>(n));
+            }
+
+            co_return RESULT_SUCCESS;
+        };
+}
+
+// Requests share keep-alive connections per host:port, see HttpConnectionPool.
 template<typename Executor = boost::asio::any_io_executor>
 class HttpClient
 {
 public:
+    using RequestType = boost::beast::http::request<boost::beast::http::string_body>;
+    using ResponseType = boost::beast::http::response<boost::beast::http::string_body>;
+    using ResponseHeaderType = boost::beast::http::response_header<>;
+
     HttpClient(Executor &ex) :
         executor_(ex),
-        stream_(ex)
+        connection_pool_(ex)
     {
     }
 
+    void set_options(const HttpClientOptions &options) { options_ = options; }
+    const HttpClientOptions& options() const { return options_; }
+
     boost::asio::awaitable<result<std::string>> co_get(const std::string &url)
     {
-        UrlParser parser;
-        RESULT_CO_CHECK(parser.parse(url), r.error_info().add_pair("url", url));
-
-        boost::asio::ip::tcp::resolver resolver(stream_.get_executor());
-        auto results = co_await resolver.async_resolve(parser.host(), parser.service(), boost::asio::use_awaitable);
-        co_await stream_.async_connect(results, boost::asio::use_awaitable);
-
-        boost::beast::http::request<boost::beast::http::string_body> req;
-        boost::beast::flat_buffer rsp_buffer;
-        boost::beast::http::response<boost::beast::http::string_body> rsp;
-        req.method(boost::beast::http::verb::get);
-        req.target(std::string(parser.path()));
-        req.version(11);
-        req.set(boost::beast::http::field::host, std::string(parser.host()));
-        req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-        co_await boost::beast::http::async_write(stream_, req, boost::asio::use_awaitable);
-        co_await boost::beast::http::async_read(stream_, rsp_buffer, rsp, boost::asio::use_awaitable);
-
-        boost::system::error_code ec;
-        stream_.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
-        if (ec && ec != boost::beast::errc::not_connected)
-        {
-            boost::system::error_code error_code;
-            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
-            error_code.assign(ec.value(), ec.category(), &loc);
-            co_return error_code;
-        }
-
-        co_return rsp.body();
+        HttpRequest request;
+        request.url = url;
+        RESULT_CO_AUTO(rsp, co_await co_request(request));
+        co_return std::move(rsp.body());
     }
 
     boost::asio::awaitable<result<std::string>> co_get(const std::string &url, std::chrono::nanoseconds timeout)
     {
         using namespace boost::asio::experimental::awaitable_operators;
 
-        boost::asio::steady_timer timer(stream_.get_executor());
+        boost::asio::steady_timer timer(executor_);
         timer.expires_after(timeout);
         boost::system::error_code ec;
         std::variant<std::monostate, result<std::string>> result = co_await (timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec)) || co_get(url));
@@ -78,7 +116,7 @@ public:
                 error_code.assign(ec.value(), ec.category(), &loc);
                 co_return error_code;
             }
-            
+
             boost::system::error_code error_code;
             static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
             error_code.assign(error::timeout, error::network_category(), &loc);
@@ -88,9 +126,441 @@ public:
         co_return std::get<1>(std::move(result));
     }
 
+    // any status code is a success, the caller checks rsp.result()
+    boost::asio::awaitable<result<ResponseType>> co_request(const HttpRequest &request)
+    {
+        UrlParser parser;
+        RESULT_CO_CHECK(parser.parse(request.url), r.error_info().add_pair("url", request.url));
+
+        auto req = make_request(request, parser);
+        std::string host(parser.host());
+        std::string service(parser.service());
+        RESULT_CO_AUTO(rsp, co_await send(host, service, req), r.error_info().add_pair("url", request.url));
+        co_return std::move(rsp);
+    }
+
+    // Hands the body to sink while it is read, through a buffer of options().stream_buffer_size,
+    // for chunked and Content-Length bodies alike. Returns the header once the body is complete.
+    boost::asio::awaitable<result<ResponseHeaderType>> co_request_stream(const HttpRequest &request, const HttpBodySink &sink)
+    {
+        UrlParser parser;
+        RESULT_CO_CHECK(parser.parse(request.url), r.error_info().add_pair("url", request.url));
+
+        auto req = make_request(request, parser);
+        std::string host(parser.host());
+        std::string service(parser.service());
+        for (int attempt=0; ; ++attempt)
+        {
+            RESULT_CO_AUTO(connection, co_await connection_pool_.get(host, service), r.error_info().add_pair("url", request.url));
+
+            // nothing reached the sink yet when the header could not be read, the request can be sent again
+            bool is_header_received = false;
+            auto exchange_result = co_await stream_exchange(*connection, req, sink, is_header_received);
+            if (exchange_result || is_header_received || !connection->is_reused || attempt > 0 ||
+                !is_idempotent(req.method()) || !is_closed_by_peer(exchange_result.error_info().error_code()))
+            {
+                if (!exchange_result)
+                    exchange_result.error_info().add_pair("url", request.url);
+                co_return std::move(exchange_result);
+            }
+        }
+    }
+
+    // Sends all requests concurrently, one result per request in the same order.
+    // Each host gets at most max_connection_per_host connections, and up to options().pipeline_depth
+    // requests in flight on each of them.
+    boost::asio::awaitable<std::vector<result<ResponseType>>> co_request_all(const std::vector<HttpRequest> &requests)
+    {
+        auto batch = std::make_shared<Batch>();
+        batch->reqs.resize(requests.size());
+        batch->results.resize(requests.size());
+
+        std::unordered_map<std::string, std::shared_ptr<HostBatch>> host_batch_group;
+        std::vector<std::shared_ptr<HostBatch>> host_batches;
+        for (std::size_t i=0; i<requests.size(); ++i)
+        {
+            UrlParser parser;
+            auto parse_result = parser.parse(requests[i].url);
+            if (!parse_result)
+            {
+                parse_result.error_info().add_pair("url", requests[i].url);
+                batch->results[i].emplace(std::move(parse_result));
+                continue;
+            }
+            batch->reqs[i] = make_request(requests[i], parser);
+
+            std::string host(parser.host());
+            std::string service(parser.service());
+            auto &host_batch = host_batch_group[host + ":" + service];
+            if (host_batch == nullptr)
+            {
+                host_batch = std::make_shared<HostBatch>();
+                host_batch->host = std::move(host);
+                host_batch->service = std::move(service);
+                host_batches.push_back(host_batch);
+            }
+
+            // non-idempotent requests are never pipelined
+            auto &chunks = host_batch->chunks;
+            bool is_pipelined = options_.pipeline_depth > 1 && is_idempotent(requests[i].method);
+            if (chunks.empty() || !is_pipelined || !host_batch->is_last_chunk_open ||
+                static_cast<int>(chunks.back().size()) >= options_.pipeline_depth)
+            {
+                chunks.emplace_back();
+            }
+            chunks.back().push_back(i);
+            host_batch->is_last_chunk_open = is_pipelined;
+        }
+
+        co_return co_await wait_batch(batch, std::move(host_batches));
+    }
+
+    HttpConnectionPool& connection_pool() { return connection_pool_; }
+
 private:
+    struct Batch
+    {
+        std::vector<RequestType> reqs;
+        std::vector<std::optional<result<ResponseType>>> results;
+        std::atomic_int running_number = 0;
+        std::function<void(Batch &)> callback;
+    };
+
+    struct HostBatch
+    {
+        std::string host;
+        std::string service;
+        // request indexes, a chunk is pipelined on one connection
+        std::vector<std::vector<std::size_t>> chunks;
+        bool is_last_chunk_open = false;
+        std::atomic_size_t next_chunk = 0;
+    };
+
+    static RequestType make_request(const HttpRequest &request, const UrlParser &parser)
+    {
+        auto path = parser.path();
+        RequestType req(request.method, boost::beast::string_view(path.data(), path.size()), 11);
+        // "host?query" has no path
+        if (path.front() == '?')
+            req.target("/" + std::string(path));
+        for (const auto &field : request.headers)
+        {
+            req.insert(field.name_string(), field.value());
+        }
+        if (req.find(boost::beast::http::field::host) == req.end())
+        {
+            std::string host(parser.host());
+            if (host.find(':') != std::string::npos)
+                host = "[" + host + "]";
+            req.set(boost::beast::http::field::host, host);
+        }
+        if (req.find(boost::beast::http::field::user_agent) == req.end())
+            req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+        req.body() = request.body;
+        req.prepare_payload();
+        return req;
+    }
+
+    boost::asio::awaitable<std::vector<result<ResponseType>>> wait_batch(std::shared_ptr<Batch> batch, std::vector<std::shared_ptr<HostBatch>> host_batches)
+    {
+        return boost::asio::async_initiate<const boost::asio::use_awaitable_t<>, void(std::vector<result<ResponseType>>)>(
+            [this, batch, host_batches = std::move(host_batches)]<typename H> (H&& self) mutable
+            {
+                auto handler_ptr = make_recycling_shared<H>(std::forward<H>(self));
+                batch->callback = [handler_ptr] (Batch &batch) mutable
+                {
+                    std::vector<result<ResponseType>> results;
+                    results.reserve(batch.results.size());
+                    for (auto &r : batch.results)
+                    {
+                        results.push_back(std::move(*r));
+                    }
+
+                    auto executor = boost::asio::get_associated_executor(*handler_ptr);
+                    boost::asio::dispatch(executor, [handler_ptr, results = std::move(results)] () mutable
+                    {
+                        auto&& handler = std::move(*handler_ptr.get());
+                        handler(std::move(results));
+                    });
+                };
+
+                int worker_number = 0;
+                for (const auto &host_batch : host_batches)
+                {
+                    worker_number += static_cast<int>(std::min<std::size_t>(host_batch->chunks.size(), connection_pool_.options().max_connection_per_host));
+                }
+                if (worker_number == 0)
+                {
+                    batch->callback(*batch);
+                    return;
+                }
+
+                batch->running_number = worker_number;
+                for (const auto &host_batch : host_batches)
+                {
+                    auto n = std::min<std::size_t>(host_batch->chunks.size(), connection_pool_.options().max_connection_per_host);
+                    for (std::size_t i=0; i<n; ++i)
+                    {
+                        boost::asio::co_spawn(executor_, run_host_batch(batch, host_batch), boost::asio::detached);
+                    }
+                }
+            },
+            boost::asio::use_awaitable);
+    }
+
+    boost::asio::awaitable<void> run_host_batch(std::shared_ptr<Batch> batch, std::shared_ptr<HostBatch> host_batch)
+    {
+        while (true)
+        {
+            auto chunk_index = host_batch->next_chunk++;
+            if (chunk_index >= host_batch->chunks.size())
+                break;
+
+            const auto &chunk = host_batch->chunks[chunk_index];
+            if (chunk.size() == 1)
+                batch->results[chunk.front()].emplace(co_await send(host_batch->host, host_batch->service, batch->reqs[chunk.front()]));
+            else
+                co_await send_pipelined(*batch, host_batch->host, host_batch->service, chunk);
+        }
+
+        if (--batch->running_number == 0)
+        {
+            auto callback = std::move(batch->callback);
+            callback(*batch);
+        }
+    }
+
+    // A reused connection may have been closed by the server while idle, which shows up as a failure
+    // before any response. Idempotent requests are sent again once on a new connection.
+    boost::asio::awaitable<result<ResponseType>> send(const std::string &host, const std::string &service, const RequestType &req)
+    {
+        for (int attempt=0; ; ++attempt)
+        {
+            RESULT_CO_AUTO(connection, co_await connection_pool_.get(host, service));
+            auto exchange_result = co_await exchange(*connection, req);
+            if (exchange_result || !connection->is_reused || attempt > 0 || !is_idempotent(req.method()) ||
+                !is_closed_by_peer(exchange_result.error_info().error_code()))
+            {
+                co_return std::move(exchange_result);
+            }
+        }
+    }
+
+    // Writes the requests of the chunk back to back while reading the responses in order.
+    // Requests left without response are idempotent and sent again one by one.
+    boost::asio::awaitable<void> send_pipelined(Batch &batch, const std::string &host, const std::string &service, const std::vector<std::size_t> &chunk)
+    {
+        using namespace boost::asio::experimental::awaitable_operators;
+
+        std::size_t received_number = 0;
+        {
+            auto get_result = co_await connection_pool_.get(host, service);
+            if (!get_result)
+            {
+                for (auto index : chunk)
+                {
+                    batch.results[index].emplace(get_result.error_info());
+                }
+                co_return;
+            }
+            auto connection = std::move(get_result).value();
+
+            // the server has to show it keeps the connection open before more requests are queued on it
+            if (!connection->can_pipeline)
+            {
+                auto exchange_result = co_await exchange(*connection, batch.reqs[chunk.front()]);
+                if (exchange_result)
+                {
+                    batch.results[chunk.front()].emplace(std::move(exchange_result));
+                    received_number = 1;
+                }
+            }
+
+            if (received_number < chunk.size() && connection->can_pipeline)
+            {
+                std::vector<std::size_t> indexes(chunk.begin() + received_number, chunk.end());
+                co_await (write_requests(*connection, batch, indexes) && read_responses(*connection, batch, indexes, received_number));
+            }
+        }
+
+        for (std::size_t i=received_number; i<chunk.size(); ++i)
+        {
+            batch.results[chunk[i]].emplace(co_await send(host, service, batch.reqs[chunk[i]]));
+        }
+    }
+
+    boost::asio::awaitable<result<void>> write_requests(HttpConnection &connection, Batch &batch, const std::vector<std::size_t> &indexes)
+    {
+        for (auto index : indexes)
+        {
+            boost::system::error_code ec;
+            co_await boost::beast::http::async_write(connection.stream, batch.reqs[index], boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            if (ec)
+            {
+                // stop the reader, no more responses are coming
+                connection.stream.cancel();
+
+                boost::system::error_code error_code;
+                static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+                error_code.assign(ec.value(), ec.category(), &loc);
+                co_return error_code;
+            }
+        }
+
+        co_return RESULT_SUCCESS;
+    }
+
+    boost::asio::awaitable<result<void>> read_responses(HttpConnection &connection, Batch &batch, const std::vector<std::size_t> &indexes, std::size_t &received_number)
+    {
+        for (auto index : indexes)
+        {
+            auto read_result = co_await read_response(connection, batch.reqs[index].method());
+            if (!read_result)
+            {
+                // stop the writer, the connection is unusable
+                connection.stream.cancel();
+                co_return read_result;
+            }
+
+            batch.results[index].emplace(std::move(read_result));
+            ++received_number;
+
+            // the server ignores the requests after this one
+            if (!connection.keep_alive)
+                break;
+        }
+
+        co_return RESULT_SUCCESS;
+    }
+
+    boost::asio::awaitable<result<ResponseType>> exchange(HttpConnection &connection, const RequestType &req)
+    {
+        connection.keep_alive = false;
+
+        boost::system::error_code ec;
+        co_await boost::beast::http::async_write(connection.stream, req, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec)
+        {
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(ec.value(), ec.category(), &loc);
+            co_return error_code;
+        }
+
+        co_return co_await read_response(connection, req.method());
+    }
+
+    boost::asio::awaitable<result<ResponseType>> read_response(HttpConnection &connection, boost::beast::http::verb method)
+    {
+        connection.keep_alive = false;
+
+        boost::beast::http::response_parser<boost::beast::http::string_body> parser;
+        // a response to HEAD has Content-Length but no body
+        if (method == boost::beast::http::verb::head)
+            parser.skip(true);
+
+        boost::system::error_code ec;
+        co_await boost::beast::http::async_read(connection.stream, connection.buffer, parser, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec)
+        {
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(ec.value(), ec.category(), &loc);
+            co_return error_code;
+        }
+
+        auto rsp = parser.release();
+        connection.keep_alive = rsp.keep_alive();
+        if (connection.keep_alive && rsp.version() == 11)
+            connection.can_pipeline = true;
+        co_return std::move(rsp);
+    }
+
+    boost::asio::awaitable<result<ResponseHeaderType>> stream_exchange(HttpConnection &connection, const RequestType &req, const HttpBodySink &sink, bool &is_header_received)
+    {
+        connection.keep_alive = false;
+
+        boost::system::error_code ec;
+        co_await boost::beast::http::async_write(connection.stream, req, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec)
+        {
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(ec.value(), ec.category(), &loc);
+            co_return error_code;
+        }
+
+        boost::beast::http::response_parser<boost::beast::http::buffer_body> parser;
+        parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+        if (req.method() == boost::beast::http::verb::head)
+            parser.skip(true);
+
+        co_await boost::beast::http::async_read_header(connection.stream, connection.buffer, parser, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec)
+        {
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(ec.value(), ec.category(), &loc);
+            co_return error_code;
+        }
+        is_header_received = true;
+
+        // the parser fills the buffer and stops with need_buffer when it is full
+        std::vector<char> body_buffer(std::max<std::size_t>(options_.stream_buffer_size, 1));
+        while (!parser.is_done())
+        {
+            parser.get().body().data = body_buffer.data();
+            parser.get().body().size = body_buffer.size();
+            co_await boost::beast::http::async_read(connection.stream, connection.buffer, parser, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            if (ec == boost::beast::http::error::need_buffer)
+                ec = {};
+            if (ec)
+            {
+                boost::system::error_code error_code;
+                static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+                error_code.assign(ec.value(), ec.category(), &loc);
+                co_return error_code;
+            }
+
+            auto size = body_buffer.size() - parser.get().body().size;
+            if (size > 0)
+                RESULT_CO_CHECK(co_await sink(std::string_view(body_buffer.data(), size)));
+        }
+
+        connection.keep_alive = parser.get().keep_alive();
+        if (connection.keep_alive && parser.get().version() == 11)
+            connection.can_pipeline = true;
+        co_return std::move(parser.get().base());
+    }
+
+    static bool is_idempotent(boost::beast::http::verb method)
+    {
+        switch (method)
+        {
+        case boost::beast::http::verb::get:
+        case boost::beast::http::verb::head:
+        case boost::beast::http::verb::put:
+        case boost::beast::http::verb::delete_:
+        case boost::beast::http::verb::options:
+        case boost::beast::http::verb::trace:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool is_closed_by_peer(const boost::system::error_code &ec)
+    {
+        return ec == boost::beast::http::error::end_of_stream ||
+            ec == boost::asio::error::eof ||
+            ec == boost::asio::error::connection_reset ||
+            ec == boost::asio::error::connection_aborted ||
+            ec == boost::asio::error::broken_pipe;
+    }
+
     Executor& executor_;
-    boost::beast::tcp_stream stream_;
+    HttpClientOptions options_;
+    HttpConnectionPool connection_pool_;
 };
 
 } // namespace conet
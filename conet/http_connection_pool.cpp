@@ -0,0 +1,273 @@
+#include "http_connection_pool.h"
+
+#include "error.h"
+
+namespace conet {
+
+static ErrorInfo pool_closed_error()
+{
+    boost::system::error_code error_code;
+    static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+    error_code.assign(error::connection_closed, error::network_category(), &loc);
+
+    ErrorInfo error_info(error_code);
+    error_info.set_error_message("http connection pool closed");
+    return error_info;
+}
+
+HttpConnectionPool::HttpConnectionPool(boost::asio::io_context &io_context) :
+    HttpConnectionPool(io_context.get_executor())
+{
+
+}
+
+HttpConnectionPool::HttpConnectionPool(boost::asio::any_io_executor executor) :
+    strand_(boost::asio::make_strand(executor)),
+    dns_cache_(&DnsCache::global()),
+    is_closed_(false),
+    idle_number_(0),
+    waiting_number_(0),
+    created_number_(0),
+    reused_number_(0),
+    stale_number_(0),
+    closed_number_(0),
+    acquire_timeout_number_(0)
+{
+
+}
+
+boost::asio::awaitable<result<std::shared_ptr<HttpConnection>>> HttpConnectionPool::get(const std::string &host_name, const std::string &service)
+{
+    co_await boost::asio::post(strand_, boost::asio::use_awaitable);
+    if (is_closed_)
+        co_return pool_closed_error();
+
+    auto key = host_name + ":" + service;
+    auto &host = host_group_[key];
+
+    // most recently used first, it is the least likely to be closed by the server
+    while (!host.idle_group.empty())
+    {
+        auto idle_connection = std::move(host.idle_group.back());
+        host.idle_group.pop_back();
+        --idle_number_;
+
+        if (std::chrono::steady_clock::now() - idle_connection.idle_since >= options_.idle_timeout ||
+            !is_alive(idle_connection.connection->stream.socket()))
+        {
+            ++stale_number_;
+            ++closed_number_;
+            release_slot(host);
+            continue;
+        }
+
+        ++reused_number_;
+        idle_connection.connection->is_reused = true;
+        co_return make_shared_connection(std::move(idle_connection.connection));
+    }
+
+    if (host.current_number < options_.max_connection_per_host)
+    {
+        ++host.current_number;
+    }
+    else
+    {
+        if (options_.acquire_timeout.count() <= 0)
+        {
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(error::internal_error, error::conet_category(), &loc);
+
+            ErrorInfo error_info(error_code);
+            error_info.set_error_message("http connection limit");
+            error_info.add_pair("host", key);
+            error_info.add_pair("current_number", host.current_number);
+            co_return error_info;
+        }
+
+        // host is full, wait for put_back() or release_slot() in FIFO order
+        Waiter waiter(strand_);
+        waiter.timer.expires_after(options_.acquire_timeout);
+        host.waiter_group.push_back(&waiter);
+        ++waiting_number_;
+
+        boost::system::error_code ec;
+        co_await waiter.timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        co_await boost::asio::post(strand_, boost::asio::use_awaitable);
+        --waiting_number_;
+
+        if (waiter.connection)
+        {
+            ++reused_number_;
+            waiter.connection->is_reused = true;
+            co_return make_shared_connection(std::move(waiter.connection));
+        }
+
+        if (is_closed_)
+            co_return pool_closed_error();
+
+        if (!waiter.slot_granted)
+        {
+            host.waiter_group.remove(&waiter);
+            ++acquire_timeout_number_;
+
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(error::timeout, error::network_category(), &loc);
+
+            ErrorInfo error_info(error_code);
+            error_info.set_error_message("http connection acquire timeout");
+            error_info.add_pair("host", key);
+            error_info.add_pair("current_number", host.current_number);
+            co_return error_info;
+        }
+    }
+
+    // the slot is reserved, released on failure
+    auto create_result = co_await create(host_name, service);
+    co_await boost::asio::post(strand_, boost::asio::use_awaitable);
+    if (!create_result)
+    {
+        release_slot(host);
+        RESULT_CO_CHECK(std::move(create_result), r.error_info().add_pair("host", key));
+    }
+
+    ++created_number_;
+    auto connection = std::move(create_result).value();
+    connection->key = key;
+    co_return make_shared_connection(std::move(connection));
+}
+
+void HttpConnectionPool::close()
+{
+    boost::asio::dispatch(strand_, [this] ()
+    {
+        is_closed_ = true;
+        for (auto &p : host_group_)
+        {
+            auto &host = p.second;
+            host.current_number -= static_cast<int>(host.idle_group.size());
+            closed_number_ += host.idle_group.size();
+            host.idle_group.clear();
+
+            for (auto waiter : host.waiter_group)
+            {
+                waiter->timer.cancel();
+            }
+            host.waiter_group.clear();
+        }
+        idle_number_ = 0;
+    });
+}
+
+HttpConnectionPoolStats HttpConnectionPool::stats() const
+{
+    HttpConnectionPoolStats stats;
+    stats.idle_number = idle_number_;
+    stats.waiting_number = waiting_number_;
+    stats.created_number = created_number_;
+    stats.reused_number = reused_number_;
+    stats.stale_number = stale_number_;
+    stats.closed_number = closed_number_;
+    stats.acquire_timeout_number = acquire_timeout_number_;
+    return stats;
+}
+
+boost::asio::awaitable<result<std::unique_ptr<HttpConnection>>> HttpConnectionPool::create(const std::string &host, const std::string &service)
+{
+    RESULT_CO_AUTO(endpoints, co_await dns_cache_->resolve(host, service));
+
+    boost::system::error_code ec;
+    auto connection = std::make_unique<HttpConnection>(strand_.get_inner_executor());
+    connection->stream.expires_after(options_.connect_timeout);
+    co_await connection->stream.async_connect(endpoints, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    connection->stream.expires_never();
+    if (ec)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(ec.value(), ec.category(), &loc);
+        co_return error_code;
+    }
+
+    co_return std::move(connection);
+}
+
+std::shared_ptr<HttpConnection> HttpConnectionPool::make_shared_connection(std::unique_ptr<HttpConnection> &&connection)
+{
+    return std::shared_ptr<HttpConnection>(connection.release(), [this] (HttpConnection *raw_p)
+    {
+        boost::asio::dispatch(strand_,
+            [raw_p, this] ()
+            {
+                put_back(std::unique_ptr<HttpConnection>(raw_p));
+            });
+    });
+}
+
+void HttpConnectionPool::put_back(std::unique_ptr<HttpConnection> &&connection)
+{
+    auto &host = host_group_[connection->key];
+    if (is_closed_ || !connection->keep_alive || !connection->stream.socket().is_open())
+    {
+        ++closed_number_;
+        release_slot(host);
+        return;
+    }
+
+    // the next request starts from a clean state
+    connection->keep_alive = false;
+
+    if (!host.waiter_group.empty())
+    {
+        auto waiter = host.waiter_group.front();
+        host.waiter_group.pop_front();
+        waiter->connection = std::move(connection);
+        waiter->timer.cancel();
+        return;
+    }
+
+    if (static_cast<int>(host.idle_group.size()) >= options_.max_idle_per_host)
+    {
+        ++closed_number_;
+        release_slot(host);
+        return;
+    }
+
+    host.idle_group.push_back({std::move(connection), std::chrono::steady_clock::now()});
+    ++idle_number_;
+}
+
+// the connection occupying a slot is gone, let the first waiter create one
+void HttpConnectionPool::release_slot(Host &host)
+{
+    --host.current_number;
+    if (!host.waiter_group.empty() && !is_closed_ && host.current_number < options_.max_connection_per_host)
+    {
+        ++host.current_number;
+        auto waiter = host.waiter_group.front();
+        host.waiter_group.pop_front();
+        waiter->slot_granted = true;
+        waiter->timer.cancel();
+    }
+}
+
+// an idle keep-alive connection has nothing to read, unless the server closed it or sent garbage
+bool HttpConnectionPool::is_alive(boost::asio::ip::tcp::socket &socket)
+{
+    if (!socket.is_open())
+        return false;
+
+    boost::system::error_code ec;
+    socket.non_blocking(true, ec);
+    if (ec)
+        return false;
+
+    char c;
+    socket.receive(boost::asio::buffer(&c, 1), boost::asio::socket_base::message_peek, ec);
+    bool is_would_block = ec == boost::asio::error::would_block;
+    socket.non_blocking(false, ec);
+    return is_would_block;
+}
+
+} // namespace conet
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+
+#include "result.h"
+#include "dns_cache.h"
+
+namespace conet {
+
+struct HttpConnectionPoolOptions
+{
+    // connections to one host:port, get() waits when all of them are in use.
+    int max_connection_per_host = 8;
+    // returned connections above this number per host are closed. zero disables keep-alive.
+    int max_idle_per_host = 8;
+    // idle connections unused for longer are not reused, servers close idle keep-alive connections on their own.
+    std::chrono::milliseconds idle_timeout = std::chrono::seconds(30);
+    // how long get() waits when the host is full. zero fails immediately.
+    std::chrono::milliseconds acquire_timeout = std::chrono::seconds(3);
+    std::chrono::milliseconds connect_timeout = std::chrono::seconds(3);
+};
+
+struct HttpConnectionPoolStats
+{
+    int idle_number;
+    int waiting_number;
+    std::uint64_t created_number;
+    std::uint64_t reused_number;
+    // idle connections found closed by the server or expired
+    std::uint64_t stale_number;
+    std::uint64_t closed_number;
+    std::uint64_t acquire_timeout_number;
+};
+
+struct HttpConnection
+{
+    HttpConnection(boost::asio::any_io_executor executor) : stream(executor) {}
+
+    boost::beast::tcp_stream stream;
+    // bytes read past the last response
+    boost::beast::flat_buffer buffer;
+    std::string key;
+    // taken from the idle list, a failure may be the server closing it meanwhile
+    bool is_reused = false;
+    // set after a complete response that allows keep-alive, otherwise the connection is closed on return
+    bool keep_alive = false;
+    // the server answered HTTP/1.1 keep-alive, requests may be pipelined
+    bool can_pipeline = false;
+};
+
+// Keep-alive connections grouped by host:port.
+// Connections go back to the pool when the returned shared_ptr is released, the pool must outlive them.
+class HttpConnectionPool
+{
+public:
+    HttpConnectionPool(boost::asio::io_context &io_context);
+    HttpConnectionPool(boost::asio::any_io_executor executor);
+
+    HttpConnectionPool(const HttpConnectionPool &) = delete;
+    HttpConnectionPool& operator=(const HttpConnectionPool &) = delete;
+
+    void set_options(const HttpConnectionPoolOptions &options) { options_ = options; }
+    const HttpConnectionPoolOptions& options() const { return options_; }
+    // resolves through DnsCache::global() unless another cache is set
+    void set_dns_cache(DnsCache &dns_cache) { dns_cache_ = &dns_cache; }
+
+    // an idle connection of the host, or a new one. waits in FIFO order when the host is full.
+    boost::asio::awaitable<result<std::shared_ptr<HttpConnection>>> get(const std::string &host, const std::string &service);
+
+    // close idle connections and fail waiting get()
+    void close();
+
+    HttpConnectionPoolStats stats() const;
+    boost::asio::any_io_executor get_executor() const { return strand_.get_inner_executor(); }
+
+private:
+    struct IdleConnection
+    {
+        std::unique_ptr<HttpConnection> connection;
+        std::chrono::steady_clock::time_point idle_since;
+    };
+
+    struct Waiter
+    {
+        Waiter(boost::asio::strand<boost::asio::any_io_executor> &strand) : timer(strand) {}
+
+        boost::asio::steady_timer timer;
+        std::unique_ptr<HttpConnection> connection;
+        bool slot_granted = false;
+    };
+
+    struct Host
+    {
+        int current_number = 0;
+        std::list<IdleConnection> idle_group;
+        std::list<Waiter *> waiter_group;
+    };
+
+    boost::asio::awaitable<result<std::unique_ptr<HttpConnection>>> create(const std::string &host, const std::string &service);
+    std::shared_ptr<HttpConnection> make_shared_connection(std::unique_ptr<HttpConnection> &&connection);
+    void put_back(std::unique_ptr<HttpConnection> &&connection);
+    void release_slot(Host &host);
+    static bool is_alive(boost::asio::ip::tcp::socket &socket);
+
+    boost::asio::strand<boost::asio::any_io_executor> strand_;
+    HttpConnectionPoolOptions options_;
+    DnsCache *dns_cache_;
+    bool is_closed_;
+    std::unordered_map<std::string, Host> host_group_;
+    std::atomic_int idle_number_;
+    std::atomic_int waiting_number_;
+    std::atomic_uint64_t created_number_;
+    std::atomic_uint64_t reused_number_;
+    std::atomic_uint64_t stale_number_;
+    std::atomic_uint64_t closed_number_;
+    std::atomic_uint64_t acquire_timeout_number_;
+};
+
+} // namespace conet
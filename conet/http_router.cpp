@@ -0,0 +1,175 @@
+#include "http_router.h"
+
+#include <algorithm>
+
+#include "error.h"
+
+namespace conet {
+
+struct HttpRouter::Node
+{
+    // static segment, or the name of a parameter
+    std::string segment;
+    // sorted by segment
+    std::vector<std::unique_ptr<Node>> static_child_group;
+    std::unique_ptr<Node> param_child;
+    std::unique_ptr<Node> rest_child;
+    std::vector<std::pair<boost::beast::http::verb, HttpHandler>> handler_group;
+};
+
+static ErrorInfo invalid_pattern(std::string_view pattern, const std::string &message)
+{
+    boost::system::error_code error_code;
+    static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+    error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+    ErrorInfo error_info(error_code);
+    error_info.set_error_message(message);
+    error_info.add_pair("pattern", std::string(pattern));
+    return error_info;
+}
+
+std::string_view HttpRouteParams::get(std::string_view name) const
+{
+    for (std::size_t i=0; i<size_; ++i)
+    {
+        if (param_group_[i].first == name)
+            return param_group_[i].second;
+    }
+
+    return {};
+}
+
+HttpRouter::HttpRouter() :
+    root_(std::make_unique<Node>())
+{
+
+}
+
+HttpRouter::~HttpRouter() = default;
+
+result<void> HttpRouter::add(boost::beast::http::verb method, std::string_view pattern, HttpHandler handler)
+{
+    if (pattern.empty() || pattern.front() != '/')
+        return invalid_pattern(pattern, "http route must start with /");
+
+    Node *node = root_.get();
+    std::size_t param_number = 0;
+    auto rest = pattern.substr(1);
+    while (true)
+    {
+        auto pos = rest.find('/');
+        auto segment = rest.substr(0, pos);
+        bool is_last = pos == std::string_view::npos;
+
+        if (!segment.empty() && (segment.front() == ':' || segment.front() == '*'))
+        {
+            auto name = segment.substr(1);
+            if (name.empty())
+                return invalid_pattern(pattern, "http route parameter without name");
+            if (++param_number > HttpRouteParams::max_size)
+                return invalid_pattern(pattern, "too many http route parameters");
+            if (segment.front() == '*' && !is_last)
+                return invalid_pattern(pattern, "http route * must be the last segment");
+
+            auto &child = segment.front() == ':' ? node->param_child : node->rest_child;
+            if (child == nullptr)
+            {
+                child = std::make_unique<Node>();
+                child->segment = name;
+            }
+            else if (child->segment != name)
+            {
+                return invalid_pattern(pattern, "http route parameter named differently by another route");
+            }
+            node = child.get();
+        }
+        else
+        {
+            auto &group = node->static_child_group;
+            auto it = std::lower_bound(group.begin(), group.end(), segment,
+                [] (const std::unique_ptr<Node> &child, std::string_view segment) { return std::string_view(child->segment) < segment; });
+            if (it == group.end() || (*it)->segment != segment)
+            {
+                it = group.insert(it, std::make_unique<Node>());
+                (*it)->segment = segment;
+            }
+            node = it->get();
+        }
+
+        if (is_last)
+            break;
+        rest = rest.substr(pos + 1);
+    }
+
+    for (const auto &p : node->handler_group)
+    {
+        if (p.first == method)
+            return invalid_pattern(pattern, "http route already added");
+    }
+    node->handler_group.emplace_back(method, std::move(handler));
+
+    return RESULT_SUCCESS;
+}
+
+const HttpHandler* HttpRouter::find(boost::beast::http::verb method, std::string_view path, HttpRouteParams &params, bool &is_path_found) const
+{
+    params.size_ = 0;
+    is_path_found = false;
+    if (path.empty() || path.front() != '/')
+        return nullptr;
+
+    auto node = match(*root_, path.substr(1), false, params);
+    if (node == nullptr)
+        return nullptr;
+
+    is_path_found = true;
+    for (const auto &p : node->handler_group)
+    {
+        if (p.first == method)
+            return &p.second;
+    }
+
+    return nullptr;
+}
+
+// path is what is left after the segments matched so far, is_end when nothing is left.
+// the depth of a match is bounded by the number of segments of the routes.
+const HttpRouter::Node* HttpRouter::match(const Node &node, std::string_view path, bool is_end, HttpRouteParams &params)
+{
+    if (is_end)
+        return node.handler_group.empty() ? nullptr : &node;
+
+    auto pos = path.find('/');
+    auto segment = path.substr(0, pos);
+    bool is_next_end = pos == std::string_view::npos;
+    auto next_path = is_next_end ? std::string_view() : path.substr(pos + 1);
+
+    const auto &group = node.static_child_group;
+    auto it = std::lower_bound(group.begin(), group.end(), segment,
+        [] (const std::unique_ptr<Node> &child, std::string_view segment) { return std::string_view(child->segment) < segment; });
+    if (it != group.end() && (*it)->segment == segment)
+    {
+        if (auto found = match(**it, next_path, is_next_end, params))
+            return found;
+    }
+
+    if (node.param_child && !segment.empty())
+    {
+        auto size = params.size_;
+        params.param_group_[params.size_++] = {node.param_child->segment, segment};
+        if (auto found = match(*node.param_child, next_path, is_next_end, params))
+            return found;
+        params.size_ = size;
+    }
+
+    if (node.rest_child && !node.rest_child->handler_group.empty())
+    {
+        params.param_group_[params.size_++] = {node.rest_child->segment, path};
+        return node.rest_child.get();
+    }
+
+    return nullptr;
+}
+
+} // namespace conet
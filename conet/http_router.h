@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/beast/http.hpp>
+
+#include "result.h"
+#include "trace.h"
+
+namespace conet {
+
+using HttpServerRequest = boost::beast::http::request<boost::beast::http::string_body>;
+using HttpServerResponse = boost::beast::http::response<boost::beast::http::string_body>;
+
+// path parameters of the matched route, views into the request target
+class HttpRouteParams
+{
+public:
+    static constexpr std::size_t max_size = 8;
+
+    // empty when the route has no such parameter
+    std::string_view get(std::string_view name) const;
+
+    std::size_t size() const { return size_; }
+    const std::pair<std::string_view, std::string_view>& operator[](std::size_t index) const { return param_group_[index]; }
+
+    // the span of the request, the parent of the spans of the handler. empty when not sampled.
+    const TraceContext& trace_context() const { return trace_context_; }
+
+private:
+    friend class HttpRouter;
+    friend class HttpServer;
+
+    std::array<std::pair<std::string_view, std::string_view>, max_size> param_group_;
+    std::size_t size_ = 0;
+    TraceContext trace_context_;
+};
+
+// the response starts as an empty 200 with the keep-alive and version of the request.
+// a failed result is answered with 500.
+using HttpHandler = std::function<boost::asio::awaitable<result<void>>(const HttpServerRequest &req, HttpServerResponse &rsp, const HttpRouteParams &params)>;
+
+// Trie of path segments. "/users/:id" binds one segment to id, "/files/*path" binds the rest of the path.
+// A static segment is tried before a parameter, and a parameter before the rest of the path.
+// find() does not allocate, routes are added before the server starts.
+class HttpRouter
+{
+public:
+    HttpRouter();
+    ~HttpRouter();
+
+    HttpRouter(const HttpRouter &) = delete;
+    HttpRouter& operator=(const HttpRouter &) = delete;
+
+    // fails on a malformed pattern or a route already added
+    result<void> add(boost::beast::http::verb method, std::string_view pattern, HttpHandler handler);
+
+    // path without query string. nullptr when nothing matches, is_path_found tells 404 from 405.
+    const HttpHandler* find(boost::beast::http::verb method, std::string_view path, HttpRouteParams &params, bool &is_path_found) const;
+
+private:
+    struct Node;
+
+    static const Node* match(const Node &node, std::string_view path, bool is_end, HttpRouteParams &params);
+
+    std::unique_ptr<Node> root_;
+};
+
+} // namespace conet
@@ -0,0 +1,231 @@
+#include "http_server.h"
+
+#include <glog/logging.h>
+
+#include "async_log.h"
+#include "defer.h"
+#include "trace.h"
+
+namespace conet {
+
+// keeps the capacity of the body for the next message on the connection
+template<typename Message>
+static void reset_message(Message &message)
+{
+    auto body = std::move(message.body());
+    body.clear();
+    message = {};
+    message.body() = std::move(body);
+}
+
+HttpServer::HttpServer(boost::asio::io_context &io_context) :
+    HttpServer(std::vector<boost::asio::any_io_executor>{io_context.get_executor()})
+{
+
+}
+
+HttpServer::HttpServer(const std::vector<boost::asio::any_io_executor> &executors) :
+    tcp_server_(executors.front()),
+    port_(0),
+    next_shard_index_(0),
+    is_closed_(false),
+    connection_number_(0),
+    accepted_number_(0),
+    request_number_(0),
+    not_found_number_(0),
+    handler_error_number_(0)
+{
+    for (const auto &executor : executors)
+    {
+        shard_group_.push_back(std::make_unique<Shard>(executor));
+    }
+}
+
+result<void> HttpServer::route(boost::beast::http::verb method, std::string_view pattern, HttpHandler handler)
+{
+    return router_.add(method, pattern, std::move(handler));
+}
+
+result<void> HttpServer::listen(const std::string &ip, unsigned short port)
+{
+    RESULT_CHECK(tcp_server_.listen(ip, static_cast<short>(port)));
+    RESULT_AUTO(endpoint, tcp_server_.local_endpoint());
+    port_ = endpoint.port();
+
+    return RESULT_SUCCESS;
+}
+
+void HttpServer::start()
+{
+    boost::asio::co_spawn(shard_group_.front()->executor, run(), boost::asio::detached);
+}
+
+void HttpServer::close()
+{
+    is_closed_ = true;
+    boost::asio::dispatch(shard_group_.front()->executor, [this] ()
+    {
+        tcp_server_.close();
+    });
+
+    // a session waiting for the next request stops, one inside a handler stops after its response
+    for (auto &shard : shard_group_)
+    {
+        boost::asio::dispatch(shard->executor, [shard = shard.get()] ()
+        {
+            for (auto stream : shard->session_group)
+            {
+                stream->cancel();
+            }
+        });
+    }
+}
+
+HttpServerStats HttpServer::stats() const
+{
+    HttpServerStats stats;
+    stats.connection_number = connection_number_;
+    stats.accepted_number = accepted_number_;
+    stats.request_number = request_number_;
+    stats.not_found_number = not_found_number_;
+    stats.handler_error_number = handler_error_number_;
+    return stats;
+}
+
+boost::asio::awaitable<void> HttpServer::run()
+{
+    while (!is_closed_)
+    {
+        auto &shard = *shard_group_[next_shard_index_];
+        next_shard_index_ = (next_shard_index_ + 1) % shard_group_.size();
+
+        auto accept_result = co_await tcp_server_.accept(shard.executor);
+        if (!accept_result)
+        {
+            if (is_closed_)
+                break;
+
+            ASYNC_LOG(INFO) << "http server accept fail. " << accept_result.error_info();
+            continue;
+        }
+
+        ++accepted_number_;
+        auto tcp_client = std::move(accept_result).value();
+        boost::system::error_code ec;
+        tcp_client.socket().set_option(boost::asio::ip::tcp::no_delay(true), ec);
+        boost::asio::co_spawn(shard.executor, session(shard, std::move(tcp_client)), boost::asio::detached);
+    }
+}
+
+boost::asio::awaitable<void> HttpServer::session(Shard &shard, TcpClient tcp_client)
+{
+    boost::beast::tcp_stream stream(std::move(tcp_client.socket()));
+    auto buffer = get_buffer(shard);
+    shard.session_group.insert(&stream);
+    ++connection_number_;
+    DEFER(
+        shard.session_group.erase(&stream);
+        --connection_number_;
+        put_buffer(shard, std::move(buffer));
+    );
+
+    auto &req = buffer->request;
+    auto &rsp = buffer->response;
+    int request_number = 0;
+    while (!is_closed_)
+    {
+        reset_message(req);
+        reset_message(rsp);
+
+        boost::beast::http::request_parser<boost::beast::http::string_body> parser(std::move(req));
+        parser.body_limit(options_.max_body_size);
+
+        boost::system::error_code ec;
+        stream.expires_after(options_.keep_alive_timeout);
+        co_await boost::beast::http::async_read(stream, buffer->read_buffer, parser, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec)
+            break;
+
+        req = parser.release();
+        ++request_number;
+        ++request_number_;
+
+        rsp.result(boost::beast::http::status::ok);
+        rsp.version(req.version());
+        rsp.keep_alive(req.keep_alive());
+        co_await handle(req, rsp);
+        if (is_closed_ || (options_.max_request_per_connection > 0 && request_number >= options_.max_request_per_connection))
+            rsp.keep_alive(false);
+        rsp.prepare_payload();
+
+        stream.expires_after(options_.keep_alive_timeout);
+        co_await boost::beast::http::async_write(stream, rsp, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec || !rsp.keep_alive())
+            break;
+    }
+
+    boost::system::error_code ec;
+    stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+}
+
+boost::asio::awaitable<void> HttpServer::handle(const HttpServerRequest &req, HttpServerResponse &rsp)
+{
+    std::string_view path(req.target().data(), req.target().size());
+    auto query_pos = path.find('?');
+    if (query_pos != std::string_view::npos)
+        path = path.substr(0, query_pos);
+
+    HttpRouteParams params;
+    bool is_path_found = false;
+    auto handler = router_.find(req.method(), path, params, is_path_found);
+    if (handler == nullptr)
+    {
+        ++not_found_number_;
+        rsp.result(is_path_found ? boost::beast::http::status::method_not_allowed : boost::beast::http::status::not_found);
+        co_return;
+    }
+
+    // the root of a trace. the handler is not traced itself, it gets the context through params
+    // instead of the thread, which runs other coroutines while the handler waits.
+    TraceSpan span("HttpServer::handle", Tracer::global().sample());
+    params.trace_context_ = span.context();
+    span.suspend();
+    auto handle_result = co_await (*handler)(req, rsp, params);
+    span.resume();
+    if (!handle_result)
+    {
+        ++handler_error_number_;
+        ASYNC_LOG(WARNING) << "http handler fail. target:" << path << " " << handle_result.error_info();
+
+        reset_message(rsp);
+        rsp.result(boost::beast::http::status::internal_server_error);
+        rsp.version(req.version());
+        rsp.keep_alive(req.keep_alive());
+    }
+}
+
+std::unique_ptr<HttpServer::Buffer> HttpServer::get_buffer(Shard &shard)
+{
+    if (shard.buffer_group.empty())
+        return std::make_unique<Buffer>();
+
+    auto buffer = std::move(shard.buffer_group.back());
+    shard.buffer_group.pop_back();
+    return buffer;
+}
+
+void HttpServer::put_buffer(Shard &shard, std::unique_ptr<Buffer> &&buffer)
+{
+    if (static_cast<int>(shard.buffer_group.size()) >= options_.max_pooled_buffer_number ||
+        buffer->read_buffer.capacity() > options_.max_pooled_buffer_size ||
+        buffer->request.body().capacity() > options_.max_pooled_buffer_size ||
+        buffer->response.body().capacity() > options_.max_pooled_buffer_size)
+    {
+        return;
+    }
+
+    buffer->read_buffer.clear();
+    shard.buffer_group.push_back(std::move(buffer));
+}
+
+} // namespace conet
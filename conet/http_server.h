@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include "result.h"
+#include "tcp_server.h"
+#include "http_router.h"
+
+namespace conet {
+
+struct HttpServerOptions
+{
+    // idle time allowed between requests on a keep-alive connection, and to read or write one message
+    std::chrono::milliseconds keep_alive_timeout = std::chrono::seconds(30);
+    std::uint64_t max_body_size = 1024 * 1024;
+    // requests served on one connection before it is closed. zero means no limit.
+    int max_request_per_connection = 0;
+    // buffers kept per executor for the next connections
+    int max_pooled_buffer_number = 256;
+    // buffers grown above this are freed instead of pooled
+    std::size_t max_pooled_buffer_size = 64 * 1024;
+};
+
+struct HttpServerStats
+{
+    int connection_number;
+    std::uint64_t accepted_number;
+    std::uint64_t request_number;
+    std::uint64_t not_found_number;
+    std::uint64_t handler_error_number;
+};
+
+// HTTP/1.1 server with keep-alive, routing with HttpRouter.
+// Connections are spread round-robin over the executors. Each executor is expected to be run
+// by a single thread (e.g. one io_context per thread), the buffers and connections of an executor
+// are only touched by its own thread. An executor gets work only when a connection is spread to it,
+// keep its io_context running with a work guard until close().
+// Routes are added before start(), the server must outlive the executors.
+class HttpServer
+{
+public:
+    HttpServer(boost::asio::io_context &io_context);
+    // accepts on the first executor
+    HttpServer(const std::vector<boost::asio::any_io_executor> &executors);
+
+    HttpServer(const HttpServer &) = delete;
+    HttpServer& operator=(const HttpServer &) = delete;
+
+    void set_options(const HttpServerOptions &options) { options_ = options; }
+    const HttpServerOptions& options() const { return options_; }
+
+    result<void> route(boost::beast::http::verb method, std::string_view pattern, HttpHandler handler);
+    HttpRouter& router() { return router_; }
+
+    // port 0 picks a free port, see port()
+    result<void> listen(const std::string &ip, unsigned short port);
+    // accept connections in background
+    void start();
+    // stop accepting and close every connection once its current request is answered
+    void close();
+
+    unsigned short port() const { return port_; }
+    HttpServerStats stats() const;
+
+private:
+    struct Buffer
+    {
+        boost::beast::flat_buffer read_buffer;
+        HttpServerRequest request;
+        HttpServerResponse response;
+    };
+
+    struct Shard
+    {
+        Shard(boost::asio::any_io_executor executor) : executor(executor) {}
+
+        boost::asio::any_io_executor executor;
+        std::vector<std::unique_ptr<Buffer>> buffer_group;
+        std::unordered_set<boost::beast::tcp_stream *> session_group;
+    };
+
+    boost::asio::awaitable<void> run();
+    boost::asio::awaitable<void> session(Shard &shard, TcpClient tcp_client);
+    boost::asio::awaitable<void> handle(const HttpServerRequest &req, HttpServerResponse &rsp);
+    std::unique_ptr<Buffer> get_buffer(Shard &shard);
+    void put_buffer(Shard &shard, std::unique_ptr<Buffer> &&buffer);
+
+    std::vector<std::unique_ptr<Shard>> shard_group_;
+    TcpServer tcp_server_;
+    HttpServerOptions options_;
+    HttpRouter router_;
+    unsigned short port_;
+    std::size_t next_shard_index_;
+    std::atomic_bool is_closed_;
+    std::atomic_int connection_number_;
+    std::atomic_uint64_t accepted_number_;
+    std::atomic_uint64_t request_number_;
+    std::atomic_uint64_t not_found_number_;
+    std::atomic_uint64_t handler_error_number_;
+};
+
+} // namespace conet
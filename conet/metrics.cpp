@@ -0,0 +1,231 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace conet {
+
+MetricSample MetricSample::from_histogram(std::string name, std::string help, MetricLabels labels, const Histogram &histogram)
+{
+    MetricSample sample;
+    sample.name = std::move(name);
+    sample.help = std::move(help);
+    sample.type = MetricType::summary;
+    sample.labels = std::move(labels);
+    sample.count = histogram.count();
+    sample.sum = histogram.sum();
+    for (double quantile : {0.5, 0.9, 0.99})
+    {
+        sample.quantiles.emplace_back(quantile, histogram.percentile(quantile * 100));
+    }
+    return sample;
+}
+
+std::size_t metrics_shard_index()
+{
+    static std::atomic_size_t next_index{0};
+    thread_local std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+std::uint64_t Counter::value() const
+{
+    std::uint64_t value = 0;
+    for (const auto &shard : shards_)
+    {
+        value += shard.value.load(std::memory_order_relaxed);
+    }
+    return value;
+}
+
+void ShardedHistogram::collect(Histogram &out) const
+{
+    for (const auto &shard : shards_)
+    {
+        out.merge(shard);
+    }
+}
+
+MetricsRegistry& MetricsRegistry::global()
+{
+    static MetricsRegistry metrics_registry;
+    return metrics_registry;
+}
+
+Counter& MetricsRegistry::counter(const std::string &name, const std::string &help, const MetricLabels &labels)
+{
+    return find_or_add(name, help, MetricType::counter, labels).counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string &name, const std::string &help, const MetricLabels &labels)
+{
+    return find_or_add(name, help, MetricType::gauge, labels).gauge;
+}
+
+ShardedHistogram& MetricsRegistry::histogram(const std::string &name, const std::string &help, const MetricLabels &labels)
+{
+    return *find_or_add(name, help, MetricType::summary, labels).histogram;
+}
+
+MetricsRegistry::Entry& MetricsRegistry::find_or_add(const std::string &name, const std::string &help, MetricType type, const MetricLabels &labels)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &entry : entries_)
+    {
+        if (entry.name == name && entry.type == type && entry.labels == labels)
+            return entry;
+    }
+
+    auto &entry = entries_.emplace_back();
+    entry.name = name;
+    entry.help = help;
+    entry.type = type;
+    entry.labels = labels;
+    if (type == MetricType::summary)
+        entry.histogram = std::make_unique<ShardedHistogram>();
+    return entry;
+}
+
+std::uint64_t MetricsRegistry::add_collector(CollectFunctionType collect_function)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto id = next_collector_id_++;
+    collectors_.emplace_back(id, std::move(collect_function));
+    return id;
+}
+
+void MetricsRegistry::remove_collector(std::uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::erase_if(collectors_, [id] (const auto &collector) { return collector.first == id; });
+}
+
+std::vector<MetricSample> MetricsRegistry::collect() const
+{
+    std::vector<MetricSample> samples;
+    // collectors run under the lock, remove_collector() waits for a running collect()
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &entry : entries_)
+    {
+        if (entry.type == MetricType::summary)
+        {
+            Histogram histogram;
+            entry.histogram->collect(histogram);
+            samples.push_back(MetricSample::from_histogram(entry.name, entry.help, entry.labels, histogram));
+            continue;
+        }
+
+        auto &sample = samples.emplace_back();
+        sample.name = entry.name;
+        sample.help = entry.help;
+        sample.type = entry.type;
+        sample.labels = entry.labels;
+        if (entry.type == MetricType::counter)
+            sample.value = static_cast<double>(entry.counter.value());
+        else
+            sample.value = static_cast<double>(entry.gauge.value());
+    }
+
+    for (const auto &collector : collectors_)
+    {
+        collector.second(samples);
+    }
+    return samples;
+}
+
+static void append_number(std::string &out, double value)
+{
+    char buffer[64];
+    auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, ptr);
+}
+
+static void append_escaped(std::string &out, std::string_view value, bool is_label)
+{
+    for (char c : value)
+    {
+        if (c == '\\')
+            out += "\\\\";
+        else if (c == '\n')
+            out += "\\n";
+        else if (c == '"' && is_label)
+            out += "\\\"";
+        else
+            out.push_back(c);
+    }
+}
+
+// name{labels,extra_label} value
+static void append_line(std::string &out, const std::string &name, std::string_view suffix, const MetricLabels &labels,
+    std::string_view extra_label, double value)
+{
+    out += name;
+    out += suffix;
+    if (!labels.empty() || !extra_label.empty())
+    {
+        out.push_back('{');
+        for (std::size_t i=0; i<labels.size(); ++i)
+        {
+            if (i > 0)
+                out.push_back(',');
+            out += labels[i].first;
+            out += "=\"";
+            append_escaped(out, labels[i].second, true);
+            out.push_back('"');
+        }
+        if (!extra_label.empty())
+        {
+            if (!labels.empty())
+                out.push_back(',');
+            out += extra_label;
+        }
+        out.push_back('}');
+    }
+    out.push_back(' ');
+    append_number(out, value);
+    out.push_back('\n');
+}
+
+std::string MetricsRegistry::prometheus_text() const
+{
+    auto samples = collect();
+    // the samples of a metric family have to be adjacent
+    std::stable_sort(samples.begin(), samples.end(), [] (const MetricSample &a, const MetricSample &b) { return a.name < b.name; });
+
+    std::string out;
+    for (std::size_t i=0; i<samples.size(); ++i)
+    {
+        const auto &sample = samples[i];
+        if (i == 0 || samples[i - 1].name != sample.name)
+        {
+            out += "# HELP " + sample.name + " ";
+            append_escaped(out, sample.help, false);
+            out += "\n# TYPE " + sample.name + " ";
+            if (sample.type == MetricType::counter)
+                out += "counter\n";
+            else if (sample.type == MetricType::gauge)
+                out += "gauge\n";
+            else
+                out += "summary\n";
+        }
+
+        if (sample.type != MetricType::summary)
+        {
+            append_line(out, sample.name, "", sample.labels, "", sample.value);
+            continue;
+        }
+
+        for (const auto &[quantile, value] : sample.quantiles)
+        {
+            std::string quantile_label = "quantile=\"";
+            append_number(quantile_label, quantile);
+            quantile_label += "\"";
+            append_line(out, sample.name, "", sample.labels, quantile_label, static_cast<double>(value));
+        }
+        append_line(out, sample.name, "_sum", sample.labels, "", static_cast<double>(sample.sum));
+        append_line(out, sample.name, "_count", sample.labels, "", static_cast<double>(sample.count));
+    }
+    return out;
+}
+
+} // namespace conet
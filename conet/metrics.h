@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "histogram.h"
+
+namespace conet {
+
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+enum class MetricType
+{
+    counter,
+    gauge,
+    // a histogram, exported as quantiles with _sum and _count
+    summary,
+};
+
+// One metric value read by MetricsRegistry::collect().
+struct MetricSample
+{
+    std::string name;
+    std::string help;
+    MetricType type = MetricType::gauge;
+    MetricLabels labels;
+    // counter and gauge
+    double value = 0;
+    // summary
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::vector<std::pair<double, std::uint64_t>> quantiles;
+
+    static MetricSample from_histogram(std::string name, std::string help, MetricLabels labels, const Histogram &histogram);
+};
+
+// the shard of the calling thread, threads are assigned round-robin
+std::size_t metrics_shard_index();
+
+// Monotonic counter. Each thread adds to its own cache line, the shards are summed on read.
+class Counter
+{
+public:
+    static constexpr std::size_t shard_count = 16;
+
+    void add(std::uint64_t n = 1)
+    {
+        shards_[metrics_shard_index() % shard_count].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    std::uint64_t value() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic_uint64_t value{0};
+    };
+
+    std::array<Shard, shard_count> shards_;
+};
+
+class Gauge
+{
+public:
+    void set(std::int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(std::int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    std::int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic_int64_t value_{0};
+};
+
+// Histogram with a shard per group of threads, merged on read.
+class ShardedHistogram
+{
+public:
+    static constexpr std::size_t shard_count = 8;
+
+    void record(std::uint64_t value)
+    {
+        shards_[metrics_shard_index() % shard_count].record(value);
+    }
+
+    // merges the shards into out
+    void collect(Histogram &out) const;
+
+private:
+    std::array<Histogram, shard_count> shards_;
+};
+
+// Process-wide metrics. Counters, gauges and histograms live as long as the registry, so hot paths
+// look them up once and keep the reference:
+//     static auto &read_bytes = MetricsRegistry::global().counter("conet_tcp_read_bytes_total", "bytes read");
+//     read_bytes.add(n);
+class MetricsRegistry
+{
+public:
+    // appends the samples of values a component already tracks, called on every collect()
+    using CollectFunctionType = std::function<void(std::vector<MetricSample> &samples)>;
+
+    MetricsRegistry() = default;
+    MetricsRegistry(const MetricsRegistry &) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry &) = delete;
+
+    static MetricsRegistry& global();
+
+    // the same name, labels and type return the same metric
+    Counter& counter(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+    Gauge& gauge(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+    ShardedHistogram& histogram(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+
+    // returns an id for remove_collector(). once remove_collector() returns the function is not called anymore.
+    std::uint64_t add_collector(CollectFunctionType collect_function);
+    void remove_collector(std::uint64_t id);
+
+    // pull API, samples are in registration order
+    std::vector<MetricSample> collect() const;
+    // Prometheus text exposition format, version 0.0.4
+    std::string prometheus_text() const;
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        MetricType type;
+        MetricLabels labels;
+        Counter counter;
+        Gauge gauge;
+        std::unique_ptr<ShardedHistogram> histogram;
+    };
+
+    Entry& find_or_add(const std::string &name, const std::string &help, MetricType type, const MetricLabels &labels);
+
+    mutable std::mutex mutex_;
+    // list keeps the references stable
+    std::list<Entry> entries_;
+    std::list<std::pair<std::uint64_t, CollectFunctionType>> collectors_;
+    std::uint64_t next_collector_id_ = 1;
+};
+
+} // namespace conet
@@ -0,0 +1,113 @@
+#include "mysql_bulk_insert.h"
+
+#include "error.h"
+
+namespace conet {
+
+MysqlBulkInsertBuilder::MysqlBulkInsertBuilder(MysqlClient &mysql_client, const std::string &table, const std::vector<std::string> &columns, std::size_t max_statement_size) :
+    mysql_client_(mysql_client),
+    max_statement_size_(max_statement_size),
+    column_number_(columns.size()),
+    row_number_(0)
+{
+    prefix_ = "INSERT INTO " + quote_identifier(table) + " (";
+    for (std::size_t i=0; i<columns.size(); ++i)
+    {
+        if (i != 0)
+            prefix_ += ',';
+        prefix_ += quote_identifier(columns[i]);
+    }
+    prefix_ += ") VALUES ";
+}
+
+result<void> MysqlBulkInsertBuilder::add_row(const std::vector<std::optional<std::string>> &values)
+{
+    if (values.size() != column_number_)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message("column number mismatch");
+        error_info.add_pair("column_number", column_number_);
+        error_info.add_pair("value_number", values.size());
+        return error_info;
+    }
+
+    std::string row = "(";
+    for (std::size_t i=0; i<values.size(); ++i)
+    {
+        if (i != 0)
+            row += ',';
+
+        if (values[i])
+        {
+            row += '\'';
+            row += mysql_client_.encode_string(*values[i]);
+            row += '\'';
+        }
+        else
+        {
+            row += "NULL";
+        }
+    }
+    row += ')';
+
+    if (!current_.empty() && current_.size() + 1 + row.size() + suffix_.size() > max_statement_size_)
+    {
+        statement_group_.push_back(std::move(current_));
+        current_.clear();
+    }
+
+    if (current_.empty())
+    {
+        current_ = prefix_;
+    }
+    else
+    {
+        current_ += ',';
+    }
+    current_ += row;
+    ++row_number_;
+
+    return RESULT_SUCCESS;
+}
+
+std::vector<std::string> MysqlBulkInsertBuilder::statements() const
+{
+    std::vector<std::string> ret;
+    ret.reserve(statement_group_.size() + 1);
+    for (const auto &statement : statement_group_)
+    {
+        ret.push_back(statement + suffix_);
+    }
+    if (!current_.empty())
+        ret.push_back(current_ + suffix_);
+    return ret;
+}
+
+void MysqlBulkInsertBuilder::clear()
+{
+    statement_group_.clear();
+    current_.clear();
+    row_number_ = 0;
+}
+
+std::string MysqlBulkInsertBuilder::quote_identifier(const std::string &name)
+{
+    std::string ret;
+    ret.reserve(name.size() + 2);
+    ret += '`';
+    for (auto c : name)
+    {
+        // a backtick inside a quoted identifier is doubled
+        if (c == '`')
+            ret += '`';
+        ret += c;
+    }
+    ret += '`';
+    return ret;
+}
+
+} // namespace conet
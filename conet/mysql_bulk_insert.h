@@ -0,0 +1,50 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "mysql_client.h"
+
+namespace conet {
+
+// Packs rows into multi-row INSERT statements of at most max_statement_size bytes.
+// A row larger than max_statement_size gets a statement of its own.
+// The table and column names are quoted, the suffix is used as is.
+// e.g.
+//   MysqlBulkInsertBuilder builder(mysql_client, "test", {"id", "name"});
+//   builder.add_row({"1", "hello"});
+//   builder.add_row({"2", std::nullopt});
+//   co_await mysql_client.batch_query(builder.statements());
+class MysqlBulkInsertBuilder
+{
+public:
+    MysqlBulkInsertBuilder(MysqlClient &mysql_client, const std::string &table, const std::vector<std::string> &columns, std::size_t max_statement_size = 1024 * 1024);
+
+    // appended to every statement. e.g. "ON DUPLICATE KEY UPDATE `name`=VALUES(`name`)"
+    void set_suffix(const std::string &suffix) { suffix_ = " " + suffix; }
+
+    // std::nullopt is NULL
+    result<void> add_row(const std::vector<std::optional<std::string>> &values);
+
+    std::vector<std::string> statements() const;
+    std::size_t row_number() const { return row_number_; }
+    // the last added row is in statement statement_number() - 1
+    std::size_t statement_number() const { return statement_group_.size() + (current_.empty() ? 0 : 1); }
+    void clear();
+
+    // e.g. a`b -> `a``b`
+    static std::string quote_identifier(const std::string &name);
+
+private:
+    MysqlClient &mysql_client_;
+    std::string prefix_;
+    std::string suffix_;
+    std::size_t max_statement_size_;
+    std::size_t column_number_;
+    std::size_t row_number_;
+    std::vector<std::string> statement_group_;
+    std::string current_;
+};
+
+} // namespace conet
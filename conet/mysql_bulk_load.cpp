@@ -0,0 +1,420 @@
+#include "mysql_bulk_load.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include <mysql/mysql.h>
+#include <mysql/errmsg.h>
+
+#include "error.h"
+#include "mysql_client.h"
+
+namespace conet {
+
+namespace {
+
+const char aborted_message[] = "bulk load is aborted";
+
+ErrorInfo make_finished_error()
+{
+    boost::system::error_code error_code;
+    static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+    error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+    ErrorInfo error_info(error_code);
+    error_info.set_error_message("bulk load is finished");
+    return error_info;
+}
+
+ErrorInfo make_not_started_error()
+{
+    boost::system::error_code error_code;
+    static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+    error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+    ErrorInfo error_info(error_code);
+    error_info.set_error_message("bulk load is not started");
+    return error_info;
+}
+
+result<void> execute(MYSQL *mysql, const std::string &sql)
+{
+    if (mysql_real_query(mysql, sql.c_str(), static_cast<unsigned long>(sql.size())) != 0)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(mysql_errno(mysql), error::mysql_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message(get_mysql_error(mysql));
+        error_info.add_pair("sql", sql);
+        return error_info;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+} // namespace
+
+void MysqlBulkLoader::encode_row(const std::vector<std::optional<std::string>> &values, std::string &buffer)
+{
+    for (std::size_t i=0; i<values.size(); ++i)
+    {
+        if (i != 0)
+            buffer += '\t';
+
+        if (!values[i])
+        {
+            buffer += "\\N";
+            continue;
+        }
+
+        for (char c : *values[i])
+        {
+            switch (c)
+            {
+            case '\\':
+                buffer += "\\\\";
+                break;
+            case '\t':
+                buffer += "\\t";
+                break;
+            case '\n':
+                buffer += "\\n";
+                break;
+            case '\r':
+                buffer += "\\r";
+                break;
+            case '\0':
+                buffer += "\\0";
+                break;
+            default:
+                buffer += c;
+                break;
+            }
+        }
+    }
+    buffer += '\n';
+}
+
+namespace impl {
+
+MysqlBulkLoaderImpl::MysqlBulkLoaderImpl(const std::string &table, const std::vector<std::string> &columns, const MysqlBulkLoadOptions &options) :
+    table_(table),
+    columns_(columns),
+    options_(options),
+    row_number_(0),
+    is_started_(false),
+    is_reader_waiting_(false),
+    is_finished_(false),
+    is_aborted_(false),
+    reading_offset_(0)
+{
+}
+
+result<void> MysqlBulkLoaderImpl::start(const std::string &host, unsigned int port, const std::string &user, const std::string &password, const std::string &database)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (is_started_)
+        {
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+            ErrorInfo error_info(error_code);
+            error_info.set_error_message("bulk load is already started");
+            return error_info;
+        }
+        is_started_ = true;
+    }
+
+    // detached, the destructor of MysqlBulkLoader must not wait for the network
+    std::thread(&MysqlBulkLoaderImpl::run, shared_from_this(), host, port, user, password, database).detach();
+    return RESULT_SUCCESS;
+}
+
+void MysqlBulkLoaderImpl::abort()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_aborted_ = true;
+    }
+    condition_.notify_one();
+}
+
+boost::asio::awaitable<result<void>> MysqlBulkLoaderImpl::add_row(const std::vector<std::optional<std::string>> &values)
+{
+    if (values.size() != columns_.size())
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message("column number mismatch");
+        error_info.add_pair("column_number", columns_.size());
+        error_info.add_pair("value_number", values.size());
+        co_return error_info;
+    }
+
+    // the loader may be destroyed while this waits
+    auto self = shared_from_this();
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!is_started_)
+                co_return make_not_started_error();
+            if (error_info_)
+                co_return *error_info_;
+            if (is_finished_)
+                co_return make_finished_error();
+
+            // a row larger than max_buffer_size is accepted when the buffer is empty
+            if (writing_.size() < options_.max_buffer_size)
+            {
+                MysqlBulkLoader::encode_row(values, writing_);
+                ++row_number_;
+                if (is_reader_waiting_)
+                    condition_.notify_one();
+                co_return RESULT_SUCCESS;
+            }
+        }
+
+        RESULT_CO_CHECK(co_await wait_writable());
+    }
+}
+
+boost::asio::awaitable<result<std::uint64_t>> MysqlBulkLoaderImpl::finish()
+{
+    auto self = shared_from_this();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!is_started_)
+            co_return make_not_started_error();
+        is_finished_ = true;
+    }
+    condition_.notify_one();
+
+    co_return co_await wait_done();
+}
+
+void MysqlBulkLoaderImpl::run(std::shared_ptr<MysqlBulkLoaderImpl> self, std::string host, unsigned int port, std::string user, std::string password, std::string database)
+{
+    mysql_thread_init();
+    auto r = self->load(host, port, user, password, database);
+    mysql_thread_end();
+
+    self->done(std::move(r));
+}
+
+result<std::uint64_t> MysqlBulkLoaderImpl::load(const std::string &host, unsigned int port, const std::string &user, const std::string &password, const std::string &database)
+{
+    std::unique_ptr<MYSQL, void(*)(MYSQL *)> mysql(mysql_init(nullptr), mysql_close);
+    if (!mysql)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::third_party_error, error::conet_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message("mysql_init fail");
+        return error_info;
+    }
+
+    unsigned int local_infile = 1;
+    mysql_options(mysql.get(), MYSQL_OPT_LOCAL_INFILE, &local_infile);
+    unsigned int timeout = static_cast<unsigned int>(options_.io_timeout.count());
+    if (timeout > 0)
+    {
+        mysql_options(mysql.get(), MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+        mysql_options(mysql.get(), MYSQL_OPT_READ_TIMEOUT, &timeout);
+        mysql_options(mysql.get(), MYSQL_OPT_WRITE_TIMEOUT, &timeout);
+    }
+
+    if (mysql_real_connect(mysql.get(), host.c_str(), user.c_str(), password.c_str(), database.c_str(), port, nullptr, CLIENT_LOCAL_FILES) == nullptr)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(mysql_errno(mysql.get()), error::mysql_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message(get_mysql_error(mysql.get()));
+        error_info.add_pair("host", host);
+        error_info.add_pair("port", port);
+        return error_info;
+    }
+
+    mysql_set_local_infile_handler(mysql.get(), local_infile_init, local_infile_read, local_infile_end, local_infile_error, this);
+
+    // the file name is not used, the content comes from local_infile_read
+    std::string sql = "LOAD DATA LOCAL INFILE 'conet' INTO TABLE `" + table_ + "` CHARACTER SET " + options_.character_set +
+        " FIELDS TERMINATED BY '\\t' ESCAPED BY '\\\\' LINES TERMINATED BY '\\n' (";
+    for (std::size_t i=0; i<columns_.size(); ++i)
+    {
+        if (i != 0)
+            sql += ',';
+        sql += '`' + columns_[i] + '`';
+    }
+    sql += ')';
+
+    // an aborted load still ends the content with an empty packet and the server keeps the rows
+    // streamed so far, the transaction drops them unless every row is sent
+    RESULT_CHECK(execute(mysql.get(), "START TRANSACTION"));
+    auto load_result = execute(mysql.get(), sql);
+    if (!load_result)
+    {
+        auto rollback_result = execute(mysql.get(), "ROLLBACK");
+        if (!rollback_result)
+            load_result.error_info().add_pair("rollback", rollback_result.error_info().error_message());
+        return load_result.error_info();
+    }
+
+    auto affected_rows = static_cast<std::uint64_t>(mysql_affected_rows(mysql.get()));
+    RESULT_CHECK(execute(mysql.get(), "COMMIT"));
+    return affected_rows;
+}
+
+void MysqlBulkLoaderImpl::done(result<std::uint64_t> &&r)
+{
+    std::vector<WritableCallbackType> writable_waiter_group;
+    FinishCallbackType finish_callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_info_ = r ? make_finished_error() : r.error_info();
+        done_result_.emplace(std::move(r));
+        writable_waiter_group.swap(writable_waiter_group_);
+        finish_callback.swap(finish_callback_);
+    }
+
+    for (auto &callback : writable_waiter_group)
+    {
+        callback(*error_info_);
+    }
+    if (finish_callback)
+        finish_callback(*done_result_);
+}
+
+int MysqlBulkLoaderImpl::read(char *buffer, unsigned int size)
+{
+    if (reading_offset_ == reading_.size())
+    {
+        std::vector<WritableCallbackType> writable_waiter_group;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            is_reader_waiting_ = true;
+            condition_.wait(lock, [this] { return !writing_.empty() || is_finished_ || is_aborted_; });
+            is_reader_waiting_ = false;
+
+            if (is_aborted_)
+                return -1;
+            // end of file
+            if (writing_.empty())
+                return 0;
+
+            reading_.swap(writing_);
+            writing_.clear();
+            reading_offset_ = 0;
+            writable_waiter_group.swap(writable_waiter_group_);
+        }
+
+        for (auto &callback : writable_waiter_group)
+        {
+            callback(RESULT_SUCCESS);
+        }
+    }
+
+    auto n = std::min(static_cast<std::size_t>(size), reading_.size() - reading_offset_);
+    std::memcpy(buffer, reading_.data() + reading_offset_, n);
+    reading_offset_ += n;
+    return static_cast<int>(n);
+}
+
+boost::asio::awaitable<result<void>> MysqlBulkLoaderImpl::wait_writable()
+{
+    return boost::asio::async_initiate<const boost::asio::use_awaitable_t<>, void(result<void>)>(
+        [this]<typename H> (H&& self) mutable
+        {
+            auto handler_ptr = make_recycling_shared<H>(std::forward<H>(self));
+            WritableCallbackType callback = [handler_ptr] (result<void> r) mutable
+            {
+                auto executor = boost::asio::get_associated_executor(*handler_ptr);
+                boost::asio::dispatch(executor, [handler_ptr, r = std::move(r)] () mutable
+                {
+                    auto&& handler = std::move(*handler_ptr.get());
+                    handler(std::move(r));
+                });
+            };
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (error_info_ || writing_.size() < options_.max_buffer_size)
+            {
+                lock.unlock();
+                callback(RESULT_SUCCESS);
+                return;
+            }
+            writable_waiter_group_.push_back(std::move(callback));
+        },
+        boost::asio::use_awaitable);
+}
+
+boost::asio::awaitable<result<std::uint64_t>> MysqlBulkLoaderImpl::wait_done()
+{
+    return boost::asio::async_initiate<const boost::asio::use_awaitable_t<>, void(result<std::uint64_t>)>(
+        [this]<typename H> (H&& self) mutable
+        {
+            auto handler_ptr = make_recycling_shared<H>(std::forward<H>(self));
+            FinishCallbackType callback = [handler_ptr] (result<std::uint64_t> r) mutable
+            {
+                auto executor = boost::asio::get_associated_executor(*handler_ptr);
+                boost::asio::dispatch(executor, [handler_ptr, r = std::move(r)] () mutable
+                {
+                    auto&& handler = std::move(*handler_ptr.get());
+                    handler(std::move(r));
+                });
+            };
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (done_result_)
+            {
+                auto r = *done_result_;
+                lock.unlock();
+                callback(std::move(r));
+                return;
+            }
+            finish_callback_ = std::move(callback);
+        },
+        boost::asio::use_awaitable);
+}
+
+int MysqlBulkLoaderImpl::local_infile_init(void **ptr, const char *file_name, void *userdata)
+{
+    *ptr = userdata;
+    return 0;
+}
+
+int MysqlBulkLoaderImpl::local_infile_read(void *ptr, char *buffer, unsigned int size)
+{
+    return static_cast<MysqlBulkLoaderImpl *>(ptr)->read(buffer, size);
+}
+
+void MysqlBulkLoaderImpl::local_infile_end(void *ptr)
+{
+}
+
+int MysqlBulkLoaderImpl::local_infile_error(void *ptr, char *error_message, unsigned int size)
+{
+    if (size > 0)
+    {
+        auto n = std::min<std::size_t>(size - 1, sizeof(aborted_message) - 1);
+        std::memcpy(error_message, aborted_message, n);
+        error_message[n] = '\0';
+    }
+    return CR_UNKNOWN_ERROR;
+}
+
+} // namespace impl
+} // namespace conet
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "result.h"
+
+namespace conet {
+
+struct MysqlBulkLoadOptions
+{
+    // encoded rows waiting for the connection, add_row() waits above this size
+    std::size_t max_buffer_size = 1024 * 1024;
+    std::string character_set = "utf8mb4";
+    // connect, read and write timeout of the connection, bounds how long an abandoned load thread lives
+    std::chrono::seconds io_timeout = std::chrono::seconds(30);
+};
+
+namespace impl {
+
+// the state of MysqlBulkLoader, kept alive by the load thread and the waiting coroutines
+class MysqlBulkLoaderImpl : public std::enable_shared_from_this<MysqlBulkLoaderImpl>
+{
+public:
+    MysqlBulkLoaderImpl(const std::string &table, const std::vector<std::string> &columns, const MysqlBulkLoadOptions &options);
+
+    MysqlBulkLoaderImpl(const MysqlBulkLoaderImpl &) = delete;
+    MysqlBulkLoaderImpl& operator=(const MysqlBulkLoaderImpl &) = delete;
+
+    result<void> start(const std::string &host, unsigned int port, const std::string &user, const std::string &password, const std::string &database);
+    boost::asio::awaitable<result<void>> add_row(const std::vector<std::optional<std::string>> &values);
+    boost::asio::awaitable<result<std::uint64_t>> finish();
+    // stops reading rows, the load thread rolls back and exits on its own
+    void abort();
+
+    std::uint64_t row_number() const { return row_number_; }
+
+private:
+    using WritableCallbackType = std::function<void(result<void>)>;
+    using FinishCallbackType = std::function<void(result<std::uint64_t>)>;
+
+    // self keeps this alive until the thread exits
+    static void run(std::shared_ptr<MysqlBulkLoaderImpl> self, std::string host, unsigned int port, std::string user, std::string password, std::string database);
+    result<std::uint64_t> load(const std::string &host, unsigned int port, const std::string &user, const std::string &password, const std::string &database);
+    void done(result<std::uint64_t> &&r);
+    int read(char *buffer, unsigned int size);
+    boost::asio::awaitable<result<void>> wait_writable();
+    boost::asio::awaitable<result<std::uint64_t>> wait_done();
+
+    static int local_infile_init(void **ptr, const char *file_name, void *userdata);
+    static int local_infile_read(void *ptr, char *buffer, unsigned int size);
+    static void local_infile_end(void *ptr);
+    static int local_infile_error(void *ptr, char *error_message, unsigned int size);
+
+    std::string table_;
+    std::vector<std::string> columns_;
+    MysqlBulkLoadOptions options_;
+    std::atomic_uint64_t row_number_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    // filled by add_row()
+    std::string writing_;
+    bool is_started_;
+    bool is_reader_waiting_;
+    bool is_finished_;
+    bool is_aborted_;
+    // set when the load stops, add_row() fails from then on
+    std::optional<ErrorInfo> error_info_;
+    std::optional<result<std::uint64_t>> done_result_;
+    std::vector<WritableCallbackType> writable_waiter_group_;
+    FinishCallbackType finish_callback_;
+
+    // owned by the load thread, swapped with writing_ when consumed
+    std::string reading_;
+    std::size_t reading_offset_;
+};
+
+} // namespace impl
+
+// Streams rows into LOAD DATA LOCAL INFILE. Rows are encoded as tab separated lines straight into
+// the buffer the client library reads the file content from, no INSERT statement is built.
+// The local infile callbacks of the client library are blocking, so the load runs on a connection
+// and a thread of its own instead of the Polling thread. The server needs local_infile=ON.
+// The load runs in a transaction, committed by finish().
+// e.g.
+//   MysqlBulkLoader loader("test", {"id", "name"});
+//   RESULT_CO_CHECK(loader.start("127.0.0.1", 3306, "root", "", "test"));
+//   co_await loader.add_row({"1", "hello"});
+//   co_await loader.add_row({"2", std::nullopt});
+//   auto affected_rows = co_await loader.finish();
+class MysqlBulkLoader
+{
+public:
+    MysqlBulkLoader(const std::string &table, const std::vector<std::string> &columns, const MysqlBulkLoadOptions &options = {}) :
+        impl_(std::make_shared<impl::MysqlBulkLoaderImpl>(table, columns, options))
+    {
+    }
+
+    // an unfinished load is rolled back, nothing is inserted into a transactional table.
+    // does not wait, the load thread exits on its own within options.io_timeout.
+    ~MysqlBulkLoader()
+    {
+        impl_->abort();
+    }
+
+    MysqlBulkLoader(const MysqlBulkLoader &) = delete;
+    MysqlBulkLoader& operator=(const MysqlBulkLoader &) = delete;
+
+    // connect and send LOAD DATA in background, failures are returned by add_row() and finish().
+    // can be called once.
+    result<void> start(const std::string &host, unsigned int port, const std::string &user, const std::string &password, const std::string &database)
+    {
+        return impl_->start(host, port, user, password, database);
+    }
+
+    // std::nullopt is NULL. waits while the buffer is full.
+    boost::asio::awaitable<result<void>> add_row(const std::vector<std::optional<std::string>> &values)
+    {
+        return impl_->add_row(values);
+    }
+
+    // end of rows, commits and returns the affected rows reported by the server
+    boost::asio::awaitable<result<std::uint64_t>> finish() { return impl_->finish(); }
+
+    std::uint64_t row_number() const { return impl_->row_number(); }
+
+    // appends a line in the format of FIELDS TERMINATED BY '\t' ESCAPED BY '\\' LINES TERMINATED BY '\n'
+    static void encode_row(const std::vector<std::optional<std::string>> &values, std::string &buffer);
+
+private:
+    std::shared_ptr<impl::MysqlBulkLoaderImpl> impl_;
+};
+
+} // namespace conet
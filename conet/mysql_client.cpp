@@ -1,6 +1,7 @@
 #include "mysql_client.h"
 
 #include <mysql/mysql.h>
+#include <mysql/errmsg.h>
 
 #include "polling.h"
 #include "error.h"
@@ -28,6 +29,16 @@ void MysqlQueryResultImpl::add_result(const std::string &key, std::string &&valu
     datas_[key] = std::move(value);
 }
 
+std::size_t MysqlQueryResultImpl::byte_size() const
+{
+    std::size_t size = sizeof(*this);
+    for (const auto &p : datas_)
+    {
+        size += sizeof(p) + p.first.capacity() + p.second.capacity();
+    }
+    return size;
+}
+
 class initiate_mysql_connect
 {
 public:
@@ -38,9 +49,15 @@ public:
 
     void operator()(boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>> &&handler)
     {
-        auto handler_ptr = std::make_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>>>(std::move(handler));
-        Polling::instance().add(&mysql_client_, [handler_ptr, this] () mutable -> bool // return is_finish
+        auto handler_ptr = make_recycling_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>>>(std::move(handler));
+        Polling::instance().add(&mysql_client_, [handler_ptr, this, enqueue_time = std::chrono::steady_clock::now(), is_first = true] () mutable -> bool // return is_finish
         {
+            if (is_first)
+            {
+                is_first = false;
+                mysql_client_.queue_time_ += std::chrono::steady_clock::now() - enqueue_time;
+            }
+
             auto net_async_status = mysql_real_connect_nonblocking(
                 mysql_client_.mysql_,
                 mysql_client_.host_.c_str(),
@@ -71,6 +88,7 @@ public:
                     boost::system::error_code error_code;
                     static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
                     error_code.assign(mysql_errno(mysql_client_.mysql_), error::mysql_category(), &loc);
+                    mysql_client_.check_broken();
 
                     ErrorInfo error_info(error_code);
                     error_info.set_error_message(get_mysql_error(mysql_client_.mysql_));
@@ -103,9 +121,15 @@ public:
 
     void operator()(boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>> &&handler)
     {
-        auto handler_ptr = std::make_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>>>(std::move(handler));
-        Polling::instance().add(&mysql_client_, [handler_ptr, this] () mutable -> bool // return is_finish
+        auto handler_ptr = make_recycling_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>>>(std::move(handler));
+        Polling::instance().add(&mysql_client_, [handler_ptr, this, enqueue_time = std::chrono::steady_clock::now(), is_first = true] () mutable -> bool // return is_finish
         {
+            if (is_first)
+            {
+                is_first = false;
+                mysql_client_.queue_time_ += std::chrono::steady_clock::now() - enqueue_time;
+            }
+
             auto net_async_status = mysql_real_query_nonblocking(
                 mysql_client_.mysql_,
                 sql_.c_str(),
@@ -131,6 +155,7 @@ public:
                     boost::system::error_code error_code;
                     static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
                     error_code.assign(mysql_errno(mysql_client_.mysql_), error::mysql_category(), &loc);
+                    mysql_client_.check_broken();
 
                     ErrorInfo error_info(error_code);
                     error_info.set_error_message(get_mysql_error(mysql_client_.mysql_));
@@ -163,9 +188,15 @@ public:
 
     void operator()(boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<std::shared_ptr<MYSQL_RES>>> &&handler)
     {
-        auto handler_ptr = std::make_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<std::shared_ptr<MYSQL_RES>>>>(std::move(handler));
-        Polling::instance().add(&mysql_client_, [handler_ptr, this] () mutable -> bool // return is_finish
+        auto handler_ptr = make_recycling_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<std::shared_ptr<MYSQL_RES>>>>(std::move(handler));
+        Polling::instance().add(&mysql_client_, [handler_ptr, this, enqueue_time = std::chrono::steady_clock::now(), is_first = true] () mutable -> bool // return is_finish
         {
+            if (is_first)
+            {
+                is_first = false;
+                mysql_client_.queue_time_ += std::chrono::steady_clock::now() - enqueue_time;
+            }
+
             MYSQL_RES *mysql_res;
             auto net_async_status = mysql_store_result_nonblocking(
                 mysql_client_.mysql_,
@@ -199,6 +230,7 @@ public:
                     boost::system::error_code error_code;
                     static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
                     error_code.assign(mysql_errno(mysql_client_.mysql_), error::mysql_category(), &loc);
+                    mysql_client_.check_broken();
 
                     ErrorInfo error_info(error_code);
                     error_info.set_error_message(get_mysql_error(mysql_client_.mysql_));
@@ -231,9 +263,15 @@ public:
 
     void operator()(boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<char **>> &&handler)
     {
-        auto handler_ptr = std::make_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<char **>>>(std::move(handler));
-        Polling::instance().add(&mysql_client_, [handler_ptr, this] () mutable -> bool // return is_finish
+        auto handler_ptr = make_recycling_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<char **>>>(std::move(handler));
+        Polling::instance().add(&mysql_client_, [handler_ptr, this, enqueue_time = std::chrono::steady_clock::now(), is_first = true] () mutable -> bool // return is_finish
         {
+            if (is_first)
+            {
+                is_first = false;
+                mysql_client_.queue_time_ += std::chrono::steady_clock::now() - enqueue_time;
+            }
+
             char** row;
 
             auto net_async_status = mysql_fetch_row_nonblocking(
@@ -260,6 +298,7 @@ public:
                     boost::system::error_code error_code;
                     static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
                     error_code.assign(mysql_errno(mysql_client_.mysql_), error::mysql_category(), &loc);
+                    mysql_client_.check_broken();
 
                     ErrorInfo error_info(error_code);
                     error_info.set_error_message(get_mysql_error(mysql_client_.mysql_));
@@ -293,9 +332,15 @@ public:
 
     void operator()(boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>> &&handler)
     {
-        auto handler_ptr = std::make_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>>>(std::move(handler));
-        Polling::instance().add(&mysql_client_, [handler_ptr, this] () mutable -> bool // return is_finish
+        auto handler_ptr = make_recycling_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>>>(std::move(handler));
+        Polling::instance().add(&mysql_client_, [handler_ptr, this, enqueue_time = std::chrono::steady_clock::now(), is_first = true] () mutable -> bool // return is_finish
         {
+            if (is_first)
+            {
+                is_first = false;
+                mysql_client_.queue_time_ += std::chrono::steady_clock::now() - enqueue_time;
+            }
+
             auto net_async_status = mysql_free_result_nonblocking(result_);
 
             switch (net_async_status)
@@ -317,6 +362,7 @@ public:
                     boost::system::error_code error_code;
                     static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
                     error_code.assign(mysql_errno(mysql_client_.mysql_), error::mysql_category(), &loc);
+                    mysql_client_.check_broken();
 
                     ErrorInfo error_info(error_code);
                     error_info.set_error_message(get_mysql_error(mysql_client_.mysql_));
@@ -339,6 +385,69 @@ private:
     MYSQL_RES *result_;
 };
 
+class initiate_mysql_next_result
+{
+public:
+    initiate_mysql_next_result(MysqlClient &mysql_client) :
+        mysql_client_(mysql_client)
+    {
+    }
+
+    void operator()(boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>> &&handler)
+    {
+        auto handler_ptr = make_recycling_shared<boost::asio::detail::awaitable_handler<boost::asio::any_io_executor, result<void>>>(std::move(handler));
+        Polling::instance().add(&mysql_client_, [handler_ptr, this, enqueue_time = std::chrono::steady_clock::now(), is_first = true] () mutable -> bool // return is_finish
+        {
+            if (is_first)
+            {
+                is_first = false;
+                mysql_client_.queue_time_ += std::chrono::steady_clock::now() - enqueue_time;
+            }
+
+            auto net_async_status = mysql_next_result_nonblocking(mysql_client_.mysql_);
+
+            switch (net_async_status)
+            {
+            case NET_ASYNC_COMPLETE:
+            case NET_ASYNC_COMPLETE_NO_MORE_RESULTS:
+                {
+                    auto executor = boost::asio::get_associated_executor(*handler_ptr);
+                    boost::asio::dispatch(executor, [handler_ptr] () mutable
+                    {
+                        auto&& handler = std::move(*handler_ptr.get());
+                        handler(RESULT_SUCCESS);
+                    });
+                }
+                return true;
+            case NET_ASYNC_NOT_READY:
+                return false;
+            default:
+                {
+                    boost::system::error_code error_code;
+                    static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+                    error_code.assign(mysql_errno(mysql_client_.mysql_), error::mysql_category(), &loc);
+                    mysql_client_.check_broken();
+
+                    ErrorInfo error_info(error_code);
+                    error_info.set_error_message(get_mysql_error(mysql_client_.mysql_));
+                    error_info.add_pair("result_type", std::to_string(net_async_status));
+
+                    auto executor = boost::asio::get_associated_executor(*handler_ptr);
+                    boost::asio::dispatch(executor, [handler_ptr, error_info = std::move(error_info)] () mutable
+                    {
+                        auto&& handler = std::move(*handler_ptr.get());
+                        handler(std::move(error_info));
+                    });
+                }
+                return true;
+            }
+        });
+    }
+
+private:
+    MysqlClient &mysql_client_;
+};
+
 MysqlClient::~MysqlClient()
 {
     close();
@@ -352,6 +461,8 @@ MysqlClient::MysqlClient(MysqlClient &&other)
 MysqlClient& MysqlClient::operator=(MysqlClient &&other)
 {
     std::swap(mysql_, other.mysql_);
+    std::swap(is_broken_, other.is_broken_);
+    std::swap(queue_time_, other.queue_time_);
     std::swap(host_, other.host_);
     std::swap(port_, other.port_);
     std::swap(user_, other.user_);
@@ -366,6 +477,7 @@ boost::asio::awaitable<result<void>> MysqlClient::connect(const std::string& hos
     {
         mysql_ = mysql_init(nullptr);
     }
+    is_broken_ = false;
 
     host_ = host;
     port_ = port;
@@ -378,6 +490,12 @@ boost::asio::awaitable<result<void>> MysqlClient::connect(const std::string& hos
         boost::asio::use_awaitable);
 }
 
+boost::asio::awaitable<result<void>> MysqlClient::ping()
+{
+    RESULT_CO_CHECK(co_await query("select 1"));
+    co_return RESULT_SUCCESS;
+}
+
 void MysqlClient::close()
 {
     if (mysql_)
@@ -385,6 +503,7 @@ void MysqlClient::close()
         mysql_close(mysql_);
         mysql_ = nullptr;
     }
+    is_broken_ = true;
 }
 
 std::string MysqlClient::encode_string(const std::string &raw)
@@ -424,6 +543,32 @@ boost::asio::awaitable<result<void>> MysqlClient::mysql_free_result(MYSQL_RES *r
         boost::asio::use_awaitable);
 }
 
+void MysqlClient::check_broken()
+{
+    auto error_number = mysql_errno(mysql_);
+    if (error_number >= CR_MIN_ERROR && error_number <= CR_MAX_ERROR)
+        is_broken_ = true;
+}
+
+boost::asio::awaitable<result<void>> MysqlClient::mysql_next_result()
+{
+    return boost::asio::async_initiate<const boost::asio::use_awaitable_t<>, void(result<void>)>(
+        initiate_mysql_next_result(*this),
+        boost::asio::use_awaitable);
+}
+
+boost::asio::awaitable<result<void>> MysqlClient::drain_result_sets()
+{
+    while (mysql_more_results(mysql_))
+    {
+        RESULT_CO_CHECK(co_await mysql_next_result());
+        RESULT_CO_AUTO(res, co_await mysql_store_result());
+        (void)res;
+    }
+
+    co_return RESULT_SUCCESS;
+}
+
 result<std::vector<std::string>> MysqlClient::get_fields(MYSQL_RES *res)
 {
     unsigned long field_num = mysql_num_fields(res);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <sstream>
 #include <memory>
@@ -7,7 +8,9 @@
 #include <boost/asio.hpp>
 
 #include "error.h"
+#include "mysql_statistics.h"
 #include "result.h"
+#include "trace.h"
 
 struct MYSQL;
 struct MYSQL_RES;
@@ -18,6 +21,7 @@ extern "C"
 {
 unsigned int mysql_errno(MYSQL *mysql);
 unsigned long *mysql_fetch_lengths(MYSQL_RES *result);
+bool mysql_more_results(MYSQL *mysql);
 }
 
 namespace conet {
@@ -29,6 +33,7 @@ class initiate_mysql_query;
 class initiate_mysql_store_result;
 class initiate_mysql_fetch_row;
 class initiate_mysql_free_result;
+class initiate_mysql_next_result;
 
 class MysqlQueryResultImpl
 {
@@ -60,6 +65,9 @@ public:
     void add_result(const std::string &key, const std::string &value);
     void add_result(const std::string &key, std::string &&value);
 
+    // approximate memory used by the row
+    std::size_t byte_size() const;
+
 private:
     std::unordered_map<std::string, std::string> datas_;
 };
@@ -71,6 +79,7 @@ class MysqlClient
     friend initiate_mysql_store_result;
     friend initiate_mysql_fetch_row;
     friend initiate_mysql_free_result;
+    friend initiate_mysql_next_result;
 
 public:
     MysqlClient() = default;
@@ -85,10 +94,103 @@ public:
 
     void close();
 
+    // true after close() or a client library error (CR_*), the connection should not be reused.
+    bool is_broken() const { return is_broken_; }
+    boost::asio::awaitable<result<void>> ping();
+
+    // phase timings are recorded to MysqlStatistics
     template<typename T = MysqlQueryResultImpl>
     boost::asio::awaitable<result<std::vector<T>>> query(const std::string& sql)
     {
-        RESULT_CO_AUTO(results, co_await query_real(sql), r.error_info().add_pair("sql", sql));
+        TraceSpan span("MysqlClient::query");
+        MysqlQueryTimer timer(queue_time_);
+        span.suspend();
+        auto query_result = co_await query_real<T>(sql, timer);
+        span.resume();
+        MysqlStatistics::instance().record(sql, timer, query_result ? query_result.value().size() : 0, query_result);
+        RESULT_CO_CHECK(std::move(query_result), r.error_info().add_pair("sql", sql));
+
+        co_return std::move(query_result);
+    }
+
+    // Send all statements in one round trip, one result per statement.
+    // Execution stops at the first failing statement, the following ones get statement_not_executed.
+    template<typename T = MysqlQueryResultImpl>
+    boost::asio::awaitable<result<std::vector<result<std::vector<T>>>>> batch_query(const std::vector<std::string>& sqls)
+    {
+        std::vector<result<std::vector<T>>> results;
+        if (sqls.empty())
+            co_return std::move(results);
+        results.reserve(sqls.size());
+
+        std::string sql;
+        for (const auto &s : sqls)
+        {
+            if (!sql.empty())
+                sql += ";\n";
+            sql += s;
+        }
+
+        MysqlQueryTimer timer(queue_time_);
+        timer.start();
+        auto r = co_await mysql_query(sql);
+        timer.stop(MysqlQueryPhase::execute);
+        if (r)
+        {
+            while (true)
+            {
+                results.push_back(co_await read_result_set<T>(timer));
+                if (!results.back() || results.size() >= sqls.size() || !mysql_more_results(mysql_))
+                    break;
+
+                // executes the next statement
+                auto next_result = co_await mysql_next_result();
+                if (!next_result)
+                {
+                    results.push_back(std::move(next_result));
+                    break;
+                }
+            }
+        }
+        else
+        {
+            results.push_back(std::move(r));
+        }
+
+        for (std::size_t i=0; i<results.size(); ++i)
+        {
+            if (!results[i])
+            {
+                results[i].error_info().add_pair("statement_index", i);
+                results[i].error_info().add_pair("sql", sqls[i]);
+            }
+        }
+
+        while (results.size() < sqls.size())
+        {
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(error::statement_not_executed, error::mysql_category(), &loc);
+
+            ErrorInfo error_info(error_code);
+            error_info.add_pair("statement_index", results.size());
+            error_info.add_pair("sql", sqls[results.size()]);
+            results.push_back(std::move(error_info));
+        }
+
+        std::size_t row_number = 0;
+        bool is_success = true;
+        for (const auto &statement_result : results)
+        {
+            if (statement_result)
+                row_number += statement_result.value().size();
+            else
+                is_success = false;
+        }
+        MysqlStatistics::instance().record(sql, timer, row_number, is_success);
+
+        // the connection is out of sync if results are left
+        RESULT_CO_CHECK(co_await drain_result_sets(), is_broken_ = true);
 
         co_return std::move(results);
     }
@@ -97,19 +199,39 @@ public:
 
 private:
     template<typename T = MysqlQueryResultImpl>
-    boost::asio::awaitable<result<std::vector<T>>> query_real(const std::string& sql)
+    boost::asio::awaitable<result<std::vector<T>>> query_real(const std::string& sql, MysqlQueryTimer &timer)
     {
-        RESULT_CO_CHECK(co_await mysql_query(sql));
-        RESULT_CO_AUTO(res, co_await mysql_store_result());
+        timer.start();
+        auto query_result = co_await mysql_query(sql);
+        timer.stop(MysqlQueryPhase::execute);
+        RESULT_CO_CHECK(query_result);
+        RESULT_CO_AUTO(query_result_group, co_await read_result_set<T>(timer));
+
+        // multi statements in sql, only the first result is returned
+        RESULT_CO_CHECK(co_await drain_result_sets());
+
+        co_return std::move(query_result_group);
+    }
+
+    template<typename T = MysqlQueryResultImpl>
+    boost::asio::awaitable<result<std::vector<T>>> read_result_set(MysqlQueryTimer &timer)
+    {
+        timer.start();
+        auto store_result = co_await mysql_store_result();
+        timer.stop(MysqlQueryPhase::store);
+        RESULT_CO_AUTO(res, std::move(store_result));
         if (res == nullptr)
             co_return RESULT_SUCCESS;
 
+        timer.start();
         RESULT_CO_AUTO(row, co_await mysql_fetch_row(res.get()));
+        timer.stop(MysqlQueryPhase::fetch);
         RESULT_CO_AUTO(field_names, get_fields(res.get()));
         
         std::vector<T> query_result_group;
         while (row)
         {
+            timer.start();
             unsigned long* element_size = mysql_fetch_lengths(res.get());
             if (element_size == nullptr)
             {
@@ -129,21 +251,31 @@ private:
                 query_result.add_result(field_names[i], std::move(value));
             }
             query_result_group.push_back(std::move(query_result));
+            timer.stop(MysqlQueryPhase::decode);
 
+            timer.start();
             RESULT_CO_TRY(row, co_await mysql_fetch_row(res.get()));
+            timer.stop(MysqlQueryPhase::fetch);
         }
 
         co_return query_result_group;
     }
 
+    boost::asio::awaitable<result<void>> drain_result_sets();
+
     boost::asio::awaitable<result<void>> mysql_query(const std::string& sql);
     boost::asio::awaitable<result<std::shared_ptr<MYSQL_RES>>> mysql_store_result();
     boost::asio::awaitable<result<char **>> mysql_fetch_row(MYSQL_RES *r);
     boost::asio::awaitable<result<void>> mysql_free_result(MYSQL_RES *r);
+    boost::asio::awaitable<result<void>> mysql_next_result();
 
     result<std::vector<std::string>> get_fields(MYSQL_RES *res);
+    void check_broken();
 
     MYSQL *mysql_ = nullptr;
+    bool is_broken_ = false;
+    // time operations waited for the Polling thread, accumulated by the initiators
+    std::chrono::steady_clock::duration queue_time_{0};
     std::string host_;
     unsigned int port_ = 0;
     std::string user_;
@@ -1,21 +1,51 @@
 #include "mysql_client_pool.h"
 
+#include <algorithm>
 #include <vector>
 
+#include "async_log.h"
+#include "defer.h"
 #include "error.h"
+#include "metrics.h"
 
 namespace conet {
+namespace impl {
 
-MysqlClientPool::MysqlClientPool(boost::asio::io_context &io_context) :
-    strand_(boost::asio::make_strand(io_context)),
+namespace {
+
+// pools of the same server, e.g. the shards of a ShardedMysqlClientPool, export separate series
+std::atomic_uint64_t next_pool_id(1);
+
+} // namespace
+
+MysqlClientPoolImpl::MysqlClientPoolImpl(boost::asio::any_io_executor executor) :
+    strand_(boost::asio::make_strand(executor)),
+    maintenance_timer_(strand_),
+    pool_id_(next_pool_id++),
+    is_closed_(false),
+    is_maintaining_(false),
     current_number_(0),
+    connecting_number_(0),
     limit_max_number_(0),
+    idle_number_(0),
+    waiting_number_(0),
+    broken_number_(0),
+    evicted_number_(0),
+    acquire_timeout_number_(0),
+    created_number_(0),
+    closed_number_(0),
     port_(0)
 {
 
 }
 
-boost::asio::awaitable<result<void>> conet::MysqlClientPool::init(
+MysqlClientPoolImpl::~MysqlClientPoolImpl()
+{
+    if (metrics_collector_id_ != 0)
+        MetricsRegistry::global().remove_collector(metrics_collector_id_);
+}
+
+boost::asio::awaitable<result<void>> MysqlClientPoolImpl::init(
         const std::string& host,
         unsigned int port,
         const std::string& user,
@@ -24,71 +54,424 @@ boost::asio::awaitable<result<void>> conet::MysqlClientPool::init(
         int init_number,
         int limit_max_number)
 {
+    // the caller may destroy the pool while this is suspended
+    auto self = shared_from_this();
     host_ = host;
     port_ = port;
     user_ = user;
     password_ = password;
     database_ = database;
     limit_max_number_ = limit_max_number;
+    is_closed_ = false;
+    if (metrics_collector_id_ == 0)
+        add_metrics_collector();
 
     co_await boost::asio::post(strand_, boost::asio::use_awaitable);
-    for (int i=0; i<init_number; ++i)
+
+    auto state = std::make_shared<InitState>(strand_);
+    state->target_number = std::min(init_number, limit_max_number);
+    state->ready_number = state->target_number;
+    if (options_.init_ready_number > 0 && options_.init_ready_number < state->ready_number)
+        state->ready_number = options_.init_ready_number;
+    state->running_number = state->target_number;
+    if (options_.connect_parallelism > 0 && options_.connect_parallelism < state->running_number)
+        state->running_number = options_.connect_parallelism;
+
+    for (int i=0; i<state->running_number; ++i)
+    {
+        boost::asio::co_spawn(strand_, init_worker(self, state), boost::asio::detached);
+    }
+
+    if (state->running_number > 0 && state->success_number < state->ready_number)
+    {
+        state->timer.expires_at(boost::asio::steady_timer::time_point::max());
+        boost::system::error_code ec;
+        co_await state->timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        co_await boost::asio::post(strand_, boost::asio::use_awaitable);
+    }
+
+    if (state->success_number < state->ready_number)
     {
-        RESULT_CO_AUTO(mysql_client, co_await create());
-        mysql_client_group_.push_back(std::move(mysql_client));
+        ErrorInfo error_info = state->error_info;
+        error_info.add_pair("success_number", state->success_number);
+        error_info.add_pair("ready_number", state->ready_number);
+        co_return error_info;
+    }
+
+    if (options_.maintenance_interval.count() > 0 && !is_maintaining_)
+    {
+        is_maintaining_ = true;
+        boost::asio::co_spawn(strand_, maintain(self), boost::asio::detached);
     }
 
     co_return RESULT_SUCCESS;
 }
 
-boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> MysqlClientPool::get()
+boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> MysqlClientPoolImpl::get()
+{
+    // the caller may destroy the pool while this is waiting
+    auto self = shared_from_this();
+    auto start_time = std::chrono::steady_clock::now();
+    DEFER(acquire_wait_histogram_.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count()));
+
+    co_return co_await get_real();
+}
+
+void MysqlClientPoolImpl::close()
+{
+    boost::asio::dispatch(strand_, [this, self = shared_from_this()] ()
+    {
+        is_closed_ = true;
+        maintenance_timer_.cancel();
+
+        current_number_ -= static_cast<int>(mysql_client_group_.size());
+        closed_number_ += mysql_client_group_.size();
+        mysql_client_group_.clear();
+        idle_number_ = 0;
+
+        for (auto waiter : waiter_group_)
+        {
+            waiter->timer.cancel();
+        }
+        waiter_group_.clear();
+    });
+}
+
+void MysqlClientPoolImpl::add_metrics_collector()
+{
+    MetricLabels labels = {{"host", host_}, {"port", std::to_string(port_)}, {"database", database_}, {"pool", std::to_string(pool_id_)}};
+    metrics_collector_id_ = MetricsRegistry::global().add_collector([this, labels] (std::vector<MetricSample> &samples)
+        {
+            auto stats = this->stats();
+            auto add = [&samples, &labels] (const char *name, const char *help, MetricType type, double value)
+            {
+                auto &sample = samples.emplace_back();
+                sample.name = name;
+                sample.help = help;
+                sample.type = type;
+                sample.labels = labels;
+                sample.value = value;
+            };
+
+            add("conet_mysql_pool_connections", "open and connecting connections", MetricType::gauge, stats.current_number);
+            add("conet_mysql_pool_connecting_connections", "connections in handshake", MetricType::gauge, stats.connecting_number);
+            add("conet_mysql_pool_idle_connections", "idle connections", MetricType::gauge, stats.idle_number);
+            add("conet_mysql_pool_active_connections", "connections checked out by callers", MetricType::gauge, stats.active_number);
+            add("conet_mysql_pool_waiting_requests", "get() calls waiting for a connection", MetricType::gauge, stats.waiting_number);
+            add("conet_mysql_pool_created_total", "connections created", MetricType::counter, stats.created_number);
+            add("conet_mysql_pool_closed_total", "connections closed", MetricType::counter, stats.closed_number);
+            add("conet_mysql_pool_broken_total", "connections found broken", MetricType::counter, stats.broken_number);
+            add("conet_mysql_pool_evicted_total", "idle connections evicted", MetricType::counter, stats.evicted_number);
+            add("conet_mysql_pool_acquire_timeouts_total", "get() calls that timed out", MetricType::counter, stats.acquire_timeout_number);
+            samples.push_back(MetricSample::from_histogram("conet_mysql_pool_acquire_microseconds",
+                "time spent in get()", labels, acquire_wait_histogram_));
+        });
+}
+
+MysqlClientPoolStats MysqlClientPoolImpl::stats() const
+{
+    MysqlClientPoolStats stats;
+    stats.current_number = current_number_;
+    stats.connecting_number = connecting_number_;
+    stats.idle_number = idle_number_;
+    stats.active_number = std::max(stats.current_number - stats.connecting_number - stats.idle_number, 0);
+    stats.waiting_number = waiting_number_;
+    stats.created_number = created_number_;
+    stats.closed_number = closed_number_;
+    stats.broken_number = broken_number_;
+    stats.evicted_number = evicted_number_;
+    stats.acquire_timeout_number = acquire_timeout_number_;
+    return stats;
+}
+
+boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> MysqlClientPoolImpl::get_real()
 {
     co_await boost::asio::post(strand_, boost::asio::use_awaitable);
 
-    std::shared_ptr<MysqlClient> p(new MysqlClient, [this] (MysqlClient *raw_p)
+    while (!is_closed_)
     {
-        boost::asio::dispatch(strand_, 
-            [raw_p, this] ()
+        if (!mysql_client_group_.empty())
+        {
+            // most recently used first, the oldest ones are left for idle eviction
+            auto idle_client = std::move(mysql_client_group_.back());
+            mysql_client_group_.pop_back();
+            idle_number_ = static_cast<int>(mysql_client_group_.size());
+
+            if (std::chrono::steady_clock::now() - idle_client.checked_at >= options_.validation_interval)
             {
-                mysql_client_group_.push_back(std::move(*raw_p));
+                auto r = co_await idle_client.mysql_client.ping();
+                co_await boost::asio::post(strand_, boost::asio::use_awaitable);
+                if (!r)
+                {
+                    ASYNC_LOG(INFO) << "drop broken mysql client. " << r.error_info();
+                    ++broken_number_;
+                    ++closed_number_;
+                    release_slot();
+                    continue;
+                }
+            }
+
+            co_return make_shared_client(std::move(idle_client.mysql_client));
+        }
+
+        if (reserve_slot())
+        {
+            RESULT_CO_AUTO(mysql_client, co_await create());
+            co_return make_shared_client(std::move(mysql_client));
+        }
+
+        if (options_.acquire_timeout.count() <= 0)
+        {
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(error::internal_error, error::conet_category(), &loc);
+
+            conet::ErrorInfo error_info(error_code);
+            error_info.set_error_message("mysql client limit");
+            error_info.add_pair("database", database_);
+            error_info.add_pair("current_number", current_number_.load());
+            error_info.add_pair("limit_max_number", limit_max_number_.load());
+
+            co_return error_info;
+        }
+
+        // pool is full or too many connecting, wait for put_back() or grant_slots() in FIFO order
+        Waiter waiter(strand_);
+        waiter.timer.expires_after(options_.acquire_timeout);
+        waiter_group_.push_back(&waiter);
+        ++waiting_number_;
+
+        boost::system::error_code ec;
+        co_await waiter.timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        co_await boost::asio::post(strand_, boost::asio::use_awaitable);
+        --waiting_number_;
+
+        if (waiter.mysql_client)
+        {
+            co_return make_shared_client(std::move(*waiter.mysql_client));
+        }
+
+        if (waiter.slot_granted)
+        {
+            RESULT_CO_AUTO(mysql_client, co_await create());
+            co_return make_shared_client(std::move(mysql_client));
+        }
+
+        if (is_closed_)
+            break;
+
+        waiter_group_.remove(&waiter);
+        ++acquire_timeout_number_;
+
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::acquire_timeout, error::mysql_category(), &loc);
+
+        conet::ErrorInfo error_info(error_code);
+        error_info.set_error_message("mysql client acquire timeout");
+        error_info.add_pair("database", database_);
+        error_info.add_pair("current_number", current_number_.load());
+        error_info.add_pair("limit_max_number", limit_max_number_.load());
+        error_info.add_pair("waiting_number", waiting_number_.load());
+
+        co_return error_info;
+    }
+
+    boost::system::error_code error_code;
+    static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+    error_code.assign(error::pool_closed, error::mysql_category(), &loc);
+    co_return error_code;
+}
+
+// the slot is reserved by the caller and released here on failure
+boost::asio::awaitable<result<MysqlClient>> MysqlClientPoolImpl::create()
+{
+    MysqlClient mysql_client;
+    auto connect_result = co_await mysql_client.connect(host_, port_, user_, password_, database_);
+    co_await boost::asio::post(strand_, boost::asio::use_awaitable);
+
+    --connecting_number_;
+    if (!connect_result)
+    {
+        release_slot();
+        RESULT_CO_CHECK(connect_result);
+    }
+
+    ++created_number_;
+    grant_slots();
+    co_return mysql_client;
+}
+
+boost::asio::awaitable<void> MysqlClientPoolImpl::init_worker(std::shared_ptr<MysqlClientPoolImpl> self, std::shared_ptr<InitState> state)
+{
+    while (!is_closed_ && !state->is_failed && state->started_number < state->target_number &&
+        current_number_ < limit_max_number_)
+    {
+        ++state->started_number;
+        ++current_number_;
+        ++connecting_number_;
+
+        auto r = co_await create();
+        if (!r)
+        {
+            if (!state->is_failed)
+                state->error_info = r.error_info();
+            state->is_failed = true;
+            break;
+        }
+
+        put_back(std::move(r).value());
+        ++state->success_number;
+        if (state->success_number == state->ready_number)
+            state->timer.cancel();
+    }
+
+    if (--state->running_number == 0)
+        state->timer.cancel();
+}
+
+boost::asio::awaitable<void> MysqlClientPoolImpl::maintain(std::shared_ptr<MysqlClientPoolImpl> self)
+{
+    while (!is_closed_)
+    {
+        maintenance_timer_.expires_after(options_.maintenance_interval);
+        boost::system::error_code ec;
+        co_await maintenance_timer_.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        co_await boost::asio::post(strand_, boost::asio::use_awaitable);
+        if (is_closed_)
+            break;
+
+        // evict from the front, it is the least recently used
+        auto now = std::chrono::steady_clock::now();
+        while (static_cast<int>(mysql_client_group_.size()) > options_.min_idle_number &&
+            now - mysql_client_group_.front().idle_since >= options_.idle_timeout)
+        {
+            mysql_client_group_.pop_front();
+            ++evicted_number_;
+            ++closed_number_;
+            release_slot();
+        }
+        idle_number_ = static_cast<int>(mysql_client_group_.size());
+
+        // background liveness check, one connection per round is enough to keep the pool healthy
+        if (!mysql_client_group_.empty() && now - mysql_client_group_.front().checked_at >= options_.validation_interval)
+        {
+            auto idle_client = std::move(mysql_client_group_.front());
+            mysql_client_group_.pop_front();
+            idle_number_ = static_cast<int>(mysql_client_group_.size());
+
+            auto r = co_await idle_client.mysql_client.ping();
+            co_await boost::asio::post(strand_, boost::asio::use_awaitable);
+            if (!r)
+            {
+                ASYNC_LOG(INFO) << "drop broken mysql client. " << r.error_info();
+                ++broken_number_;
+                ++closed_number_;
+                release_slot();
+            }
+            else
+            {
+                idle_client.checked_at = std::chrono::steady_clock::now();
+                mysql_client_group_.push_front(std::move(idle_client));
+                idle_number_ = static_cast<int>(mysql_client_group_.size());
+            }
+        }
+
+        while (!is_closed_ && static_cast<int>(mysql_client_group_.size()) < options_.min_idle_number &&
+            reserve_slot())
+        {
+            auto r = co_await create();
+            if (!r)
+            {
+                ASYNC_LOG(INFO) << "create mysql client fail. " << r.error_info();
+                break;
+            }
+
+            put_back(std::move(r).value());
+        }
+    }
+
+    is_maintaining_ = false;
+}
+
+std::shared_ptr<MysqlClient> MysqlClientPoolImpl::make_shared_client(MysqlClient &&mysql_client)
+{
+    return std::shared_ptr<MysqlClient>(new MysqlClient(std::move(mysql_client)), [self = shared_from_this()] (MysqlClient *raw_p)
+    {
+        boost::asio::dispatch(self->strand_,
+            [raw_p, self] ()
+            {
+                self->put_back(std::move(*raw_p));
                 delete raw_p;
             });
     });
+}
 
-    if (!mysql_client_group_.empty())
+void MysqlClientPoolImpl::put_back(MysqlClient &&mysql_client)
+{
+    if (mysql_client.is_broken() || is_closed_)
     {
-        auto mysql_client = std::move(mysql_client_group_.front());
-        mysql_client_group_.pop_front();
+        if (!is_closed_)
+            ++broken_number_;
+        mysql_client.close();
+        ++closed_number_;
+        release_slot();
+        return;
+    }
 
-        *p = std::move(mysql_client);
-        co_return p;
+    if (!waiter_group_.empty())
+    {
+        auto waiter = waiter_group_.front();
+        waiter_group_.pop_front();
+        waiter->mysql_client = std::move(mysql_client);
+        waiter->timer.cancel();
+        return;
     }
 
-    if (current_number_ < limit_max_number_)
+    if (static_cast<int>(mysql_client_group_.size()) >= options_.max_idle_number)
     {
-        RESULT_CO_TRY(*p, co_await create());
-        co_return p;
+        mysql_client.close();
+        ++evicted_number_;
+        ++closed_number_;
+        release_slot();
+        return;
     }
 
-    boost::system::error_code error_code;
-    static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
-    error_code.assign(error::internal_error, error::conet_category(), &loc);
+    auto now = std::chrono::steady_clock::now();
+    mysql_client_group_.push_back({std::move(mysql_client), now, now});
+    idle_number_ = static_cast<int>(mysql_client_group_.size());
+}
 
-    conet::ErrorInfo error_info(error_code);
-    error_info.set_error_message("mysql client limit");
-    error_info.add_pair("database", database_);
-    error_info.add_pair("current_number", current_number_);
-    error_info.add_pair("limit_max_number", limit_max_number_);
+bool MysqlClientPoolImpl::reserve_slot()
+{
+    if (current_number_ >= limit_max_number_)
+        return false;
+    if (options_.connect_parallelism > 0 && connecting_number_ >= options_.connect_parallelism)
+        return false;
 
-    co_return error_info;
+    ++current_number_;
+    ++connecting_number_;
+    return true;
 }
 
-boost::asio::awaitable<result<MysqlClient>> MysqlClientPool::create()
+// the connection occupying a slot is gone
+void MysqlClientPoolImpl::release_slot()
 {
-    MysqlClient mysql_client;
-    RESULT_CO_CHECK(co_await mysql_client.connect(host_, port_, user_, password_, database_));
-    ++current_number_;
-    co_return mysql_client;
+    --current_number_;
+    grant_slots();
+}
+
+// let waiters create connections while there are free slots
+void MysqlClientPoolImpl::grant_slots()
+{
+    while (!waiter_group_.empty() && !is_closed_ && reserve_slot())
+    {
+        auto waiter = waiter_group_.front();
+        waiter_group_.pop_front();
+        waiter->slot_granted = true;
+        waiter->timer.cancel();
+    }
 }
 
+} // namespace impl
 } // namespace conet
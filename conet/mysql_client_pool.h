@@ -1,18 +1,71 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <list>
+#include <optional>
 
 #include <boost/asio.hpp>
+#include "histogram.h"
 #include "mysql_client.h"
 
 namespace conet {
 
-class MysqlClientPool
+struct MysqlClientPoolOptions
+{
+    // how long get() waits in queue when the pool is full. zero fails immediately.
+    std::chrono::milliseconds acquire_timeout = std::chrono::seconds(3);
+    // maintenance keeps at least this many idle connections.
+    int min_idle_number = 0;
+    // returned connections above this number are closed.
+    int max_idle_number = std::numeric_limits<int>::max();
+    // idle connections unused for longer are closed by maintenance, down to min_idle_number.
+    std::chrono::milliseconds idle_timeout = std::chrono::minutes(10);
+    // idle connections unchecked for longer are pinged before being handed out.
+    std::chrono::milliseconds validation_interval = std::chrono::seconds(30);
+    // period of the background maintenance. zero disables it.
+    std::chrono::milliseconds maintenance_interval = std::chrono::seconds(10);
+    // concurrent connection handshakes in init() and on-demand growth. zero is unlimited.
+    int connect_parallelism = 8;
+    // init() returns once this many connections are ready, the rest keep connecting in background.
+    // zero waits for all.
+    int init_ready_number = 0;
+};
+
+struct MysqlClientPoolStats
+{
+    int current_number;
+    int connecting_number;
+    int idle_number;
+    // checked out by callers
+    int active_number;
+    int waiting_number;
+    // connection churn
+    std::uint64_t created_number;
+    std::uint64_t closed_number;
+    std::uint64_t broken_number;
+    std::uint64_t evicted_number;
+    std::uint64_t acquire_timeout_number;
+};
+
+namespace impl {
+
+// the state of MysqlClientPool, kept alive by the maintenance, the waiting get() and the connections
+// checked out
+class MysqlClientPoolImpl : public std::enable_shared_from_this<MysqlClientPoolImpl>
 {
 public:
-    MysqlClientPool(boost::asio::io_context &io_context);
+    MysqlClientPoolImpl(boost::asio::any_io_executor executor);
+    ~MysqlClientPoolImpl();
+
+    MysqlClientPoolImpl(const MysqlClientPoolImpl &) = delete;
+    MysqlClientPoolImpl& operator=(const MysqlClientPoolImpl &) = delete;
+
+    void set_options(const MysqlClientPoolOptions &options) { options_ = options; }
+    const MysqlClientPoolOptions& options() const { return options_; }
 
     boost::asio::awaitable<result<void>> init(
         const std::string& host,
@@ -22,21 +75,146 @@ public:
         const std::string& database,
         int init_number,
         int limit_max_number);
-
     boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> get();
+    void close();
+
+    MysqlClientPoolStats stats() const;
+    bool is_maintaining() const { return is_maintaining_; }
+    int limit_max_number() const { return limit_max_number_; }
+    std::uint64_t pool_id() const { return pool_id_; }
+    boost::asio::any_io_executor get_executor() const { return strand_.get_inner_executor(); }
+    const Histogram& acquire_wait_histogram() const { return acquire_wait_histogram_; }
 
 private:
+    struct IdleClient
+    {
+        MysqlClient mysql_client;
+        std::chrono::steady_clock::time_point idle_since;
+        std::chrono::steady_clock::time_point checked_at;
+    };
+
+    struct Waiter
+    {
+        Waiter(boost::asio::strand<boost::asio::any_io_executor> &strand) : timer(strand) {}
+
+        boost::asio::steady_timer timer;
+        std::optional<MysqlClient> mysql_client;
+        bool slot_granted = false;
+    };
+
+    struct InitState
+    {
+        InitState(boost::asio::strand<boost::asio::any_io_executor> &strand) : timer(strand) {}
+
+        boost::asio::steady_timer timer;
+        int target_number = 0;
+        int ready_number = 0;
+        int started_number = 0;
+        int success_number = 0;
+        int running_number = 0;
+        bool is_failed = false;
+        ErrorInfo error_info;
+    };
+
+    boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> get_real();
     boost::asio::awaitable<result<MysqlClient>> create();
+    // self keeps this alive until the coroutine exits
+    boost::asio::awaitable<void> init_worker(std::shared_ptr<MysqlClientPoolImpl> self, std::shared_ptr<InitState> state);
+    boost::asio::awaitable<void> maintain(std::shared_ptr<MysqlClientPoolImpl> self);
+    std::shared_ptr<MysqlClient> make_shared_client(MysqlClient &&mysql_client);
+    void put_back(MysqlClient &&mysql_client);
+    bool reserve_slot();
+    void release_slot();
+    void grant_slots();
+    // exports stats() to MetricsRegistry::global(), labeled by the server and the pool id
+    void add_metrics_collector();
 
     boost::asio::strand<boost::asio::any_io_executor> strand_;
-    int current_number_;
-    int limit_max_number_;
-    std::list<MysqlClient> mysql_client_group_;
+    boost::asio::steady_timer maintenance_timer_;
+    // process wide sequence number
+    std::uint64_t pool_id_;
+    MysqlClientPoolOptions options_;
+    bool is_closed_;
+    std::atomic_bool is_maintaining_;
+    std::atomic_int current_number_;
+    std::atomic_int connecting_number_;
+    std::atomic_int limit_max_number_;
+    std::list<IdleClient> mysql_client_group_;
+    std::list<Waiter *> waiter_group_;
+    std::atomic_int idle_number_;
+    std::atomic_int waiting_number_;
+    std::atomic_uint64_t broken_number_;
+    std::atomic_uint64_t evicted_number_;
+    std::atomic_uint64_t acquire_timeout_number_;
+    std::atomic_uint64_t created_number_;
+    std::atomic_uint64_t closed_number_;
+    Histogram acquire_wait_histogram_;
     std::string host_;
     unsigned int port_;
     std::string user_;
     std::string password_;
     std::string database_;
+    std::uint64_t metrics_collector_id_ = 0;
+};
+
+} // namespace impl
+
+class MysqlClientPool
+{
+public:
+    MysqlClientPool(boost::asio::io_context &io_context) :
+        MysqlClientPool(io_context.get_executor())
+    {
+    }
+
+    MysqlClientPool(boost::asio::any_io_executor executor) :
+        impl_(std::make_shared<impl::MysqlClientPoolImpl>(executor))
+    {
+    }
+
+    // closes without waiting, the maintenance and the connections still checked out keep the state
+    // alive on the executor, which has to outlive them
+    ~MysqlClientPool()
+    {
+        impl_->close();
+    }
+
+    MysqlClientPool(const MysqlClientPool &) = delete;
+    MysqlClientPool& operator=(const MysqlClientPool &) = delete;
+
+    void set_options(const MysqlClientPoolOptions &options) { impl_->set_options(options); }
+    const MysqlClientPoolOptions& options() const { return impl_->options(); }
+
+    boost::asio::awaitable<result<void>> init(
+        const std::string& host,
+        unsigned int port,
+        const std::string& user,
+        const std::string& password,
+        const std::string& database,
+        int init_number,
+        int limit_max_number)
+    {
+        return impl_->init(host, port, user, password, database, init_number, limit_max_number);
+    }
+
+    // waits in FIFO order up to options().acquire_timeout when the pool is full.
+    boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> get() { return impl_->get(); }
+
+    // stop maintenance, close idle connections and fail waiting get().
+    void close() { impl_->close(); }
+
+    MysqlClientPoolStats stats() const { return impl_->stats(); }
+    // the maintenance coroutine started by init() has not exited yet
+    bool is_maintaining() const { return impl_->is_maintaining(); }
+    int limit_max_number() const { return impl_->limit_max_number(); }
+    // the "pool" label of the metrics, unique in the process
+    std::uint64_t pool_id() const { return impl_->pool_id(); }
+    boost::asio::any_io_executor get_executor() const { return impl_->get_executor(); }
+    // microseconds spent in get()
+    const Histogram& acquire_wait_histogram() const { return impl_->acquire_wait_histogram(); }
+
+private:
+    std::shared_ptr<impl::MysqlClientPoolImpl> impl_;
 };
 
 } // namespace conet
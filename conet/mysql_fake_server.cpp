@@ -0,0 +1,709 @@
+#include "mysql_fake_server.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include <glog/logging.h>
+
+#include "error.h"
+
+namespace conet {
+
+namespace {
+
+// capability flags
+constexpr std::uint32_t client_long_password = 0x1;
+constexpr std::uint32_t client_found_rows = 0x2;
+constexpr std::uint32_t client_long_flag = 0x4;
+constexpr std::uint32_t client_connect_with_db = 0x8;
+constexpr std::uint32_t client_local_files = 0x80;
+constexpr std::uint32_t client_protocol_41 = 0x200;
+constexpr std::uint32_t client_transactions = 0x2000;
+constexpr std::uint32_t client_secure_connection = 0x8000;
+constexpr std::uint32_t client_multi_statements = 0x10000;
+constexpr std::uint32_t client_multi_results = 0x20000;
+constexpr std::uint32_t client_plugin_auth = 0x80000;
+constexpr std::uint32_t client_connect_attrs = 0x100000;
+constexpr std::uint32_t client_plugin_auth_lenenc_client_data = 0x200000;
+
+// no CLIENT_SSL and no CLIENT_DEPRECATE_EOF, result sets end with EOF packets
+constexpr std::uint32_t server_capabilities =
+    client_long_password | client_found_rows | client_long_flag | client_connect_with_db |
+    client_local_files | client_protocol_41 | client_transactions | client_secure_connection |
+    client_multi_statements | client_multi_results | client_plugin_auth |
+    client_connect_attrs | client_plugin_auth_lenenc_client_data;
+
+constexpr std::uint16_t server_status_autocommit = 0x2;
+constexpr std::uint16_t server_more_results_exists = 0x8;
+
+constexpr std::uint8_t com_quit = 0x01;
+constexpr std::uint8_t com_init_db = 0x02;
+constexpr std::uint8_t com_query = 0x03;
+constexpr std::uint8_t com_ping = 0x0e;
+
+constexpr std::uint8_t utf8_general_ci = 33;
+constexpr std::uint8_t mysql_type_var_string = 0xfd;
+
+const std::string server_version = "8.0.0-conet-fake";
+const std::string caching_sha2_password = "caching_sha2_password";
+const std::string mysql_native_password = "mysql_native_password";
+const std::string scramble = "0123456789abcdefghij";
+
+// packets larger than 16MB are not split, the fake server never sends them
+class PacketWriter
+{
+public:
+    PacketWriter(std::uint8_t sequence_id) : sequence_id_(sequence_id), start_(0) {}
+
+    void begin()
+    {
+        start_ = buffer_.size();
+        buffer_.resize(start_ + 4);
+    }
+
+    void end()
+    {
+        auto size = buffer_.size() - start_ - 4;
+        buffer_[start_] = static_cast<char>(size & 0xff);
+        buffer_[start_ + 1] = static_cast<char>((size >> 8) & 0xff);
+        buffer_[start_ + 2] = static_cast<char>((size >> 16) & 0xff);
+        buffer_[start_ + 3] = static_cast<char>(sequence_id_++);
+    }
+
+    void put_int(std::uint64_t value, std::size_t size)
+    {
+        for (std::size_t i=0; i<size; ++i)
+        {
+            buffer_.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    void put_lenenc_int(std::uint64_t value)
+    {
+        if (value < 251)
+        {
+            put_int(value, 1);
+        }
+        else if (value < 0x10000)
+        {
+            put_int(0xfc, 1);
+            put_int(value, 2);
+        }
+        else if (value < 0x1000000)
+        {
+            put_int(0xfd, 1);
+            put_int(value, 3);
+        }
+        else
+        {
+            put_int(0xfe, 1);
+            put_int(value, 8);
+        }
+    }
+
+    void put_string(const std::string &value)
+    {
+        buffer_.insert(buffer_.end(), value.begin(), value.end());
+    }
+
+    void put_null_terminated_string(const std::string &value)
+    {
+        put_string(value);
+        buffer_.push_back('\0');
+    }
+
+    void put_lenenc_string(const std::string &value)
+    {
+        put_lenenc_int(value.size());
+        put_string(value);
+    }
+
+    void put_ok(std::uint64_t affected_rows, std::uint64_t last_insert_id, std::uint16_t status)
+    {
+        begin();
+        put_int(0x00, 1);
+        put_lenenc_int(affected_rows);
+        put_lenenc_int(last_insert_id);
+        put_int(status, 2);
+        put_int(0, 2);
+        end();
+    }
+
+    void put_eof(std::uint16_t status)
+    {
+        begin();
+        put_int(0xfe, 1);
+        put_int(0, 2);
+        put_int(status, 2);
+        end();
+    }
+
+    void put_err(std::uint16_t error_number, const std::string &error_message)
+    {
+        begin();
+        put_int(0xff, 1);
+        put_int(error_number, 2);
+        put_string("#HY000");
+        put_string(error_message);
+        end();
+    }
+
+    std::uint8_t sequence_id() const { return sequence_id_; }
+    std::vector<char>&& release() { return std::move(buffer_); }
+
+private:
+    std::vector<char> buffer_;
+    std::uint8_t sequence_id_;
+    std::size_t start_;
+};
+
+class PacketReader
+{
+public:
+    PacketReader(const std::vector<char> &packet) : packet_(packet), offset_(0) {}
+
+    bool skip(std::size_t size)
+    {
+        if (packet_.size() - offset_ < size)
+            return false;
+        offset_ += size;
+        return true;
+    }
+
+    std::optional<std::uint64_t> get_int(std::size_t size)
+    {
+        if (packet_.size() - offset_ < size)
+            return std::nullopt;
+
+        std::uint64_t value = 0;
+        for (std::size_t i=0; i<size; ++i)
+        {
+            value |= static_cast<std::uint64_t>(static_cast<unsigned char>(packet_[offset_ + i])) << (8 * i);
+        }
+        offset_ += size;
+        return value;
+    }
+
+    std::optional<std::uint64_t> get_lenenc_int()
+    {
+        auto first = get_int(1);
+        if (!first)
+            return std::nullopt;
+
+        switch (*first)
+        {
+        case 0xfc:
+            return get_int(2);
+        case 0xfd:
+            return get_int(3);
+        case 0xfe:
+            return get_int(8);
+        default:
+            return first;
+        }
+    }
+
+    std::optional<std::string> get_null_terminated_string()
+    {
+        for (std::size_t i=offset_; i<packet_.size(); ++i)
+        {
+            if (packet_[i] == '\0')
+            {
+                std::string value(packet_.data() + offset_, i - offset_);
+                offset_ = i + 1;
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    const std::vector<char> &packet_;
+    std::size_t offset_;
+};
+
+boost::asio::awaitable<result<std::vector<char>>> read_packet(TcpClient &tcp_client, std::uint8_t &sequence_id)
+{
+    std::vector<char> header(4);
+    RESULT_CO_CHECK(co_await tcp_client.read(header));
+
+    std::size_t size =
+        static_cast<std::size_t>(static_cast<unsigned char>(header[0])) |
+        static_cast<std::size_t>(static_cast<unsigned char>(header[1])) << 8 |
+        static_cast<std::size_t>(static_cast<unsigned char>(header[2])) << 16;
+    sequence_id = static_cast<std::uint8_t>(header[3]);
+
+    std::vector<char> payload(size);
+    if (size > 0)
+    {
+        RESULT_CO_CHECK(co_await tcp_client.read(payload));
+    }
+
+    co_return std::move(payload);
+}
+
+result<void> malformed_packet(const char *packet_name)
+{
+    boost::system::error_code error_code;
+    static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+    error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+    ErrorInfo error_info(error_code);
+    error_info.set_error_message("malformed mysql packet");
+    error_info.add_pair("packet", packet_name);
+    return error_info;
+}
+
+struct HandshakeResponse
+{
+    // empty when the client does not send one
+    std::string auth_plugin_name;
+    std::size_t auth_response_size = 0;
+};
+
+result<HandshakeResponse> parse_handshake_response(const std::vector<char> &packet)
+{
+    HandshakeResponse response;
+
+    PacketReader reader(packet);
+    auto capabilities = reader.get_int(4);
+    // max packet size, character set, filler
+    if (!capabilities || !reader.skip(4 + 1 + 23) || !reader.get_null_terminated_string())
+        return malformed_packet("handshake response");
+
+    if (*capabilities & client_plugin_auth_lenenc_client_data)
+    {
+        auto size = reader.get_lenenc_int();
+        if (!size || !reader.skip(*size))
+            return malformed_packet("handshake response");
+        response.auth_response_size = *size;
+    }
+    else if (*capabilities & client_secure_connection)
+    {
+        auto size = reader.get_int(1);
+        if (!size || !reader.skip(*size))
+            return malformed_packet("handshake response");
+        response.auth_response_size = *size;
+    }
+    else
+    {
+        auto auth_response = reader.get_null_terminated_string();
+        if (!auth_response)
+            return malformed_packet("handshake response");
+        response.auth_response_size = auth_response->size();
+    }
+
+    if ((*capabilities & client_connect_with_db) && !reader.get_null_terminated_string())
+        return malformed_packet("handshake response");
+
+    if (*capabilities & client_plugin_auth)
+    {
+        auto plugin_name = reader.get_null_terminated_string();
+        if (!plugin_name)
+            return malformed_packet("handshake response");
+        response.auth_plugin_name = std::move(*plugin_name);
+    }
+
+    return response;
+}
+
+bool is_result_set_statement(const std::string &sql)
+{
+    std::size_t i = 0;
+    while (i < sql.size() && std::isspace(static_cast<unsigned char>(sql[i])))
+    {
+        ++i;
+    }
+
+    std::string keyword;
+    while (i < sql.size() && std::isalpha(static_cast<unsigned char>(sql[i])))
+    {
+        keyword += static_cast<char>(std::tolower(static_cast<unsigned char>(sql[i])));
+        ++i;
+    }
+
+    return keyword == "select" || keyword == "show";
+}
+
+// LOAD DATA LOCAL INFILE 'file_name' ..., returns the file name
+std::optional<std::string> get_local_infile_name(const std::string &sql)
+{
+    std::string words;
+    std::size_t i = 0;
+    for (; i < sql.size() && sql[i] != '\'' && sql[i] != '"'; ++i)
+    {
+        char c = static_cast<char>(std::tolower(static_cast<unsigned char>(sql[i])));
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            if (!words.empty() && words.back() != ' ')
+                words += ' ';
+            continue;
+        }
+        words += c;
+    }
+
+    if (words != "load data local infile " || i == sql.size())
+        return std::nullopt;
+
+    auto end = sql.find(sql[i], i + 1);
+    if (end == std::string::npos)
+        return std::nullopt;
+    return sql.substr(i + 1, end - i - 1);
+}
+
+} // namespace
+
+MysqlFakeServer::MysqlFakeServer(boost::asio::io_context &io_context) :
+    MysqlFakeServer(io_context.get_executor())
+{
+
+}
+
+MysqlFakeServer::MysqlFakeServer(boost::asio::any_io_executor executor) :
+    executor_(executor),
+    tcp_server_(executor),
+    port_(0),
+    is_closed_(false),
+    connection_number_(0),
+    query_number_(0),
+    local_infile_size_(0)
+{
+
+}
+
+result<void> MysqlFakeServer::listen(const std::string &ip, unsigned short port)
+{
+    RESULT_CHECK(tcp_server_.listen(ip, static_cast<short>(port)));
+    RESULT_AUTO(endpoint, tcp_server_.local_endpoint());
+    port_ = endpoint.port();
+
+    return RESULT_SUCCESS;
+}
+
+void MysqlFakeServer::start()
+{
+    boost::asio::co_spawn(executor_, run(), boost::asio::detached);
+}
+
+void MysqlFakeServer::close()
+{
+    boost::asio::dispatch(executor_, [this] ()
+    {
+        is_closed_ = true;
+        tcp_server_.close();
+        for (auto tcp_client : session_group_)
+        {
+            tcp_client->disconnect();
+        }
+    });
+}
+
+std::vector<std::string> MysqlFakeServer::split_statements(const std::string &sql)
+{
+    std::vector<std::string> statements;
+    std::string statement;
+    char quote = 0;
+
+    auto finish_statement = [&statements, &statement] ()
+    {
+        auto begin = statement.find_first_not_of(" \t\r\n");
+        if (begin != std::string::npos)
+        {
+            auto end = statement.find_last_not_of(" \t\r\n");
+            statements.push_back(statement.substr(begin, end - begin + 1));
+        }
+        statement.clear();
+    };
+
+    for (std::size_t i=0; i<sql.size(); ++i)
+    {
+        char c = sql[i];
+        if (quote != 0)
+        {
+            statement += c;
+            if (c == '\\' && quote != '`' && i + 1 < sql.size())
+                statement += sql[++i];
+            else if (c == quote)
+                quote = 0;
+            continue;
+        }
+
+        if (c == ';')
+        {
+            finish_statement();
+            continue;
+        }
+
+        if (c == '\'' || c == '"' || c == '`')
+            quote = c;
+        statement += c;
+    }
+    finish_statement();
+
+    return statements;
+}
+
+boost::asio::awaitable<void> MysqlFakeServer::run()
+{
+    while (!is_closed_)
+    {
+        auto accept_result = co_await tcp_server_.accept();
+        if (!accept_result)
+        {
+            if (is_closed_)
+                break;
+
+            LOG(INFO) << "mysql fake server accept fail. " << accept_result.error_info();
+            continue;
+        }
+
+        ++connection_number_;
+        boost::asio::co_spawn(executor_, session(std::move(accept_result).value()), boost::asio::detached);
+    }
+}
+
+boost::asio::awaitable<void> MysqlFakeServer::session(TcpClient tcp_client)
+{
+    session_group_.insert(&tcp_client);
+    auto r = co_await serve(tcp_client);
+    session_group_.erase(&tcp_client);
+    tcp_client.disconnect();
+
+    const auto &error_code = r.error_info().error_code();
+    if (!r && !(error_code.value() == error::connection_closed && error_code.category() == error::network_category()))
+    {
+        LOG(INFO) << "mysql fake server session fail. " << r.error_info();
+    }
+}
+
+boost::asio::awaitable<result<void>> MysqlFakeServer::serve(TcpClient &tcp_client)
+{
+    RESULT_CO_CHECK(co_await handshake(tcp_client));
+
+    while (true)
+    {
+        std::uint8_t sequence_id = 0;
+        RESULT_CO_AUTO(packet, co_await read_packet(tcp_client, sequence_id));
+        if (packet.empty())
+            co_return malformed_packet("command");
+
+        PacketWriter writer(sequence_id + 1);
+        switch (static_cast<std::uint8_t>(packet[0]))
+        {
+        case com_quit:
+            co_return RESULT_SUCCESS;
+        case com_ping:
+        case com_init_db:
+            writer.put_ok(0, 0, server_status_autocommit);
+            break;
+        case com_query:
+            RESULT_CO_CHECK(co_await handle_query(tcp_client, std::string(packet.begin() + 1, packet.end()), sequence_id + 1));
+            continue;
+        default:
+            writer.put_err(1047, "Unknown command");
+            break;
+        }
+
+        RESULT_CO_CHECK(co_await tcp_client.write(writer.release()));
+    }
+}
+
+boost::asio::awaitable<result<void>> MysqlFakeServer::handshake(TcpClient &tcp_client)
+{
+    PacketWriter writer(0);
+    writer.begin();
+    writer.put_int(10, 1);
+    writer.put_null_terminated_string(server_version);
+    writer.put_int(connection_number_, 4);
+    writer.put_null_terminated_string(scramble.substr(0, 8));
+    writer.put_int(server_capabilities & 0xffff, 2);
+    writer.put_int(utf8_general_ci, 1);
+    writer.put_int(server_status_autocommit, 2);
+    writer.put_int(server_capabilities >> 16, 2);
+    writer.put_int(scramble.size() + 1, 1);
+    writer.put_string(std::string(10, '\0'));
+    writer.put_null_terminated_string(scramble.substr(8));
+    writer.put_null_terminated_string(caching_sha2_password);
+    writer.end();
+    RESULT_CO_CHECK(co_await tcp_client.write(writer.release()));
+
+    // any user and password is accepted
+    std::uint8_t sequence_id = 0;
+    RESULT_CO_AUTO(response, co_await read_packet(tcp_client, sequence_id));
+    RESULT_CO_AUTO(handshake_response, parse_handshake_response(response));
+
+    auto plugin_name = handshake_response.auth_plugin_name.empty() ? mysql_native_password : handshake_response.auth_plugin_name;
+    auto auth_response_size = handshake_response.auth_response_size;
+    if (plugin_name != caching_sha2_password && plugin_name != mysql_native_password)
+    {
+        // e.g. sha256_password
+        PacketWriter switch_writer(sequence_id + 1);
+        switch_writer.begin();
+        switch_writer.put_int(0xfe, 1);
+        switch_writer.put_null_terminated_string(caching_sha2_password);
+        switch_writer.put_null_terminated_string(scramble);
+        switch_writer.end();
+        RESULT_CO_CHECK(co_await tcp_client.write(switch_writer.release()));
+
+        RESULT_CO_AUTO(switch_response, co_await read_packet(tcp_client, sequence_id));
+        plugin_name = caching_sha2_password;
+        auth_response_size = switch_response.size();
+    }
+
+    PacketWriter ok_writer(sequence_id + 1);
+    // caching_sha2_password waits for fast_auth_success, unless the password is empty
+    if (plugin_name == caching_sha2_password && auth_response_size == 32)
+    {
+        ok_writer.begin();
+        ok_writer.put_int(0x01, 1);
+        ok_writer.put_int(0x03, 1);
+        ok_writer.end();
+    }
+    ok_writer.put_ok(0, 0, server_status_autocommit);
+    RESULT_CO_CHECK(co_await tcp_client.write(ok_writer.release()));
+
+    co_return RESULT_SUCCESS;
+}
+
+boost::asio::awaitable<result<void>> MysqlFakeServer::handle_query(TcpClient &tcp_client, const std::string &sql, std::uint8_t sequence_id)
+{
+    auto statements = split_statements(sql);
+    if (statements.empty())
+    {
+        PacketWriter writer(sequence_id);
+        writer.put_err(1065, "Query was empty");
+        co_return co_await tcp_client.write(writer.release());
+    }
+
+    for (std::size_t i=0; i<statements.size(); ++i)
+    {
+        ++query_number_;
+        if (options_.latency.count() > 0)
+        {
+            boost::asio::steady_timer timer(executor_, options_.latency);
+            boost::system::error_code ec;
+            co_await timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        }
+
+        MysqlFakeResult query_result;
+        if (auto file_name = get_local_infile_name(statements[i]))
+        {
+            RESULT_CO_AUTO(line_number, co_await receive_local_infile(tcp_client, *file_name, sequence_id));
+            query_result.affected_rows = line_number;
+        }
+        else
+        {
+            query_result = options_.handler ? options_.handler(statements[i]) : make_default_result(statements[i]);
+        }
+
+        // the last packet of every statement but the last one tells the client to read on
+        std::uint16_t status = server_status_autocommit;
+        if (i + 1 < statements.size())
+            status |= server_more_results_exists;
+
+        PacketWriter writer(sequence_id);
+        if (query_result.error_number != 0)
+        {
+            writer.put_err(query_result.error_number, query_result.error_message);
+            co_return co_await tcp_client.write(writer.release());
+        }
+
+        if (query_result.columns.empty())
+        {
+            writer.put_ok(query_result.affected_rows, query_result.last_insert_id, status);
+        }
+        else
+        {
+            writer.begin();
+            writer.put_lenenc_int(query_result.columns.size());
+            writer.end();
+
+            for (const auto &column : query_result.columns)
+            {
+                writer.begin();
+                writer.put_lenenc_string("def");
+                writer.put_lenenc_string("");
+                writer.put_lenenc_string("");
+                writer.put_lenenc_string("");
+                writer.put_lenenc_string(column);
+                writer.put_lenenc_string(column);
+                // length of the fixed fields
+                writer.put_lenenc_int(0x0c);
+                writer.put_int(utf8_general_ci, 2);
+                writer.put_int(1024, 4);
+                writer.put_int(mysql_type_var_string, 1);
+                // flags, decimals, filler
+                writer.put_int(0, 2);
+                writer.put_int(0, 1);
+                writer.put_int(0, 2);
+                writer.end();
+            }
+            writer.put_eof(status);
+
+            for (const auto &row : query_result.rows)
+            {
+                writer.begin();
+                for (std::size_t j=0; j<query_result.columns.size(); ++j)
+                {
+                    if (j < row.size() && row[j])
+                        writer.put_lenenc_string(*row[j]);
+                    else
+                        writer.put_int(0xfb, 1);
+                }
+                writer.end();
+            }
+            writer.put_eof(status);
+        }
+
+        sequence_id = writer.sequence_id();
+        RESULT_CO_CHECK(co_await tcp_client.write(writer.release()));
+    }
+
+    co_return RESULT_SUCCESS;
+}
+
+boost::asio::awaitable<result<std::uint64_t>> MysqlFakeServer::receive_local_infile(TcpClient &tcp_client, const std::string &file_name, std::uint8_t &sequence_id)
+{
+    PacketWriter writer(sequence_id);
+    writer.begin();
+    writer.put_int(0xfb, 1);
+    writer.put_string(file_name);
+    writer.end();
+    RESULT_CO_CHECK(co_await tcp_client.write(writer.release()));
+
+    // the content ends with an empty packet
+    std::uint64_t line_number = 0;
+    while (true)
+    {
+        RESULT_CO_AUTO(packet, co_await read_packet(tcp_client, sequence_id));
+        if (packet.empty())
+            break;
+
+        line_number += std::count(packet.begin(), packet.end(), '\n');
+        local_infile_size_ += packet.size();
+    }
+    ++sequence_id;
+
+    co_return line_number;
+}
+
+MysqlFakeResult MysqlFakeServer::make_default_result(const std::string &sql) const
+{
+    MysqlFakeResult query_result;
+    if (!is_result_set_statement(sql))
+    {
+        query_result.affected_rows = 1;
+        return query_result;
+    }
+
+    for (std::size_t i=0; i<options_.column_number; ++i)
+    {
+        query_result.columns.push_back("c" + std::to_string(i));
+    }
+
+    std::vector<std::optional<std::string>> row(options_.column_number, std::string(options_.value_size, 'x'));
+    query_result.rows.assign(options_.row_number, row);
+    return query_result;
+}
+
+} // namespace conet
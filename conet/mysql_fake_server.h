@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "result.h"
+#include "tcp_client.h"
+#include "tcp_server.h"
+
+namespace conet {
+
+struct MysqlFakeResult
+{
+    // no columns sends an OK packet
+    std::vector<std::string> columns;
+    // nullopt is NULL
+    std::vector<std::vector<std::optional<std::string>>> rows;
+    std::uint64_t affected_rows = 0;
+    std::uint64_t last_insert_id = 0;
+    // non-zero sends an ERR packet and skips the following statements
+    std::uint16_t error_number = 0;
+    std::string error_message;
+};
+
+struct MysqlFakeServerOptions
+{
+    // delay before answering each statement
+    std::chrono::microseconds latency = std::chrono::microseconds::zero();
+    // result of SELECT and SHOW statements when there is no handler,
+    // columns are named c0, c1 ... and every value is value_size bytes
+    std::size_t row_number = 1;
+    std::size_t column_number = 1;
+    std::size_t value_size = 8;
+    // called on the server executor for every statement of a COM_QUERY
+    std::function<MysqlFakeResult(const std::string &sql)> handler;
+};
+
+// Speaks enough of the MySQL client/server protocol to drive MysqlClient without a real server:
+// handshake with any user and password, COM_QUERY with text result sets and multi statements,
+// COM_PING, COM_INIT_DB and COM_QUIT. LOAD DATA LOCAL INFILE reads the whole content
+// and reports one affected row per line. Meant for tests and benchmarks, it is built into
+// conet_test_support rather than conet.
+class MysqlFakeServer
+{
+public:
+    MysqlFakeServer(boost::asio::io_context &io_context);
+    MysqlFakeServer(boost::asio::any_io_executor executor);
+
+    MysqlFakeServer(const MysqlFakeServer &) = delete;
+    MysqlFakeServer& operator=(const MysqlFakeServer &) = delete;
+
+    void set_options(const MysqlFakeServerOptions &options) { options_ = options; }
+    const MysqlFakeServerOptions& options() const { return options_; }
+
+    // port 0 picks a free port, see port()
+    result<void> listen(const std::string &ip, unsigned short port);
+    // accept connections in background
+    void start();
+    // stop accepting and disconnect every connection
+    void close();
+
+    unsigned short port() const { return port_; }
+    std::uint64_t connection_number() const { return connection_number_; }
+    std::uint64_t query_number() const { return query_number_; }
+    // bytes received by LOAD DATA LOCAL INFILE
+    std::uint64_t local_infile_size() const { return local_infile_size_; }
+
+    // split on ';' outside of quotes, empty statements are dropped
+    static std::vector<std::string> split_statements(const std::string &sql);
+
+private:
+    boost::asio::awaitable<void> run();
+    boost::asio::awaitable<void> session(TcpClient tcp_client);
+    boost::asio::awaitable<result<void>> serve(TcpClient &tcp_client);
+    boost::asio::awaitable<result<void>> handshake(TcpClient &tcp_client);
+    boost::asio::awaitable<result<void>> handle_query(TcpClient &tcp_client, const std::string &sql, std::uint8_t sequence_id);
+    boost::asio::awaitable<result<std::uint64_t>> receive_local_infile(TcpClient &tcp_client, const std::string &file_name, std::uint8_t &sequence_id);
+    MysqlFakeResult make_default_result(const std::string &sql) const;
+
+    boost::asio::any_io_executor executor_;
+    TcpServer tcp_server_;
+    MysqlFakeServerOptions options_;
+    unsigned short port_;
+    bool is_closed_;
+    std::unordered_set<TcpClient *> session_group_;
+    std::atomic_uint64_t connection_number_;
+    std::atomic_uint64_t query_number_;
+    std::atomic_uint64_t local_infile_size_;
+};
+
+} // namespace conet
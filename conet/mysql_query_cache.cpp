@@ -0,0 +1,415 @@
+#include "mysql_query_cache.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "error.h"
+
+namespace conet {
+
+static std::string to_lower(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [] (unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+static bool is_identifier_char(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || c == '`' || c == '.';
+}
+
+MysqlQueryCache::MysqlQueryCache(MysqlClientPool &mysql_client_pool, const MysqlQueryCacheOptions &options) :
+    mysql_client_pool_(mysql_client_pool),
+    options_(options),
+    single_flight_(mutex_),
+    memory_size_(0),
+    hit_number_(0),
+    miss_number_(0),
+    coalesced_number_(0),
+    evicted_number_(0)
+{
+}
+
+boost::asio::awaitable<result<MysqlQueryCache::ResultType>> MysqlQueryCache::query(
+    const std::string &sql,
+    std::chrono::milliseconds ttl,
+    const std::vector<std::string> &tables)
+{
+    auto key = normalize(sql);
+    co_return co_await query_real(key, sql, nullptr, ttl, tables);
+}
+
+boost::asio::awaitable<result<MysqlQueryCache::ResultType>> MysqlQueryCache::query(
+    const std::string &sql,
+    const std::vector<std::string> &params,
+    std::chrono::milliseconds ttl,
+    const std::vector<std::string> &tables)
+{
+    // length prefixed, params can not be confused with each other
+    auto key = normalize(sql);
+    for (const auto &param : params)
+    {
+        key += '\0';
+        key += std::to_string(param.size());
+        key += ':';
+        key += param;
+    }
+
+    co_return co_await query_real(key, sql, &params, ttl, tables);
+}
+
+void MysqlQueryCache::invalidate_table(const std::string &table)
+{
+    auto name = to_lower(table);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = table_key_group_.find(name);
+    if (it != table_key_group_.end())
+    {
+        auto keys = std::move(it->second);
+        table_key_group_.erase(it);
+        for (const auto &key : keys)
+        {
+            auto entry_it = entry_group_.find(key);
+            if (entry_it != entry_group_.end())
+                erase(entry_it->second);
+        }
+    }
+
+    single_flight_.for_each_state([&name] (FlightState &state)
+        {
+            if (std::find(state.tables.begin(), state.tables.end(), name) != state.tables.end())
+                state.is_invalidated = true;
+        });
+}
+
+void MysqlQueryCache::invalidate_all()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    entry_group_.clear();
+    table_key_group_.clear();
+    memory_size_ = 0;
+
+    single_flight_.for_each_state([] (FlightState &state) { state.is_invalidated = true; });
+}
+
+MysqlQueryCacheStats MysqlQueryCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    MysqlQueryCacheStats stats;
+    stats.hit_number = hit_number_;
+    stats.miss_number = miss_number_;
+    stats.coalesced_number = coalesced_number_;
+    stats.evicted_number = evicted_number_;
+    stats.entry_number = entry_group_.size();
+    stats.memory_size = memory_size_;
+    return stats;
+}
+
+std::string MysqlQueryCache::normalize(const std::string &sql)
+{
+    std::string ret;
+    ret.reserve(sql.size());
+
+    char quote = 0;
+    bool pending_space = false;
+    for (std::size_t i=0; i<sql.size(); ++i)
+    {
+        char c = sql[i];
+        if (quote != 0)
+        {
+            ret += c;
+            if (c == '\\' && i + 1 < sql.size())
+                ret += sql[++i];
+            else if (c == quote)
+                quote = 0;
+            continue;
+        }
+
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            pending_space = !ret.empty();
+            continue;
+        }
+
+        if (pending_space)
+        {
+            ret += ' ';
+            pending_space = false;
+        }
+
+        if (c == '\'' || c == '"' || c == '`')
+            quote = c;
+        ret += c;
+    }
+
+    while (!ret.empty() && (ret.back() == ';' || ret.back() == ' '))
+    {
+        ret.pop_back();
+    }
+
+    return ret;
+}
+
+std::vector<std::string> MysqlQueryCache::extract_tables(const std::string &sql)
+{
+    // tokens outside of string literals
+    std::vector<std::string> tokens;
+    for (std::size_t i=0; i<sql.size();)
+    {
+        char c = sql[i];
+        if (c == '\'' || c == '"')
+        {
+            for (++i; i<sql.size() && sql[i] != c; ++i)
+            {
+                if (sql[i] == '\\')
+                    ++i;
+            }
+            ++i;
+        }
+        else if (is_identifier_char(c))
+        {
+            auto begin = i;
+            bool in_backtick = false;
+            while (i < sql.size() && (is_identifier_char(sql[i]) || (in_backtick && sql[i] != '`')))
+            {
+                if (sql[i] == '`')
+                    in_backtick = !in_backtick;
+                ++i;
+            }
+            tokens.push_back(sql.substr(begin, i - begin));
+        }
+        else
+        {
+            if (c == ',')
+                tokens.push_back(",");
+            ++i;
+        }
+    }
+
+    std::vector<std::string> tables;
+    auto add_table = [&tables] (std::string name)
+    {
+        std::erase(name, '`');
+        auto pos = name.rfind('.');
+        if (pos != std::string::npos)
+            name = name.substr(pos + 1);
+        name = to_lower(std::move(name));
+        if (!name.empty() && std::find(tables.begin(), tables.end(), name) == tables.end())
+            tables.push_back(std::move(name));
+    };
+
+    for (std::size_t i=0; i+1<tokens.size(); ++i)
+    {
+        auto keyword = to_lower(tokens[i]);
+        if (keyword != "from" && keyword != "join" && keyword != "update" && keyword != "into")
+            continue;
+
+        // from a, b as x, c
+        std::size_t j = i + 1;
+        while (j < tokens.size())
+        {
+            add_table(tokens[j]);
+            while (j < tokens.size() && tokens[j] != ",")
+            {
+                auto next = to_lower(tokens[j]);
+                if (next == "where" || next == "join" || next == "on" || next == "group" || next == "order" || next == "limit")
+                    break;
+                ++j;
+            }
+            if (j >= tokens.size() || tokens[j] != ",")
+                break;
+            ++j;
+        }
+    }
+
+    return tables;
+}
+
+boost::asio::awaitable<result<MysqlQueryCache::ResultType>> MysqlQueryCache::query_real(
+    const std::string &key,
+    const std::string &sql,
+    const std::vector<std::string> *params,
+    std::chrono::milliseconds ttl,
+    const std::vector<std::string> &tables)
+{
+    SingleFlight<ResultType, FlightState>::FlightPtr flight;
+    bool is_leader = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (auto value = find(key))
+        {
+            ++hit_number_;
+            co_return value;
+        }
+
+        flight = single_flight_.join(key, is_leader);
+        if (is_leader)
+        {
+            ++miss_number_;
+            flight->state.tables = tables.empty() ? extract_tables(sql) : tables;
+            for (auto &table : flight->state.tables)
+            {
+                table = to_lower(std::move(table));
+            }
+        }
+        else
+        {
+            ++coalesced_number_;
+        }
+    }
+
+    if (!is_leader)
+        co_return co_await single_flight_.wait(std::move(flight));
+
+    SingleFlight<ResultType, FlightState>::Leader leader(single_flight_, key, flight);
+    auto load_result = co_await load(sql, params);
+    leader.finish(load_result, [&] (const FlightState &state)
+        {
+            if (load_result && !state.is_invalidated)
+                insert(key, state, load_result.value(), ttl.count() > 0 ? ttl : options_.default_ttl);
+        });
+
+    RESULT_CO_CHECK(load_result, r.error_info().add_pair("sql", sql));
+    co_return load_result;
+}
+
+boost::asio::awaitable<result<MysqlQueryCache::ResultType>> MysqlQueryCache::load(const std::string &sql, const std::vector<std::string> *params)
+{
+    RESULT_CO_AUTO(p, co_await mysql_client_pool_.get());
+    MysqlClient &mysql_client = *p;
+
+    if (params == nullptr)
+    {
+        RESULT_CO_AUTO(rows, co_await mysql_client.query(sql));
+        co_return std::make_shared<const std::vector<MysqlQueryResultImpl>>(std::move(rows));
+    }
+
+    std::string real_sql;
+    std::size_t placeholder_number = 0;
+    char quote = 0;
+    for (std::size_t i=0; i<sql.size(); ++i)
+    {
+        char c = sql[i];
+        if (quote != 0)
+        {
+            real_sql += c;
+            if (c == '\\' && i + 1 < sql.size())
+                real_sql += sql[++i];
+            else if (c == quote)
+                quote = 0;
+            continue;
+        }
+
+        if (c == '\'' || c == '"' || c == '`')
+            quote = c;
+
+        if (c != '?')
+        {
+            real_sql += c;
+            continue;
+        }
+
+        if (placeholder_number < params->size())
+        {
+            real_sql += '\'';
+            real_sql += mysql_client.encode_string((*params)[placeholder_number]);
+            real_sql += '\'';
+        }
+        ++placeholder_number;
+    }
+
+    if (placeholder_number != params->size())
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message("placeholder and param number mismatch");
+        error_info.add_pair("placeholder_number", placeholder_number);
+        error_info.add_pair("param_number", params->size());
+        co_return error_info;
+    }
+
+    RESULT_CO_AUTO(rows, co_await mysql_client.query(real_sql));
+    co_return std::make_shared<const std::vector<MysqlQueryResultImpl>>(std::move(rows));
+}
+
+MysqlQueryCache::ResultType MysqlQueryCache::find(const std::string &key)
+{
+    auto it = entry_group_.find(key);
+    if (it == entry_group_.end())
+        return nullptr;
+
+    if (Clock::now() >= it->second->expire_time)
+    {
+        erase(it->second);
+        return nullptr;
+    }
+
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->value;
+}
+
+void MysqlQueryCache::insert(Entry &&entry)
+{
+    if (entry.size > options_.memory_budget)
+        return;
+
+    auto it = entry_group_.find(entry.key);
+    if (it != entry_group_.end())
+        erase(it->second);
+
+    while (!lru_.empty() && memory_size_ + entry.size > options_.memory_budget)
+    {
+        erase(std::prev(lru_.end()));
+        ++evicted_number_;
+    }
+
+    memory_size_ += entry.size;
+    for (const auto &table : entry.tables)
+    {
+        table_key_group_[table].insert(entry.key);
+    }
+    lru_.push_front(std::move(entry));
+    entry_group_[lru_.front().key] = lru_.begin();
+}
+
+void MysqlQueryCache::erase(std::list<Entry>::iterator it)
+{
+    for (const auto &table : it->tables)
+    {
+        auto table_it = table_key_group_.find(table);
+        if (table_it == table_key_group_.end())
+            continue;
+
+        table_it->second.erase(it->key);
+        if (table_it->second.empty())
+            table_key_group_.erase(table_it);
+    }
+
+    memory_size_ -= it->size;
+    entry_group_.erase(it->key);
+    lru_.erase(it);
+}
+
+// with the mutex held
+void MysqlQueryCache::insert(const std::string &key, const FlightState &state, const ResultType &value, std::chrono::milliseconds ttl)
+{
+    Entry entry;
+    entry.key = key;
+    entry.value = value;
+    entry.expire_time = Clock::now() + ttl;
+    entry.tables = state.tables;
+    entry.size = sizeof(Entry) + key.capacity();
+    for (const auto &row : *entry.value)
+    {
+        entry.size += row.byte_size();
+    }
+    insert(std::move(entry));
+}
+
+} // namespace conet
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include "mysql_client_pool.h"
+#include "single_flight.h"
+
+namespace conet {
+
+struct MysqlQueryCacheOptions
+{
+    std::size_t memory_budget = 64 * 1024 * 1024;
+    // used when query() is called without ttl
+    std::chrono::milliseconds default_ttl = std::chrono::seconds(1);
+};
+
+struct MysqlQueryCacheStats
+{
+    std::uint64_t hit_number;
+    std::uint64_t miss_number;
+    std::uint64_t coalesced_number;
+    std::uint64_t evicted_number;
+    std::size_t entry_number;
+    std::size_t memory_size;
+};
+
+// Read-through cache of query results on top of MysqlClientPool.
+// Results are immutable and shared between callers. Concurrent misses of the same key
+// wait for the first one instead of sending the same query again.
+class MysqlQueryCache
+{
+public:
+    using ResultType = std::shared_ptr<const std::vector<MysqlQueryResultImpl>>;
+
+    MysqlQueryCache(MysqlClientPool &mysql_client_pool, const MysqlQueryCacheOptions &options = {});
+
+    MysqlQueryCache(const MysqlQueryCache &) = delete;
+    MysqlQueryCache& operator=(const MysqlQueryCache &) = delete;
+
+    // tables are used by invalidate_table(). extracted from the FROM/JOIN clauses when empty.
+    boost::asio::awaitable<result<ResultType>> query(
+        const std::string &sql,
+        std::chrono::milliseconds ttl = std::chrono::milliseconds::zero(),
+        const std::vector<std::string> &tables = {});
+
+    // every '?' in sql is replaced by the escaped and quoted param of the same position.
+    boost::asio::awaitable<result<ResultType>> query(
+        const std::string &sql,
+        const std::vector<std::string> &params,
+        std::chrono::milliseconds ttl = std::chrono::milliseconds::zero(),
+        const std::vector<std::string> &tables = {});
+
+    void invalidate_table(const std::string &table);
+    void invalidate_all();
+
+    MysqlQueryCacheStats stats() const;
+
+    // collapse whitespace outside of quotes, strip the trailing ';'
+    static std::string normalize(const std::string &sql);
+    static std::vector<std::string> extract_tables(const std::string &sql);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::string key;
+        ResultType value;
+        Clock::time_point expire_time;
+        std::vector<std::string> tables;
+        std::size_t size;
+    };
+
+    struct FlightState
+    {
+        std::vector<std::string> tables;
+        // invalidate_table() during the query, the result must not be cached
+        bool is_invalidated = false;
+    };
+
+    boost::asio::awaitable<result<ResultType>> query_real(
+        const std::string &key,
+        const std::string &sql,
+        const std::vector<std::string> *params,
+        std::chrono::milliseconds ttl,
+        const std::vector<std::string> &tables);
+    boost::asio::awaitable<result<ResultType>> load(const std::string &sql, const std::vector<std::string> *params);
+
+    ResultType find(const std::string &key);
+    void insert(Entry &&entry);
+    void erase(std::list<Entry>::iterator it);
+    void insert(const std::string &key, const FlightState &state, const ResultType &value, std::chrono::milliseconds ttl);
+
+    MysqlClientPool &mysql_client_pool_;
+    MysqlQueryCacheOptions options_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> entry_group_;
+    std::unordered_map<std::string, std::unordered_set<std::string>> table_key_group_;
+    SingleFlight<ResultType, FlightState> single_flight_;
+    std::size_t memory_size_;
+    std::uint64_t hit_number_;
+    std::uint64_t miss_number_;
+    std::uint64_t coalesced_number_;
+    std::uint64_t evicted_number_;
+};
+
+} // namespace conet
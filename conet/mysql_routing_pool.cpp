@@ -0,0 +1,302 @@
+#include "mysql_routing_pool.h"
+
+#include <cctype>
+#include <charconv>
+
+#include "async_log.h"
+#include "error.h"
+
+namespace conet {
+
+static boost::asio::awaitable<result<std::vector<MysqlQueryResultImpl>>> query_replica_status(MysqlClient &mysql_client)
+{
+    auto r = co_await mysql_client.query("SHOW REPLICA STATUS");
+    if (r)
+        co_return std::move(r);
+
+    // before 8.0.22
+    co_return co_await mysql_client.query("SHOW SLAVE STATUS");
+}
+
+MysqlRoutingPool::MysqlRoutingPool(boost::asio::io_context &io_context) :
+    MysqlRoutingPool(io_context.get_executor())
+{
+}
+
+MysqlRoutingPool::MysqlRoutingPool(boost::asio::any_io_executor executor) :
+    executor_(executor),
+    primary_pool_(std::make_unique<MysqlClientPool>(executor)),
+    is_initialized_(false)
+{
+}
+
+MysqlRoutingPool::~MysqlRoutingPool()
+{
+    close();
+}
+
+boost::asio::awaitable<result<void>> MysqlRoutingPool::init(
+    const MysqlEndpoint &primary,
+    const std::vector<MysqlEndpoint> &replicas,
+    int init_number,
+    int limit_max_number)
+{
+    // a second init() would add the replicas and their lag checks again
+    if (is_initialized_)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message("mysql routing pool is already initialized");
+        error_info.add_pair("host", primary.host);
+        co_return error_info;
+    }
+    is_initialized_ = true;
+
+    primary_pool_->set_options(options_.pool_options);
+    RESULT_CO_CHECK(co_await primary_pool_->init(primary.host, primary.port, primary.user, primary.password, primary.database, init_number, limit_max_number),
+        r.error_info().add_pair("host", primary.host));
+
+    for (const auto &endpoint : replicas)
+    {
+        auto replica = std::make_shared<Replica>(executor_);
+        replica->host = endpoint.host + ":" + std::to_string(endpoint.port);
+        replica->pool = std::make_unique<MysqlClientPool>(executor_);
+        replica->pool->set_options(options_.pool_options);
+
+        // a broken replica should not stop the service, reads fall back to the primary
+        auto r = co_await replica->pool->init(endpoint.host, endpoint.port, endpoint.user, endpoint.password, endpoint.database, init_number, limit_max_number);
+        if (!r)
+        {
+            ASYNC_LOG(WARNING) << "init mysql replica fail. host:" << replica->host << " " << r.error_info();
+        }
+
+        if (options_.lag_check_interval.count() > 0)
+        {
+            replica->is_checking_lag = true;
+            boost::asio::co_spawn(executor_, check_lag(replica, options_.lag_check_interval), boost::asio::detached);
+        }
+        replica_group_.push_back(std::move(replica));
+    }
+
+    co_return RESULT_SUCCESS;
+}
+
+boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> MysqlRoutingPool::get_primary()
+{
+    return primary_pool_->get();
+}
+
+boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> MysqlRoutingPool::get_replica()
+{
+    std::shared_ptr<Replica> best;
+    for (auto &replica : replica_group_)
+    {
+        if (!is_available(*replica))
+            continue;
+
+        if (best == nullptr || replica->outstanding_number < best->outstanding_number)
+            best = replica;
+    }
+
+    if (best == nullptr)
+        co_return co_await get_primary();
+
+    ++best->outstanding_number;
+    auto r = co_await best->pool->get();
+    if (!r)
+    {
+        --best->outstanding_number;
+        ASYNC_LOG(INFO) << "get mysql replica fail, use primary. host:" << best->host << " " << r.error_info();
+        co_return co_await get_primary();
+    }
+
+    // the outstanding request ends when the caller releases the connection, which may be after the
+    // pool is destroyed
+    auto mysql_client = std::move(r).value();
+    auto raw_p = mysql_client.get();
+    co_return std::shared_ptr<MysqlClient>(raw_p, [mysql_client = std::move(mysql_client), best = std::move(best)] (MysqlClient *) mutable
+    {
+        --best->outstanding_number;
+        mysql_client.reset();
+    });
+}
+
+MysqlRoutingSession MysqlRoutingPool::session()
+{
+    return MysqlRoutingSession(*this);
+}
+
+void MysqlRoutingPool::close()
+{
+    primary_pool_->close();
+    for (auto &replica : replica_group_)
+    {
+        replica->is_closed = true;
+        replica->pool->close();
+        replica->lag_check_timer.cancel();
+    }
+}
+
+bool MysqlRoutingPool::is_maintaining() const
+{
+    if (primary_pool_->is_maintaining())
+        return true;
+
+    for (const auto &replica : replica_group_)
+    {
+        if (replica->is_checking_lag || replica->pool->is_maintaining())
+            return true;
+    }
+    return false;
+}
+
+std::vector<MysqlReplicaStats> MysqlRoutingPool::replica_stats() const
+{
+    std::vector<MysqlReplicaStats> ret;
+    for (const auto &replica : replica_group_)
+    {
+        MysqlReplicaStats stats;
+        stats.host = replica->host;
+        stats.outstanding_number = replica->outstanding_number;
+        stats.lag_seconds = replica->lag_seconds;
+        stats.is_available = is_available(*replica);
+        ret.push_back(std::move(stats));
+    }
+    return ret;
+}
+
+bool MysqlRoutingPool::is_read_statement(const std::string &sql)
+{
+    // skip leading whitespace and comments
+    std::size_t i = 0;
+    while (i < sql.size())
+    {
+        if (std::isspace(static_cast<unsigned char>(sql[i])))
+        {
+            ++i;
+        }
+        else if (sql.compare(i, 2, "/*") == 0)
+        {
+            auto end = sql.find("*/", i + 2);
+            i = end == std::string::npos ? sql.size() : end + 2;
+        }
+        else if (sql.compare(i, 2, "--") == 0 || sql[i] == '#')
+        {
+            auto end = sql.find('\n', i);
+            i = end == std::string::npos ? sql.size() : end + 1;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    std::string lower_sql;
+    lower_sql.reserve(sql.size() - i);
+    for (; i<sql.size(); ++i)
+    {
+        lower_sql += static_cast<char>(std::tolower(static_cast<unsigned char>(sql[i])));
+    }
+
+    auto begin_with = [&lower_sql] (const char *keyword)
+    {
+        auto size = std::char_traits<char>::length(keyword);
+        return lower_sql.compare(0, size, keyword) == 0 &&
+            (lower_sql.size() == size || !std::isalnum(static_cast<unsigned char>(lower_sql[size])));
+    };
+
+    if (begin_with("show") || begin_with("describe") || begin_with("desc") || begin_with("explain"))
+        return true;
+
+    if (!begin_with("select") && !begin_with("with"))
+        return false;
+
+    // locking reads need the primary
+    if (lower_sql.find("for update") != std::string::npos ||
+        lower_sql.find("for share") != std::string::npos ||
+        lower_sql.find("lock in share mode") != std::string::npos)
+        return false;
+
+    // SELECT ... INTO OUTFILE/DUMPFILE writes a file on the server, WITH ... UPDATE/DELETE writes rows
+    if (lower_sql.find("outfile") != std::string::npos || lower_sql.find("dumpfile") != std::string::npos)
+        return false;
+    if (begin_with("with") && (lower_sql.find("update ") != std::string::npos || lower_sql.find("delete ") != std::string::npos))
+        return false;
+
+    return true;
+}
+
+bool MysqlRoutingPool::is_available(const Replica &replica) const
+{
+    if (options_.lag_check_interval.count() <= 0)
+        return true;
+
+    auto lag_seconds = replica.lag_seconds.load();
+    return lag_seconds >= 0 && lag_seconds <= options_.max_replication_lag.count();
+}
+
+boost::asio::awaitable<result<int>> MysqlRoutingPool::query_lag(Replica &replica)
+{
+    RESULT_CO_AUTO(mysql_client, co_await replica.pool->get());
+    RESULT_CO_AUTO(rows, co_await query_replica_status(*mysql_client));
+
+    // not a replica, nothing to wait for
+    if (rows.empty())
+        co_return 0;
+
+    auto lag = rows.front().get<std::string>("Seconds_Behind_Source");
+    if (lag.empty())
+        lag = rows.front().get<std::string>("Seconds_Behind_Master");
+
+    // NULL when replication is stopped
+    if (lag.empty())
+        co_return -1;
+
+    int lag_seconds = 0;
+    auto [ptr, ec] = std::from_chars(lag.data(), lag.data() + lag.size(), lag_seconds);
+    if (ec != std::errc() || ptr != lag.data() + lag.size() || lag_seconds < 0)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::third_party_error, error::conet_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message("invalid replication lag");
+        error_info.add_pair("host", replica.host);
+        error_info.add_pair("lag", lag);
+        co_return error_info;
+    }
+
+    co_return lag_seconds;
+}
+
+boost::asio::awaitable<void> MysqlRoutingPool::check_lag(std::shared_ptr<Replica> replica, std::chrono::milliseconds interval)
+{
+    while (!replica->is_closed)
+    {
+        auto r = co_await query_lag(*replica);
+        if (!r)
+        {
+            ASYNC_LOG(INFO) << "check mysql replica lag fail. host:" << replica->host << " " << r.error_info();
+            replica->lag_seconds = -1;
+        }
+        else
+        {
+            replica->lag_seconds = r.value();
+        }
+
+        if (replica->is_closed)
+            break;
+
+        replica->lag_check_timer.expires_after(interval);
+        boost::system::error_code ec;
+        co_await replica->lag_check_timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    }
+
+    replica->is_checking_lag = false;
+}
+
+} // namespace conet
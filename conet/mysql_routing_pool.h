@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include "mysql_client_pool.h"
+
+namespace conet {
+
+struct MysqlEndpoint
+{
+    std::string host;
+    unsigned int port = 3306;
+    std::string user;
+    std::string password;
+    std::string database;
+};
+
+struct MysqlRoutingPoolOptions
+{
+    MysqlClientPoolOptions pool_options;
+    // replicas lagging more are excluded from reads
+    std::chrono::seconds max_replication_lag = std::chrono::seconds(5);
+    // period of the replication lag check. zero disables it and replicas are always used.
+    std::chrono::milliseconds lag_check_interval = std::chrono::seconds(1);
+};
+
+struct MysqlReplicaStats
+{
+    std::string host;
+    int outstanding_number;
+    // -1 is unknown or replication stopped
+    int lag_seconds;
+    bool is_available;
+};
+
+class MysqlRoutingSession;
+
+// One MysqlClientPool for the primary and one for each read replica.
+// Reads go to the available replica with the least outstanding requests,
+// writes and reads of a pinned session go to the primary.
+class MysqlRoutingPool
+{
+public:
+    MysqlRoutingPool(boost::asio::io_context &io_context);
+    MysqlRoutingPool(boost::asio::any_io_executor executor);
+    // closes without waiting, the lag checks keep their replica alive on the executor, which has
+    // to outlive them
+    ~MysqlRoutingPool();
+
+    MysqlRoutingPool(const MysqlRoutingPool &) = delete;
+    MysqlRoutingPool& operator=(const MysqlRoutingPool &) = delete;
+
+    void set_options(const MysqlRoutingPoolOptions &options) { options_ = options; }
+
+    // can be called once
+    boost::asio::awaitable<result<void>> init(
+        const MysqlEndpoint &primary,
+        const std::vector<MysqlEndpoint> &replicas,
+        int init_number,
+        int limit_max_number);
+
+    boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> get_primary();
+    // falls back to the primary when no replica is available
+    boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> get_replica();
+
+    // route by statement type
+    template<typename T = MysqlQueryResultImpl>
+    boost::asio::awaitable<result<std::vector<T>>> query(const std::string &sql)
+    {
+        RESULT_CO_AUTO(mysql_client, is_read_statement(sql) ? co_await get_replica() : co_await get_primary());
+        co_return co_await mysql_client->template query<T>(sql);
+    }
+
+    // read-your-writes, see MysqlRoutingSession
+    MysqlRoutingSession session();
+
+    void close();
+    // a lag check or the maintenance of a pool has not exited yet
+    bool is_maintaining() const;
+
+    MysqlClientPool& primary() { return *primary_pool_; }
+    std::vector<MysqlReplicaStats> replica_stats() const;
+
+    // SELECT, SHOW, DESCRIBE, EXPLAIN and WITH without locking clause or INTO OUTFILE/DUMPFILE
+    static bool is_read_statement(const std::string &sql);
+
+private:
+    struct Replica
+    {
+        Replica(boost::asio::any_io_executor executor) : lag_check_timer(executor) {}
+
+        std::string host;
+        std::unique_ptr<MysqlClientPool> pool;
+        std::atomic_int outstanding_number{0};
+        std::atomic_int lag_seconds{-1};
+        // cancelled by close()
+        boost::asio::steady_timer lag_check_timer;
+        std::atomic_bool is_checking_lag{false};
+        std::atomic_bool is_closed{false};
+    };
+
+    bool is_available(const Replica &replica) const;
+    static boost::asio::awaitable<result<int>> query_lag(Replica &replica);
+    // only touches the replica, it may outlive the pool
+    static boost::asio::awaitable<void> check_lag(std::shared_ptr<Replica> replica, std::chrono::milliseconds interval);
+
+    boost::asio::any_io_executor executor_;
+    MysqlRoutingPoolOptions options_;
+    std::unique_ptr<MysqlClientPool> primary_pool_;
+    std::vector<std::shared_ptr<Replica>> replica_group_;
+    bool is_initialized_;
+};
+
+// Routes like MysqlRoutingPool, but once a write is sent (or pin_primary() is called)
+// every following read of the session goes to the primary too.
+class MysqlRoutingSession
+{
+public:
+    MysqlRoutingSession(MysqlRoutingPool &pool) : pool_(pool), is_pinned_(false) {}
+
+    void pin_primary() { is_pinned_ = true; }
+    bool is_pinned() const { return is_pinned_; }
+
+    template<typename T = MysqlQueryResultImpl>
+    boost::asio::awaitable<result<std::vector<T>>> query(const std::string &sql)
+    {
+        if (!is_pinned_ && MysqlRoutingPool::is_read_statement(sql))
+        {
+            RESULT_CO_AUTO(mysql_client, co_await pool_.get_replica());
+            co_return co_await mysql_client->template query<T>(sql);
+        }
+
+        is_pinned_ = true;
+        RESULT_CO_AUTO(mysql_client, co_await pool_.get_primary());
+        co_return co_await mysql_client->template query<T>(sql);
+    }
+
+private:
+    MysqlRoutingPool &pool_;
+    bool is_pinned_;
+};
+
+} // namespace conet
@@ -0,0 +1,363 @@
+#include "mysql_statistics.h"
+
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <random>
+#include <string_view>
+
+#include "async_log.h"
+
+namespace conet {
+
+namespace {
+
+const std::string other_fingerprint = "other";
+const std::size_t other_hash = std::hash<std::string_view>()(other_fingerprint);
+const std::size_t max_slow_query_sql_size = 1024;
+
+std::chrono::microseconds to_microseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+}
+
+bool is_identifier_char(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+} // namespace
+
+const char* to_string(MysqlQueryPhase phase)
+{
+    switch (phase)
+    {
+    case MysqlQueryPhase::queue:
+        return "queue";
+    case MysqlQueryPhase::execute:
+        return "execute";
+    case MysqlQueryPhase::store:
+        return "store";
+    case MysqlQueryPhase::fetch:
+        return "fetch";
+    case MysqlQueryPhase::decode:
+        return "decode";
+    }
+    return "unknown";
+}
+
+MysqlQueryTimer::MysqlQueryTimer(const Clock::duration &queue_time) :
+    queue_time_(queue_time),
+    is_enabled_(MysqlStatistics::instance().is_enabled()),
+    start_queue_time_(0)
+{
+}
+
+void MysqlQueryTimer::start()
+{
+    if (!is_enabled_)
+        return;
+
+    start_time_ = Clock::now();
+    start_queue_time_ = queue_time_;
+}
+
+void MysqlQueryTimer::stop(MysqlQueryPhase phase)
+{
+    if (!is_enabled_)
+        return;
+
+    auto queued = queue_time_ - start_queue_time_;
+    phases_[static_cast<std::size_t>(MysqlQueryPhase::queue)] += queued;
+    phases_[static_cast<std::size_t>(phase)] += std::max(Clock::now() - start_time_ - queued, Clock::duration::zero());
+}
+
+MysqlQueryTimer::Clock::duration MysqlQueryTimer::total() const
+{
+    Clock::duration total(0);
+    for (auto duration : phases_)
+    {
+        total += duration;
+    }
+    return total;
+}
+
+MysqlStatistics& MysqlStatistics::instance()
+{
+    static MysqlStatistics object;
+    return object;
+}
+
+void MysqlStatistics::set_options(const MysqlStatisticsOptions &options)
+{
+    std::unique_lock lock(mutex_);
+    options_ = options;
+    is_enabled_ = options.is_enabled;
+    slow_query_threshold_ = options.slow_query_threshold.count();
+    max_fingerprint_number_ = options.max_fingerprint_number;
+}
+
+MysqlStatisticsOptions MysqlStatistics::options() const
+{
+    std::shared_lock lock(mutex_);
+    return options_;
+}
+
+void MysqlStatistics::record(const std::string &sql, const MysqlQueryTimer &timer, std::size_t row_number, bool is_success)
+{
+    if (!timer.is_enabled())
+        return;
+
+    auto total = to_microseconds(timer.total());
+    total_histogram_.record(total.count());
+    for (std::size_t i=0; i<mysql_query_phase_count; ++i)
+    {
+        phase_histograms_[i].record(to_microseconds(timer.phases()[i]).count());
+    }
+
+    // only copied for new statements and slow queries
+    thread_local std::string statement_fingerprint;
+    fingerprint(sql, statement_fingerprint);
+    auto hash = std::hash<std::string_view>()(statement_fingerprint);
+
+    {
+        std::shared_lock<std::shared_mutex> lock;
+        auto statistics = find(hash, lock);
+        if (statistics == nullptr)
+        {
+            lock.unlock();
+            statistics = find(insert(hash, statement_fingerprint), lock);
+        }
+
+        // reset() may run between the two locks
+        if (statistics != nullptr)
+        {
+            statistics->total.record(total.count());
+            for (std::size_t i=0; i<mysql_query_phase_count; ++i)
+            {
+                statistics->phase_sums[i].fetch_add(to_microseconds(timer.phases()[i]).count(), std::memory_order_relaxed);
+            }
+            statistics->row_number.fetch_add(row_number, std::memory_order_relaxed);
+            if (!is_success)
+                statistics->error_number.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (total.count() >= slow_query_threshold_.load(std::memory_order_relaxed))
+        add_slow_query(sql, statement_fingerprint, timer, row_number, is_success);
+}
+
+MysqlStatementStatistics* MysqlStatistics::find(std::size_t hash, std::shared_lock<std::shared_mutex> &lock)
+{
+    auto &shard = shard_group_[hash % shard_count];
+    lock = std::shared_lock(shard.mutex);
+    auto it = shard.statement_group.find(hash);
+    return it == shard.statement_group.end() ? nullptr : it->second.statistics.get();
+}
+
+std::size_t MysqlStatistics::insert(std::size_t hash, const std::string &fingerprint)
+{
+    {
+        auto &shard = shard_group_[hash % shard_count];
+        std::unique_lock lock(shard.mutex);
+        if (shard.statement_group.count(hash) != 0)
+            return hash;
+
+        if (fingerprint_number_.fetch_add(1, std::memory_order_relaxed) < max_fingerprint_number_.load(std::memory_order_relaxed))
+        {
+            shard.statement_group.emplace(hash, Statement{fingerprint, std::make_unique<MysqlStatementStatistics>()});
+            return hash;
+        }
+        fingerprint_number_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    auto &shard = shard_group_[other_hash % shard_count];
+    std::unique_lock lock(shard.mutex);
+    auto &statement = shard.statement_group[other_hash];
+    if (!statement.statistics)
+    {
+        statement.fingerprint = other_fingerprint;
+        statement.statistics = std::make_unique<MysqlStatementStatistics>();
+    }
+    return other_hash;
+}
+
+void MysqlStatistics::add_slow_query(const std::string &sql, const std::string &fingerprint, const MysqlQueryTimer &timer, std::size_t row_number, bool is_success)
+{
+    thread_local std::minstd_rand random_engine(std::random_device{}());
+
+    double sample_rate;
+    {
+        std::shared_lock lock(mutex_);
+        sample_rate = options_.slow_query_sample_rate;
+    }
+    if (sample_rate < 1 && std::uniform_real_distribution<double>(0, 1)(random_engine) >= sample_rate)
+        return;
+
+    MysqlSlowQuery slow_query;
+    slow_query.time = std::chrono::system_clock::now();
+    slow_query.sql = sql.substr(0, max_slow_query_sql_size);
+    slow_query.fingerprint = fingerprint;
+    slow_query.duration = to_microseconds(timer.total());
+    for (std::size_t i=0; i<mysql_query_phase_count; ++i)
+    {
+        slow_query.phase_durations[i] = to_microseconds(timer.phases()[i]);
+    }
+    slow_query.row_number = row_number;
+    slow_query.is_success = is_success;
+
+    ASYNC_LOG(WARNING) << "mysql slow query. duration_us:" << slow_query.duration.count()
+        << " queue_us:" << slow_query.phase_durations[0].count()
+        << " execute_us:" << slow_query.phase_durations[1].count()
+        << " store_us:" << slow_query.phase_durations[2].count()
+        << " fetch_us:" << slow_query.phase_durations[3].count()
+        << " decode_us:" << slow_query.phase_durations[4].count()
+        << " row_number:" << row_number
+        << " sql:" << slow_query.sql;
+
+    std::unique_lock lock(mutex_);
+    if (options_.slow_query_log_capacity == 0)
+        return;
+    while (slow_query_group_.size() >= options_.slow_query_log_capacity)
+    {
+        slow_query_group_.pop_front();
+    }
+    slow_query_group_.push_back(std::move(slow_query));
+}
+
+void MysqlStatistics::for_each_statement(const std::function<void(const std::string &fingerprint, const MysqlStatementStatistics &statistics)> &callback) const
+{
+    for (const auto &shard : shard_group_)
+    {
+        std::shared_lock lock(shard.mutex);
+        for (const auto &p : shard.statement_group)
+        {
+            callback(p.second.fingerprint, *p.second.statistics);
+        }
+    }
+}
+
+std::vector<MysqlSlowQuery> MysqlStatistics::slow_queries() const
+{
+    std::shared_lock lock(mutex_);
+    return std::vector<MysqlSlowQuery>(slow_query_group_.begin(), slow_query_group_.end());
+}
+
+void MysqlStatistics::reset()
+{
+    for (auto &shard : shard_group_)
+    {
+        std::unique_lock lock(shard.mutex);
+        shard.statement_group.clear();
+    }
+    fingerprint_number_ = 0;
+
+    {
+        std::unique_lock lock(mutex_);
+        slow_query_group_.clear();
+    }
+    total_histogram_.reset();
+    for (auto &histogram : phase_histograms_)
+    {
+        histogram.reset();
+    }
+}
+
+std::string MysqlStatistics::fingerprint(const std::string &sql)
+{
+    std::string ret;
+    ret.reserve(sql.size());
+    fingerprint(sql, ret);
+    return ret;
+}
+
+void MysqlStatistics::fingerprint(const std::string &sql, std::string &ret)
+{
+    ret.clear();
+
+    auto append_space = [&ret] ()
+    {
+        if (!ret.empty() && ret.back() != ' ')
+            ret += ' ';
+    };
+
+    // "?, ?, ?" -> "?"
+    auto append_placeholder = [&ret] ()
+    {
+        auto n = ret.size();
+        if (n >= 2 && ret[n - 1] == ',' && ret[n - 2] == '?')
+        {
+            ret.pop_back();
+            return;
+        }
+        if (n >= 3 && ret[n - 1] == ' ' && ret[n - 2] == ',' && ret[n - 3] == '?')
+        {
+            ret.resize(n - 2);
+            return;
+        }
+        ret += '?';
+    };
+
+    std::size_t i = 0;
+    while (i < sql.size())
+    {
+        char c = sql[i];
+        if (c == '\'' || c == '"')
+        {
+            // string literal, backslash and doubled quote escapes
+            ++i;
+            while (i < sql.size())
+            {
+                if (sql[i] == '\\')
+                {
+                    i += 2;
+                    continue;
+                }
+                if (sql[i] == c)
+                {
+                    if (i + 1 < sql.size() && sql[i + 1] == c)
+                    {
+                        i += 2;
+                        continue;
+                    }
+                    break;
+                }
+                ++i;
+            }
+            ++i;
+            append_placeholder();
+        }
+        else if (c == '`')
+        {
+            auto end = sql.find('`', i + 1);
+            end = end == std::string::npos ? sql.size() : end + 1;
+            ret.append(sql, i, end - i);
+            i = end;
+        }
+        else if (std::isdigit(static_cast<unsigned char>(c)) && (ret.empty() || !is_identifier_char(ret.back())))
+        {
+            while (i < sql.size() && (is_identifier_char(sql[i]) || sql[i] == '.'))
+            {
+                ++i;
+            }
+            append_placeholder();
+        }
+        else if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            append_space();
+            ++i;
+        }
+        else
+        {
+            ret += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            ++i;
+        }
+    }
+
+    while (!ret.empty() && (ret.back() == ' ' || ret.back() == ';'))
+    {
+        ret.pop_back();
+    }
+}
+
+} // namespace conet
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "histogram.h"
+
+namespace conet {
+
+enum class MysqlQueryPhase
+{
+    // waiting for the Polling thread to pick up the operation
+    queue,
+    // sending the statement until the server answered
+    execute,
+    // mysql_store_result, reading the result set
+    store,
+    // mysql_fetch_row
+    fetch,
+    // building the row objects
+    decode,
+};
+
+inline constexpr std::size_t mysql_query_phase_count = 5;
+
+const char* to_string(MysqlQueryPhase phase);
+
+struct MysqlStatisticsOptions
+{
+    // off by default, every query pays a fingerprint scan and a few histogram updates
+    bool is_enabled = false;
+    // queries taking longer go to the slow query log
+    std::chrono::microseconds slow_query_threshold = std::chrono::seconds(1);
+    // fraction of the slow queries which are kept and logged, in [0, 1]
+    double slow_query_sample_rate = 1;
+    std::size_t slow_query_log_capacity = 128;
+    // statements with new fingerprints beyond this are counted under "other"
+    std::size_t max_fingerprint_number = 128;
+};
+
+// latency of one statement fingerprint in microseconds. only the total has a histogram, the phase
+// distribution of all statements is in MysqlStatistics::phase_histogram()
+struct MysqlStatementStatistics
+{
+    Histogram total;
+    std::array<std::atomic_uint64_t, mysql_query_phase_count> phase_sums{};
+    std::atomic_uint64_t error_number{0};
+    std::atomic_uint64_t row_number{0};
+};
+
+struct MysqlSlowQuery
+{
+    std::chrono::system_clock::time_point time;
+    std::string sql;
+    std::string fingerprint;
+    std::chrono::microseconds duration;
+    std::array<std::chrono::microseconds, mysql_query_phase_count> phase_durations;
+    std::size_t row_number;
+    bool is_success;
+};
+
+// Phase durations of one query. Time spent queued in Polling is accumulated by MysqlClient
+// into queue_time and moved out of the phase it happened in.
+class MysqlQueryTimer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    MysqlQueryTimer(const Clock::duration &queue_time);
+
+    void start();
+    void stop(MysqlQueryPhase phase);
+
+    bool is_enabled() const { return is_enabled_; }
+    const std::array<Clock::duration, mysql_query_phase_count>& phases() const { return phases_; }
+    Clock::duration total() const;
+
+private:
+    const Clock::duration &queue_time_;
+    bool is_enabled_;
+    Clock::time_point start_time_;
+    Clock::duration start_queue_time_;
+    std::array<Clock::duration, mysql_query_phase_count> phases_{};
+};
+
+// Process wide query statistics fed by MysqlClient, grouped by statement fingerprint.
+// Statements are spread over shards by the hash of their fingerprint, recording one only takes
+// the shared lock of its shard.
+class MysqlStatistics
+{
+public:
+    static MysqlStatistics& instance();
+
+    MysqlStatistics(const MysqlStatistics &) = delete;
+    MysqlStatistics& operator=(const MysqlStatistics &) = delete;
+
+    void set_options(const MysqlStatisticsOptions &options);
+    MysqlStatisticsOptions options() const;
+    bool is_enabled() const { return is_enabled_.load(std::memory_order_relaxed); }
+
+    void record(const std::string &sql, const MysqlQueryTimer &timer, std::size_t row_number, bool is_success);
+
+    // all statements together
+    const Histogram& total_histogram() const { return total_histogram_; }
+    const Histogram& phase_histogram(MysqlQueryPhase phase) const { return phase_histograms_[static_cast<std::size_t>(phase)]; }
+
+    // called under the shared lock of a shard, do not call record() from the callback
+    void for_each_statement(const std::function<void(const std::string &fingerprint, const MysqlStatementStatistics &statistics)> &callback) const;
+    std::vector<MysqlSlowQuery> slow_queries() const;
+
+    void reset();
+
+    // lower case, literals replaced by '?', lists of literals collapsed, whitespace collapsed
+    static std::string fingerprint(const std::string &sql);
+    // same, into a buffer which is reused across calls
+    static void fingerprint(const std::string &sql, std::string &ret);
+
+private:
+    struct Statement
+    {
+        std::string fingerprint;
+        std::unique_ptr<MysqlStatementStatistics> statistics;
+    };
+
+    struct Shard
+    {
+        mutable std::shared_mutex mutex;
+        // by the hash of the fingerprint, fingerprints with the same hash share an entry
+        std::unordered_map<std::size_t, Statement> statement_group;
+    };
+
+    static constexpr std::size_t shard_count = 16;
+
+    MysqlStatistics() = default;
+
+    // nullptr when unknown, lock holds the shard
+    MysqlStatementStatistics* find(std::size_t hash, std::shared_lock<std::shared_mutex> &lock);
+    // returns the hash the statement is counted under, the one of "other" beyond max_fingerprint_number
+    std::size_t insert(std::size_t hash, const std::string &fingerprint);
+    void add_slow_query(const std::string &sql, const std::string &fingerprint, const MysqlQueryTimer &timer, std::size_t row_number, bool is_success);
+
+    std::atomic_bool is_enabled_{false};
+    // copies of the options read by record()
+    std::atomic<std::chrono::microseconds::rep> slow_query_threshold_{MysqlStatisticsOptions().slow_query_threshold.count()};
+    std::atomic_size_t max_fingerprint_number_{MysqlStatisticsOptions().max_fingerprint_number};
+    std::atomic_size_t fingerprint_number_{0};
+    Histogram total_histogram_;
+    std::array<Histogram, mysql_query_phase_count> phase_histograms_;
+    std::array<Shard, shard_count> shard_group_;
+
+    // options and the slow query log
+    mutable std::shared_mutex mutex_;
+    MysqlStatisticsOptions options_;
+    std::deque<MysqlSlowQuery> slow_query_group_;
+};
+
+} // namespace conet
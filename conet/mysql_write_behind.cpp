@@ -0,0 +1,371 @@
+#include "mysql_write_behind.h"
+
+#include <memory>
+#include <unordered_map>
+
+#include "error.h"
+#include "mysql_bulk_insert.h"
+
+namespace conet {
+namespace impl {
+
+MysqlWriteBehindImpl::MysqlWriteBehindImpl(MysqlClientPool &mysql_client_pool, const MysqlWriteBehindOptions &options) :
+    mysql_client_pool_(mysql_client_pool),
+    options_(options),
+    strand_(boost::asio::make_strand(mysql_client_pool.get_executor())),
+    window_timer_(strand_),
+    is_timer_armed_(false),
+    is_closed_(false),
+    in_flight_batch_number_(0),
+    pending_number_(0),
+    write_number_(0),
+    batch_number_(0),
+    statement_number_(0),
+    retry_number_(0)
+{
+}
+
+boost::asio::awaitable<result<void>> MysqlWriteBehindImpl::insert(
+    const std::string &table,
+    const std::vector<std::string> &columns,
+    const std::vector<std::optional<std::string>> &values,
+    const std::string &suffix)
+{
+    if (values.size() != columns.size())
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message("column number mismatch");
+        error_info.add_pair("table", table);
+        error_info.add_pair("column_number", columns.size());
+        error_info.add_pair("value_number", values.size());
+        co_return error_info;
+    }
+
+    Write write;
+    write.key = table;
+    for (const auto &column : columns)
+    {
+        write.key += '\0';
+        write.key += column;
+    }
+    write.key += '\0';
+    write.key += suffix;
+    write.table = table;
+    write.columns = columns;
+    write.values = values;
+    write.suffix = suffix;
+
+    co_return co_await submit(std::move(write));
+}
+
+boost::asio::awaitable<result<void>> MysqlWriteBehindImpl::execute(const std::string &sql)
+{
+    Write write;
+    write.sql = sql;
+    co_return co_await submit(std::move(write));
+}
+
+void MysqlWriteBehindImpl::flush()
+{
+    boost::asio::dispatch(strand_, [self = shared_from_this()] { self->send(); });
+}
+
+void MysqlWriteBehindImpl::close()
+{
+    boost::asio::dispatch(strand_, [self = shared_from_this()]
+        {
+            self->is_closed_ = true;
+            self->send();
+        });
+}
+
+MysqlWriteBehindStats MysqlWriteBehindImpl::stats() const
+{
+    MysqlWriteBehindStats ret;
+    ret.write_number = write_number_;
+    ret.batch_number = batch_number_;
+    ret.statement_number = statement_number_;
+    ret.retry_number = retry_number_;
+    ret.pending_number = pending_number_;
+    return ret;
+}
+
+boost::asio::awaitable<result<void>> MysqlWriteBehindImpl::submit(Write &&write)
+{
+    return boost::asio::async_initiate<const boost::asio::use_awaitable_t<>, void(result<void>)>(
+        [this, write = std::move(write)]<typename H> (H&& self) mutable
+        {
+            auto handler_ptr = make_recycling_shared<H>(std::forward<H>(self));
+            write.callback = [handler_ptr] (result<void> r) mutable
+            {
+                auto executor = boost::asio::get_associated_executor(*handler_ptr);
+                boost::asio::dispatch(executor, [handler_ptr, r = std::move(r)] () mutable
+                {
+                    auto&& handler = std::move(*handler_ptr.get());
+                    handler(std::move(r));
+                });
+            };
+
+            boost::asio::dispatch(strand_, [self = shared_from_this(), write = std::move(write)] () mutable
+            {
+                self->add(std::move(write));
+            });
+        },
+        boost::asio::use_awaitable);
+}
+
+void MysqlWriteBehindImpl::add(Write &&write)
+{
+    if (is_closed_)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::pool_closed, error::mysql_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message("write behind is closed");
+        write.callback(error_info);
+        return;
+    }
+
+    pending_write_group_.push_back(std::move(write));
+    ++pending_number_;
+    ++write_number_;
+
+    if (pending_write_group_.size() >= options_.max_batch_write_number)
+    {
+        send();
+        return;
+    }
+
+    if (is_timer_armed_)
+        return;
+
+    is_timer_armed_ = true;
+    window_timer_.expires_after(options_.window);
+    window_timer_.async_wait([self = shared_from_this()] (const boost::system::error_code &ec)
+        {
+            // canceled by send(), is_timer_armed_ is already reset
+            if (ec)
+                return;
+
+            self->is_timer_armed_ = false;
+            self->send();
+        });
+}
+
+void MysqlWriteBehindImpl::send()
+{
+    if (is_timer_armed_)
+    {
+        is_timer_armed_ = false;
+        window_timer_.cancel();
+    }
+
+    // the rest is sent when a batch finishes
+    while (!pending_write_group_.empty() && in_flight_batch_number_ < options_.max_in_flight_batch_number)
+    {
+        std::vector<Write> write_group;
+        if (pending_write_group_.size() <= options_.max_batch_write_number)
+        {
+            write_group.swap(pending_write_group_);
+        }
+        else
+        {
+            auto end = pending_write_group_.begin() + options_.max_batch_write_number;
+            write_group.assign(std::make_move_iterator(pending_write_group_.begin()), std::make_move_iterator(end));
+            pending_write_group_.erase(pending_write_group_.begin(), end);
+        }
+        pending_number_ -= write_group.size();
+
+        ++in_flight_batch_number_;
+        ++batch_number_;
+        boost::asio::co_spawn(strand_, run_batch(shared_from_this(), std::move(write_group)), boost::asio::detached);
+    }
+}
+
+boost::asio::awaitable<void> MysqlWriteBehindImpl::run_batch(std::shared_ptr<MysqlWriteBehindImpl> self, std::vector<Write> write_group)
+{
+    std::vector<std::optional<result<void>>> write_results(write_group.size());
+    auto batch_result = co_await execute_batch(write_group, write_results);
+
+    for (std::size_t i=0; i<write_group.size(); ++i)
+    {
+        if (write_results[i])
+            write_group[i].callback(std::move(*write_results[i]));
+        else
+            write_group[i].callback(batch_result);
+    }
+
+    --in_flight_batch_number_;
+    send();
+}
+
+boost::asio::awaitable<result<void>> MysqlWriteBehindImpl::execute_batch(const std::vector<Write> &write_group, std::vector<std::optional<result<void>>> &write_results)
+{
+    RESULT_CO_AUTO(p, co_await mysql_client_pool_.get());
+    MysqlClient &mysql_client = *p;
+
+    auto statements = make_statements(mysql_client, write_group);
+    // a single statement is atomic anyway
+    bool use_transaction = options_.use_transaction && statements.size() > 1;
+
+    std::vector<std::string> sqls;
+    sqls.reserve(statements.size() + 2);
+    if (use_transaction)
+        sqls.push_back("START TRANSACTION");
+    for (const auto &statement : statements)
+    {
+        sqls.push_back(statement.sql);
+    }
+    if (use_transaction)
+        sqls.push_back("COMMIT");
+    statement_number_ += statements.size();
+
+    // the outcome of an unfinished batch is unknown, every write gets the error
+    RESULT_CO_AUTO(batch_results, co_await mysql_client.batch_query(sqls));
+
+    if (!use_transaction)
+    {
+        // a failed merged insert does not tell which row broke it, and statements after a failure
+        // are not executed. their writes are left without a result and rerun one by one.
+        bool is_retrying = false;
+        for (std::size_t i=0; i<statements.size() && i<batch_results.size(); ++i)
+        {
+            const auto &batch_result = batch_results[i];
+            bool is_not_executed = !batch_result &&
+                batch_result.error_info().error_code() == boost::system::error_code(error::statement_not_executed, error::mysql_category());
+            if (!batch_result && (is_not_executed || statements[i].write_indexes.size() > 1))
+            {
+                is_retrying = true;
+                continue;
+            }
+
+            for (auto index : statements[i].write_indexes)
+            {
+                write_results[index].emplace(batch_result);
+            }
+        }
+
+        if (!is_retrying)
+            co_return RESULT_SUCCESS;
+
+        ++retry_number_;
+        co_return co_await retry_one_by_one(mysql_client, write_group, write_results);
+    }
+
+    bool is_success = batch_results.size() == sqls.size();
+    for (auto &batch_result : batch_results)
+    {
+        if (!batch_result)
+            is_success = false;
+    }
+
+    if (is_success)
+    {
+        for (auto &write_result : write_results)
+        {
+            write_result.emplace(RESULT_SUCCESS);
+        }
+        co_return RESULT_SUCCESS;
+    }
+
+    // which write broke the batch is not known, rerun them one by one
+    RESULT_CO_CHECK(co_await mysql_client.query("ROLLBACK"));
+    ++retry_number_;
+    co_return co_await retry_one_by_one(mysql_client, write_group, write_results);
+}
+
+boost::asio::awaitable<result<void>> MysqlWriteBehindImpl::retry_one_by_one(MysqlClient &mysql_client, const std::vector<Write> &write_group, std::vector<std::optional<result<void>>> &write_results)
+{
+    for (std::size_t i=0; i<write_group.size(); ++i)
+    {
+        // already has the result of its own statement
+        if (write_results[i])
+            continue;
+
+        const auto &write = write_group[i];
+        std::string sql = write.sql;
+        if (!write.key.empty())
+        {
+            MysqlBulkInsertBuilder builder(mysql_client, write.table, write.columns, options_.max_statement_size);
+            if (!write.suffix.empty())
+                builder.set_suffix(write.suffix);
+            builder.add_row(write.values);
+            sql = builder.statements().front();
+        }
+
+        ++statement_number_;
+        auto query_result = co_await mysql_client.query(sql);
+        // the rest of the writes get the error
+        if (!query_result && mysql_client.is_broken())
+            co_return query_result;
+        write_results[i].emplace(std::move(query_result));
+    }
+
+    co_return RESULT_SUCCESS;
+}
+
+std::vector<MysqlWriteBehindImpl::Statement> MysqlWriteBehindImpl::make_statements(MysqlClient &mysql_client, const std::vector<Write> &write_group) const
+{
+    struct InsertGroup
+    {
+        MysqlBulkInsertBuilder builder;
+        // write indexes of each statement of builder
+        std::vector<std::vector<std::size_t>> write_indexes_group;
+    };
+
+    std::vector<Statement> statements;
+    std::vector<std::unique_ptr<InsertGroup>> insert_group_group;
+    std::unordered_map<std::string, InsertGroup *> key_insert_group;
+
+    auto close_insert_groups = [&]
+        {
+            for (auto &insert_group : insert_group_group)
+            {
+                auto sqls = insert_group->builder.statements();
+                for (std::size_t i=0; i<sqls.size(); ++i)
+                {
+                    statements.push_back(Statement{std::move(sqls[i]), std::move(insert_group->write_indexes_group[i])});
+                }
+            }
+            insert_group_group.clear();
+            key_insert_group.clear();
+        };
+
+    for (std::size_t i=0; i<write_group.size(); ++i)
+    {
+        const auto &write = write_group[i];
+        if (write.key.empty())
+        {
+            close_insert_groups();
+            statements.push_back(Statement{write.sql, {i}});
+            continue;
+        }
+
+        auto &insert_group = key_insert_group[write.key];
+        if (insert_group == nullptr)
+        {
+            insert_group_group.push_back(std::make_unique<InsertGroup>(InsertGroup{
+                MysqlBulkInsertBuilder(mysql_client, write.table, write.columns, options_.max_statement_size), {}}));
+            insert_group = insert_group_group.back().get();
+            if (!write.suffix.empty())
+                insert_group->builder.set_suffix(write.suffix);
+        }
+
+        // column number is checked by insert()
+        insert_group->builder.add_row(write.values);
+        insert_group->write_indexes_group.resize(insert_group->builder.statement_number());
+        insert_group->write_indexes_group.back().push_back(i);
+    }
+    close_insert_groups();
+
+    return statements;
+}
+
+} // namespace impl
+} // namespace conet
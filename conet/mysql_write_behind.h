@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include "mysql_client_pool.h"
+
+namespace conet {
+
+struct MysqlWriteBehindOptions
+{
+    // how long the first write of a batch waits for more writes
+    std::chrono::microseconds window = std::chrono::milliseconds(2);
+    // a batch is sent at once when this many writes are pending
+    std::size_t max_batch_write_number = 1000;
+    // merged INSERT statements are split above this size
+    std::size_t max_statement_size = 1024 * 1024;
+    // batches sent concurrently, each holds one pool connection.
+    // writes arriving meanwhile are sent together when a batch finishes.
+    int max_in_flight_batch_number = 4;
+    // run a batch in one transaction. a failed batch is rolled back and its writes are retried one by one,
+    // so every caller gets the result of its own write. without it only the writes of a failed merged
+    // insert and of the statements not executed after a failure are retried.
+    bool use_transaction = true;
+};
+
+struct MysqlWriteBehindStats
+{
+    std::uint64_t write_number;
+    std::uint64_t batch_number;
+    std::uint64_t statement_number;
+    // batches with writes retried one at a time
+    std::uint64_t retry_number;
+    std::size_t pending_number;
+};
+
+namespace impl {
+
+// the state of MysqlWriteBehind, kept alive by the work it has scheduled on the strand
+class MysqlWriteBehindImpl : public std::enable_shared_from_this<MysqlWriteBehindImpl>
+{
+public:
+    MysqlWriteBehindImpl(MysqlClientPool &mysql_client_pool, const MysqlWriteBehindOptions &options);
+
+    MysqlWriteBehindImpl(const MysqlWriteBehindImpl &) = delete;
+    MysqlWriteBehindImpl& operator=(const MysqlWriteBehindImpl &) = delete;
+
+    boost::asio::awaitable<result<void>> insert(
+        const std::string &table,
+        const std::vector<std::string> &columns,
+        const std::vector<std::optional<std::string>> &values,
+        const std::string &suffix);
+    boost::asio::awaitable<result<void>> execute(const std::string &sql);
+    void flush();
+    void close();
+    MysqlWriteBehindStats stats() const;
+
+private:
+    using CallbackType = std::function<void(result<void>)>;
+
+    struct Write
+    {
+        // empty for execute()
+        std::string key;
+        std::string table;
+        std::vector<std::string> columns;
+        std::vector<std::optional<std::string>> values;
+        std::string suffix;
+        std::string sql;
+        CallbackType callback;
+    };
+
+    struct Statement
+    {
+        std::string sql;
+        std::vector<std::size_t> write_indexes;
+    };
+
+    boost::asio::awaitable<result<void>> submit(Write &&write);
+    void add(Write &&write);
+    void send();
+    // self keeps this alive until the batch ends
+    boost::asio::awaitable<void> run_batch(std::shared_ptr<MysqlWriteBehindImpl> self, std::vector<Write> write_group);
+    boost::asio::awaitable<result<void>> execute_batch(const std::vector<Write> &write_group, std::vector<std::optional<result<void>>> &write_results);
+    boost::asio::awaitable<result<void>> retry_one_by_one(MysqlClient &mysql_client, const std::vector<Write> &write_group, std::vector<std::optional<result<void>>> &write_results);
+    std::vector<Statement> make_statements(MysqlClient &mysql_client, const std::vector<Write> &write_group) const;
+
+    MysqlClientPool &mysql_client_pool_;
+    MysqlWriteBehindOptions options_;
+    boost::asio::strand<boost::asio::any_io_executor> strand_;
+    boost::asio::steady_timer window_timer_;
+    bool is_timer_armed_;
+    bool is_closed_;
+    int in_flight_batch_number_;
+    std::vector<Write> pending_write_group_;
+    std::atomic_size_t pending_number_;
+    std::atomic_uint64_t write_number_;
+    std::atomic_uint64_t batch_number_;
+    std::atomic_uint64_t statement_number_;
+    std::atomic_uint64_t retry_number_;
+};
+
+} // namespace impl
+
+// Group commit on top of MysqlClientPool. Writes are collected over a short window,
+// inserts into the same table and columns are merged into multi-row INSERT statements,
+// and the whole batch is sent in one round trip.
+// Writes of one batch are executed in submission order, except that the merged inserts run
+// at the position of their first row. execute() is a barrier, inserts are never merged across it.
+// e.g.
+//   MysqlWriteBehind write_behind(mysql_client_pool);
+//   co_await write_behind.insert("test", {"id", "name"}, {"1", "hello"});
+//   co_await write_behind.execute("update `test` set `name`='world' where `id`=1");
+class MysqlWriteBehind
+{
+public:
+    MysqlWriteBehind(MysqlClientPool &mysql_client_pool, const MysqlWriteBehindOptions &options = {}) :
+        impl_(std::make_shared<impl::MysqlWriteBehindImpl>(mysql_client_pool, options))
+    {
+    }
+
+    // closes without waiting, the pending writes and the batches in flight still complete on the
+    // executor of the pool, which has to outlive them
+    ~MysqlWriteBehind()
+    {
+        impl_->close();
+    }
+
+    MysqlWriteBehind(const MysqlWriteBehind &) = delete;
+    MysqlWriteBehind& operator=(const MysqlWriteBehind &) = delete;
+
+    // std::nullopt is NULL. suffix is appended to the statement, e.g. "ON DUPLICATE KEY UPDATE ..."
+    // and rows are only merged with rows of the same suffix.
+    boost::asio::awaitable<result<void>> insert(
+        const std::string &table,
+        const std::vector<std::string> &columns,
+        const std::vector<std::optional<std::string>> &values,
+        const std::string &suffix = "")
+    {
+        return impl_->insert(table, columns, values, suffix);
+    }
+
+    // UPDATE, DELETE or any statement without result set
+    boost::asio::awaitable<result<void>> execute(const std::string &sql)
+    {
+        return impl_->execute(sql);
+    }
+
+    // send pending writes without waiting for the window
+    void flush() { impl_->flush(); }
+    // send pending writes, the writes submitted afterwards fail with pool_closed
+    void close() { impl_->close(); }
+
+    MysqlWriteBehindStats stats() const { return impl_->stats(); }
+
+private:
+    std::shared_ptr<impl::MysqlWriteBehindImpl> impl_;
+};
+
+} // namespace conet
@@ -11,6 +11,7 @@
 
 #include "error.h"
 #include "error_info.h"
+#include "metrics.h"
 #include "pack_maker.h"
 #include "pack_parser.h"
 
@@ -31,10 +32,26 @@ std::vector<char> PackCoder::encode(const google::protobuf::Message& message) co
 	pack_maker.add(&packet_version, sizeof(packet_version));
 	pack_maker.add(data.c_str(), data.size());
 
+	static auto &encoded_number = MetricsRegistry::global().counter("conet_pack_encoded_total", "messages encoded by PackCoder");
+	encoded_number.add();
+
 	return pack_maker.make();
 }
 
 result<std::shared_ptr<google::protobuf::Message>> PackCoder::decode(std::vector<char> &&binary)
+{
+	static auto &decoded_number = MetricsRegistry::global().counter("conet_pack_decoded_total", "messages decoded by PackCoder");
+	static auto &decode_failed_number = MetricsRegistry::global().counter("conet_pack_decode_failures_total", "packets PackCoder failed to decode");
+
+	auto r = decode_real(std::move(binary));
+	if (r.has_error())
+		decode_failed_number.add();
+	else
+		decoded_number.add();
+	return r;
+}
+
+result<std::shared_ptr<google::protobuf::Message>> PackCoder::decode_real(std::vector<char> &&binary)
 {
 	PacketParser parser(binary);
 
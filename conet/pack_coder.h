@@ -15,6 +15,9 @@ public:
 	result<std::shared_ptr<google::protobuf::Message>> decode(std::vector<char> &&binary);
 
 	int32_t packet_version_;
+
+private:
+	result<std::shared_ptr<google::protobuf::Message>> decode_real(std::vector<char> &&binary);
 };
 
 } // namespace conet
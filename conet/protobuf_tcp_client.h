@@ -4,8 +4,11 @@
 #include <google/protobuf/message.h>
 #include <glog/logging.h>
 
+#include "async_log.h"
 #include "defer.h"
+#include "metrics.h"
 #include "tcp_client.h"
+#include "trace.h"
 
 namespace conet {
 
@@ -93,12 +96,12 @@ public:
             {
                 if (e)
                 {
-                    LOG(WARNING) << "exception.";
+                    ASYNC_LOG(WARNING) << "exception.";
                 }
 
                 if (result.has_error())
                 {
-                    LOG(WARNING) << "result.error_info:" << result.error_info();
+                    ASYNC_LOG(WARNING) << "result.error_info:" << result.error_info();
                 }
             });
     }
@@ -109,6 +112,11 @@ public:
         is_receiving_ = true;
         DEFER(is_receiving_ = false);
 
+        static auto &dispatch_histogram = MetricsRegistry::global().histogram("conet_protobuf_dispatch_nanoseconds",
+            "time from a decoded message to its callback returning or its coroutine being spawned");
+        static auto &unhandled_number = MetricsRegistry::global().counter("conet_protobuf_unhandled_messages_total",
+            "decoded messages without a callback");
+
         while (true)
         {
             RESULT_CO_AUTO(buffer, co_await pack_tcp_reader_.read());
@@ -118,7 +126,7 @@ public:
             auto&& r = pack_coder_.decode(std::move(buffer));
             if (!r)
             {
-                LOG(INFO) << r;
+                ASYNC_LOG(INFO) << "decode fail. " << r.error_info();
                 continue;
             }
             auto &&message = std::move(r).value();
@@ -127,6 +135,9 @@ public:
             //RESULT_CO_AUTO(message, pack_coder_.decode(std::move(buffer)));
 
             const auto &pb_name = message->GetDescriptor()->full_name();
+            TraceSpan span("ProtobufTcpClient::dispatch", Tracer::global().sample());
+            auto dispatch_start = std::chrono::steady_clock::now();
+            DEFER(dispatch_histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - dispatch_start).count()));
 
             // handle
             {
@@ -156,20 +167,27 @@ public:
                 {
                     auto callback = it->second;
                     boost::asio::co_spawn(tcp_client_.get_executor(),
-                    [callback, message]() -> boost::asio::awaitable<result<void>>
+                    [callback, message, trace_context = span.context()]() -> boost::asio::awaitable<result<void>>
                     {
-                        return callback(*message.get());
+                        // the callback is not traced itself, the span only covers it
+                        TraceSpan span("ProtobufTcpClient::callback", trace_context);
+                        span.suspend();
+                        auto callback_result = co_await callback(*message.get());
+                        span.resume();
+                        co_return callback_result;
                     },
                     [](std::exception_ptr e, result<void> result)
                     {
                         if (result.has_error())
                         {
-                            LOG(INFO) << "result.error_info:" << result.error_info();
+                            ASYNC_LOG(INFO) << "result.error_info:" << result.error_info();
                         }
                     });
                     continue;
                 }
             }
+
+            unhandled_number.add();
         }
 
         is_receiving_ = false;
@@ -295,7 +313,7 @@ private:
                 [this]<typename H> (H&& self) mutable
                 {
                     wait_callback_group_.insert(std::make_pair(T::descriptor()->full_name(),
-                        [self = std::make_shared<H>(std::forward<H>(self))] (boost::system::error_code ec, std::shared_ptr<google::protobuf::Message> result) mutable
+                        [self = make_recycling_shared<H>(std::forward<H>(self))] (boost::system::error_code ec, std::shared_ptr<google::protobuf::Message> result) mutable
                         {
                             (*self)(ec, result);
                         }));
@@ -0,0 +1,115 @@
+#include "recycling_allocator.h"
+
+#include <array>
+
+namespace conet {
+
+namespace {
+
+struct FreeBlock
+{
+    FreeBlock *next;
+};
+
+struct FreeList
+{
+    FreeBlock *head = nullptr;
+    std::size_t size = 0;
+};
+
+// set once the cache of the thread is destroyed, blocks freed later by other thread_local
+// destructors go straight to operator delete
+thread_local bool is_cache_destroyed = false;
+
+struct ThreadCache
+{
+    ~ThreadCache()
+    {
+        is_cache_destroyed = true;
+        for (auto &free_list : free_lists)
+        {
+            while (free_list.head != nullptr)
+            {
+                auto block = free_list.head;
+                free_list.head = block->next;
+                ::operator delete(block);
+            }
+        }
+    }
+
+    std::array<FreeList, RecyclingMemory::class_number> free_lists;
+    RecyclingMemoryStats stats{};
+};
+
+ThreadCache* thread_cache()
+{
+    if (is_cache_destroyed)
+        return nullptr;
+    thread_local ThreadCache cache;
+    return &cache;
+}
+
+// sizes in (class_size * i, class_size * (i + 1)] share class i
+std::size_t class_index(std::size_t size)
+{
+    return size == 0 ? 0 : (size - 1) / RecyclingMemory::class_size;
+}
+
+} // namespace
+
+void* RecyclingMemory::allocate(std::size_t size)
+{
+    if (size > max_size)
+        return ::operator new(size);
+
+    auto index = class_index(size);
+    auto cache = thread_cache();
+    if (cache != nullptr)
+    {
+        auto &free_list = cache->free_lists[index];
+        if (free_list.head != nullptr)
+        {
+            auto block = free_list.head;
+            free_list.head = block->next;
+            --free_list.size;
+            ++cache->stats.recycled_number;
+            return block;
+        }
+        ++cache->stats.system_allocation_number;
+    }
+    return ::operator new((index + 1) * class_size);
+}
+
+void RecyclingMemory::deallocate(void *pointer, std::size_t size) noexcept
+{
+    if (pointer == nullptr)
+        return;
+
+    if (size <= max_size)
+    {
+        auto cache = thread_cache();
+        if (cache != nullptr)
+        {
+            auto &free_list = cache->free_lists[class_index(size)];
+            if (free_list.size < max_cached_number)
+            {
+                auto block = static_cast<FreeBlock *>(pointer);
+                block->next = free_list.head;
+                free_list.head = block;
+                ++free_list.size;
+                return;
+            }
+        }
+    }
+    ::operator delete(pointer);
+}
+
+RecyclingMemoryStats RecyclingMemory::stats()
+{
+    auto cache = thread_cache();
+    if (cache == nullptr)
+        return {};
+    return cache->stats;
+}
+
+} // namespace conet
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/version.hpp>
+
+// The awaitable_frame specialization below mirrors asio's own awaitable_frame and relies on its
+// members, which are the same from asio 1.18 (Boost 1.74) to 1.22 (Boost 1.78, the version conet
+// requires). Other versions keep asio's frame allocation until it is checked against them.
+#if BOOST_ASIO_VERSION >= 101800 && BOOST_ASIO_VERSION <= 102200
+#define CONET_RECYCLE_AWAITABLE_FRAME 1
+#endif
+
+namespace conet {
+
+struct RecyclingMemoryStats
+{
+    // blocks taken from operator new
+    std::uint64_t system_allocation_number;
+    // blocks served from the cache of the thread
+    std::uint64_t recycled_number;
+};
+
+// Per-thread free lists of size classes. A freed block goes to the cache of the thread freeing it,
+// so frames and handlers completing on the thread that runs them are reused without malloc.
+// Blocks above max_size, and blocks beyond max_cached_number per class, go to operator new/delete.
+class RecyclingMemory
+{
+public:
+    static constexpr std::size_t class_size = 64;
+    static constexpr std::size_t max_size = 4096;
+    static constexpr std::size_t class_number = max_size / class_size;
+    static constexpr std::size_t max_cached_number = 256;
+
+    static void* allocate(std::size_t size);
+    static void deallocate(void *pointer, std::size_t size) noexcept;
+
+    // of the calling thread
+    static RecyclingMemoryStats stats();
+};
+
+// std allocator over RecyclingMemory, also usable as the associated allocator of an asio handler
+template<typename T>
+class RecyclingAllocator
+{
+public:
+    using value_type = T;
+
+    RecyclingAllocator() noexcept = default;
+
+    template<typename U>
+    RecyclingAllocator(const RecyclingAllocator<U> &) noexcept
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(RecyclingMemory::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *pointer, std::size_t n) noexcept
+    {
+        RecyclingMemory::deallocate(pointer, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const RecyclingAllocator<U> &) const noexcept { return true; }
+};
+
+// std::make_shared from RecyclingMemory, for handlers kept alive by the callback of an operation
+template<typename T, typename... Args>
+std::shared_ptr<T> make_recycling_shared(Args&&... args)
+{
+    return std::allocate_shared<T>(RecyclingAllocator<T>(), std::forward<Args>(args)...);
+}
+
+} // namespace conet
+
+#ifdef CONET_RECYCLE_AWAITABLE_FRAME
+
+namespace conet::impl {
+
+template<typename T>
+class Result;
+
+} // namespace conet::impl
+
+namespace boost::asio::detail {
+
+// The frame of every awaitable<result<T>> coroutine, asio's awaitable_frame allocated from
+// RecyclingMemory. Asio itself caches a single frame per thread, so a chain of nested coroutines
+// would allocate the rest. awaitable's await_suspend only accepts awaitable_frame handles, which
+// is why this is a specialization rather than a derived promise type.
+template<typename T, typename Executor>
+class awaitable_frame<conet::impl::Result<T>, Executor> : public awaitable_frame_base<Executor>
+{
+public:
+    using value_type = conet::impl::Result<T>;
+
+    awaitable_frame() noexcept
+    {
+    }
+
+    awaitable_frame(awaitable_frame &&other) noexcept :
+        awaitable_frame_base<Executor>(std::move(other))
+    {
+    }
+
+    ~awaitable_frame()
+    {
+        if (has_result_)
+            std::launder(reinterpret_cast<value_type*>(result_))->~value_type();
+    }
+
+    void* operator new(std::size_t size)
+    {
+        return conet::RecyclingMemory::allocate(size);
+    }
+
+    void operator delete(void *pointer, std::size_t size) noexcept
+    {
+        conet::RecyclingMemory::deallocate(pointer, size);
+    }
+
+    awaitable<value_type, Executor> get_return_object() noexcept
+    {
+        this->coro_ = coroutine_handle<awaitable_frame>::from_promise(*this);
+        return awaitable<value_type, Executor>(this);
+    }
+
+    template<typename U>
+    void return_value(U &&u)
+    {
+        new (&result_) value_type(std::forward<U>(u));
+        has_result_ = true;
+    }
+
+    value_type get()
+    {
+        this->caller_ = nullptr;
+        this->rethrow_exception();
+        return std::move(*std::launder(reinterpret_cast<value_type*>(result_)));
+    }
+
+private:
+    alignas(value_type) unsigned char result_[sizeof(value_type)];
+    bool has_result_ = false;
+};
+
+} // namespace boost::asio::detail
+
+#endif // CONET_RECYCLE_AWAITABLE_FRAME
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "recycling_allocator.h"
 #include "result_impl.h"
 
 namespace conet {
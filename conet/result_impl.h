@@ -1,11 +1,14 @@
 #pragma once
 
+#include <concepts>
 #include <sstream>
 #include <cstdio>
 #include <memory>
+#include <type_traits>
 
 #include <glog/logging.h>
 
+#include "async_log.h"
 #include "error_info.h"
 
 #define SINGLE_ARG(...) __VA_ARGS__
@@ -20,12 +23,20 @@
 #define RESULT_LOG(level, e) \
 []<typename RESULT_LOG_T> (RESULT_LOG_T &&result) -> RESULT_LOG_T&& \
 { \
-    LOG(level) << result; \
+    ASYNC_LOG(level) << result.error_info(); \
     return std::forward<RESULT_LOG_T>(result); \
 }(std::move(e));
 
+// records where a failed result passed, as a pointer to a static location. CONET_DISABLE_ERROR_TRAIL compiles it out.
+#ifdef CONET_DISABLE_ERROR_TRAIL
+#define RESULT_LOG_WITH_ERROR(level, result)
+#else
 #define RESULT_LOG_WITH_ERROR(level, result) \
-    result.error_info().add_pair("callstack", __FILE__ + std::string(":") + std::to_string(__LINE__));
+{ \
+    static constexpr boost::source_location result_trail_location = BOOST_CURRENT_LOCATION; \
+    result.error_info().add_trail(&result_trail_location); \
+}
+#endif
 
 
 #define RESULT_CHECK(e, ...) \
@@ -113,6 +124,8 @@ public:
     Result() = default;
     Result(const Result &) = default;
     Result(Result &&) = default;
+    Result& operator=(const Result &) = default;
+    Result& operator=(Result &&) = default;
 
     Result(const ErrorInfo &error_info) :
         error_info_(error_info)
@@ -171,8 +184,11 @@ protected:
     ErrorInfo error_info_;
 };
 
+// The value lives in place, a success costs no allocation. Default-initializable values are
+// default-constructed when the result holds none (an error, or a conversion from another Result),
+// other values are left unconstructed and value() must not be called.
 template<typename ValueType>
-    requires (std::default_initializable<ValueType> && !std::same_as<ValueType, void>)
+    requires (!std::same_as<ValueType, void>)
 class Result<ValueType> : public Result<void>
 {
     using this_type = Result;
@@ -182,160 +198,174 @@ class Result<ValueType> : public Result<void>
     friend class Result;
 
 public:
-    Result() = default;
-    Result(const Result &) = default;
-    Result(Result &&) = default;
-
-    Result(const ErrorInfo &error_info) :
-        base_type(error_info)
-    {
-    }
-
-    Result(ErrorInfo &&error_info) :
-        base_type(std::move(error_info))
+    Result()
     {
+        construct_default();
     }
 
-    Result(const boost::system::error_code &error_code) :
-        base_type(error_code)
-    {
-    }
-
-    Result(boost::system::error_code &&error_code) :
-        base_type(std::move(error_code))
-    {
-    }
-
-    Result(const ValueType &x) :
-        base_type(),
-        value_(x)
-    {
-    }
-
-    Result(ValueType &&x) :
-        base_type(),
-        value_(std::move(x))
-    {
-    }
-
-    template<typename U>
-    Result(const Result<U> &other) :
+    Result(const Result &other) requires std::copy_constructible<ValueType> :
         base_type(other)
     {
+        if (other.has_value_)
+            construct(other.value_);
     }
 
-    template<typename U>
-    Result(Result<U> &&other) :
-        base_type(std::move(other))
-    {
-    }
+    Result(const Result &) requires (!std::copy_constructible<ValueType>) = delete;
 
-    ValueType&& value() &&
+    Result(Result &&other) noexcept(std::is_nothrow_move_constructible_v<ValueType>) :
+        base_type(std::move(other))
     {
-        return std::move(value_);
+        if (other.has_value_)
+            construct(std::move(other.value_));
     }
 
-    ValueType& value() &
+    Result& operator=(const Result &other) requires std::copy_constructible<ValueType>
     {
-        return value_;
+        if (this != &other)
+        {
+            base_type::operator=(other);
+            assign(other.has_value_, other.value_);
+        }
+        return *this;
     }
 
-    const ValueType& value() const &
-    {
-        return value_;
-    }
+    Result& operator=(const Result &) requires (!std::copy_constructible<ValueType>) = delete;
 
-    const ValueType& value() const &&
+    Result& operator=(Result &&other) noexcept(std::is_nothrow_move_constructible_v<ValueType> && std::is_nothrow_move_assignable_v<ValueType>)
     {
-        return value_;
+        if (this != &other)
+        {
+            base_type::operator=(std::move(other));
+            assign(other.has_value_, std::move(other.value_));
+        }
+        return *this;
     }
 
-protected:
-    ValueType value_;
-};
-
-
-template<typename ValueType>
-    requires (!std::default_initializable<ValueType> && !std::same_as<ValueType, void>)
-class Result<ValueType> : public Result<void>
-{
-    using this_type = Result;
-    using base_type = Result<void>;
-
-    template<typename T>
-    friend class Result;
-
-public:
-    Result() = default;
-    Result(const Result &) = default;
-    Result(Result &&) = default;
-
     Result(const ErrorInfo &error_info) :
         base_type(error_info)
     {
+        construct_default();
     }
 
     Result(ErrorInfo &&error_info) :
         base_type(std::move(error_info))
     {
+        construct_default();
     }
 
     Result(const boost::system::error_code &error_code) :
         base_type(error_code)
     {
+        construct_default();
     }
 
     Result(boost::system::error_code &&error_code) :
         base_type(std::move(error_code))
     {
+        construct_default();
     }
 
     Result(const ValueType &x) :
-        base_type(),
-        value_(std::make_unique<ValueType>(x))
+        base_type()
     {
+        construct(x);
     }
 
     Result(ValueType &&x) :
-        base_type(),
-        value_(std::make_unique<ValueType>(std::move(x)))
+        base_type()
     {
+        construct(std::move(x));
     }
 
     template<typename U>
+        requires (!std::same_as<U, ValueType>)
     Result(const Result<U> &other) :
         base_type(other)
     {
+        construct_default();
     }
 
     template<typename U>
+        requires (!std::same_as<U, ValueType>)
     Result(Result<U> &&other) :
         base_type(std::move(other))
     {
+        construct_default();
     }
 
-    ValueType& value() &
+    ~Result()
     {
-        return *value_;
+        destroy();
     }
 
     ValueType&& value() &&
     {
-        return std::move(*value_);
+        return std::move(value_);
+    }
+
+    ValueType& value() &
+    {
+        return value_;
     }
 
     const ValueType& value() const &
     {
-        return *value_;
+        return value_;
     }
 
     const ValueType& value() const &&
     {
-        return *value_;
+        return value_;
     }
 
 protected:
-    std::unique_ptr<ValueType> value_;
+    template<typename... Args>
+    void construct(Args&&... args)
+    {
+        std::construct_at(std::addressof(value_), std::forward<Args>(args)...);
+        has_value_ = true;
+    }
+
+    void construct_default()
+    {
+        if constexpr (std::default_initializable<ValueType>)
+            construct();
+    }
+
+    void destroy()
+    {
+        if (has_value_)
+        {
+            std::destroy_at(std::addressof(value_));
+            has_value_ = false;
+        }
+    }
+
+    // x is only read when has_value, values without assignment are reconstructed
+    template<typename T>
+    void assign(bool has_value, T &&x)
+    {
+        if (!has_value)
+        {
+            destroy();
+        }
+        else if (has_value_ && std::is_assignable_v<ValueType&, T&&>)
+        {
+            if constexpr (std::is_assignable_v<ValueType&, T&&>)
+                value_ = std::forward<T>(x);
+        }
+        else
+        {
+            destroy();
+            construct(std::forward<T>(x));
+        }
+    }
+
+    union
+    {
+        ValueType value_;
+    };
+    bool has_value_ = false;
 };
 
 } // namespace impl
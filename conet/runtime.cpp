@@ -0,0 +1,271 @@
+#include "runtime.h"
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <glog/logging.h>
+
+#include "error.h"
+
+namespace conet {
+
+static thread_local const Runtime *current_runtime = nullptr;
+static thread_local std::size_t current_reactor_index = 0;
+
+Runtime::Runtime(const RuntimeOptions &options) :
+    options_(options),
+    next_index_(0)
+{
+
+}
+
+Runtime::~Runtime()
+{
+    stop();
+}
+
+result<void> Runtime::start()
+{
+    if (!reactor_group_.empty())
+        return {};
+
+    RESULT_AUTO(cpus, allowed_cpus());
+    std::size_t reactor_number = options_.reactor_number > 0 ? options_.reactor_number : cpus.size();
+
+    for (std::size_t i=0; i<reactor_number; ++i)
+    {
+        auto &reactor = reactor_group_.emplace_back(std::make_unique<Reactor>());
+        if (options_.pin_threads)
+            reactor->cpu = cpus[i % cpus.size()];
+    }
+
+    // a thread pins itself before it creates its io_context, then reports back the pinning error
+    std::vector<std::future<int>> ready_group;
+    for (std::size_t i=0; i<reactor_number; ++i)
+    {
+        auto ready = std::make_shared<std::promise<int>>();
+        ready_group.push_back(ready->get_future());
+        auto reactor = reactor_group_[i].get();
+        reactor->thread = std::thread([this, i, reactor, ready]
+            {
+                int error = 0;
+#ifdef __linux__
+                auto name = (options_.thread_name + std::to_string(i)).substr(0, 15);
+                pthread_setname_np(pthread_self(), name.c_str());
+                if (reactor->cpu >= 0)
+                {
+                    cpu_set_t cpu_set;
+                    CPU_ZERO(&cpu_set);
+                    CPU_SET(reactor->cpu, &cpu_set);
+                    error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+                }
+#endif
+                if (error == 0)
+                    reactor->io_context = std::make_unique<boost::asio::io_context>(1);
+                ready->set_value(error);
+                if (error == 0)
+                    run(i, *reactor->io_context);
+            });
+    }
+
+    std::vector<int> error_group;
+    for (auto &ready : ready_group)
+    {
+        error_group.push_back(ready.get());
+    }
+
+    for (std::size_t i=0; i<error_group.size(); ++i)
+    {
+        int error = error_group[i];
+        if (error != 0)
+        {
+            stop();
+            reactor_group_.clear();
+
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(error, boost::system::generic_category(), &loc);
+
+            ErrorInfo error_info(error_code);
+            error_info.set_error_message("pin reactor thread fail");
+            error_info.add_pair("reactor", i);
+            error_info.add_pair("cpu", cpus[i % cpus.size()]);
+            return error_info;
+        }
+    }
+
+    return {};
+}
+
+void Runtime::stop()
+{
+    for (auto &reactor : reactor_group_)
+    {
+        if (reactor->io_context)
+            reactor->io_context->stop();
+    }
+    for (auto &reactor : reactor_group_)
+    {
+        if (reactor->thread.joinable())
+            reactor->thread.join();
+    }
+}
+
+std::vector<boost::asio::any_io_executor> Runtime::executors()
+{
+    std::vector<boost::asio::any_io_executor> ret;
+    ret.reserve(size());
+    for (std::size_t i=0; i<size(); ++i)
+    {
+        ret.push_back(executor(i));
+    }
+    return ret;
+}
+
+boost::asio::any_io_executor Runtime::next_executor()
+{
+    return executor(next_index_.fetch_add(1, std::memory_order_relaxed) % size());
+}
+
+int Runtime::current_index() const
+{
+    if (current_runtime != this)
+        return -1;
+    return static_cast<int>(current_reactor_index);
+}
+
+boost::asio::any_io_executor Runtime::local_executor()
+{
+    auto index = current_index();
+    if (index < 0)
+        return next_executor();
+    return executor(index);
+}
+
+std::vector<int> Runtime::numa_node_cpus(int node)
+{
+    std::vector<int> cpus;
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!std::getline(file, list))
+        return cpus;
+
+    // e.g. 0-3,8-11
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        auto dash_pos = range.find('-');
+        try
+        {
+            int first = std::stoi(range.substr(0, dash_pos));
+            int last = dash_pos == std::string::npos ? first : std::stoi(range.substr(dash_pos + 1));
+            for (int cpu=first; cpu<=last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (const std::exception &)
+        {
+            LOG(WARNING) << "bad numa node cpulist. node:" << node << " cpulist:" << list;
+            return {};
+        }
+    }
+    return cpus;
+}
+
+result<std::vector<int>> Runtime::allowed_cpus() const
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+    {
+        for (int cpu=0; cpu<CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &cpu_set))
+                cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty())
+    {
+        for (int cpu=0; cpu<static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)); ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    if (!options_.cpu_group.empty())
+    {
+        for (int cpu : options_.cpu_group)
+        {
+            if (std::find(cpus.begin(), cpus.end(), cpu) == cpus.end())
+            {
+                boost::system::error_code error_code;
+                static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+                error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+                ErrorInfo error_info(error_code);
+                error_info.set_error_message("cpu not available");
+                error_info.add_pair("cpu", cpu);
+                return error_info;
+            }
+        }
+        cpus = options_.cpu_group;
+    }
+
+    if (!options_.numa_node_group.empty())
+    {
+        std::vector<int> node_cpus;
+        for (int node : options_.numa_node_group)
+        {
+            auto cpus_of_node = numa_node_cpus(node);
+            if (cpus_of_node.empty())
+            {
+                boost::system::error_code error_code;
+                static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+                error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+                ErrorInfo error_info(error_code);
+                error_info.set_error_message("numa node not available");
+                error_info.add_pair("numa_node", node);
+                return error_info;
+            }
+            node_cpus.insert(node_cpus.end(), cpus_of_node.begin(), cpus_of_node.end());
+        }
+        std::erase_if(cpus, [&node_cpus] (int cpu) { return std::find(node_cpus.begin(), node_cpus.end(), cpu) == node_cpus.end(); });
+    }
+
+    if (cpus.empty())
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(error::parameter_error, error::conet_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.set_error_message("no cpu left by cpu_group and numa_node_group");
+        return error_info;
+    }
+
+    return {std::move(cpus)};
+}
+
+void Runtime::run(std::size_t index, boost::asio::io_context &io_context)
+{
+    current_runtime = this;
+    current_reactor_index = index;
+
+    auto work_guard = boost::asio::make_work_guard(io_context);
+    io_context.run();
+}
+
+} // namespace conet
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "result.h"
+
+namespace conet {
+
+struct RuntimeOptions
+{
+    // reactors, each an io_context run by its own thread. zero is one per allowed cpu.
+    std::size_t reactor_number = 0;
+    // reactor i is pinned to the i-th of the allowed cpus, round-robin
+    bool pin_threads = false;
+    // allowed cpus, empty is every online cpu. combined with numa_node_group by intersection.
+    std::vector<int> cpu_group;
+    // allowed NUMA nodes, empty is every node. a pinned reactor creates its io_context on its own
+    // thread, so first-touch puts the reactor's memory on the node of its cpu.
+    std::vector<int> numa_node_group;
+    // threads are named thread_name + index, at most 15 characters on linux
+    std::string thread_name = "conet";
+};
+
+// Owns N io_contexts with one thread each, a reactor per core. An object bound to a reactor's
+// executor is only touched by that thread, which is what HttpServer, ShardedMysqlClientPool and
+// the clients expect. A single io_context run by several threads does not give that guarantee.
+//     Runtime runtime;
+//     RESULT_CHECK(runtime.start());
+//     HttpServer http_server(runtime.executors());
+//     auto mysql_pools = runtime.make_per_reactor<MysqlClientPool>();
+//     TcpClient tcp_client(runtime.next_executor());
+class Runtime
+{
+public:
+    explicit Runtime(const RuntimeOptions &options = {});
+    // stop() and join the threads
+    ~Runtime();
+
+    Runtime(const Runtime &) = delete;
+    Runtime& operator=(const Runtime &) = delete;
+
+    // starts the reactors once, fails when the cpus or NUMA nodes of the options are not available
+    result<void> start();
+    // stops every io_context, handlers not yet run are dropped
+    void stop();
+
+    std::size_t size() const { return reactor_group_.size(); }
+    boost::asio::io_context& io_context(std::size_t index) { return *reactor_group_[index]->io_context; }
+    boost::asio::any_io_executor executor(std::size_t index) { return reactor_group_[index]->io_context->get_executor(); }
+    std::vector<boost::asio::any_io_executor> executors();
+    // the cpu reactor index is pinned to, -1 when not pinned
+    int cpu(std::size_t index) const { return reactor_group_[index]->cpu; }
+
+    // round-robin over the reactors, for spreading new objects
+    boost::asio::any_io_executor next_executor();
+    // the reactor the calling thread runs, -1 on a thread of no reactor of this runtime
+    int current_index() const;
+    // the executor of the calling thread's reactor, next_executor() outside of the runtime
+    boost::asio::any_io_executor local_executor();
+
+    // one T(executor, args...) per reactor, index i bound to reactor i
+    template<typename T, typename... Args>
+    std::vector<std::unique_ptr<T>> make_per_reactor(Args&&... args)
+    {
+        std::vector<std::unique_ptr<T>> ret;
+        ret.reserve(size());
+        for (std::size_t i=0; i<size(); ++i)
+        {
+            auto executor = this->executor(i);
+            ret.push_back(std::make_unique<T>(executor, args...));
+        }
+        return ret;
+    }
+
+    // cross-reactor posting, f runs on the thread of reactor index
+    template<typename F>
+    void post(std::size_t index, F &&f)
+    {
+        boost::asio::post(executor(index), std::forward<F>(f));
+    }
+
+    // runs awaitable on reactor index, the caller resumes on its own executor with the result
+    template<typename T>
+    boost::asio::awaitable<T> run_on(std::size_t index, boost::asio::awaitable<T> awaitable)
+    {
+        return boost::asio::co_spawn(executor(index), std::move(awaitable), boost::asio::use_awaitable);
+    }
+
+    // cpus listed in /sys/devices/system/node/node<node>/cpulist, empty when the node does not exist
+    static std::vector<int> numa_node_cpus(int node);
+
+private:
+    struct Reactor
+    {
+        std::unique_ptr<boost::asio::io_context> io_context;
+        std::thread thread;
+        int cpu = -1;
+    };
+
+    result<std::vector<int>> allowed_cpus() const;
+    void run(std::size_t index, boost::asio::io_context &io_context);
+
+    RuntimeOptions options_;
+    std::vector<std::unique_ptr<Reactor>> reactor_group_;
+    std::atomic_size_t next_index_;
+};
+
+} // namespace conet
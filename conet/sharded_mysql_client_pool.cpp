@@ -0,0 +1,214 @@
+#include "sharded_mysql_client_pool.h"
+
+#include <algorithm>
+
+namespace conet {
+
+ShardedMysqlClientPool::ShardedMysqlClientPool(const std::vector<boost::asio::any_io_executor> &executors) :
+    next_shard_index_(0),
+    steal_number_(0),
+    local_reuse_number_(0)
+{
+    for (const auto &executor : executors)
+    {
+        auto shard = std::make_shared<Shard>();
+        shard->pool = std::make_unique<MysqlClientPool>(executor);
+        shard_group_.push_back(std::move(shard));
+    }
+}
+
+void ShardedMysqlClientPool::set_options(const MysqlClientPoolOptions &options)
+{
+    for (auto &shard : shard_group_)
+    {
+        shard->pool->set_options(options);
+    }
+}
+
+boost::asio::awaitable<result<void>> ShardedMysqlClientPool::init(
+        const std::string& host,
+        unsigned int port,
+        const std::string& user,
+        const std::string& password,
+        const std::string& database,
+        int init_number_per_shard,
+        int limit_max_number_per_shard)
+{
+    for (std::size_t i=0; i<shard_group_.size(); ++i)
+    {
+        auto &pool = *shard_group_[i]->pool;
+        shard_group_[i]->is_closed = false;
+
+        // run on the shard's own thread, the shard is not thread safe
+        RESULT_CO_CHECK(co_await boost::asio::co_spawn(pool.get_executor(),
+            pool.init(host, port, user, password, database, init_number_per_shard, limit_max_number_per_shard),
+            boost::asio::use_awaitable),
+            r.error_info().add_pair("shard", i));
+    }
+
+    co_return RESULT_SUCCESS;
+}
+
+boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> ShardedMysqlClientPool::get()
+{
+    auto executor = co_await boost::asio::this_coro::executor;
+    auto local_index = local_shard_index(executor);
+
+    if (!has_capacity(*shard_group_[local_index]))
+    {
+        // only read atomics of other shards, steal from the first one having idle connections
+        for (std::size_t i=1; i<shard_group_.size(); ++i)
+        {
+            auto index = (local_index + i) % shard_group_.size();
+            if (idle_number(*shard_group_[index]) > 0)
+            {
+                ++steal_number_;
+                co_return co_await get_from(index, executor);
+            }
+        }
+    }
+
+    // local shard, waits in its queue if it is full
+    co_return co_await get_from(local_index, executor);
+}
+
+void ShardedMysqlClientPool::close()
+{
+    for (auto &shard : shard_group_)
+    {
+        shard->is_closed = true;
+        shard->pool->close();
+
+        // the pool is closed, the dropped connections are closed too
+        boost::asio::dispatch(shard->pool->get_executor(), [shard] ()
+            {
+                shard->free_client_group.clear();
+                shard->free_number = 0;
+            });
+    }
+}
+
+MysqlClientPoolStats ShardedMysqlClientPool::stats() const
+{
+    MysqlClientPoolStats stats{};
+    for (const auto &shard : shard_group_)
+    {
+        auto shard_stats = shard->pool->stats();
+        // checked out from the pool but free
+        int free_number = std::min(shard->free_number.load(), shard_stats.active_number);
+        stats.current_number += shard_stats.current_number;
+        stats.connecting_number += shard_stats.connecting_number;
+        stats.idle_number += shard_stats.idle_number + free_number;
+        stats.active_number += shard_stats.active_number - free_number;
+        stats.waiting_number += shard_stats.waiting_number;
+        stats.created_number += shard_stats.created_number;
+        stats.closed_number += shard_stats.closed_number;
+        stats.broken_number += shard_stats.broken_number;
+        stats.evicted_number += shard_stats.evicted_number;
+        stats.acquire_timeout_number += shard_stats.acquire_timeout_number;
+    }
+    return stats;
+}
+
+std::size_t ShardedMysqlClientPool::local_shard_index(const boost::asio::any_io_executor &executor)
+{
+    auto &context = boost::asio::query(executor, boost::asio::execution::context);
+    for (std::size_t i=0; i<shard_group_.size(); ++i)
+    {
+        if (&boost::asio::query(shard_group_[i]->pool->get_executor(), boost::asio::execution::context) == &context)
+            return i;
+    }
+
+    // caller is not running on any shard, spread them
+    return next_shard_index_++ % shard_group_.size();
+}
+
+bool ShardedMysqlClientPool::has_capacity(const Shard &shard) const
+{
+    return idle_number(shard) > 0 || shard.pool->stats().current_number < shard.pool->limit_max_number();
+}
+
+int ShardedMysqlClientPool::idle_number(const Shard &shard) const
+{
+    return shard.free_number + shard.pool->stats().idle_number;
+}
+
+boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> ShardedMysqlClientPool::get_from(std::size_t index, const boost::asio::any_io_executor &executor)
+{
+    auto shard = shard_group_[index];
+    auto shard_executor = shard->pool->get_executor();
+
+    if (&boost::asio::query(shard_executor, boost::asio::execution::context) == &boost::asio::query(executor, boost::asio::execution::context))
+    {
+        co_return co_await checkout(std::move(shard));
+    }
+
+    // cross thread, run the checkout on the owner of the shard
+    co_return co_await boost::asio::co_spawn(shard_executor, checkout(std::move(shard)), boost::asio::use_awaitable);
+}
+
+boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> ShardedMysqlClientPool::checkout(std::shared_ptr<Shard> shard)
+{
+    if (auto mysql_client = take_free(*shard))
+    {
+        ++local_reuse_number_;
+        co_return wrap(std::move(shard), std::move(mysql_client));
+    }
+
+    RESULT_CO_AUTO(mysql_client, co_await shard->pool->get());
+    co_return wrap(std::move(shard), std::move(mysql_client));
+}
+
+std::shared_ptr<MysqlClient> ShardedMysqlClientPool::take_free(Shard &shard)
+{
+    trim_free(shard);
+    if (shard.free_client_group.empty())
+        return nullptr;
+
+    // most recently released first, like the pool
+    auto mysql_client = std::move(shard.free_client_group.back().mysql_client);
+    shard.free_client_group.pop_back();
+    shard.free_number = static_cast<int>(shard.free_client_group.size());
+    return mysql_client;
+}
+
+std::shared_ptr<MysqlClient> ShardedMysqlClientPool::wrap(std::shared_ptr<Shard> shard, std::shared_ptr<MysqlClient> &&mysql_client)
+{
+    auto raw_p = mysql_client.get();
+    return std::shared_ptr<MysqlClient>(raw_p, [shard = std::move(shard), mysql_client = std::move(mysql_client)] (MysqlClient *) mutable
+    {
+        // runs inline when released on the thread of the shard
+        auto executor = shard->pool->get_executor();
+        boost::asio::dispatch(executor, [shard = std::move(shard), mysql_client = std::move(mysql_client)] () mutable
+            {
+                put_free(*shard, std::move(mysql_client));
+            });
+    });
+}
+
+void ShardedMysqlClientPool::put_free(Shard &shard, std::shared_ptr<MysqlClient> &&mysql_client)
+{
+    // dropping it returns it to the pool, which closes it when the pool is closed or it is broken
+    if (shard.is_closed || mysql_client->is_broken() ||
+        static_cast<int>(shard.free_client_group.size()) >= shard.pool->options().max_idle_number)
+        return;
+
+    shard.free_client_group.push_back({std::move(mysql_client), std::chrono::steady_clock::now()});
+    trim_free(shard);
+    shard.free_number = static_cast<int>(shard.free_client_group.size());
+}
+
+void ShardedMysqlClientPool::trim_free(Shard &shard)
+{
+    // the pool pings and evicts idle connections, give it back the ones free for too long
+    auto now = std::chrono::steady_clock::now();
+    auto validation_interval = shard.pool->options().validation_interval;
+    auto it = std::find_if(shard.free_client_group.begin(), shard.free_client_group.end(), [now, validation_interval] (const FreeClient &free_client)
+        {
+            return now - free_client.released_at < validation_interval;
+        });
+    shard.free_client_group.erase(shard.free_client_group.begin(), it);
+    shard.free_number = static_cast<int>(shard.free_client_group.size());
+}
+
+} // namespace conet
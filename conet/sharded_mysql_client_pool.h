@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include "mysql_client_pool.h"
+
+namespace conet {
+
+// One MysqlClientPool per executor. Each executor is expected to be run by a single thread
+// (e.g. one io_context per thread), so a shard is only touched by its own thread.
+// get() takes a connection from the shard of the calling executor and only steals
+// from another shard when the local one has no idle connection and no free slot.
+// Connections always return to the shard they were created by. A shard keeps the connections
+// released on its thread in a free list of its own, a get() on that thread takes them back without
+// going through the strand of the MysqlClientPool.
+class ShardedMysqlClientPool
+{
+public:
+    ShardedMysqlClientPool(const std::vector<boost::asio::any_io_executor> &executors);
+    // closes without waiting, like MysqlClientPool
+    ~ShardedMysqlClientPool() { close(); }
+
+    ShardedMysqlClientPool(const ShardedMysqlClientPool &) = delete;
+    ShardedMysqlClientPool& operator=(const ShardedMysqlClientPool &) = delete;
+
+    void set_options(const MysqlClientPoolOptions &options);
+
+    boost::asio::awaitable<result<void>> init(
+        const std::string& host,
+        unsigned int port,
+        const std::string& user,
+        const std::string& password,
+        const std::string& database,
+        int init_number_per_shard,
+        int limit_max_number_per_shard);
+
+    boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> get();
+
+    void close();
+
+    std::size_t shard_count() const { return shard_group_.size(); }
+    MysqlClientPool& shard(std::size_t index) { return *shard_group_[index]->pool; }
+    // sum of all shards, the connections in the free lists are counted as idle
+    MysqlClientPoolStats stats() const;
+    std::uint64_t steal_number() const { return steal_number_; }
+    // get() served from the free list of a shard
+    std::uint64_t local_reuse_number() const { return local_reuse_number_; }
+
+private:
+    struct FreeClient
+    {
+        std::shared_ptr<MysqlClient> mysql_client;
+        std::chrono::steady_clock::time_point released_at;
+    };
+
+    struct Shard
+    {
+        std::unique_ptr<MysqlClientPool> pool;
+        // only touched on the thread of the shard
+        std::vector<FreeClient> free_client_group;
+        // size of free_client_group, read by the other threads
+        std::atomic_int free_number{0};
+        std::atomic_bool is_closed{false};
+    };
+
+    std::size_t local_shard_index(const boost::asio::any_io_executor &executor);
+    bool has_capacity(const Shard &shard) const;
+    int idle_number(const Shard &shard) const;
+    boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> get_from(std::size_t index, const boost::asio::any_io_executor &executor);
+    // on the thread of the shard
+    boost::asio::awaitable<result<std::shared_ptr<MysqlClient>>> checkout(std::shared_ptr<Shard> shard);
+    std::shared_ptr<MysqlClient> take_free(Shard &shard);
+    // released connections go back to the free list on the thread of the shard
+    static std::shared_ptr<MysqlClient> wrap(std::shared_ptr<Shard> shard, std::shared_ptr<MysqlClient> &&mysql_client);
+    static void put_free(Shard &shard, std::shared_ptr<MysqlClient> &&mysql_client);
+    // drops the free connections which should be validated by the pool
+    static void trim_free(Shard &shard);
+
+    std::vector<std::shared_ptr<Shard>> shard_group_;
+    std::atomic_size_t next_shard_index_;
+    std::atomic_uint64_t steal_number_;
+    std::atomic_uint64_t local_reuse_number_;
+};
+
+} // namespace conet
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "result.h"
+
+namespace conet {
+
+// Coalesces concurrent loads of the same key, the first caller loads and the others wait for its
+// result. It shares the mutex of the cache using it, so a cache lookup and joining a flight are one
+// step, and finish() can fill the cache before the flight is gone.
+//     bool is_leader = false;
+//     {
+//         std::lock_guard<std::mutex> lock(mutex_);
+//         ... return a cached value ...
+//         flight = single_flight_.join(key, is_leader);
+//     }
+//     if (!is_leader)
+//         co_return co_await single_flight_.wait(std::move(flight));
+//     SingleFlight<T>::Leader leader(single_flight_, key, flight);
+//     auto r = co_await load();
+//     leader.finish(r, [&] (auto &state) { ... insert r ... });
+template<typename T, typename State = std::monostate>
+class SingleFlight
+{
+public:
+    struct Flight
+    {
+        // data of the cache about the load, guarded by the mutex
+        State state;
+        std::vector<std::function<void(result<T>)>> waiter_group;
+        std::optional<result<T>> finished_result;
+    };
+    using FlightPtr = std::shared_ptr<Flight>;
+
+    // Held by the leader across its load. A leader coroutine destroyed before the load returns, its
+    // io_context stopped, or a load that throws, fails the waiters with operation_aborted instead of
+    // leaving them and every later join() of the key on a flight nobody finishes.
+    class Leader
+    {
+    public:
+        Leader(SingleFlight &single_flight, std::string key, FlightPtr flight) :
+            single_flight_(single_flight),
+            key_(std::move(key)),
+            flight_(std::move(flight))
+        {
+        }
+
+        Leader(const Leader &) = delete;
+        Leader& operator=(const Leader &) = delete;
+
+        ~Leader()
+        {
+            if (flight_)
+                single_flight_.finish(key_, flight_, aborted());
+        }
+
+        template<typename F>
+        void finish(const result<T> &r, F &&under_lock)
+        {
+            auto flight = std::move(flight_);
+            single_flight_.finish(key_, flight, r, std::forward<F>(under_lock));
+        }
+
+        void finish(const result<T> &r)
+        {
+            finish(r, [] (State &) {});
+        }
+
+    private:
+        static result<T> aborted()
+        {
+            boost::system::error_code error_code;
+            static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+            error_code.assign(boost::asio::error::operation_aborted, boost::asio::error::get_system_category(), &loc);
+
+            ErrorInfo error_info(error_code);
+            error_info.set_error_message("the leading load was abandoned");
+            return error_info;
+        }
+
+        SingleFlight &single_flight_;
+        std::string key_;
+        FlightPtr flight_;
+    };
+
+    explicit SingleFlight(std::mutex &mutex) :
+        mutex_(mutex)
+    {
+    }
+
+    SingleFlight(const SingleFlight &) = delete;
+    SingleFlight& operator=(const SingleFlight &) = delete;
+
+    // with the mutex held. the caller is the leader when it started the flight, it finishes it through a Leader.
+    FlightPtr join(const std::string &key, bool &is_leader)
+    {
+        auto &flight = flight_group_[key];
+        is_leader = !flight;
+        if (is_leader)
+            flight = std::make_shared<Flight>();
+        return flight;
+    }
+
+    // with the mutex held
+    template<typename F>
+    void for_each_state(F &&f)
+    {
+        for (auto &p : flight_group_)
+        {
+            f(p.second->state);
+        }
+    }
+
+    // the result of the leader, resumed on the executor of the caller
+    boost::asio::awaitable<result<T>> wait(FlightPtr flight)
+    {
+        return boost::asio::async_initiate<const boost::asio::use_awaitable_t<>, void(result<T>)>(
+            [this, flight]<typename H> (H&& self) mutable
+            {
+                auto handler_ptr = make_recycling_shared<H>(std::forward<H>(self));
+                std::function<void(result<T>)> callback = [handler_ptr] (result<T> r) mutable
+                {
+                    auto executor = boost::asio::get_associated_executor(*handler_ptr);
+                    boost::asio::dispatch(executor, [handler_ptr, r = std::move(r)] () mutable
+                    {
+                        auto&& handler = std::move(*handler_ptr.get());
+                        handler(std::move(r));
+                    });
+                };
+
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (flight->finished_result)
+                {
+                    auto r = *flight->finished_result;
+                    lock.unlock();
+                    callback(std::move(r));
+                    return;
+                }
+                flight->waiter_group.push_back(std::move(callback));
+            },
+            boost::asio::use_awaitable);
+    }
+
+private:
+    // ends the flight and wakes the waiters with r. under_lock(state) runs with the mutex held, a
+    // caller looking up the cache next either finds the flight or what under_lock stored.
+    template<typename F>
+    void finish(const std::string &key, const FlightPtr &flight, const result<T> &r, F &&under_lock)
+    {
+        std::vector<std::function<void(result<T>)>> waiter_group;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flight->finished_result.emplace(r);
+            waiter_group = std::move(flight->waiter_group);
+            flight_group_.erase(key);
+            under_lock(flight->state);
+        }
+
+        for (auto &callback : waiter_group)
+        {
+            callback(r);
+        }
+    }
+
+    void finish(const std::string &key, const FlightPtr &flight, const result<T> &r)
+    {
+        finish(key, flight, r, [] (State &) {});
+    }
+
+    std::mutex &mutex_;
+    std::unordered_map<std::string, FlightPtr> flight_group_;
+};
+
+} // namespace conet
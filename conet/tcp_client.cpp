@@ -2,24 +2,47 @@
 
 #include <regex>
 #include <glog/logging.h>
+#include "metrics.h"
+#include "trace.h"
 #include "url_parser.h"
 
 namespace conet {
 
+namespace {
+
+struct TcpClientMetrics
+{
+    Counter &read_bytes = MetricsRegistry::global().counter("conet_tcp_read_bytes_total", "bytes read by TcpClient");
+    Counter &read_number = MetricsRegistry::global().counter("conet_tcp_reads_total", "completed TcpClient reads");
+    Counter &write_bytes = MetricsRegistry::global().counter("conet_tcp_write_bytes_total", "bytes written by TcpClient");
+    Counter &write_number = MetricsRegistry::global().counter("conet_tcp_writes_total", "completed TcpClient writes");
+};
+
+TcpClientMetrics& tcp_client_metrics()
+{
+    static TcpClientMetrics metrics;
+    return metrics;
+}
+
+} // namespace
+
 TcpClient::TcpClient(boost::asio::io_context& io_context) :
-    socket_(io_context)
+    socket_(io_context),
+    dns_cache_(&DnsCache::global())
 {
 
 }
 
 TcpClient::TcpClient(boost::asio::any_io_executor executor) :
-    socket_(executor)
+    socket_(executor),
+    dns_cache_(&DnsCache::global())
 {
 
 }
 
 TcpClient::TcpClient(boost::asio::ip::tcp::socket socket) :
-    socket_(std::move(socket))
+    socket_(std::move(socket)),
+    dns_cache_(&DnsCache::global())
 {
 
 }
@@ -29,21 +52,12 @@ boost::asio::awaitable<result<void>> TcpClient::connect(const std::string &url)
     UrlParser url_parser;
     RESULT_CO_CHECK(url_parser.parse(url));
 
-    boost::asio::ip::tcp::resolver::results_type ret_results;
-	boost::asio::ip::tcp::resolver::query query(url_parser.host(), url_parser.service(), boost::asio::ip::resolver_query_base::numeric_service);
+    std::string host(url_parser.host());
+    std::string service(url_parser.service());
+    RESULT_CO_AUTO(endpoints, co_await dns_cache_->resolve(host, service));
 
     boost::system::error_code ec;
-	boost::asio::ip::tcp::resolver resolver(socket_.get_executor());
-	boost::asio::ip::tcp::resolver::results_type results = co_await resolver.async_resolve(query, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
-    if (ec)
-    {
-        boost::system::error_code error_code;
-        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
-        error_code.assign(ec.value(), ec.category(), &loc);
-        co_return error_code;
-    }
-
-    boost::asio::ip::tcp::endpoint endpoint = co_await boost::asio::async_connect(socket_, results, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    boost::asio::ip::tcp::endpoint endpoint = co_await boost::asio::async_connect(socket_, endpoints, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
     if (ec)
     {
         boost::system::error_code error_code;
@@ -83,8 +97,11 @@ result<void> TcpClient::disconnect()
 
 boost::asio::awaitable<result<void>> TcpClient::write(std::vector<char> &&data)
 {
+    TraceSpan span("TcpClient::write");
     boost::system::error_code ec;
+    span.suspend();
     std::size_t bytes_transferred = co_await boost::asio::async_write(socket_, boost::asio::buffer(data), boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    span.resume();
     if (ec)
     {
         boost::system::error_code error_code;
@@ -104,13 +121,20 @@ boost::asio::awaitable<result<void>> TcpClient::write(std::vector<char> &&data)
         co_return error_code;
     }
 
+    auto &metrics = tcp_client_metrics();
+    metrics.write_bytes.add(bytes_transferred);
+    metrics.write_number.add();
+
     co_return RESULT_SUCCESS;
 }
 
 boost::asio::awaitable<result<void>> TcpClient::read(std::vector<char> &read_buffer)
 {
+    TraceSpan span("TcpClient::read");
     boost::system::error_code ec;
+    span.suspend();
     std::size_t bytes_transferred = co_await boost::asio::async_read(socket_, boost::asio::buffer(read_buffer), boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    span.resume();
     if (ec == boost::asio::error::eof)
     {
         // tcp closed
@@ -153,6 +177,10 @@ boost::asio::awaitable<result<void>> TcpClient::read(std::vector<char> &read_buf
         co_return error_code;
     }
 
+    auto &metrics = tcp_client_metrics();
+    metrics.read_bytes.add(bytes_transferred);
+    metrics.read_number.add();
+
     co_return RESULT_SUCCESS;
 }
 
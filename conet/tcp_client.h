@@ -5,6 +5,7 @@
 
 #include "error.h"
 #include "result.h"
+#include "dns_cache.h"
 
 namespace conet {
 
@@ -20,14 +21,18 @@ public:
     TcpClient& operator=(const TcpClient &) = delete;
     TcpClient& operator=(TcpClient &&) = default;
 
+    // resolves through DnsCache::global() unless another cache is set
+    void set_dns_cache(DnsCache &dns_cache) { dns_cache_ = &dns_cache; }
     boost::asio::awaitable<result<void>> connect(const std::string &url);
     result<void> disconnect();
     boost::asio::awaitable<result<void>> read(std::vector<char> &read_buffer);
     boost::asio::awaitable<result<void>> write(std::vector<char> &&data);
     boost::asio::any_io_executor get_executor();
+    boost::asio::ip::tcp::socket& socket() { return socket_; }
 
 private:
 	boost::asio::ip::tcp::socket socket_;
+    DnsCache *dns_cache_;
 };
 
 } // namespace conet
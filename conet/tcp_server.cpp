@@ -98,4 +98,35 @@ boost::asio::awaitable<TcpServer::AcceptResultType> TcpServer::accept()
     co_return std::move(socket);
 }
 
+boost::asio::awaitable<TcpServer::AcceptResultType> TcpServer::accept(boost::asio::any_io_executor executor)
+{
+    boost::system::error_code ec;
+    boost::asio::ip::tcp::socket socket = co_await acceptor_.async_accept(executor, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+
+    if (ec)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(ec.value(), ec.category(), &loc);
+        co_return error_code;
+    }
+
+    co_return std::move(socket);
+}
+
+result<boost::asio::ip::tcp::endpoint> TcpServer::local_endpoint() const
+{
+    boost::system::error_code ec;
+    auto endpoint = acceptor_.local_endpoint(ec);
+    if (ec)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(ec.value(), ec.category(), &loc);
+        return error_code;
+    }
+
+    return endpoint;
+}
+
 } // conet
@@ -25,6 +25,10 @@ public:
     result<void> listen(const std::string &ip, short port);
     result<void> close();
     boost::asio::awaitable<AcceptResultType> accept();
+    // the accepted connection runs on executor instead of the one of the server
+    boost::asio::awaitable<AcceptResultType> accept(boost::asio::any_io_executor executor);
+    // the bound port when listen() was called with port 0
+    result<boost::asio::ip::tcp::endpoint> local_endpoint() const;
 
 private:
     boost::asio::ip::tcp::acceptor acceptor_;
@@ -0,0 +1,276 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#include "error.h"
+
+namespace conet {
+
+static thread_local TraceContext current_context;
+
+// unique without a shared counter: the thread number in the high bits
+static std::uint64_t next_id()
+{
+    static std::atomic_uint64_t thread_number{0};
+    thread_local std::uint64_t base = (thread_number.fetch_add(1, std::memory_order_relaxed) + 1) << 32;
+    thread_local std::uint64_t number = 0;
+    return base | ++number;
+}
+
+static std::int64_t now_nanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Tracer::~Tracer()
+{
+    disable();
+}
+
+Tracer& Tracer::global()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+TraceContext Tracer::current()
+{
+    return current_context;
+}
+
+void Tracer::enable(const TraceOptions &options)
+{
+    options_ = options;
+    is_enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::disable()
+{
+    is_enabled_.store(false, std::memory_order_relaxed);
+}
+
+TraceContext Tracer::sample()
+{
+    if (!is_enabled())
+        return {};
+    if (options_.sample_every > 1 && sample_number_.fetch_add(1, std::memory_order_relaxed) % options_.sample_every != 0)
+        return {};
+
+    TraceContext context;
+    context.trace_id = next_id();
+    return context;
+}
+
+Tracer::Ring& Tracer::ring()
+{
+    thread_local std::shared_ptr<Ring> thread_ring;
+    if (thread_ring == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        thread_ring = std::make_shared<Ring>(std::max<std::size_t>(options_.ring_size, 1), ++thread_number_);
+        rings_.push_back(thread_ring);
+    }
+    return *thread_ring;
+}
+
+void Tracer::record(TraceEventType type, const char *name, const TraceContext &context, std::uint64_t parent_span_id)
+{
+    auto &ring = this->ring();
+    auto &slot = ring.slots[ring.head++ % ring.slots.size()];
+
+    auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.type.store(type, std::memory_order_relaxed);
+    slot.timestamp.store(now_nanoseconds(), std::memory_order_relaxed);
+    slot.trace_id.store(context.trace_id, std::memory_order_relaxed);
+    slot.span_id.store(context.span_id, std::memory_order_relaxed);
+    slot.parent_span_id.store(parent_span_id, std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+namespace {
+
+struct TraceEvent
+{
+    const char *name;
+    TraceEventType type;
+    std::int64_t timestamp;
+    std::uint64_t trace_id;
+    std::uint64_t span_id;
+    std::uint64_t parent_span_id;
+    std::uint32_t thread_index;
+};
+
+void append_json_string(std::string &out, const char *value)
+{
+    out.push_back('"');
+    for (; *value != '\0'; ++value)
+    {
+        char c = *value;
+        if (c == '"' || c == '\\')
+        {
+            out.push_back('\\');
+            out.push_back(c);
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            out += buffer;
+        }
+        else
+        {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+} // namespace
+
+std::string Tracer::chrome_trace() const
+{
+    std::vector<TraceEvent> events;
+    auto cleared_at = cleared_at_.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &ring : rings_)
+        {
+            for (const auto &slot : ring->slots)
+            {
+                auto sequence = slot.sequence.load(std::memory_order_acquire);
+                if (sequence == 0 || sequence % 2 != 0)
+                    continue;
+
+                TraceEvent event;
+                event.name = slot.name.load(std::memory_order_relaxed);
+                event.type = slot.type.load(std::memory_order_relaxed);
+                event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+                event.trace_id = slot.trace_id.load(std::memory_order_relaxed);
+                event.span_id = slot.span_id.load(std::memory_order_relaxed);
+                event.parent_span_id = slot.parent_span_id.load(std::memory_order_relaxed);
+                event.thread_index = ring->thread_index;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                // overwritten while being read
+                if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+                    continue;
+                if (event.timestamp < cleared_at)
+                    continue;
+                events.push_back(event);
+            }
+        }
+    }
+    std::sort(events.begin(), events.end(), [] (const TraceEvent &a, const TraceEvent &b) { return a.timestamp < b.timestamp; });
+
+    std::string out = "{\"traceEvents\":[";
+    char buffer[256];
+    for (std::size_t i=0; i<events.size(); ++i)
+    {
+        const auto &event = events[i];
+        if (i > 0)
+            out.push_back(',');
+
+        const char *phase = "n";
+        if (event.type == TraceEventType::begin)
+            phase = "b";
+        else if (event.type == TraceEventType::end)
+            phase = "e";
+
+        // suspend and resume are instant events on the track of the trace, named after the event
+        out += "{\"name\":";
+        if (event.type == TraceEventType::suspend)
+            out += "\"suspend\"";
+        else if (event.type == TraceEventType::resume)
+            out += "\"resume\"";
+        else
+            append_json_string(out, event.name);
+
+        std::snprintf(buffer, sizeof(buffer),
+            ",\"cat\":\"conet\",\"ph\":\"%s\",\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"span_id\":%llu,\"parent_span_id\":%llu",
+            phase,
+            static_cast<unsigned long long>(event.trace_id),
+            event.timestamp / 1000.0,
+            event.thread_index,
+            static_cast<unsigned long long>(event.span_id),
+            static_cast<unsigned long long>(event.parent_span_id));
+        out += buffer;
+        if (event.type == TraceEventType::suspend || event.type == TraceEventType::resume)
+        {
+            out += ",\"span\":";
+            append_json_string(out, event.name);
+        }
+        out += "}}";
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+}
+
+result<void> Tracer::dump(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (file)
+        file << chrome_trace();
+    if (!file)
+    {
+        boost::system::error_code error_code;
+        static constexpr boost::source_location loc = BOOST_CURRENT_LOCATION;
+        error_code.assign(errno, boost::system::generic_category(), &loc);
+
+        ErrorInfo error_info(error_code);
+        error_info.add_pair("path", path);
+        return error_info;
+    }
+
+    return {};
+}
+
+void Tracer::clear()
+{
+    cleared_at_.store(now_nanoseconds(), std::memory_order_relaxed);
+
+    // rings of exited threads are not written anymore
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::erase_if(rings_, [] (const std::shared_ptr<Ring> &ring) { return ring.use_count() == 1; });
+}
+
+void TraceSpan::begin(const char *name, const TraceContext &parent)
+{
+    if (!parent)
+        return;
+
+    name_ = name;
+    context_.trace_id = parent.trace_id;
+    context_.span_id = next_id();
+    parent_span_id_ = parent.span_id;
+    previous_ = current_context;
+    current_context = context_;
+    Tracer::global().record(TraceEventType::begin, name_, context_, parent_span_id_);
+}
+
+void TraceSpan::end()
+{
+    Tracer::global().record(TraceEventType::end, name_, context_, parent_span_id_);
+    current_context = previous_;
+}
+
+void TraceSpan::record_suspend()
+{
+    Tracer::global().record(TraceEventType::suspend, name_, context_, parent_span_id_);
+    // the thread goes back to the io_context, the coroutines it runs meanwhile are not children
+    current_context = {};
+}
+
+void TraceSpan::record_resume()
+{
+    // possibly on another thread of the io_context
+    current_context = context_;
+    Tracer::global().record(TraceEventType::resume, name_, context_, parent_span_id_);
+}
+
+} // namespace conet
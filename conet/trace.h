@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "result.h"
+
+namespace conet {
+
+struct TraceOptions
+{
+    // events kept per thread, the oldest are overwritten
+    std::size_t ring_size = 16384;
+    // one in sample_every Tracer::sample() calls starts a trace
+    std::uint32_t sample_every = 1;
+};
+
+// Identifies a span. Copy it into a co_spawn'ed coroutine to continue the trace there.
+struct TraceContext
+{
+    std::uint64_t trace_id = 0;
+    std::uint64_t span_id = 0;
+
+    explicit operator bool() const { return trace_id != 0; }
+};
+
+enum class TraceEventType : std::uint8_t
+{
+    begin,
+    end,
+    suspend,
+    resume,
+};
+
+// Records span events into per-thread rings and dumps them as Chrome trace JSON, which
+// chrome://tracing and Perfetto open. Each trace is an async track, its spans nest on it.
+class Tracer
+{
+public:
+    ~Tracer();
+
+    Tracer(const Tracer &) = delete;
+    Tracer& operator=(const Tracer &) = delete;
+
+    static Tracer& global();
+
+    static bool is_enabled() { return is_enabled_.load(std::memory_order_relaxed); }
+    // the span running on the calling thread
+    static TraceContext current();
+
+    // options are read without a lock, change them while disabled
+    void enable(const TraceOptions &options = {});
+    void disable();
+    const TraceOptions& options() const { return options_; }
+
+    // a new root context for a request when tracing is enabled and the request is sampled
+    TraceContext sample();
+
+    // the events still in the rings, oldest first
+    std::string chrome_trace() const;
+    result<void> dump(const std::string &path) const;
+    // drops the recorded events
+    void clear();
+
+private:
+    friend class TraceSpan;
+
+    Tracer() = default;
+
+    // a seqlock lets chrome_trace() read slots the owning thread may be overwriting
+    struct Slot
+    {
+        std::atomic_uint64_t sequence{0};
+        std::atomic<const char *> name{nullptr};
+        std::atomic<TraceEventType> type{TraceEventType::begin};
+        std::atomic_int64_t timestamp{0};
+        std::atomic_uint64_t trace_id{0};
+        std::atomic_uint64_t span_id{0};
+        std::atomic_uint64_t parent_span_id{0};
+    };
+
+    struct Ring
+    {
+        Ring(std::size_t size, std::uint32_t thread_index) : slots(size), thread_index(thread_index) {}
+
+        std::vector<Slot> slots;
+        std::uint32_t thread_index;
+        // written by the owning thread only
+        std::uint64_t head = 0;
+    };
+
+    // the ring of the calling thread, registered on first use
+    Ring& ring();
+    void record(TraceEventType type, const char *name, const TraceContext &context, std::uint64_t parent_span_id);
+
+    static inline std::atomic_bool is_enabled_{false};
+    TraceOptions options_;
+    std::atomic_uint64_t sample_number_{0};
+    // events before it were dropped by clear()
+    std::atomic_int64_t cleared_at_{0};
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Ring>> rings_;
+    std::uint32_t thread_number_ = 0;
+};
+
+// A span from construction to destruction. Without an explicit parent it is a child of the span
+// running on the calling thread, and inactive when there is none, so only sampled requests record.
+// While tracing is disabled every call costs one branch.
+// A coroutine calls suspend() and resume() around co_await of anything not traced itself, so the
+// coroutines running in between are not taken as its children.
+//     TraceSpan span("TcpClient::read");
+//     span.suspend();
+//     co_await boost::asio::async_read(...);
+//     span.resume();
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name)
+    {
+        if (Tracer::is_enabled()) [[unlikely]]
+            begin(name, Tracer::current());
+    }
+
+    // parent is the context of a span in another coroutine, or a root from Tracer::sample()
+    TraceSpan(const char *name, const TraceContext &parent)
+    {
+        if (Tracer::is_enabled() && parent) [[unlikely]]
+            begin(name, parent);
+    }
+
+    ~TraceSpan()
+    {
+        if (context_) [[unlikely]]
+            end();
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan& operator=(const TraceSpan &) = delete;
+
+    void suspend()
+    {
+        if (context_) [[unlikely]]
+            record_suspend();
+    }
+
+    void resume()
+    {
+        if (context_) [[unlikely]]
+            record_resume();
+    }
+
+    // empty when the span is inactive
+    const TraceContext& context() const { return context_; }
+
+private:
+    void begin(const char *name, const TraceContext &parent);
+    void end();
+    void record_suspend();
+    void record_resume();
+
+    const char *name_ = nullptr;
+    TraceContext context_;
+    TraceContext previous_;
+    std::uint64_t parent_span_id_ = 0;
+};
+
+} // namespace conet
@@ -1,27 +1,131 @@
 #pragma once
 
-#include <string>
+#include <string_view>
 
 #include "result.h"
 
 namespace conet {
 
+// [protocol://][userinfo@]host[:port][/path][?query][#fragment], host may be a bracketed IPv6 literal.
+// The components are views into the parsed url, which has to outlive them.
 class UrlParser
 {
 public:
-    result<void> parse(const std::string &url);
+    result<void> parse(std::string_view url);
+    // parse() without the error, usable in constant expressions
+    constexpr bool try_parse(std::string_view url) noexcept;
 
-    std::string protocol() const noexcept { return protocol_; }
-    std::string host() const noexcept { return host_; }
-    std::string port() const noexcept { return port_; }
-    std::string path() const noexcept;
-    std::string service() const noexcept;
+    constexpr std::string_view protocol() const noexcept { return protocol_; }
+    constexpr std::string_view userinfo() const noexcept { return userinfo_; }
+    // without the brackets of an IPv6 literal
+    constexpr std::string_view host() const noexcept { return host_; }
+    constexpr std::string_view port() const noexcept { return port_; }
+    // the request target, path and query, "/" when both are empty
+    constexpr std::string_view path() const noexcept { return path_.empty() ? "/" : path_; }
+    constexpr std::string_view query() const noexcept { return query_; }
+    constexpr std::string_view fragment() const noexcept { return fragment_; }
+    constexpr std::string_view service() const noexcept;
 
 private:
-    std::string protocol_;
-    std::string host_;
-    std::string port_;
-    std::string path_;
+    static constexpr bool is_word(char c) noexcept
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    static constexpr bool is_digits(std::string_view s) noexcept
+    {
+        for (char c : s)
+        {
+            if (c < '0' || c > '9')
+                return false;
+        }
+        return true;
+    }
+
+    std::string_view protocol_;
+    std::string_view userinfo_;
+    std::string_view host_;
+    std::string_view port_;
+    std::string_view path_;
+    std::string_view query_;
+    std::string_view fragment_;
 };
 
+constexpr bool UrlParser::try_parse(std::string_view url) noexcept
+{
+    *this = UrlParser();
+
+    std::size_t pos = 0;
+    while (pos < url.size() && is_word(url[pos]))
+    {
+        ++pos;
+    }
+    if (pos > 0 && url.substr(pos, 3) == "://")
+    {
+        protocol_ = url.substr(0, pos);
+        url.remove_prefix(pos + 3);
+    }
+
+    auto fragment_pos = url.find('#');
+    if (fragment_pos != std::string_view::npos)
+    {
+        fragment_ = url.substr(fragment_pos + 1);
+        url = url.substr(0, fragment_pos);
+    }
+
+    auto path_pos = url.find_first_of("/?");
+    auto authority = url.substr(0, path_pos);
+    if (path_pos != std::string_view::npos)
+    {
+        path_ = url.substr(path_pos);
+        auto query_pos = path_.find('?');
+        if (query_pos != std::string_view::npos)
+            query_ = path_.substr(query_pos + 1);
+    }
+
+    auto userinfo_pos = authority.rfind('@');
+    if (userinfo_pos != std::string_view::npos)
+    {
+        userinfo_ = authority.substr(0, userinfo_pos);
+        authority.remove_prefix(userinfo_pos + 1);
+    }
+
+    std::string_view port;
+    if (!authority.empty() && authority.front() == '[')
+    {
+        auto end_pos = authority.find(']');
+        if (end_pos == std::string_view::npos)
+            return false;
+        host_ = authority.substr(1, end_pos - 1);
+        auto rest = authority.substr(end_pos + 1);
+        if (!rest.empty())
+        {
+            if (rest.front() != ':')
+                return false;
+            port = rest.substr(1);
+        }
+    }
+    else
+    {
+        auto port_pos = authority.find(':');
+        host_ = authority.substr(0, port_pos);
+        if (port_pos != std::string_view::npos)
+            port = authority.substr(port_pos + 1);
+    }
+
+    if (host_.empty() || !is_digits(port))
+        return false;
+    port_ = port;
+    return true;
+}
+
+constexpr std::string_view UrlParser::service() const noexcept
+{
+    if (!port_.empty())
+        return port_;
+    if (!protocol_.empty())
+        return protocol_;
+    return "80";
+}
+
 } // namespace conet
@@ -2,6 +2,7 @@
 
 #include "conet/result.h"
 #include "conet/mysql_client.h"
+#include "conet/mysql_bulk_insert.h"
 
 boost::asio::awaitable<conet::result<void>> f(boost::asio::io_context &io_context)
 {
@@ -11,6 +12,18 @@ boost::asio::awaitable<conet::result<void>> f(boost::asio::io_context &io_contex
     RESULT_CO_CHECK(co_await mysql_client.query("create table if not exists `test` (`id` bigint(20) AUTO_INCREMENT, `name` varchar(20), PRIMARY KEY (`id`))"));
     RESULT_CO_CHECK(co_await mysql_client.query("insert into `test`(`name`) VALUES ('hello')"));
     RESULT_CO_CHECK(co_await mysql_client.query("insert into `test`(`name`) VALUES ('world')"));
+
+    // many rows in one round trip
+    conet::MysqlBulkInsertBuilder builder(mysql_client, "test", {"name"});
+    for (int i=0; i<1000; ++i)
+    {
+        RESULT_CO_CHECK(builder.add_row({"name_" + std::to_string(i)}));
+    }
+    RESULT_CO_AUTO(batch_results, co_await mysql_client.batch_query(builder.statements()));
+    for (auto &batch_result : batch_results)
+    {
+        RESULT_CO_CHECK(batch_result);
+    }
     RESULT_CO_AUTO(r, co_await mysql_client.query("select * from `test`"));
 
     for (const auto &row : r)
@@ -34,9 +34,14 @@ boost::asio::awaitable<conet::result<void>> f(boost::asio::io_context &io_contex
         LOG(WARNING) << "error " << num1 << " " << num2;
     }
     
-    RESULT_CO_AUTO(a, co_await mysql_client_pool.get());
-    conet::MysqlClient& mysql_client = *a;
-    RESULT_CO_CHECK(co_await mysql_client.query("drop table if exists `test`"));
+    {
+        RESULT_CO_AUTO(a, co_await mysql_client_pool.get());
+        conet::MysqlClient& mysql_client = *a;
+        RESULT_CO_CHECK(co_await mysql_client.query("drop table if exists `test`"));
+    }
+
+    // close idle connections and stop the maintenance, io_context.run() returns once it exits
+    mysql_client_pool.close();
 
     co_return RESULT_SUCCESS;
 }
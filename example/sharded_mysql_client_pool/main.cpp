@@ -0,0 +1,67 @@
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+#include "conet/result.h"
+#include "conet/sharded_mysql_client_pool.h"
+
+boost::asio::awaitable<conet::result<void>> g(conet::ShardedMysqlClientPool &mysql_client_pool)
+{
+    for (int i=0; i<100; ++i)
+    {
+        RESULT_CO_AUTO(a, co_await mysql_client_pool.get());
+        conet::MysqlClient& mysql_client = *a;
+        RESULT_CO_CHECK(co_await mysql_client.query("select 1"));
+    }
+
+    co_return RESULT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    // one io_context per thread, each thread checks out from its own shard
+    std::vector<std::unique_ptr<boost::asio::io_context>> io_context_group;
+    std::vector<boost::asio::any_io_executor> executors;
+    for (int i=0; i<4; ++i)
+    {
+        io_context_group.push_back(std::make_unique<boost::asio::io_context>(1));
+        executors.push_back(io_context_group.back()->get_executor());
+    }
+
+    conet::ShardedMysqlClientPool mysql_client_pool(executors);
+    // init mysql_client_pool first. e.g. co_await mysql_client_pool.init( ... );
+
+    std::atomic_int running_number = static_cast<int>(io_context_group.size());
+    for (auto &io_context : io_context_group)
+    {
+        boost::asio::co_spawn(*io_context,
+            g(mysql_client_pool),
+            [&mysql_client_pool, &running_number](std::exception_ptr e, conet::result<void> result)
+            {
+                if (result.has_error())
+                {
+                    LOG(INFO) << result.error_info();
+                }
+
+                // the last one stops the maintenance of every shard, so that run() returns
+                if (--running_number == 0)
+                {
+                    mysql_client_pool.close();
+                }
+            });
+    }
+
+    std::vector<std::thread> thread_group;
+    for (auto &io_context : io_context_group)
+    {
+        thread_group.emplace_back([&io_context] { io_context->run(); });
+    }
+    for (auto &t : thread_group)
+    {
+        t.join();
+    }
+
+    LOG(INFO) << "steal_number:" << mysql_client_pool.steal_number();
+
+    return 0;
+}
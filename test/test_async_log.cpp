@@ -0,0 +1,150 @@
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "conet/async_log.h"
+#include "conet/error.h"
+
+namespace {
+
+struct Collector
+{
+    void install(conet::AsyncLog &async_log)
+    {
+        async_log.set_write_function([this] (const conet::AsyncLogSite &site, std::string_view message)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                messages.emplace_back(message);
+            });
+    }
+
+    std::mutex mutex;
+    std::vector<std::string> messages;
+};
+
+// logs while it is being formatted
+struct Nested
+{
+};
+
+std::ostream& operator<<(std::ostream &os, const Nested &)
+{
+    ASYNC_LOG(INFO) << "nested";
+    return os << "outer";
+}
+
+// the global log is shared by all tests, the collector must not outlive the test
+class AsyncLogTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        collector_.install(conet::AsyncLog::global());
+    }
+
+    void TearDown() override
+    {
+        auto &async_log = conet::AsyncLog::global();
+        async_log.stop();
+        async_log.set_options({});
+        async_log.set_write_function(nullptr);
+    }
+
+    Collector collector_;
+};
+
+} // namespace
+
+TEST_F(AsyncLogTest, RateLimit)
+{
+    auto &async_log = conet::AsyncLog::global();
+    auto &collector = collector_;
+    conet::AsyncLogOptions options;
+    options.max_per_second = 3;
+    options.sample_every = 4;
+    async_log.set_options(options);
+    auto stats = async_log.stats();
+
+    int evaluated_number = 0;
+    auto evaluate = [&evaluated_number] { return ++evaluated_number; };
+    for (int i=0; i<10; ++i)
+    {
+        ASYNC_LOG(INFO) << "message " << evaluate() << " " << 0.5 << " " << true << " " << 'c';
+    }
+
+    // 1, 2 and 3 are under the limit, 7 is sampled
+    ASSERT_EQ(collector.messages.size(), 4);
+    EXPECT_EQ(evaluated_number, 4);
+    EXPECT_EQ(collector.messages[0], "message 1 0.5 1 c");
+    EXPECT_EQ(collector.messages[3], "message 4 0.5 1 c (suppressed 3)");
+    EXPECT_EQ(async_log.stats().written_number - stats.written_number, 4);
+    EXPECT_EQ(async_log.stats().suppressed_number - stats.suppressed_number, 6);
+}
+
+TEST_F(AsyncLogTest, Synchronous)
+{
+    auto &async_log = conet::AsyncLog::global();
+    auto &collector = collector_;
+
+    // not limited by default
+    for (int i=0; i<20; ++i)
+    {
+        ASYNC_LOG(INFO) << i;
+    }
+    ASSERT_EQ(collector.messages.size(), 20);
+    EXPECT_EQ(collector.messages[19], "19");
+
+    // no record before start(), nothing is cut
+    collector.messages.clear();
+    std::string text(300, 'x');
+    ASYNC_LOG(INFO) << text << 1 << 2 << 3 << 4 << 5 << 6 << 7 << 8 << 9 << 10 << 11 << 12 << 13 << 14 << 15 << 16 << 17 << ' ' << Nested();
+    ASSERT_EQ(collector.messages.size(), 2);
+    EXPECT_EQ(collector.messages[0], "nested");
+    EXPECT_EQ(collector.messages[1], text + "1234567891011121314151617 outer");
+}
+
+TEST_F(AsyncLogTest, Threads)
+{
+    auto &async_log = conet::AsyncLog::global();
+    auto &collector = collector_;
+    conet::AsyncLogOptions options;
+    options.ring_size = 64;
+    async_log.set_options(options);
+    auto stats = async_log.stats();
+    async_log.start();
+
+    boost::system::error_code ec(conet::error::internal_error, conet::error::conet_category());
+    conet::ErrorInfo error_info(ec);
+    error_info.add_pair("key", "value");
+
+    std::vector<std::thread> threads;
+    for (int i=0; i<4; ++i)
+    {
+        threads.emplace_back([i, &error_info]
+            {
+                for (int j=0; j<1000; ++j)
+                {
+                    ASYNC_LOG(WARNING) << "thread " << i << " " << std::string(300, 'x') << error_info;
+                }
+            });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    async_log.flush();
+    async_log.stop();
+
+    auto written_number = async_log.stats().written_number - stats.written_number;
+    auto dropped_number = async_log.stats().dropped_number - stats.dropped_number;
+    EXPECT_EQ(written_number + dropped_number, 4000);
+    EXPECT_EQ(collector.messages.size(), written_number);
+    ASSERT_FALSE(collector.messages.empty());
+    // the text is cut at max_text_size, the ErrorInfo is kept whole
+    EXPECT_EQ(collector.messages[0].find("thread "), 0);
+    EXPECT_NE(collector.messages[0].find("x[error_id="), std::string::npos) << collector.messages[0];
+    EXPECT_TRUE(collector.messages[0].ends_with("]...")) << collector.messages[0];
+    EXPECT_NE(collector.messages[0].find("key: value"), std::string::npos) << collector.messages[0];
+}
@@ -0,0 +1,250 @@
+#include <memory>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/dns_cache.h"
+#include "conet/tcp_client.h"
+#include "conet/tcp_server.h"
+
+namespace {
+
+// counts lookups, each takes a while so that concurrent misses overlap
+conet::DnsCache::ResolveFunctionType make_counting_resolve_function(int &resolve_number)
+{
+    conet::DnsCache::HostsType hosts;
+    hosts["db.test"] = {boost::asio::ip::make_address("127.0.0.1")};
+    auto hosts_resolve_function = conet::DnsCache::make_hosts_resolve_function(std::move(hosts));
+
+    return [&resolve_number, hosts_resolve_function] (const std::string &host, const std::string &service) -> boost::asio::awaitable<conet::result<conet::DnsCache::EndpointsType>>
+        {
+            ++resolve_number;
+            boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::milliseconds(10));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            co_return co_await hosts_resolve_function(host, service);
+        };
+}
+
+} // namespace
+
+TEST(DnsCacheTest, Numeric)
+{
+    EXPECT_TRUE(conet::DnsCache::parse_numeric("127.0.0.1", "80"));
+    EXPECT_FALSE(conet::DnsCache::parse_numeric("127.0.0.1", "http"));
+    EXPECT_FALSE(conet::DnsCache::parse_numeric("localhost", "80"));
+    EXPECT_FALSE(conet::DnsCache::parse_numeric("127.0.0.1", "80000"));
+}
+
+TEST(DnsCacheTest, CoalesceAndCache)
+{
+    boost::asio::io_context io_context;
+
+    int resolve_number = 0;
+    conet::DnsCacheOptions options;
+    options.ttl = std::chrono::milliseconds(50);
+    conet::DnsCache dns_cache(options);
+    dns_cache.set_resolve_function(make_counting_resolve_function(resolve_number));
+
+    int success_number = 0;
+    auto resolve = [&] () -> boost::asio::awaitable<void>
+        {
+            auto resolve_result = co_await dns_cache.resolve("db.test", "3306");
+            EXPECT_TRUE(resolve_result) << resolve_result.error_info();
+            if (resolve_result && resolve_result.value().size() == 1 && resolve_result.value()[0].port() == 3306)
+                ++success_number;
+        };
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            // cached
+            co_await resolve();
+            EXPECT_EQ(resolve_number, 1);
+
+            // expired
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(60));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            co_await resolve();
+            EXPECT_EQ(resolve_number, 2);
+
+            // failures are cached too
+            auto fail_result = co_await dns_cache.resolve("none.test", "80");
+            EXPECT_FALSE(fail_result);
+            auto fail_again_result = co_await dns_cache.resolve("none.test", "80");
+            EXPECT_FALSE(fail_again_result);
+            EXPECT_EQ(resolve_number, 3);
+
+            // never reach the resolver
+            auto numeric_result = co_await dns_cache.resolve("127.0.0.1", "80");
+            EXPECT_TRUE(numeric_result);
+            EXPECT_EQ(resolve_number, 3);
+            ++check_point;
+        };
+
+    // concurrent misses share one lookup
+    for (int i=0; i<10; ++i)
+    {
+        boost::asio::co_spawn(io_context, resolve(), boost::asio::detached);
+    }
+    io_context.run();
+    EXPECT_EQ(resolve_number, 1);
+    EXPECT_EQ(success_number, 10);
+
+    io_context.restart();
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    auto stats = dns_cache.stats();
+    EXPECT_EQ(stats.miss_number, 3);
+    EXPECT_EQ(stats.coalesced_number, 9);
+    EXPECT_EQ(stats.hit_number, 1);
+    EXPECT_EQ(stats.negative_hit_number, 1);
+    EXPECT_EQ(stats.numeric_number, 1);
+}
+
+TEST(DnsCacheTest, LeaderThrows)
+{
+    boost::asio::io_context io_context;
+
+    int resolve_number = 0;
+    bool is_throwing = true;
+    auto counting_resolve_function = make_counting_resolve_function(resolve_number);
+    conet::DnsCache dns_cache;
+    dns_cache.set_resolve_function([&] (const std::string &host, const std::string &service) -> boost::asio::awaitable<conet::result<conet::DnsCache::EndpointsType>>
+        {
+            auto resolve_result = co_await counting_resolve_function(host, service);
+            if (is_throwing)
+                throw std::runtime_error("resolver failed");
+            co_return resolve_result;
+        });
+
+    int aborted_number = 0;
+    auto resolve = [&] () -> boost::asio::awaitable<void>
+        {
+            try
+            {
+                auto resolve_result = co_await dns_cache.resolve("db.test", "3306");
+                EXPECT_FALSE(resolve_result);
+                EXPECT_EQ(resolve_result.error_info().error_code(), boost::asio::error::operation_aborted);
+                ++aborted_number;
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+        };
+
+    for (int i=0; i<3; ++i)
+    {
+        boost::asio::co_spawn(io_context, resolve(), boost::asio::detached);
+    }
+    io_context.run();
+    EXPECT_EQ(resolve_number, 1);
+    EXPECT_EQ(aborted_number, 2);
+
+    // nothing was cached, the next caller leads a new lookup
+    is_throwing = false;
+    int check_point = 0;
+    io_context.restart();
+    boost::asio::co_spawn(io_context, [&] () -> boost::asio::awaitable<void>
+        {
+            auto resolve_result = co_await dns_cache.resolve("db.test", "3306");
+            EXPECT_TRUE(resolve_result) << resolve_result.error_info();
+            ++check_point;
+        }, boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(resolve_number, 2);
+}
+
+TEST(DnsCacheTest, LeaderDestroyed)
+{
+    auto leader_io_context = std::make_unique<boost::asio::io_context>();
+    boost::asio::io_context io_context;
+
+    int resolve_number = 0;
+    bool is_hanging = true;
+    auto counting_resolve_function = make_counting_resolve_function(resolve_number);
+    conet::DnsCache dns_cache;
+    dns_cache.set_resolve_function([&] (const std::string &host, const std::string &service) -> boost::asio::awaitable<conet::result<conet::DnsCache::EndpointsType>>
+        {
+            if (is_hanging)
+            {
+                ++resolve_number;
+                boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::hours(1));
+                co_await timer.async_wait(boost::asio::use_awaitable);
+            }
+            co_return co_await counting_resolve_function(host, service);
+        });
+
+    auto resolve = [&] () -> boost::asio::awaitable<conet::result<conet::DnsCache::EndpointsType>>
+        {
+            co_return co_await dns_cache.resolve("db.test", "3306");
+        };
+
+    // the leader hangs in the resolver, a caller on another io_context waits for it
+    boost::asio::co_spawn(*leader_io_context, resolve(), boost::asio::detached);
+    leader_io_context->poll();
+
+    int check_point = 0;
+    boost::asio::co_spawn(io_context, [&] () -> boost::asio::awaitable<void>
+        {
+            auto resolve_result = co_await resolve();
+            EXPECT_FALSE(resolve_result);
+            EXPECT_EQ(resolve_result.error_info().error_code(), boost::asio::error::operation_aborted);
+            ++check_point;
+
+            is_hanging = false;
+            auto again_result = co_await resolve();
+            EXPECT_TRUE(again_result) << again_result.error_info();
+            ++check_point;
+        }, boost::asio::detached);
+    io_context.poll();
+    EXPECT_EQ(dns_cache.stats().coalesced_number, 1);
+
+    // destroys the leader coroutine
+    leader_io_context.reset();
+    io_context.run();
+
+    EXPECT_EQ(check_point, 2);
+    EXPECT_EQ(resolve_number, 2);
+}
+
+TEST(DnsCacheTest, TcpClientConnect)
+{
+    boost::asio::io_context io_context;
+
+    conet::TcpServer tcp_server(io_context);
+    ASSERT_TRUE(tcp_server.listen("127.0.0.1", 0));
+    auto port = tcp_server.local_endpoint().value().port();
+
+    int resolve_number = 0;
+    conet::DnsCache dns_cache;
+    dns_cache.set_resolve_function(make_counting_resolve_function(resolve_number));
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            for (int i=0; i<2; ++i)
+            {
+                conet::TcpClient tcp_client(io_context);
+                tcp_client.set_dns_cache(dns_cache);
+                auto connect_result = co_await tcp_client.connect("db.test:" + std::to_string(port));
+                EXPECT_TRUE(connect_result) << connect_result.error_info();
+
+                auto accept_result = co_await tcp_server.accept();
+                EXPECT_TRUE(accept_result) << accept_result.error_info();
+            }
+            ++check_point;
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(resolve_number, 1);
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include "conet/histogram.h"
+
+TEST(HistogramTest, Empty)
+{
+    conet::Histogram histogram;
+
+    EXPECT_EQ(histogram.count(), 0);
+    EXPECT_EQ(histogram.percentile(50), 0);
+    EXPECT_TRUE(histogram.buckets().empty());
+}
+
+TEST(HistogramTest, Record)
+{
+    conet::Histogram histogram;
+    histogram.record(0);
+    histogram.record(1);
+    histogram.record(100);
+    histogram.record(1000);
+
+    EXPECT_EQ(histogram.count(), 4);
+    EXPECT_EQ(histogram.sum(), 1101);
+    EXPECT_EQ(histogram.max(), 1000);
+    EXPECT_EQ(histogram.buckets().size(), 4);
+}
+
+TEST(HistogramTest, SmallValuesAreExact)
+{
+    conet::Histogram histogram;
+    for (int i=0; i<99; ++i)
+    {
+        histogram.record(10);
+    }
+    histogram.record(5000);
+
+    EXPECT_EQ(histogram.percentile(50), 10);
+    EXPECT_EQ(histogram.percentile(100), 5000);
+
+    histogram.reset();
+    EXPECT_EQ(histogram.count(), 0);
+}
+
+TEST(HistogramTest, RelativeErrorIsBounded)
+{
+    for (std::uint64_t value : {17ull, 1000ull, 123456ull, 987654321ull, 1ull << 62})
+    {
+        conet::Histogram histogram;
+        histogram.record(value);
+        histogram.record(value * 2);
+
+        auto p = histogram.percentile(0);
+        EXPECT_GE(p, value);
+        EXPECT_LE(p - value, value / conet::Histogram::sub_bucket_count);
+    }
+}
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/http_cache.h"
+#include "conet/http_server.h"
+
+namespace {
+
+// serves "<path>" with the given Cache-Control, answers If-None-Match with 304. each request takes a while
+// so that concurrent misses overlap.
+conet::HttpCache::RequestFunctionType make_upstream(int &request_number, int &not_modified_number, std::string cache_control)
+{
+    return [&request_number, &not_modified_number, cache_control] (const conet::HttpRequest &request) -> boost::asio::awaitable<conet::result<conet::HttpCache::ResponseType>>
+        {
+            ++request_number;
+            boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::milliseconds(10));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+
+            conet::HttpCache::ResponseType rsp;
+            rsp.version(11);
+            if (request.headers[boost::beast::http::field::if_none_match] == "\"v1\"")
+            {
+                ++not_modified_number;
+                rsp.result(boost::beast::http::status::not_modified);
+                co_return rsp;
+            }
+
+            rsp.result(boost::beast::http::status::ok);
+            if (!cache_control.empty())
+                rsp.set(boost::beast::http::field::cache_control, cache_control);
+            rsp.set(boost::beast::http::field::etag, "\"v1\"");
+            rsp.body() = request.url;
+            rsp.prepare_payload();
+            co_return rsp;
+        };
+}
+
+} // namespace
+
+TEST(HttpCacheTest, ParseCacheControl)
+{
+    auto control = conet::HttpCache::parse_cache_control("public, Max-Age=60");
+    EXPECT_FALSE(control.no_store);
+    EXPECT_FALSE(control.no_cache);
+    EXPECT_EQ(control.max_age, std::chrono::seconds(60));
+
+    control = conet::HttpCache::parse_cache_control("no-cache,no-store, max-age=\"5\"");
+    EXPECT_TRUE(control.no_store);
+    EXPECT_TRUE(control.no_cache);
+    EXPECT_EQ(control.max_age, std::chrono::seconds(5));
+
+    control = conet::HttpCache::parse_cache_control("max-age=abc");
+    EXPECT_FALSE(control.max_age);
+}
+
+TEST(HttpCacheTest, CoalesceAndCache)
+{
+    boost::asio::io_context io_context;
+
+    int request_number = 0;
+    int not_modified_number = 0;
+    conet::HttpCache http_cache(make_upstream(request_number, not_modified_number, "max-age=60"));
+
+    int success_number = 0;
+    auto get = [&] () -> boost::asio::awaitable<void>
+        {
+            auto get_result = co_await http_cache.co_get("http://cache.test/a");
+            EXPECT_TRUE(get_result) << get_result.error_info();
+            if (get_result && get_result.value()->body() == "http://cache.test/a")
+                ++success_number;
+        };
+
+    // concurrent misses share one request
+    for (int i=0; i<10; ++i)
+    {
+        boost::asio::co_spawn(io_context, get(), boost::asio::detached);
+    }
+    io_context.run();
+    EXPECT_EQ(request_number, 1);
+    EXPECT_EQ(success_number, 10);
+
+    io_context.restart();
+    boost::asio::co_spawn(io_context, get(), boost::asio::detached);
+    io_context.run();
+    EXPECT_EQ(request_number, 1);
+    EXPECT_EQ(success_number, 11);
+
+    http_cache.invalidate("http://cache.test/a");
+    io_context.restart();
+    boost::asio::co_spawn(io_context, get(), boost::asio::detached);
+    io_context.run();
+    EXPECT_EQ(request_number, 2);
+    EXPECT_EQ(not_modified_number, 0);
+
+    auto stats = http_cache.stats();
+    EXPECT_EQ(stats.miss_number, 2);
+    EXPECT_EQ(stats.coalesced_number, 9);
+    EXPECT_EQ(stats.hit_number, 1);
+    EXPECT_EQ(stats.entry_number, 1);
+}
+
+TEST(HttpCacheTest, Revalidate)
+{
+    boost::asio::io_context io_context;
+
+    int request_number = 0;
+    int not_modified_number = 0;
+    conet::HttpCache http_cache(make_upstream(request_number, not_modified_number, "no-cache"));
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto first_result = co_await http_cache.co_get("http://cache.test/a");
+            EXPECT_TRUE(first_result) << first_result.error_info();
+
+            auto second_result = co_await http_cache.co_get("http://cache.test/a");
+            EXPECT_TRUE(second_result) << second_result.error_info();
+            if (first_result && second_result)
+                EXPECT_EQ(first_result.value(), second_result.value());
+
+            EXPECT_EQ(request_number, 2);
+            EXPECT_EQ(not_modified_number, 1);
+            ++check_point;
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(http_cache.stats().revalidated_number, 1);
+}
+
+TEST(HttpCacheTest, Evict)
+{
+    boost::asio::io_context io_context;
+
+    int request_number = 0;
+    int not_modified_number = 0;
+    conet::HttpCacheOptions options;
+    options.memory_budget = 120;
+    conet::HttpCache http_cache(make_upstream(request_number, not_modified_number, "max-age=60"), options);
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            for (auto url : {"http://cache.test/a", "http://cache.test/b", "http://cache.test/a"})
+            {
+                auto get_result = co_await http_cache.co_get(url);
+                EXPECT_TRUE(get_result) << get_result.error_info();
+            }
+            ++check_point;
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(request_number, 3);
+    auto stats = http_cache.stats();
+    EXPECT_EQ(stats.evicted_number, 2);
+    EXPECT_EQ(stats.entry_number, 1);
+    EXPECT_LE(stats.memory_size, options.memory_budget);
+}
+
+TEST(HttpCacheTest, HttpClient)
+{
+    using boost::beast::http::verb;
+
+    boost::asio::io_context io_context;
+    int request_number = 0;
+    conet::HttpServer http_server(io_context);
+    EXPECT_TRUE(http_server.route(verb::get, "/users/:id",
+        [&request_number] (const conet::HttpServerRequest &req, conet::HttpServerResponse &rsp, const conet::HttpRouteParams &params) -> boost::asio::awaitable<conet::result<void>>
+        {
+            ++request_number;
+            rsp.set(boost::beast::http::field::cache_control, "max-age=60");
+            rsp.body() = params.get("id");
+            co_return RESULT_SUCCESS;
+        }));
+    ASSERT_TRUE(http_server.listen("127.0.0.1", 0));
+    http_server.start();
+
+    conet::HttpClient http_client(io_context);
+    conet::HttpCache http_cache(http_client);
+    auto url = "127.0.0.1:" + std::to_string(http_server.port()) + "/users/42";
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            for (int i=0; i<2; ++i)
+            {
+                auto get_result = co_await http_cache.co_get(url);
+                EXPECT_TRUE(get_result) << get_result.error_info();
+                if (get_result)
+                    EXPECT_EQ(get_result.value()->body(), "42");
+            }
+            ++check_point;
+            http_client.connection_pool().close();
+            http_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(request_number, 1);
+}
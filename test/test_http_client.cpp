@@ -0,0 +1,322 @@
+#include <cstdio>
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include "conet/http_client.h"
+
+namespace {
+
+// answers every request with its target as body, or with the request body and X-Echo header for POST.
+// /large answers large_body_size bytes, /large/chunked the same with chunked encoding.
+// with close_after_response the connection is closed although the response allows keep-alive,
+// like a server dropping idle connections.
+class EchoServer
+{
+public:
+    static constexpr std::size_t large_body_size = 200000;
+
+    EchoServer(boost::asio::io_context &io_context, bool close_after_response) :
+        acceptor_(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0)),
+        close_after_response_(close_after_response),
+        connection_number_(0)
+    {
+    }
+
+    void start()
+    {
+        boost::asio::co_spawn(acceptor_.get_executor(), run(), boost::asio::detached);
+    }
+
+    void close()
+    {
+        boost::system::error_code ec;
+        acceptor_.close(ec);
+    }
+
+    unsigned short port() const { return acceptor_.local_endpoint().port(); }
+    int connection_number() const { return connection_number_; }
+
+private:
+    boost::asio::awaitable<void> run()
+    {
+        while (true)
+        {
+            boost::system::error_code ec;
+            auto socket = co_await acceptor_.async_accept(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            if (ec)
+                break;
+
+            ++connection_number_;
+            boost::asio::co_spawn(acceptor_.get_executor(), session(std::move(socket)), boost::asio::detached);
+        }
+    }
+
+    boost::asio::awaitable<void> session(boost::asio::ip::tcp::socket socket)
+    {
+        boost::beast::flat_buffer buffer;
+        while (true)
+        {
+            boost::system::error_code ec;
+            boost::beast::http::request<boost::beast::http::string_body> req;
+            co_await boost::beast::http::async_read(socket, buffer, req, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            if (ec)
+                break;
+
+            boost::beast::http::response<boost::beast::http::string_body> rsp(boost::beast::http::status::ok, req.version());
+            rsp.keep_alive(req.keep_alive());
+            bool is_chunked = false;
+            if (req.target().starts_with("/large"))
+            {
+                rsp.body() = std::string(large_body_size, 'x');
+                is_chunked = req.target() == "/large/chunked";
+            }
+            else if (req.method() == boost::beast::http::verb::post)
+            {
+                rsp.set("X-Echo", req["X-Echo"]);
+                rsp.body() = req.body();
+            }
+            else
+            {
+                rsp.body() = std::string(req.target());
+            }
+            rsp.prepare_payload();
+            if (is_chunked)
+            {
+                rsp.content_length(boost::none);
+                rsp.chunked(true);
+            }
+            co_await boost::beast::http::async_write(socket, rsp, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            if (ec || !req.keep_alive() || close_after_response_)
+                break;
+        }
+
+        boost::system::error_code ec;
+        socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    }
+
+    boost::asio::ip::tcp::acceptor acceptor_;
+    bool close_after_response_;
+    int connection_number_;
+};
+
+} // namespace
+
+TEST(HttpClientTest, ReusesConnection)
+{
+    boost::asio::io_context io_context;
+    EchoServer echo_server(io_context, false);
+    echo_server.start();
+
+    conet::HttpClient http_client(io_context);
+    int success_number = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto url = "127.0.0.1:" + std::to_string(echo_server.port());
+            for (int i=0; i<10; ++i)
+            {
+                auto get_result = co_await http_client.co_get(url + "/hello");
+                EXPECT_TRUE(get_result) << get_result.error_info();
+                if (get_result && get_result.value() == "/hello")
+                    ++success_number;
+            }
+
+            http_client.connection_pool().close();
+            echo_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(success_number, 10);
+    EXPECT_EQ(echo_server.connection_number(), 1);
+    EXPECT_EQ(http_client.connection_pool().stats().created_number, 1);
+    EXPECT_EQ(http_client.connection_pool().stats().reused_number, 9);
+}
+
+TEST(HttpClientTest, DropsStaleConnection)
+{
+    boost::asio::io_context io_context;
+    EchoServer echo_server(io_context, true);
+    echo_server.start();
+
+    conet::HttpClient http_client(io_context);
+    int success_number = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto url = "127.0.0.1:" + std::to_string(echo_server.port());
+            for (int i=0; i<3; ++i)
+            {
+                auto get_result = co_await http_client.co_get(url + "/hello");
+                EXPECT_TRUE(get_result) << get_result.error_info();
+                if (get_result)
+                    ++success_number;
+
+                // let the server close the idle connection
+                boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(10));
+                co_await timer.async_wait(boost::asio::use_awaitable);
+            }
+
+            http_client.connection_pool().close();
+            echo_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(success_number, 3);
+    EXPECT_EQ(echo_server.connection_number(), 3);
+    EXPECT_EQ(http_client.connection_pool().stats().stale_number, 2);
+}
+
+TEST(HttpClientTest, PostWithHeaders)
+{
+    boost::asio::io_context io_context;
+    EchoServer echo_server(io_context, false);
+    echo_server.start();
+
+    conet::HttpClient http_client(io_context);
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            conet::HttpRequest request;
+            request.method = boost::beast::http::verb::post;
+            request.url = "127.0.0.1:" + std::to_string(echo_server.port()) + "/post";
+            request.headers.set("X-Echo", "value");
+            request.body = "body";
+
+            auto request_result = co_await http_client.co_request(request);
+            EXPECT_TRUE(request_result) << request_result.error_info();
+            if (request_result)
+            {
+                auto &rsp = request_result.value();
+                EXPECT_EQ(rsp.result(), boost::beast::http::status::ok);
+                EXPECT_EQ(rsp["X-Echo"], "value");
+                EXPECT_EQ(rsp.body(), "body");
+                ++check_point;
+            }
+
+            http_client.connection_pool().close();
+            echo_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(HttpClientTest, RequestAllPipelined)
+{
+    boost::asio::io_context io_context;
+    EchoServer echo_server(io_context, false);
+    echo_server.start();
+
+    conet::HttpClient http_client(io_context);
+    conet::HttpClientOptions options;
+    options.pipeline_depth = 8;
+    http_client.set_options(options);
+
+    const int request_number = 100;
+    int success_number = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto url = "127.0.0.1:" + std::to_string(echo_server.port());
+            std::vector<conet::HttpRequest> requests(request_number);
+            for (int i=0; i<request_number; ++i)
+            {
+                requests[i].url = url + "/" + std::to_string(i);
+                // a POST in the middle ends the pipelined chunk
+                if (i == 50)
+                {
+                    requests[i].method = boost::beast::http::verb::post;
+                    requests[i].body = "/50";
+                }
+            }
+            requests.push_back({boost::beast::http::verb::get, "not a url:port", {}, {}});
+
+            auto results = co_await http_client.co_request_all(requests);
+            EXPECT_EQ(results.size(), request_number + 1);
+            for (int i=0; i<request_number; ++i)
+            {
+                EXPECT_TRUE(results[i]) << results[i].error_info();
+                if (results[i] && results[i].value().body() == "/" + std::to_string(i))
+                    ++success_number;
+            }
+            EXPECT_FALSE(results.back());
+
+            http_client.connection_pool().close();
+            echo_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(success_number, request_number);
+    EXPECT_LE(echo_server.connection_number(), http_client.connection_pool().options().max_connection_per_host);
+}
+
+TEST(HttpClientTest, StreamsBody)
+{
+    boost::asio::io_context io_context;
+    EchoServer echo_server(io_context, false);
+    echo_server.start();
+
+    conet::HttpClient http_client(io_context);
+    conet::HttpClientOptions options;
+    options.stream_buffer_size = 1000;
+    http_client.set_options(options);
+
+    auto file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto url = "127.0.0.1:" + std::to_string(echo_server.port());
+            for (const auto &target : {"/large", "/large/chunked"})
+            {
+                std::size_t body_size = 0;
+                std::size_t max_piece_size = 0;
+                conet::HttpRequest request;
+                request.url = url + target;
+                auto stream_result = co_await http_client.co_request_stream(request,
+                    [&] (std::string_view data) -> boost::asio::awaitable<conet::result<void>>
+                    {
+                        body_size += data.size();
+                        max_piece_size = std::max(max_piece_size, data.size());
+                        co_return RESULT_SUCCESS;
+                    });
+                EXPECT_TRUE(stream_result) << stream_result.error_info();
+                if (stream_result)
+                    EXPECT_EQ(stream_result.value().result(), boost::beast::http::status::ok);
+                EXPECT_EQ(body_size, EchoServer::large_body_size);
+                EXPECT_LE(max_piece_size, options.stream_buffer_size);
+            }
+
+            conet::HttpRequest request;
+            request.url = url + "/large/chunked";
+            auto stream_result = co_await http_client.co_request_stream(request, conet::make_fd_body_sink(fileno(file)));
+            EXPECT_TRUE(stream_result) << stream_result.error_info();
+            ++check_point;
+
+            http_client.connection_pool().close();
+            echo_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(echo_server.connection_number(), 1);
+
+    struct stat file_stat;
+    ASSERT_EQ(fstat(fileno(file), &file_stat), 0);
+    EXPECT_EQ(file_stat.st_size, EchoServer::large_body_size);
+    std::fclose(file);
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/http_server.h"
+#include "conet/http_client.h"
+
+namespace {
+
+conet::HttpHandler make_handler(std::string name)
+{
+    return [name] (const conet::HttpServerRequest &req, conet::HttpServerResponse &rsp, const conet::HttpRouteParams &params) -> boost::asio::awaitable<conet::result<void>>
+        {
+            rsp.body() = name;
+            co_return RESULT_SUCCESS;
+        };
+}
+
+} // namespace
+
+TEST(HttpServerTest, Router)
+{
+    using boost::beast::http::verb;
+
+    conet::HttpRouter router;
+    EXPECT_TRUE(router.add(verb::get, "/", make_handler("root")));
+    EXPECT_TRUE(router.add(verb::get, "/users/me", make_handler("me")));
+    EXPECT_TRUE(router.add(verb::get, "/users/:id", make_handler("user")));
+    EXPECT_TRUE(router.add(verb::get, "/users/:id/posts/:post_id", make_handler("post")));
+    EXPECT_TRUE(router.add(verb::get, "/files/*path", make_handler("file")));
+    EXPECT_TRUE(router.add(verb::post, "/users/:id", make_handler("update")));
+
+    EXPECT_FALSE(router.add(verb::get, "users", make_handler("")));
+    EXPECT_FALSE(router.add(verb::get, "/users/:name", make_handler("")));
+    EXPECT_FALSE(router.add(verb::get, "/users/:id", make_handler("")));
+    EXPECT_FALSE(router.add(verb::get, "/files/*path/x", make_handler("")));
+    EXPECT_FALSE(router.add(verb::get, "/x/:", make_handler("")));
+
+    conet::HttpRouteParams params;
+    bool is_path_found = false;
+    EXPECT_NE(router.find(verb::get, "/", params, is_path_found), nullptr);
+
+    EXPECT_NE(router.find(verb::get, "/users/me", params, is_path_found), nullptr);
+    EXPECT_EQ(params.size(), 0);
+
+    EXPECT_NE(router.find(verb::get, "/users/42", params, is_path_found), nullptr);
+    EXPECT_EQ(params.get("id"), "42");
+
+    EXPECT_NE(router.find(verb::get, "/users/me/posts/7", params, is_path_found), nullptr);
+    EXPECT_EQ(params.get("id"), "me");
+    EXPECT_EQ(params.get("post_id"), "7");
+
+    EXPECT_NE(router.find(verb::get, "/files/a/b.txt", params, is_path_found), nullptr);
+    EXPECT_EQ(params.get("path"), "a/b.txt");
+
+    EXPECT_EQ(router.find(verb::get, "/users/", params, is_path_found), nullptr);
+    EXPECT_FALSE(is_path_found);
+    EXPECT_EQ(router.find(verb::get, "/none", params, is_path_found), nullptr);
+    EXPECT_FALSE(is_path_found);
+    EXPECT_EQ(router.find(verb::delete_, "/users/42", params, is_path_found), nullptr);
+    EXPECT_TRUE(is_path_found);
+}
+
+TEST(HttpServerTest, Serve)
+{
+    using boost::beast::http::verb;
+
+    boost::asio::io_context io_context;
+    conet::HttpServer http_server(io_context);
+    EXPECT_TRUE(http_server.route(verb::get, "/users/:id",
+        [] (const conet::HttpServerRequest &req, conet::HttpServerResponse &rsp, const conet::HttpRouteParams &params) -> boost::asio::awaitable<conet::result<void>>
+        {
+            rsp.body() = params.get("id");
+            co_return RESULT_SUCCESS;
+        }));
+    EXPECT_TRUE(http_server.route(verb::post, "/echo",
+        [] (const conet::HttpServerRequest &req, conet::HttpServerResponse &rsp, const conet::HttpRouteParams &params) -> boost::asio::awaitable<conet::result<void>>
+        {
+            rsp.body() = req.body();
+            co_return RESULT_SUCCESS;
+        }));
+    EXPECT_TRUE(http_server.route(verb::get, "/fail",
+        [] (const conet::HttpServerRequest &req, conet::HttpServerResponse &rsp, const conet::HttpRouteParams &params) -> boost::asio::awaitable<conet::result<void>>
+        {
+            boost::system::error_code error_code;
+            error_code.assign(conet::error::internal_error, conet::error::conet_category());
+            co_return error_code;
+        }));
+    ASSERT_TRUE(http_server.listen("127.0.0.1", 0));
+    http_server.start();
+
+    conet::HttpClient http_client(io_context);
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto url = "127.0.0.1:" + std::to_string(http_server.port());
+
+            auto get_result = co_await http_client.co_get(url + "/users/42?x=1");
+            EXPECT_TRUE(get_result) << get_result.error_info();
+            if (get_result)
+                EXPECT_EQ(get_result.value(), "42");
+
+            conet::HttpRequest request;
+            request.method = verb::post;
+            request.url = url + "/echo";
+            request.body = "body";
+            auto post_result = co_await http_client.co_request(request);
+            EXPECT_TRUE(post_result) << post_result.error_info();
+            if (post_result)
+                EXPECT_EQ(post_result.value().body(), "body");
+
+            request.method = verb::get;
+            request.url = url + "/fail";
+            auto fail_result = co_await http_client.co_request(request);
+            EXPECT_TRUE(fail_result) << fail_result.error_info();
+            if (fail_result)
+                EXPECT_EQ(fail_result.value().result(), boost::beast::http::status::internal_server_error);
+
+            request.url = url + "/none";
+            auto none_result = co_await http_client.co_request(request);
+            EXPECT_TRUE(none_result) << none_result.error_info();
+            if (none_result)
+                EXPECT_EQ(none_result.value().result(), boost::beast::http::status::not_found);
+
+            ++check_point;
+            http_client.connection_pool().close();
+            http_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    auto stats = http_server.stats();
+    EXPECT_EQ(stats.accepted_number, 1);
+    EXPECT_EQ(stats.request_number, 4);
+    EXPECT_EQ(stats.not_found_number, 1);
+    EXPECT_EQ(stats.handler_error_number, 1);
+    EXPECT_EQ(stats.connection_number, 0);
+}
@@ -0,0 +1,87 @@
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "conet/metrics.h"
+
+TEST(MetricsTest, CounterThreads)
+{
+    conet::MetricsRegistry registry;
+    auto &counter = registry.counter("test_total", "test counter");
+    EXPECT_EQ(&counter, &registry.counter("test_total", "test counter"));
+    EXPECT_NE(&counter, &registry.counter("test_total", "test counter", {{"shard", "1"}}));
+
+    std::vector<std::thread> threads;
+    for (int i=0; i<8; ++i)
+    {
+        threads.emplace_back([&counter]
+            {
+                for (int j=0; j<10000; ++j)
+                {
+                    counter.add();
+                }
+            });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(counter.value(), 80000);
+}
+
+TEST(MetricsTest, Collect)
+{
+    conet::MetricsRegistry registry;
+    registry.counter("requests_total", "requests").add(3);
+    registry.gauge("connections", "connections").set(-2);
+    auto &histogram = registry.histogram("latency", "latency");
+    std::thread thread([&histogram] { histogram.record(1000); });
+    thread.join();
+    histogram.record(10);
+
+    auto id = registry.add_collector([] (std::vector<conet::MetricSample> &samples)
+        {
+            auto &sample = samples.emplace_back();
+            sample.name = "pool_idle";
+            sample.value = 4;
+        });
+
+    auto samples = registry.collect();
+    ASSERT_EQ(samples.size(), 4);
+    EXPECT_EQ(samples[0].value, 3);
+    EXPECT_EQ(samples[1].value, -2);
+    EXPECT_EQ(samples[2].type, conet::MetricType::summary);
+    EXPECT_EQ(samples[2].count, 2);
+    EXPECT_EQ(samples[2].sum, 1010);
+    EXPECT_EQ(samples[3].name, "pool_idle");
+
+    registry.remove_collector(id);
+    EXPECT_EQ(registry.collect().size(), 3);
+}
+
+TEST(MetricsTest, PrometheusText)
+{
+    conet::MetricsRegistry registry;
+    registry.counter("conet_reads_total", "reads", {{"server", "a"}}).add(2);
+    registry.gauge("conet_idle", "idle \\ connections").set(5);
+    registry.counter("conet_reads_total", "reads", {{"server", "b\"\n"}}).add(1);
+    registry.histogram("conet_latency", "latency").record(7);
+
+    EXPECT_EQ(registry.prometheus_text(),
+        "# HELP conet_idle idle \\\\ connections\n"
+        "# TYPE conet_idle gauge\n"
+        "conet_idle 5\n"
+        "# HELP conet_latency latency\n"
+        "# TYPE conet_latency summary\n"
+        "conet_latency{quantile=\"0.5\"} 7\n"
+        "conet_latency{quantile=\"0.9\"} 7\n"
+        "conet_latency{quantile=\"0.99\"} 7\n"
+        "conet_latency_sum 7\n"
+        "conet_latency_count 1\n"
+        "# HELP conet_reads_total reads\n"
+        "# TYPE conet_reads_total counter\n"
+        "conet_reads_total{server=\"a\"} 2\n"
+        "conet_reads_total{server=\"b\\\"\\n\"} 1\n");
+}
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <memory>
+
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/mysql_bulk_load.h"
+#include "conet/mysql_fake_server.h"
+
+TEST(MysqlBulkLoadTest, EncodeRow)
+{
+    std::string buffer;
+    std::vector<std::optional<std::string>> values = {"1", std::nullopt, std::string("a\tb\nc\\d\0e", 9), ""};
+    conet::MysqlBulkLoader::encode_row(values, buffer);
+    EXPECT_EQ(buffer, "1\t\\N\ta\\tb\\nc\\\\d\\0e\t\n");
+}
+
+TEST(MysqlBulkLoadTest, LoadFakeServer)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    // small buffer, add_row() has to wait for the connection
+    conet::MysqlBulkLoadOptions options;
+    options.max_buffer_size = 256;
+    conet::MysqlBulkLoader loader("t", {"id", "name"}, options);
+    ASSERT_TRUE(loader.start("127.0.0.1", mysql_fake_server.port(), "root", "", "test"));
+
+    const int row_number = 1000;
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            for (int i=0; i<row_number; ++i)
+            {
+                std::vector<std::optional<std::string>> values = {std::to_string(i), "name\t" + std::to_string(i)};
+                auto add_result = co_await loader.add_row(values);
+                EXPECT_TRUE(add_result) << add_result.error_info();
+                if (!add_result)
+                    break;
+            }
+
+            auto finish_result = co_await loader.finish();
+            EXPECT_TRUE(finish_result) << finish_result.error_info();
+            if (finish_result)
+                EXPECT_EQ(finish_result.value(), row_number);
+
+            std::vector<std::optional<std::string>> values = {"1", "2"};
+            auto add_result = co_await loader.add_row(values);
+            EXPECT_FALSE(add_result);
+            ++check_point;
+
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(loader.row_number(), row_number);
+    EXPECT_GT(mysql_fake_server.local_infile_size(), 0);
+}
+
+TEST(MysqlBulkLoadTest, StartOnce)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlBulkLoader loader("t", {"id"});
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            std::vector<std::optional<std::string>> values = {"1"};
+            auto add_result = co_await loader.add_row(values);
+            EXPECT_FALSE(add_result);
+            auto finish_result = co_await loader.finish();
+            EXPECT_FALSE(finish_result);
+
+            EXPECT_TRUE(loader.start("127.0.0.1", mysql_fake_server.port(), "root", "", "test"));
+            EXPECT_FALSE(loader.start("127.0.0.1", mysql_fake_server.port(), "root", "", "test"));
+
+            add_result = co_await loader.add_row(values);
+            EXPECT_TRUE(add_result) << add_result.error_info();
+            finish_result = co_await loader.finish();
+            EXPECT_TRUE(finish_result) << finish_result.error_info();
+            if (finish_result)
+                EXPECT_EQ(finish_result.value(), 1);
+            ++check_point;
+
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(MysqlBulkLoadTest, AbortRollsBack)
+{
+    boost::asio::io_context io_context;
+
+    std::vector<std::string> statements;
+    conet::MysqlFakeServerOptions server_options;
+    server_options.handler = [&statements] (const std::string &sql)
+        {
+            statements.push_back(sql);
+            return conet::MysqlFakeResult();
+        };
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    mysql_fake_server.set_options(server_options);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlBulkLoadOptions options;
+    options.max_buffer_size = 256;
+    auto loader = std::make_unique<conet::MysqlBulkLoader>("t", std::vector<std::string>{"id", "name"}, options);
+    ASSERT_TRUE(loader->start("127.0.0.1", mysql_fake_server.port(), "root", "", "test"));
+
+    auto has_statement = [&statements] (const std::string &sql)
+        {
+            return std::find(statements.begin(), statements.end(), sql) != statements.end();
+        };
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            // more than the buffer holds, part of the rows has been handed to the load thread
+            for (int i=0; i<100; ++i)
+            {
+                std::vector<std::optional<std::string>> values = {std::to_string(i), "name"};
+                auto add_result = co_await loader->add_row(values);
+                EXPECT_TRUE(add_result) << add_result.error_info();
+            }
+
+            // abandoned halfway, the destructor does not wait for the load thread
+            loader.reset();
+
+            for (int i=0; i<100 && !has_statement("ROLLBACK"); ++i)
+            {
+                boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(10));
+                co_await timer.async_wait(boost::asio::use_awaitable);
+            }
+            ++check_point;
+
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_GT(mysql_fake_server.local_infile_size(), 0);
+    EXPECT_TRUE(has_statement("START TRANSACTION"));
+    EXPECT_TRUE(has_statement("ROLLBACK"));
+    EXPECT_FALSE(has_statement("COMMIT"));
+}
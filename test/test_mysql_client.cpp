@@ -0,0 +1,250 @@
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/mysql_bulk_insert.h"
+#include "conet/mysql_client.h"
+#include "conet/mysql_client_pool.h"
+#include "conet/mysql_fake_server.h"
+
+TEST(MysqlClientTest, SplitStatements)
+{
+    auto statements = conet::MysqlFakeServer::split_statements("select 1; select ';'  ;\n insert into t values (\"a\\\";\");");
+    ASSERT_EQ(statements.size(), 3);
+    EXPECT_EQ(statements[0], "select 1");
+    EXPECT_EQ(statements[1], "select ';'");
+    EXPECT_EQ(statements[2], "insert into t values (\"a\\\";\")");
+}
+
+TEST(MysqlClientTest, QueryFakeServer)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServerOptions options;
+    options.row_number = 3;
+    options.column_number = 2;
+    options.value_size = 4;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    mysql_fake_server.set_options(options);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            conet::MysqlClient mysql_client;
+            auto connect_result = co_await mysql_client.connect("127.0.0.1", mysql_fake_server.port(), "root", "password", "test");
+            EXPECT_TRUE(connect_result) << connect_result.error_info();
+
+            auto query_result = co_await mysql_client.query("select * from t");
+            EXPECT_TRUE(query_result) << query_result.error_info();
+            EXPECT_EQ(query_result.value().size(), 3);
+            for (const auto &row : query_result.value())
+            {
+                EXPECT_EQ(row.get<std::string>("c1"), "xxxx");
+            }
+
+            auto ping_result = co_await mysql_client.ping();
+            EXPECT_TRUE(ping_result) << ping_result.error_info();
+            ++check_point;
+
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(mysql_fake_server.query_number(), 2);
+}
+
+TEST(MysqlClientTest, BatchQueryStopsAtError)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServerOptions options;
+    options.handler = [] (const std::string &sql)
+        {
+            conet::MysqlFakeResult query_result;
+            if (sql == "bad")
+            {
+                query_result.error_number = 1064;
+                query_result.error_message = "syntax error";
+            }
+            else if (sql.starts_with("select"))
+            {
+                query_result.columns = {"a"};
+                query_result.rows = {{"1"}, {std::nullopt}};
+            }
+            return query_result;
+        };
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    mysql_fake_server.set_options(options);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            conet::MysqlClient mysql_client;
+            auto connect_result = co_await mysql_client.connect("127.0.0.1", mysql_fake_server.port(), "root", "", "test");
+            EXPECT_TRUE(connect_result) << connect_result.error_info();
+
+            std::vector<std::string> sqls = {"select a", "insert into t values (1)", "bad", "select a"};
+            auto batch_result = co_await mysql_client.batch_query(sqls);
+            EXPECT_TRUE(batch_result) << batch_result.error_info();
+
+            const auto &results = batch_result.value();
+            EXPECT_EQ(results.size(), 4);
+            EXPECT_TRUE(results[0]);
+            EXPECT_EQ(results[0].value().size(), 2);
+            EXPECT_TRUE(results[1]);
+            EXPECT_FALSE(results[2]);
+            EXPECT_EQ(results[3].error_info().error_code().value(), conet::error::statement_not_executed);
+
+            // the connection is still usable
+            auto query_result = co_await mysql_client.query("select a");
+            EXPECT_TRUE(query_result) << query_result.error_info();
+            EXPECT_FALSE(mysql_client.is_broken());
+            ++check_point;
+
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(MysqlClientTest, QuoteIdentifier)
+{
+    EXPECT_EQ(conet::MysqlBulkInsertBuilder::quote_identifier("name"), "`name`");
+    EXPECT_EQ(conet::MysqlBulkInsertBuilder::quote_identifier("a`b"), "`a``b`");
+    EXPECT_EQ(conet::MysqlBulkInsertBuilder::quote_identifier("`"), "````");
+}
+
+TEST(MysqlClientTest, BulkInsert)
+{
+    boost::asio::io_context io_context;
+
+    std::vector<std::string> executed_sqls;
+    conet::MysqlFakeServerOptions options;
+    options.handler = [&executed_sqls] (const std::string &sql)
+        {
+            executed_sqls.push_back(sql);
+            return conet::MysqlFakeResult();
+        };
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    mysql_fake_server.set_options(options);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            conet::MysqlClient mysql_client;
+            auto connect_result = co_await mysql_client.connect("127.0.0.1", mysql_fake_server.port(), "root", "", "test");
+            EXPECT_TRUE(connect_result) << connect_result.error_info();
+
+            // nothing to send, no round trip
+            auto empty_result = co_await mysql_client.batch_query(std::vector<std::string>());
+            EXPECT_TRUE(empty_result) << empty_result.error_info();
+            EXPECT_TRUE(empty_result.value().empty());
+            EXPECT_EQ(mysql_fake_server.query_number(), 0);
+
+            const std::string suffix = " ON DUPLICATE KEY UPDATE `id`=VALUES(`id`)";
+            const std::string first_statement = "INSERT INTO `t``x` (`id`,`na``me`) VALUES ('1','it\\'s'),('2',NULL)" + suffix;
+            const std::string second_statement = "INSERT INTO `t``x` (`id`,`na``me`) VALUES ('3','c')" + suffix;
+
+            // the first two rows fill a statement exactly
+            conet::MysqlBulkInsertBuilder builder(mysql_client, "t`x", {"id", "na`me"}, first_statement.size());
+            builder.set_suffix("ON DUPLICATE KEY UPDATE `id`=VALUES(`id`)");
+            EXPECT_TRUE(builder.add_row({"1", "it's"}));
+            EXPECT_TRUE(builder.add_row({"2", std::nullopt}));
+            EXPECT_TRUE(builder.add_row({"3", "c"}));
+            EXPECT_FALSE(builder.add_row({"4"}));
+            EXPECT_EQ(builder.row_number(), 3);
+            EXPECT_EQ(builder.statement_number(), 2);
+
+            auto statements = builder.statements();
+            EXPECT_EQ(statements, (std::vector<std::string>{first_statement, second_statement}));
+
+            auto batch_result = co_await mysql_client.batch_query(statements);
+            EXPECT_TRUE(batch_result) << batch_result.error_info();
+            EXPECT_EQ(batch_result.value().size(), 2);
+            for (const auto &statement_result : batch_result.value())
+            {
+                EXPECT_TRUE(statement_result) << statement_result.error_info();
+            }
+            EXPECT_EQ(executed_sqls, statements);
+
+            builder.clear();
+            EXPECT_EQ(builder.row_number(), 0);
+            EXPECT_TRUE(builder.statements().empty());
+            ++check_point;
+
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(MysqlClientTest, PoolSharesConnections)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+
+    const int worker_number = 8;
+    int finished_number = 0;
+    int success_number = 0;
+    auto worker = [&] () -> boost::asio::awaitable<void>
+        {
+            for (int i=0; i<10; ++i)
+            {
+                auto get_result = co_await mysql_client_pool.get();
+                EXPECT_TRUE(get_result) << get_result.error_info();
+                if (!get_result)
+                    continue;
+
+                auto query_result = co_await get_result.value()->query("select 1");
+                if (query_result)
+                    ++success_number;
+            }
+
+            if (++finished_number == worker_number)
+            {
+                mysql_client_pool.close();
+                mysql_fake_server.close();
+            }
+        };
+
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            for (int i=0; i<worker_number; ++i)
+            {
+                boost::asio::co_spawn(io_context, worker(), boost::asio::detached);
+            }
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(success_number, worker_number * 10);
+    EXPECT_LE(mysql_client_pool.stats().created_number, 2);
+}
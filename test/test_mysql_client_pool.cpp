@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <memory>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/error.h"
+#include "conet/metrics.h"
+#include "conet/mysql_client_pool.h"
+#include "conet/mysql_fake_server.h"
+
+TEST(MysqlClientPoolTest, WaitersAreServedInOrder)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+
+    const int waiter_number = 3;
+    std::vector<int> served_order;
+    auto waiter = [&] (int i) -> boost::asio::awaitable<void>
+        {
+            auto get_result = co_await mysql_client_pool.get();
+            EXPECT_TRUE(get_result) << get_result.error_info();
+            served_order.push_back(i);
+
+            // hold the connection a little, the next waiter must not overtake
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(5));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+
+            if (static_cast<int>(served_order.size()) == waiter_number)
+            {
+                mysql_client_pool.close();
+                mysql_fake_server.close();
+            }
+        };
+
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 1);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            auto holder = co_await mysql_client_pool.get();
+            EXPECT_TRUE(holder) << holder.error_info();
+
+            for (int i=0; i<waiter_number; ++i)
+            {
+                boost::asio::co_spawn(io_context, waiter(i), boost::asio::detached);
+            }
+
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(20));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            EXPECT_EQ(mysql_client_pool.stats().waiting_number, waiter_number);
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    std::vector<int> expect_order = {0, 1, 2};
+    EXPECT_EQ(served_order, expect_order);
+    EXPECT_EQ(mysql_client_pool.stats().created_number, 1);
+    EXPECT_FALSE(mysql_client_pool.is_maintaining());
+}
+
+TEST(MysqlClientPoolTest, AcquireTimeout)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlClientPoolOptions options;
+    options.acquire_timeout = std::chrono::milliseconds(30);
+    mysql_client_pool.set_options(options);
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 1);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            auto holder = co_await mysql_client_pool.get();
+            EXPECT_TRUE(holder) << holder.error_info();
+
+            auto start_time = std::chrono::steady_clock::now();
+            auto get_result = co_await mysql_client_pool.get();
+            EXPECT_FALSE(get_result);
+            EXPECT_EQ(get_result.error_info().error_code(), boost::system::error_code(conet::error::acquire_timeout, conet::error::mysql_category()));
+            EXPECT_GE(std::chrono::steady_clock::now() - start_time, options.acquire_timeout);
+
+            auto stats = mysql_client_pool.stats();
+            EXPECT_EQ(stats.acquire_timeout_number, 1);
+            EXPECT_EQ(stats.waiting_number, 0);
+            check_point = 1;
+
+            mysql_client_pool.close();
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(MysqlClientPoolTest, IdleEviction)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlClientPoolOptions options;
+    options.min_idle_number = 1;
+    options.idle_timeout = std::chrono::milliseconds(20);
+    options.maintenance_interval = std::chrono::milliseconds(10);
+    mysql_client_pool.set_options(options);
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 3, 3);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+            EXPECT_EQ(mysql_client_pool.stats().idle_number, 3);
+            EXPECT_TRUE(mysql_client_pool.is_maintaining());
+
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(100));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+
+            auto stats = mysql_client_pool.stats();
+            EXPECT_EQ(stats.idle_number, 1);
+            EXPECT_EQ(stats.current_number, 1);
+            EXPECT_EQ(stats.evicted_number, 2);
+            check_point = 1;
+
+            mysql_client_pool.close();
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_FALSE(mysql_client_pool.is_maintaining());
+}
+
+TEST(MysqlClientPoolTest, DestroyWhileMaintaining)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    auto mysql_client_pool = std::make_unique<conet::MysqlClientPool>(io_context);
+    conet::MysqlClientPoolOptions options;
+    options.maintenance_interval = std::chrono::milliseconds(10);
+    mysql_client_pool->set_options(options);
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool->init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+            EXPECT_TRUE(mysql_client_pool->is_maintaining());
+
+            // the maintenance and a connection still checked out outlive the pool
+            auto get_result = co_await mysql_client_pool->get();
+            EXPECT_TRUE(get_result) << get_result.error_info();
+            auto mysql_client = std::move(get_result).value();
+
+            mysql_client_pool.reset();
+
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(30));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            auto query_result = co_await mysql_client->query("select 1");
+            EXPECT_TRUE(query_result) << query_result.error_info();
+            mysql_client.reset();
+            check_point = 1;
+
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(MysqlClientPoolTest, MetricsPerPool)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    // the same server, like the shards of a ShardedMysqlClientPool
+    conet::MysqlClientPool first_pool(io_context);
+    conet::MysqlClientPool second_pool(io_context);
+    EXPECT_NE(first_pool.pool_id(), second_pool.pool_id());
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto first_result = co_await first_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 1);
+            EXPECT_TRUE(first_result) << first_result.error_info();
+            auto second_result = co_await second_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 2, 2);
+            EXPECT_TRUE(second_result) << second_result.error_info();
+
+            std::set<conet::MetricLabels> label_group;
+            for (const auto &sample : conet::MetricsRegistry::global().collect())
+            {
+                // pools of other tests may still be registered
+                conet::MetricLabels::value_type port_label("port", std::to_string(mysql_fake_server.port()));
+                if (sample.name != "conet_mysql_pool_connections" ||
+                    std::find(sample.labels.begin(), sample.labels.end(), port_label) == sample.labels.end())
+                    continue;
+
+                EXPECT_TRUE(label_group.insert(sample.labels).second);
+                auto pool_label = std::find_if(sample.labels.begin(), sample.labels.end(), [] (const auto &label) { return label.first == "pool"; });
+                EXPECT_NE(pool_label, sample.labels.end());
+                if (pool_label != sample.labels.end() && pool_label->second == std::to_string(second_pool.pool_id()))
+                    EXPECT_EQ(sample.value, 2);
+            }
+            EXPECT_EQ(label_group.size(), 2);
+            check_point = 1;
+
+            first_pool.close();
+            second_pool.close();
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
@@ -0,0 +1,249 @@
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/mysql_fake_server.h"
+#include "conet/mysql_query_cache.h"
+
+TEST(MysqlQueryCacheTest, NormalizeCollapsesWhitespaceOutsideQuotes)
+{
+    EXPECT_EQ(conet::MysqlQueryCache::normalize("  select *\n from   `t`  where a = ' x  y ' ;  "),
+        "select * from `t` where a = ' x  y '");
+    EXPECT_EQ(conet::MysqlQueryCache::normalize("select 1"), "select 1");
+}
+
+TEST(MysqlQueryCacheTest, ExtractTables)
+{
+    std::vector<std::string> expect_tables = {"a", "b", "c"};
+    EXPECT_EQ(conet::MysqlQueryCache::extract_tables("select * from a, b as x, db.c where a.id=1"), expect_tables);
+    EXPECT_EQ(conet::MysqlQueryCache::extract_tables("select * from `A` join b on a.x=b.x left join c using(id)"), expect_tables);
+
+    std::vector<std::string> expect_update_tables = {"t"};
+    EXPECT_EQ(conet::MysqlQueryCache::extract_tables("update t set x='from y'"), expect_update_tables);
+
+    EXPECT_TRUE(conet::MysqlQueryCache::extract_tables("select 1").empty());
+}
+
+TEST(MysqlQueryCacheTest, TtlExpiry)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlQueryCache mysql_query_cache(mysql_client_pool);
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 1);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            for (int i=0; i<2; ++i)
+            {
+                auto query_result = co_await mysql_query_cache.query("select * from t", std::chrono::milliseconds(30));
+                EXPECT_TRUE(query_result) << query_result.error_info();
+            }
+            EXPECT_EQ(mysql_fake_server.query_number(), 1);
+
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(40));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+
+            auto query_result = co_await mysql_query_cache.query("select * from t", std::chrono::milliseconds(30));
+            EXPECT_TRUE(query_result) << query_result.error_info();
+            EXPECT_EQ(mysql_fake_server.query_number(), 2);
+
+            auto stats = mysql_query_cache.stats();
+            EXPECT_EQ(stats.hit_number, 1);
+            EXPECT_EQ(stats.miss_number, 2);
+            EXPECT_EQ(stats.entry_number, 1);
+            check_point = 1;
+
+            mysql_client_pool.close();
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(MysqlQueryCacheTest, LruEviction)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    // sizes one entry, the queries below all cost the same
+    conet::MysqlQueryCache probe_cache(mysql_client_pool);
+    std::unique_ptr<conet::MysqlQueryCache> mysql_query_cache;
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 1);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            auto probe_result = co_await probe_cache.query("select * from t0", std::chrono::seconds(10));
+            EXPECT_TRUE(probe_result) << probe_result.error_info();
+            auto entry_size = probe_cache.stats().memory_size;
+            EXPECT_GT(entry_size, 0);
+
+            // room for two entries
+            conet::MysqlQueryCacheOptions options;
+            options.memory_budget = entry_size * 2 + entry_size / 2;
+            mysql_query_cache = std::make_unique<conet::MysqlQueryCache>(mysql_client_pool, options);
+
+            auto query = [&] (const std::string &sql) -> boost::asio::awaitable<void>
+                {
+                    auto query_result = co_await mysql_query_cache->query(sql, std::chrono::seconds(10));
+                    EXPECT_TRUE(query_result) << query_result.error_info();
+                };
+
+            co_await query("select * from t1");
+            co_await query("select * from t2");
+            // t1 becomes the most recent, t3 evicts t2
+            co_await query("select * from t1");
+            co_await query("select * from t3");
+            EXPECT_EQ(mysql_fake_server.query_number(), 4);
+
+            auto stats = mysql_query_cache->stats();
+            EXPECT_EQ(stats.evicted_number, 1);
+            EXPECT_EQ(stats.entry_number, 2);
+            EXPECT_LE(stats.memory_size, options.memory_budget);
+
+            co_await query("select * from t1");
+            EXPECT_EQ(mysql_fake_server.query_number(), 4);
+            co_await query("select * from t2");
+            EXPECT_EQ(mysql_fake_server.query_number(), 5);
+            check_point = 1;
+
+            mysql_client_pool.close();
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(MysqlQueryCacheTest, InvalidateTable)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlQueryCache mysql_query_cache(mysql_client_pool);
+
+    const std::string join_sql = "select * from a join b on a.id=b.id";
+    const std::string c_sql = "select * from c";
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 1);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            EXPECT_TRUE(co_await mysql_query_cache.query(join_sql, std::chrono::seconds(10)));
+            EXPECT_TRUE(co_await mysql_query_cache.query(c_sql, std::chrono::seconds(10)));
+            EXPECT_EQ(mysql_fake_server.query_number(), 2);
+
+            // case insensitive, only the entries reading the table go
+            mysql_query_cache.invalidate_table("B");
+            EXPECT_EQ(mysql_query_cache.stats().entry_number, 1);
+            EXPECT_TRUE(co_await mysql_query_cache.query(c_sql, std::chrono::seconds(10)));
+            EXPECT_EQ(mysql_fake_server.query_number(), 2);
+            EXPECT_TRUE(co_await mysql_query_cache.query(join_sql, std::chrono::seconds(10)));
+            EXPECT_EQ(mysql_fake_server.query_number(), 3);
+
+            // invalidated while the query is running, the result is returned but not cached
+            auto options = mysql_fake_server.options();
+            options.latency = std::chrono::milliseconds(20);
+            mysql_fake_server.set_options(options);
+            mysql_query_cache.invalidate_all();
+            boost::asio::co_spawn(io_context, [&] () -> boost::asio::awaitable<void>
+                {
+                    boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(5));
+                    co_await timer.async_wait(boost::asio::use_awaitable);
+                    mysql_query_cache.invalidate_table("c");
+                }, boost::asio::detached);
+            EXPECT_TRUE(co_await mysql_query_cache.query(c_sql, std::chrono::seconds(10)));
+            EXPECT_EQ(mysql_query_cache.stats().entry_number, 0);
+            EXPECT_TRUE(co_await mysql_query_cache.query(c_sql, std::chrono::seconds(10)));
+            EXPECT_EQ(mysql_fake_server.query_number(), 5);
+            check_point = 1;
+
+            mysql_client_pool.close();
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(MysqlQueryCacheTest, CoalesceMisses)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    conet::MysqlFakeServerOptions server_options;
+    server_options.latency = std::chrono::milliseconds(20);
+    mysql_fake_server.set_options(server_options);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlQueryCache mysql_query_cache(mysql_client_pool);
+
+    const int query_number = 10;
+    int success_number = 0;
+    auto query = [&] () -> boost::asio::awaitable<void>
+        {
+            // the same key after normalize
+            std::vector<std::string> params = {"1"};
+            auto query_result = co_await mysql_query_cache.query("select *  from t where id = ?", params, std::chrono::seconds(10));
+            EXPECT_TRUE(query_result) << query_result.error_info();
+            if (query_result)
+                ++success_number;
+
+            if (success_number == query_number)
+            {
+                mysql_client_pool.close();
+                mysql_fake_server.close();
+            }
+        };
+
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            for (int i=0; i<query_number; ++i)
+            {
+                boost::asio::co_spawn(io_context, query(), boost::asio::detached);
+            }
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(success_number, query_number);
+    EXPECT_EQ(mysql_fake_server.query_number(), 1);
+    auto stats = mysql_query_cache.stats();
+    EXPECT_EQ(stats.miss_number, 1);
+    EXPECT_EQ(stats.coalesced_number, query_number - 1);
+}
@@ -0,0 +1,278 @@
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/mysql_fake_server.h"
+#include "conet/mysql_routing_pool.h"
+
+namespace {
+
+// counts the statements a server runs, the lag checks excepted
+conet::MysqlFakeServerOptions make_counting_options(int &statement_number, const std::string &lag)
+{
+    conet::MysqlFakeServerOptions options;
+    options.handler = [&statement_number, &lag] (const std::string &sql)
+        {
+            conet::MysqlFakeResult result;
+            if (sql.find("STATUS") != std::string::npos)
+            {
+                result.columns = {"Seconds_Behind_Source"};
+                result.rows = {{lag}};
+                return result;
+            }
+
+            ++statement_number;
+            result.columns = {"c0"};
+            result.rows = {{"1"}};
+            return result;
+        };
+    return options;
+}
+
+conet::MysqlEndpoint make_endpoint(const conet::MysqlFakeServer &mysql_fake_server)
+{
+    conet::MysqlEndpoint endpoint;
+    endpoint.host = "127.0.0.1";
+    endpoint.port = mysql_fake_server.port();
+    endpoint.user = "root";
+    endpoint.database = "test";
+    return endpoint;
+}
+
+} // namespace
+
+TEST(MysqlRoutingPoolTest, ReadStatement)
+{
+    EXPECT_TRUE(conet::MysqlRoutingPool::is_read_statement("select * from `test`"));
+    EXPECT_TRUE(conet::MysqlRoutingPool::is_read_statement("  SELECT 1"));
+    EXPECT_TRUE(conet::MysqlRoutingPool::is_read_statement("/* hint */ select 1"));
+    EXPECT_TRUE(conet::MysqlRoutingPool::is_read_statement("-- comment\nselect 1"));
+    EXPECT_TRUE(conet::MysqlRoutingPool::is_read_statement("show tables"));
+    EXPECT_TRUE(conet::MysqlRoutingPool::is_read_statement("with t as (select 1) select * from t"));
+}
+
+TEST(MysqlRoutingPoolTest, WriteStatement)
+{
+    EXPECT_FALSE(conet::MysqlRoutingPool::is_read_statement("insert into `test`(`name`) VALUES ('hello')"));
+    EXPECT_FALSE(conet::MysqlRoutingPool::is_read_statement("update `test` set `name`='a'"));
+    EXPECT_FALSE(conet::MysqlRoutingPool::is_read_statement("selectx"));
+    EXPECT_FALSE(conet::MysqlRoutingPool::is_read_statement("select * from `test` for update"));
+    EXPECT_FALSE(conet::MysqlRoutingPool::is_read_statement("select * from `test` lock in share mode"));
+    EXPECT_FALSE(conet::MysqlRoutingPool::is_read_statement("select * from `test` into outfile '/tmp/test.txt'"));
+    EXPECT_FALSE(conet::MysqlRoutingPool::is_read_statement("SELECT `name` FROM `test` LIMIT 1 INTO DUMPFILE '/tmp/name'"));
+    EXPECT_FALSE(conet::MysqlRoutingPool::is_read_statement("with t as (select 1) select * from t into outfile '/tmp/t.txt'"));
+    EXPECT_FALSE(conet::MysqlRoutingPool::is_read_statement(""));
+}
+
+TEST(MysqlRoutingPoolTest, RouteAndPin)
+{
+    boost::asio::io_context io_context;
+
+    int primary_number = 0;
+    int replica_number = 0;
+    std::string lag = "0";
+
+    conet::MysqlFakeServer primary_server(io_context);
+    primary_server.set_options(make_counting_options(primary_number, lag));
+    ASSERT_TRUE(primary_server.listen("127.0.0.1", 0));
+    primary_server.start();
+
+    conet::MysqlFakeServer replica_server(io_context);
+    replica_server.set_options(make_counting_options(replica_number, lag));
+    ASSERT_TRUE(replica_server.listen("127.0.0.1", 0));
+    replica_server.start();
+
+    conet::MysqlRoutingPool mysql_routing_pool(io_context);
+    conet::MysqlRoutingPoolOptions options;
+    options.lag_check_interval = std::chrono::milliseconds(10);
+    mysql_routing_pool.set_options(options);
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            std::vector<conet::MysqlEndpoint> replicas = {make_endpoint(replica_server)};
+            auto init_result = co_await mysql_routing_pool.init(make_endpoint(primary_server), replicas, 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(30));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            auto replica_stats = mysql_routing_pool.replica_stats();
+            EXPECT_EQ(replica_stats.size(), 1);
+            EXPECT_EQ(replica_stats[0].lag_seconds, 0);
+            EXPECT_TRUE(replica_stats[0].is_available);
+
+            auto query = [&] (const std::string &sql) -> boost::asio::awaitable<void>
+                {
+                    auto query_result = co_await mysql_routing_pool.query(sql);
+                    EXPECT_TRUE(query_result) << query_result.error_info();
+                };
+
+            co_await query("select 1");
+            EXPECT_EQ(replica_number, 1);
+            co_await query("insert into t values(1)");
+            co_await query("select * from t for update");
+            co_await query("select * from t into outfile '/tmp/t.txt'");
+            EXPECT_EQ(primary_number, 3);
+            EXPECT_EQ(replica_number, 1);
+
+            // reads of a session go to the primary after its first write
+            auto session = mysql_routing_pool.session();
+            EXPECT_TRUE(co_await session.query("select 1"));
+            EXPECT_EQ(replica_number, 2);
+            EXPECT_TRUE(co_await session.query("update t set a=1"));
+            EXPECT_TRUE(session.is_pinned());
+            EXPECT_TRUE(co_await session.query("select 1"));
+            EXPECT_EQ(primary_number, 5);
+            EXPECT_EQ(replica_number, 2);
+
+            // an other session is not pinned
+            auto other_session = mysql_routing_pool.session();
+            EXPECT_TRUE(co_await other_session.query("select 1"));
+            EXPECT_EQ(replica_number, 3);
+            check_point = 1;
+
+            mysql_routing_pool.close();
+            primary_server.close();
+            replica_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_FALSE(mysql_routing_pool.is_maintaining());
+}
+
+TEST(MysqlRoutingPoolTest, LagExclusion)
+{
+    boost::asio::io_context io_context;
+
+    int primary_number = 0;
+    int replica_number = 0;
+    std::string primary_lag = "0";
+    std::string lag = "100";
+
+    conet::MysqlFakeServer primary_server(io_context);
+    primary_server.set_options(make_counting_options(primary_number, primary_lag));
+    ASSERT_TRUE(primary_server.listen("127.0.0.1", 0));
+    primary_server.start();
+
+    conet::MysqlFakeServer replica_server(io_context);
+    replica_server.set_options(make_counting_options(replica_number, lag));
+    ASSERT_TRUE(replica_server.listen("127.0.0.1", 0));
+    replica_server.start();
+
+    conet::MysqlRoutingPool mysql_routing_pool(io_context);
+    conet::MysqlRoutingPoolOptions options;
+    options.max_replication_lag = std::chrono::seconds(5);
+    options.lag_check_interval = std::chrono::milliseconds(10);
+    mysql_routing_pool.set_options(options);
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            std::vector<conet::MysqlEndpoint> replicas = {make_endpoint(replica_server)};
+            auto init_result = co_await mysql_routing_pool.init(make_endpoint(primary_server), replicas, 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            auto wait_check = [&] () -> boost::asio::awaitable<void>
+                {
+                    boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(30));
+                    co_await timer.async_wait(boost::asio::use_awaitable);
+                };
+
+            // lagging, reads fall back to the primary
+            co_await wait_check();
+            auto replica_stats = mysql_routing_pool.replica_stats();
+            EXPECT_EQ(replica_stats[0].lag_seconds, 100);
+            EXPECT_FALSE(replica_stats[0].is_available);
+            EXPECT_TRUE(co_await mysql_routing_pool.query("select 1"));
+            EXPECT_EQ(primary_number, 1);
+            EXPECT_EQ(replica_number, 0);
+
+            // not a number, the lag is unknown
+            lag = "abc";
+            co_await wait_check();
+            replica_stats = mysql_routing_pool.replica_stats();
+            EXPECT_EQ(replica_stats[0].lag_seconds, -1);
+            EXPECT_FALSE(replica_stats[0].is_available);
+
+            // caught up
+            lag = "1";
+            co_await wait_check();
+            replica_stats = mysql_routing_pool.replica_stats();
+            EXPECT_EQ(replica_stats[0].lag_seconds, 1);
+            EXPECT_TRUE(replica_stats[0].is_available);
+            EXPECT_TRUE(co_await mysql_routing_pool.query("select 1"));
+            EXPECT_EQ(primary_number, 1);
+            EXPECT_EQ(replica_number, 1);
+            check_point = 1;
+
+            mysql_routing_pool.close();
+            primary_server.close();
+            replica_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_FALSE(mysql_routing_pool.is_maintaining());
+}
+
+TEST(MysqlRoutingPoolTest, InitOnceAndDestroyWhileCheckingLag)
+{
+    boost::asio::io_context io_context;
+
+    int primary_number = 0;
+    int replica_number = 0;
+    std::string lag = "0";
+
+    conet::MysqlFakeServer primary_server(io_context);
+    primary_server.set_options(make_counting_options(primary_number, lag));
+    ASSERT_TRUE(primary_server.listen("127.0.0.1", 0));
+    primary_server.start();
+
+    conet::MysqlFakeServer replica_server(io_context);
+    replica_server.set_options(make_counting_options(replica_number, lag));
+    ASSERT_TRUE(replica_server.listen("127.0.0.1", 0));
+    replica_server.start();
+
+    auto mysql_routing_pool = std::make_unique<conet::MysqlRoutingPool>(io_context);
+    conet::MysqlRoutingPoolOptions options;
+    options.lag_check_interval = std::chrono::milliseconds(10);
+    mysql_routing_pool->set_options(options);
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            std::vector<conet::MysqlEndpoint> replicas = {make_endpoint(replica_server)};
+            auto init_result = co_await mysql_routing_pool->init(make_endpoint(primary_server), replicas, 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            auto again_result = co_await mysql_routing_pool->init(make_endpoint(primary_server), replicas, 1, 2);
+            EXPECT_FALSE(again_result);
+            EXPECT_EQ(mysql_routing_pool->replica_stats().size(), 1);
+
+            // the lag check and a replica connection still checked out outlive the pool
+            auto get_result = co_await mysql_routing_pool->get_replica();
+            EXPECT_TRUE(get_result) << get_result.error_info();
+            auto mysql_client = std::move(get_result).value();
+            mysql_routing_pool.reset();
+
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(30));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            mysql_client.reset();
+            check_point = 1;
+
+            primary_server.close();
+            replica_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+}
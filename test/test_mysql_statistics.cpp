@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <thread>
+
+#include "conet/mysql_statistics.h"
+
+TEST(MysqlStatisticsTest, Fingerprint)
+{
+    EXPECT_EQ(conet::MysqlStatistics::fingerprint("SELECT * FROM t WHERE id = 5 AND name='a''b' ;"), "select * from t where id = ? and name=?");
+    EXPECT_EQ(conet::MysqlStatistics::fingerprint("select *  from t where id in (1, 2,3)"), "select * from t where id in (?)");
+    EXPECT_EQ(conet::MysqlStatistics::fingerprint("select `Col1` from t2 where x=\"a\\\"b\""), "select `Col1` from t2 where x=?");
+}
+
+TEST(MysqlStatisticsTest, RecordAndSlowQuery)
+{
+    auto &statistics = conet::MysqlStatistics::instance();
+    statistics.reset();
+
+    conet::MysqlStatisticsOptions options;
+    options.is_enabled = true;
+    options.slow_query_threshold = std::chrono::milliseconds(1);
+    options.slow_query_log_capacity = 1;
+    statistics.set_options(options);
+
+    // 2ms of the 3ms execute phase were spent in queue
+    std::chrono::steady_clock::duration queue_time(0);
+    conet::MysqlQueryTimer timer(queue_time);
+    timer.start();
+    queue_time += std::chrono::milliseconds(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    timer.stop(conet::MysqlQueryPhase::execute);
+    EXPECT_EQ(timer.phases()[static_cast<std::size_t>(conet::MysqlQueryPhase::queue)], std::chrono::milliseconds(2));
+
+    statistics.record("select 1", timer, 1, true);
+    statistics.record("select 2", timer, 1, false);
+
+    std::uint64_t count = 0;
+    std::uint64_t error_number = 0;
+    statistics.for_each_statement([&](const std::string &fingerprint, const conet::MysqlStatementStatistics &s)
+    {
+        EXPECT_EQ(fingerprint, "select ?");
+        count += s.total.count();
+        error_number += s.error_number;
+        EXPECT_GE(s.phase_sums[static_cast<std::size_t>(conet::MysqlQueryPhase::queue)].load(), 4000);
+    });
+    EXPECT_EQ(count, 2);
+    EXPECT_EQ(error_number, 1);
+    EXPECT_EQ(statistics.phase_histogram(conet::MysqlQueryPhase::queue).count(), 2);
+
+    auto slow_queries = statistics.slow_queries();
+    ASSERT_EQ(slow_queries.size(), 1);
+    EXPECT_EQ(slow_queries[0].sql, "select 2");
+
+    statistics.reset();
+    statistics.set_options({});
+}
+
+TEST(MysqlStatisticsTest, FingerprintLimit)
+{
+    auto &statistics = conet::MysqlStatistics::instance();
+    statistics.reset();
+    EXPECT_FALSE(statistics.is_enabled());
+
+    conet::MysqlStatisticsOptions options;
+    options.is_enabled = true;
+    options.max_fingerprint_number = 1;
+    statistics.set_options(options);
+
+    std::chrono::steady_clock::duration queue_time(0);
+    conet::MysqlQueryTimer timer(queue_time);
+    timer.start();
+    timer.stop(conet::MysqlQueryPhase::execute);
+
+    statistics.record("select 1", timer, 1, true);
+    statistics.record("update t set a=1", timer, 0, true);
+    statistics.record("delete from t", timer, 0, true);
+    statistics.record("select 2", timer, 1, true);
+
+    std::map<std::string, std::uint64_t> counts;
+    statistics.for_each_statement([&](const std::string &fingerprint, const conet::MysqlStatementStatistics &s)
+    {
+        counts[fingerprint] += s.total.count();
+    });
+    std::map<std::string, std::uint64_t> expect_counts = {{"select ?", 2}, {"other", 2}};
+    EXPECT_EQ(counts, expect_counts);
+
+    statistics.reset();
+    statistics.set_options({});
+}
@@ -0,0 +1,348 @@
+#include <memory>
+
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/error.h"
+#include "conet/mysql_client_pool.h"
+#include "conet/mysql_fake_server.h"
+#include "conet/mysql_write_behind.h"
+
+TEST(MysqlWriteBehindTest, MergesInserts)
+{
+    boost::asio::io_context io_context;
+
+    std::vector<std::string> received_sqls;
+    conet::MysqlFakeServerOptions server_options;
+    server_options.handler = [&] (const std::string &sql)
+        {
+            received_sqls.push_back(sql);
+            return conet::MysqlFakeResult{};
+        };
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    mysql_fake_server.set_options(server_options);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlWriteBehindOptions options;
+    options.window = std::chrono::milliseconds(50);
+    conet::MysqlWriteBehind write_behind(mysql_client_pool, options);
+
+    const int writer_number = 10;
+    int finished_number = 0;
+    int success_number = 0;
+    auto writer = [&] (int i) -> boost::asio::awaitable<void>
+        {
+            std::vector<std::string> columns = {"id", "name"};
+            std::vector<std::optional<std::string>> values = {std::to_string(i), std::nullopt};
+            auto insert_result = co_await write_behind.insert("t", columns, values);
+            EXPECT_TRUE(insert_result) << insert_result.error_info();
+            if (insert_result)
+                ++success_number;
+
+            if (++finished_number == writer_number)
+            {
+                mysql_client_pool.close();
+                mysql_fake_server.close();
+            }
+        };
+
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            for (int i=0; i<writer_number; ++i)
+            {
+                boost::asio::co_spawn(io_context, writer(i), boost::asio::detached);
+            }
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(success_number, writer_number);
+    ASSERT_EQ(received_sqls.size(), 1);
+    EXPECT_EQ(received_sqls[0], "INSERT INTO `t` (`id`,`name`) VALUES ('0',NULL),('1',NULL),('2',NULL),('3',NULL),('4',NULL),"
+        "('5',NULL),('6',NULL),('7',NULL),('8',NULL),('9',NULL)");
+
+    auto stats = write_behind.stats();
+    EXPECT_EQ(stats.write_number, writer_number);
+    EXPECT_EQ(stats.batch_number, 1);
+    EXPECT_EQ(stats.pending_number, 0);
+}
+
+TEST(MysqlWriteBehindTest, FailedBatchIsRetried)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServerOptions server_options;
+    server_options.handler = [] (const std::string &sql)
+        {
+            conet::MysqlFakeResult query_result;
+            if (sql.find("bad") != std::string::npos)
+            {
+                query_result.error_number = 1064;
+                query_result.error_message = "syntax error";
+            }
+            return query_result;
+        };
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    mysql_fake_server.set_options(server_options);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlWriteBehindOptions options;
+    options.window = std::chrono::milliseconds(50);
+    conet::MysqlWriteBehind write_behind(mysql_client_pool, options);
+
+    const int writer_number = 4;
+    int finished_number = 0;
+    int success_number = 0;
+    int fail_number = 0;
+    auto writer = [&] (std::string sql) -> boost::asio::awaitable<void>
+        {
+            auto execute_result = co_await write_behind.execute(sql);
+            if (execute_result)
+                ++success_number;
+            else
+                ++fail_number;
+
+            if (++finished_number == writer_number)
+            {
+                mysql_client_pool.close();
+                mysql_fake_server.close();
+            }
+        };
+
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            boost::asio::co_spawn(io_context, writer("update t set a=1"), boost::asio::detached);
+            boost::asio::co_spawn(io_context, writer("update bad"), boost::asio::detached);
+            boost::asio::co_spawn(io_context, writer("update t set a=2"), boost::asio::detached);
+            boost::asio::co_spawn(io_context, writer("update t set a=3"), boost::asio::detached);
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(success_number, 3);
+    EXPECT_EQ(fail_number, 1);
+
+    auto stats = write_behind.stats();
+    EXPECT_EQ(stats.batch_number, 1);
+    EXPECT_EQ(stats.retry_number, 1);
+}
+
+TEST(MysqlWriteBehindTest, FailedMergedInsertIsRetried)
+{
+    boost::asio::io_context io_context;
+
+    std::vector<std::string> received_sqls;
+    conet::MysqlFakeServerOptions server_options;
+    server_options.handler = [&] (const std::string &sql)
+        {
+            received_sqls.push_back(sql);
+            conet::MysqlFakeResult query_result;
+            if (sql.find("'bad'") != std::string::npos)
+            {
+                query_result.error_number = 1366;
+                query_result.error_message = "incorrect value";
+            }
+            return query_result;
+        };
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    mysql_fake_server.set_options(server_options);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlWriteBehindOptions options;
+    options.window = std::chrono::milliseconds(50);
+    conet::MysqlWriteBehind write_behind(mysql_client_pool, options);
+
+    const int writer_number = 5;
+    const int bad_index = 2;
+    int finished_number = 0;
+    std::vector<int> failed_indexes;
+    auto writer = [&] (int i) -> boost::asio::awaitable<void>
+        {
+            std::vector<std::string> columns = {"id", "name"};
+            std::vector<std::optional<std::string>> values = {std::to_string(i), i == bad_index ? "bad" : "good"};
+            auto insert_result = co_await write_behind.insert("t", columns, values);
+            if (!insert_result)
+                failed_indexes.push_back(i);
+
+            if (++finished_number == writer_number)
+            {
+                mysql_client_pool.close();
+                mysql_fake_server.close();
+            }
+        };
+
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            for (int i=0; i<writer_number; ++i)
+            {
+                boost::asio::co_spawn(io_context, writer(i), boost::asio::detached);
+            }
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    // only the caller of the rejected row fails
+    std::vector<int> expect_failed_indexes = {bad_index};
+    EXPECT_EQ(failed_indexes, expect_failed_indexes);
+    // the merged insert, then every row on its own
+    ASSERT_EQ(received_sqls.size(), 1 + writer_number);
+    EXPECT_EQ(received_sqls[1], "INSERT INTO `t` (`id`,`name`) VALUES ('0','good')");
+
+    auto stats = write_behind.stats();
+    EXPECT_EQ(stats.batch_number, 1);
+    EXPECT_EQ(stats.retry_number, 1);
+}
+
+TEST(MysqlWriteBehindTest, CloseFlushesAndRejects)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlWriteBehindOptions options;
+    // only close() sends the writes
+    options.window = std::chrono::seconds(10);
+    conet::MysqlWriteBehind write_behind(mysql_client_pool, options);
+
+    const int writer_number = 3;
+    int success_number = 0;
+    auto writer = [&] (int i) -> boost::asio::awaitable<void>
+        {
+            std::vector<std::string> columns = {"id"};
+            std::vector<std::optional<std::string>> values = {std::to_string(i)};
+            auto insert_result = co_await write_behind.insert("t", columns, values);
+            EXPECT_TRUE(insert_result) << insert_result.error_info();
+            if (insert_result)
+                ++success_number;
+        };
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            for (int i=0; i<writer_number; ++i)
+            {
+                boost::asio::co_spawn(io_context, writer(i), boost::asio::detached);
+            }
+
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(10));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            EXPECT_EQ(write_behind.stats().pending_number, writer_number);
+
+            auto start_time = std::chrono::steady_clock::now();
+            write_behind.close();
+            auto execute_result = co_await write_behind.execute("update t set a=1");
+            EXPECT_FALSE(execute_result);
+            EXPECT_EQ(execute_result.error_info().error_code(), boost::system::error_code(conet::error::pool_closed, conet::error::mysql_category()));
+
+            while (success_number < writer_number)
+            {
+                timer.expires_after(std::chrono::milliseconds(1));
+                co_await timer.async_wait(boost::asio::use_awaitable);
+            }
+            EXPECT_LT(std::chrono::steady_clock::now() - start_time, options.window);
+            check_point = 1;
+
+            mysql_client_pool.close();
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(mysql_fake_server.query_number(), 1);
+    auto stats = write_behind.stats();
+    EXPECT_EQ(stats.write_number, writer_number);
+    EXPECT_EQ(stats.batch_number, 1);
+}
+
+TEST(MysqlWriteBehindTest, DestroyWithWritesInFlight)
+{
+    boost::asio::io_context io_context;
+
+    conet::MysqlFakeServer mysql_fake_server(io_context);
+    conet::MysqlFakeServerOptions server_options;
+    server_options.latency = std::chrono::milliseconds(20);
+    mysql_fake_server.set_options(server_options);
+    ASSERT_TRUE(mysql_fake_server.listen("127.0.0.1", 0));
+    mysql_fake_server.start();
+
+    conet::MysqlClientPool mysql_client_pool(io_context);
+    conet::MysqlWriteBehindOptions options;
+    options.window = std::chrono::seconds(10);
+    auto write_behind = std::make_unique<conet::MysqlWriteBehind>(mysql_client_pool, options);
+
+    int success_number = 0;
+    auto writer = [&] (std::string sql) -> boost::asio::awaitable<void>
+        {
+            auto execute_result = co_await write_behind->execute(sql);
+            EXPECT_TRUE(execute_result) << execute_result.error_info();
+            if (execute_result)
+                ++success_number;
+        };
+
+    int check_point = 0;
+    auto f = [&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", mysql_fake_server.port(), "root", "", "test", 1, 1);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            // one batch in flight, one write pending behind the long window
+            boost::asio::co_spawn(io_context, writer("update t set a=1"), boost::asio::detached);
+            write_behind->flush();
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(5));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            boost::asio::co_spawn(io_context, writer("update t set a=2"), boost::asio::detached);
+            timer.expires_after(std::chrono::milliseconds(5));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            EXPECT_EQ(write_behind->stats().pending_number, 1);
+
+            // on the thread driving the pool, does not wait
+            write_behind.reset();
+
+            while (success_number < 2)
+            {
+                timer.expires_after(std::chrono::milliseconds(1));
+                co_await timer.async_wait(boost::asio::use_awaitable);
+            }
+            check_point = 1;
+
+            mysql_client_pool.close();
+            mysql_fake_server.close();
+        };
+
+    boost::asio::co_spawn(io_context, f(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(check_point, 1);
+    EXPECT_EQ(mysql_fake_server.query_number(), 2);
+}
@@ -0,0 +1,143 @@
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/recycling_allocator.h"
+#include "conet/result.h"
+
+namespace {
+
+// global operator new calls of the current thread while is_counting
+thread_local bool is_counting = false;
+thread_local int allocation_number = 0;
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    if (is_counting)
+        ++allocation_number;
+    if (auto p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    if (is_counting)
+        ++allocation_number;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace {
+
+boost::asio::awaitable<conet::result<int>> leaf(int x)
+{
+    co_return x + 1;
+}
+
+boost::asio::awaitable<conet::result<int>> middle(int x)
+{
+    RESULT_CO_AUTO(y, co_await leaf(x));
+    RESULT_CO_AUTO(z, co_await leaf(y));
+    co_return z;
+}
+
+// completes later on the executor like the mysql initiators, the handler kept by a shared_ptr
+boost::asio::awaitable<conet::result<int>> async_add(int x)
+{
+    return boost::asio::async_initiate<const boost::asio::use_awaitable_t<>, void(conet::result<int>)>(
+        [x]<typename H> (H&& self) mutable
+        {
+            auto handler_ptr = conet::make_recycling_shared<H>(std::forward<H>(self));
+            auto executor = boost::asio::get_associated_executor(*handler_ptr);
+            boost::asio::post(executor, [handler_ptr, x] () mutable
+            {
+                auto&& handler = std::move(*handler_ptr.get());
+                handler(conet::result<int>(x + 1));
+            });
+        }, boost::asio::use_awaitable);
+}
+
+// a request: nested coroutines and an asynchronous operation
+boost::asio::awaitable<conet::result<int>> handle(int x)
+{
+    RESULT_CO_AUTO(y, co_await middle(x));
+    RESULT_CO_AUTO(z, co_await async_add(y));
+    co_return z;
+}
+
+} // namespace
+
+TEST(RecyclingAllocatorTest, Memory)
+{
+    // a new thread starts with an empty cache
+    std::thread([]
+        {
+            auto p1 = conet::RecyclingMemory::allocate(100);
+            conet::RecyclingMemory::deallocate(p1, 100);
+            // same size class
+            auto p2 = conet::RecyclingMemory::allocate(128);
+            EXPECT_EQ(p1, p2);
+            conet::RecyclingMemory::deallocate(p2, 128);
+
+            auto stats = conet::RecyclingMemory::stats();
+            EXPECT_EQ(stats.system_allocation_number, 1);
+            EXPECT_EQ(stats.recycled_number, 1);
+
+            // above max_size
+            auto p3 = conet::RecyclingMemory::allocate(conet::RecyclingMemory::max_size + 1);
+            conet::RecyclingMemory::deallocate(p3, conet::RecyclingMemory::max_size + 1);
+            EXPECT_EQ(conet::RecyclingMemory::stats().system_allocation_number, 1);
+        }).join();
+}
+
+TEST(RecyclingAllocatorTest, SteadyStateNoMalloc)
+{
+#ifndef CONET_RECYCLE_AWAITABLE_FRAME
+    GTEST_SKIP() << "awaitable frames are not recycled with this asio version";
+#endif
+
+    boost::asio::io_context io_context(1);
+    int sum = 0;
+    int steady_allocation_number = -1;
+
+    boost::asio::co_spawn(io_context, [&] () -> boost::asio::awaitable<void>
+        {
+            // warm up the caches
+            for (int i=0; i<100; ++i)
+            {
+                auto r = co_await handle(i);
+                sum += r.value();
+            }
+
+            allocation_number = 0;
+            is_counting = true;
+            for (int i=0; i<1000; ++i)
+            {
+                auto r = co_await handle(i);
+                sum += r.value();
+            }
+            is_counting = false;
+            steady_allocation_number = allocation_number;
+        }, boost::asio::detached);
+    io_context.run();
+
+    EXPECT_EQ(sum, 1100 * 3 + 99 * 100 / 2 + 999 * 1000 / 2);
+    EXPECT_EQ(steady_allocation_number, 0);
+    EXPECT_GT(conet::RecyclingMemory::stats().recycled_number, 1000);
+}
@@ -1,4 +1,6 @@
+#include <array>
 #include <memory>
+#include <sstream>
 
 #include <gtest/gtest.h>
 
@@ -10,6 +12,19 @@ struct NoDefaultConstructor
     NoDefaultConstructor() = delete;
 };
 
+// counts live instances, has no default constructor like TcpClient or MysqlClient
+struct Counted
+{
+    static inline int live_number = 0;
+
+    explicit Counted(int x) : x(x) { ++live_number; }
+    Counted(const Counted &other) : x(other.x) { ++live_number; }
+    Counted(Counted &&other) : x(other.x) { other.x = 0; ++live_number; }
+    ~Counted() { --live_number; }
+
+    int x;
+};
+
 TEST(ResultTest, ConstructorDefault)
 {
     // void
@@ -100,3 +115,195 @@ TEST(ResultTest, ConstructorCopyCheckErrorCode)
     conet::result<std::unique_ptr<int>> c4(b1);
     EXPECT_EQ(c4.error_info().error_code(), boost::system::error_condition(1, conet::error::conet_category()));
 }
+
+conet::result<Counted> make_counted(int x)
+{
+    if (x < 0)
+    {
+        boost::system::error_code ec(1, conet::error::conet_category());
+        return ec;
+    }
+    return Counted(x);
+}
+
+conet::result<int> add_counted(int x)
+{
+    RESULT_AUTO(counted, make_counted(x));
+    return counted.x + 1;
+}
+
+TEST(ResultTest, NoDefaultConstructorValue)
+{
+    {
+        conet::result<Counted> r1(Counted(1));
+        EXPECT_EQ(Counted::live_number, 1);
+        EXPECT_EQ(r1.value().x, 1);
+
+        // copyable values make a copyable result
+        conet::result<Counted> r2(r1);
+        EXPECT_EQ(Counted::live_number, 2);
+        EXPECT_EQ(r2.value().x, 1);
+
+        conet::result<Counted> r3(std::move(r1));
+        EXPECT_EQ(Counted::live_number, 3);
+        EXPECT_EQ(r3.value().x, 1);
+
+        // no value is constructed without one
+        conet::result<Counted> r4(make_counted(-1));
+        EXPECT_TRUE(r4.has_error());
+        conet::result<Counted> r5(std::move(r4));
+        conet::result<void> r6(r3);
+        conet::result<Counted> r7(r6);
+        EXPECT_FALSE(r7.has_error());
+        EXPECT_EQ(Counted::live_number, 3);
+
+        Counted counted = std::move(r3).value();
+        EXPECT_EQ(counted.x, 1);
+        EXPECT_EQ(Counted::live_number, 4);
+    }
+    EXPECT_EQ(Counted::live_number, 0);
+
+    auto r8 = add_counted(1);
+    EXPECT_EQ(r8.value(), 2);
+    auto r9 = add_counted(-1);
+    EXPECT_TRUE(r9.has_error());
+    EXPECT_EQ(Counted::live_number, 0);
+
+    // in place, not behind a pointer
+    EXPECT_LT(sizeof(conet::result<std::array<char, 256>>), sizeof(conet::result<void>) + 256 + 16);
+}
+
+TEST(ResultTest, Assignment)
+{
+    boost::system::error_code ec(1, conet::error::conet_category());
+
+    // assignable value
+    conet::result<int> a1(1);
+    conet::result<int> a2(ec);
+    a2 = a1;
+    EXPECT_FALSE(a2.has_error());
+    EXPECT_EQ(a2.value(), 1);
+    a1 = conet::result<int>(ec);
+    EXPECT_TRUE(a1.has_error());
+
+    // move-only
+    conet::result<std::unique_ptr<int>> b1(std::make_unique<int>(1));
+    conet::result<std::unique_ptr<int>> b2;
+    b2 = std::move(b1);
+    EXPECT_EQ(*b2.value(), 1);
+    b2 = conet::result<std::unique_ptr<int>>(ec);
+    EXPECT_TRUE(b2.has_error());
+    EXPECT_EQ(b2.value().get(), nullptr);
+
+    {
+        // no assignment and no default constructor, value to error, error to value, value to value
+        conet::result<Counted> c1(Counted(1));
+        conet::result<Counted> c2(make_counted(-1));
+        EXPECT_EQ(Counted::live_number, 1);
+
+        c1 = c2;
+        EXPECT_TRUE(c1.has_error());
+        EXPECT_EQ(Counted::live_number, 0);
+
+        c1 = make_counted(2);
+        EXPECT_FALSE(c1.has_error());
+        EXPECT_EQ(c1.value().x, 2);
+        EXPECT_EQ(Counted::live_number, 1);
+
+        conet::result<Counted> c3(Counted(3));
+        c1 = c3;
+        EXPECT_EQ(c1.value().x, 3);
+        EXPECT_EQ(Counted::live_number, 2);
+
+        c2 = std::move(c3);
+        EXPECT_FALSE(c2.has_error());
+        EXPECT_EQ(c2.value().x, 3);
+        EXPECT_EQ(Counted::live_number, 3);
+
+        auto &self = c2;
+        c2 = self;
+        EXPECT_EQ(c2.value().x, 3);
+        EXPECT_EQ(Counted::live_number, 3);
+    }
+    EXPECT_EQ(Counted::live_number, 0);
+}
+
+TEST(ResultTest, ErrorInfo)
+{
+    // a success is one pointer
+    EXPECT_EQ(sizeof(conet::result<void>), sizeof(void*));
+    conet::result<void> success;
+    EXPECT_FALSE(success.has_error());
+    EXPECT_EQ(success.error_info().error_id(), 0);
+    EXPECT_FALSE(success.error_info().error_code());
+    EXPECT_TRUE(success.error_info().pairs().empty());
+
+    boost::system::error_code ec(1, conet::error::conet_category());
+    conet::ErrorInfo e1(ec);
+    e1.set_error_message("message")
+        .add_pair("string", std::string("a"))
+        .add_pair("literal", "b")
+        .add_pair("int", -42)
+        .add_pair("size", std::size_t(7))
+        .add_pair("bool", true)
+        .add_pair("char", 'c')
+        .add_pair("double", 0.5)
+        .add_pair("code", ec.value())
+        .add_pair("int", 1);
+    conet::ErrorInfo::PairsType pairs = {{"string", "a"}, {"literal", "b"}, {"int", "-42"}, {"size", "7"},
+        {"bool", "1"}, {"char", "c"}, {"double", "0.5"}, {"code", "1"}, {"int", "1"}};
+    EXPECT_EQ(e1.pairs(), pairs);
+
+    std::stringstream ss;
+    ss << e1;
+    EXPECT_NE(ss.str().find(",int[0]: -42,"), std::string::npos) << ss.str();
+    EXPECT_NE(ss.str().find(",int[1]: 1]"), std::string::npos) << ss.str();
+    EXPECT_NE(ss.str().find(",error_message=message"), std::string::npos) << ss.str();
+
+    // copies share the context until one of them changes
+    conet::ErrorInfo e2(e1);
+    EXPECT_EQ(&e1.pairs(), &e2.pairs());
+    e2.add_pair("copy", 2);
+    EXPECT_NE(&e1.pairs(), &e2.pairs());
+    EXPECT_EQ(e1.pairs().size(), pairs.size());
+    EXPECT_EQ(e2.pairs().size(), pairs.size() + 1);
+    EXPECT_EQ(e1.error_id(), e2.error_id());
+    EXPECT_TRUE(e2.has_error());
+
+    conet::ErrorInfo e3;
+    e3 = std::move(e2);
+    EXPECT_FALSE(e2.has_error());
+    EXPECT_EQ(e3.pairs().size(), pairs.size() + 1);
+    e3 = e1;
+    EXPECT_EQ(&e1.pairs(), &e3.pairs());
+}
+
+conet::result<void> fail_after(int depth)
+{
+    if (depth == 0)
+    {
+        boost::system::error_code ec(1, conet::error::conet_category());
+        return ec;
+    }
+    RESULT_CHECK(fail_after(depth - 1));
+    return {};
+}
+
+TEST(ResultTest, ErrorTrail)
+{
+    auto r1 = fail_after(3);
+    EXPECT_TRUE(r1.has_error());
+#ifndef CONET_DISABLE_ERROR_TRAIL
+    ASSERT_EQ(r1.error_info().trail().size(), 3);
+    EXPECT_EQ(r1.error_info().trail()[0], r1.error_info().trail()[2]);
+    EXPECT_NE(std::string(r1.error_info().trail()[0]->file_name()).find("test_result.cpp"), std::string::npos);
+
+    std::stringstream ss;
+    ss << r1.error_info();
+    EXPECT_NE(ss.str().find(",callstack[2]: "), std::string::npos) << ss.str();
+
+    auto r2 = fail_after(conet::ErrorInfo::max_trail_size + 4);
+    EXPECT_EQ(r2.error_info().trail().size(), conet::ErrorInfo::max_trail_size);
+    EXPECT_EQ(r2.error_info().dropped_trail_number(), 4);
+#endif
+}
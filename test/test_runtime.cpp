@@ -0,0 +1,75 @@
+#include <future>
+#include <set>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/runtime.h"
+
+TEST(RuntimeTest, Reactors)
+{
+    conet::RuntimeOptions options;
+    options.reactor_number = 3;
+    options.pin_threads = true;
+    conet::Runtime runtime(options);
+    ASSERT_TRUE(runtime.start());
+    ASSERT_EQ(runtime.size(), 3);
+    EXPECT_EQ(runtime.current_index(), -1);
+
+    std::set<std::thread::id> thread_ids;
+    for (std::size_t i=0; i<runtime.size(); ++i)
+    {
+        EXPECT_GE(runtime.cpu(i), 0);
+
+        std::promise<int> promise;
+        runtime.post(i, [&runtime, &promise, &thread_ids]
+            {
+                thread_ids.insert(std::this_thread::get_id());
+                promise.set_value(runtime.current_index());
+            });
+        EXPECT_EQ(promise.get_future().get(), i);
+    }
+    EXPECT_EQ(thread_ids.size(), 3);
+
+    auto timers = runtime.make_per_reactor<boost::asio::steady_timer>();
+    ASSERT_EQ(timers.size(), 3);
+    EXPECT_TRUE(timers[2]->get_executor() == runtime.executor(2));
+}
+
+TEST(RuntimeTest, RunOn)
+{
+    conet::RuntimeOptions options;
+    options.reactor_number = 2;
+    conet::Runtime runtime(options);
+    ASSERT_TRUE(runtime.start());
+
+    std::promise<std::pair<int, int>> promise;
+    boost::asio::co_spawn(runtime.executor(0), [&runtime, &promise] () -> boost::asio::awaitable<void>
+        {
+            auto remote_index = co_await runtime.run_on(1, [&runtime] () -> boost::asio::awaitable<int>
+                {
+                    co_return runtime.current_index();
+                }());
+            promise.set_value({remote_index, runtime.current_index()});
+        }, boost::asio::detached);
+
+    auto [remote_index, local_index] = promise.get_future().get();
+    EXPECT_EQ(remote_index, 1);
+    EXPECT_EQ(local_index, 0);
+}
+
+TEST(RuntimeTest, Unavailable)
+{
+    conet::RuntimeOptions options;
+    options.cpu_group = {100000};
+    conet::Runtime runtime(options);
+    EXPECT_FALSE(runtime.start());
+    EXPECT_EQ(runtime.size(), 0);
+
+    options.cpu_group.clear();
+    options.numa_node_group = {100000};
+    conet::Runtime numa_runtime(options);
+    EXPECT_FALSE(numa_runtime.start());
+}
@@ -0,0 +1,185 @@
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/mysql_fake_server.h"
+#include "conet/sharded_mysql_client_pool.h"
+
+namespace {
+
+// one io_context and thread per shard, the fake server has a thread of its own
+class ShardThreads
+{
+public:
+    ShardThreads(std::size_t shard_number) :
+        server_work_guard_(boost::asio::make_work_guard(server_io_context_)),
+        mysql_fake_server_(server_io_context_)
+    {
+        for (std::size_t i=0; i<shard_number; ++i)
+        {
+            io_context_group_.push_back(std::make_unique<boost::asio::io_context>(1));
+            executors_.push_back(io_context_group_.back()->get_executor());
+            work_guard_group_.push_back(boost::asio::make_work_guard(*io_context_group_.back()));
+        }
+    }
+
+    bool start()
+    {
+        if (!mysql_fake_server_.listen("127.0.0.1", 0))
+            return false;
+        mysql_fake_server_.start();
+
+        thread_group_.emplace_back([this] { server_io_context_.run(); });
+        for (auto &io_context : io_context_group_)
+        {
+            thread_group_.emplace_back([&io_context] { io_context->run(); });
+        }
+        return true;
+    }
+
+    // runs f on the first shard and waits for it
+    void run(std::function<boost::asio::awaitable<void>()> f)
+    {
+        std::promise<void> promise;
+        boost::asio::co_spawn(*io_context_group_.front(), f(), [&promise] (std::exception_ptr e)
+            {
+                promise.set_value();
+            });
+        promise.get_future().wait();
+    }
+
+    void stop()
+    {
+        boost::asio::post(server_io_context_, [this] { mysql_fake_server_.close(); });
+        server_work_guard_.reset();
+        work_guard_group_.clear();
+        for (auto &t : thread_group_)
+        {
+            t.join();
+        }
+    }
+
+    const std::vector<boost::asio::any_io_executor>& executors() const { return executors_; }
+    unsigned short port() const { return mysql_fake_server_.port(); }
+
+private:
+    boost::asio::io_context server_io_context_;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> server_work_guard_;
+    conet::MysqlFakeServer mysql_fake_server_;
+    std::vector<std::unique_ptr<boost::asio::io_context>> io_context_group_;
+    std::vector<boost::asio::any_io_executor> executors_;
+    std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_guard_group_;
+    std::vector<std::thread> thread_group_;
+};
+
+} // namespace
+
+TEST(ShardedMysqlClientPoolTest, LocalCheckout)
+{
+    ShardThreads shard_threads(1);
+    ASSERT_TRUE(shard_threads.start());
+
+    conet::ShardedMysqlClientPool mysql_client_pool(shard_threads.executors());
+
+    int check_point = 0;
+    shard_threads.run([&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", shard_threads.port(), "root", "", "test", 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            // released on the thread of the shard, the next get() takes it from the free list
+            for (int i=0; i<3; ++i)
+            {
+                auto get_result = co_await mysql_client_pool.get();
+                EXPECT_TRUE(get_result) << get_result.error_info();
+            }
+
+            EXPECT_EQ(mysql_client_pool.local_reuse_number(), 2);
+            auto stats = mysql_client_pool.stats();
+            EXPECT_EQ(stats.created_number, 1);
+            EXPECT_EQ(stats.idle_number, 1);
+            EXPECT_EQ(stats.active_number, 0);
+            check_point = 1;
+
+            mysql_client_pool.close();
+        });
+    shard_threads.stop();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(ShardedMysqlClientPoolTest, CrossShardFallback)
+{
+    ShardThreads shard_threads(2);
+    ASSERT_TRUE(shard_threads.start());
+
+    conet::ShardedMysqlClientPool mysql_client_pool(shard_threads.executors());
+
+    int check_point = 0;
+    shard_threads.run([&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", shard_threads.port(), "root", "", "test", 1, 1);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            {
+                auto local_result = co_await mysql_client_pool.get();
+                EXPECT_TRUE(local_result) << local_result.error_info();
+                EXPECT_EQ(mysql_client_pool.steal_number(), 0);
+
+                // the local shard is full, the idle connection of the other shard is used
+                auto stolen_result = co_await mysql_client_pool.get();
+                EXPECT_TRUE(stolen_result) << stolen_result.error_info();
+                EXPECT_EQ(mysql_client_pool.steal_number(), 1);
+                EXPECT_EQ(mysql_client_pool.stats().created_number, 2);
+                if (stolen_result)
+                {
+                    auto query_result = co_await stolen_result.value()->query("select 1");
+                    EXPECT_TRUE(query_result) << query_result.error_info();
+                }
+                check_point = 1;
+            }
+
+            mysql_client_pool.close();
+        });
+    shard_threads.stop();
+
+    EXPECT_EQ(check_point, 1);
+}
+
+TEST(ShardedMysqlClientPoolTest, LocalShardWithCapacity)
+{
+    ShardThreads shard_threads(2);
+    ASSERT_TRUE(shard_threads.start());
+
+    conet::ShardedMysqlClientPool mysql_client_pool(shard_threads.executors());
+
+    int check_point = 0;
+    shard_threads.run([&] () -> boost::asio::awaitable<void>
+        {
+            auto init_result = co_await mysql_client_pool.init("127.0.0.1", shard_threads.port(), "root", "", "test", 1, 2);
+            EXPECT_TRUE(init_result) << init_result.error_info();
+
+            {
+                auto first_result = co_await mysql_client_pool.get();
+                EXPECT_TRUE(first_result) << first_result.error_info();
+
+                // no idle connection left but a free slot, the local shard connects rather than steal
+                auto second_result = co_await mysql_client_pool.get();
+                EXPECT_TRUE(second_result) << second_result.error_info();
+                EXPECT_EQ(mysql_client_pool.steal_number(), 0);
+                EXPECT_EQ(mysql_client_pool.shard(0).stats().created_number, 2);
+                EXPECT_EQ(mysql_client_pool.shard(1).stats().active_number, 0);
+                check_point = 1;
+            }
+
+            mysql_client_pool.close();
+        });
+    shard_threads.stop();
+
+    EXPECT_EQ(check_point, 1);
+}
@@ -0,0 +1,210 @@
+#include <map>
+#include <regex>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+
+#include "conet/http_client.h"
+#include "conet/http_server.h"
+#include "conet/trace.h"
+
+namespace {
+
+boost::asio::awaitable<void> traced_wait()
+{
+    conet::TraceSpan span("traced_wait");
+    boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::milliseconds(1));
+    span.suspend();
+    co_await timer.async_wait(boost::asio::use_awaitable);
+    span.resume();
+}
+
+boost::asio::awaitable<void> traced_request(boost::asio::io_context &io_context)
+{
+    conet::TraceSpan span("request", conet::Tracer::global().sample());
+    co_await traced_wait();
+    EXPECT_EQ(conet::Tracer::current().span_id, span.context().span_id);
+
+    boost::asio::co_spawn(io_context, [trace_context = span.context()] () -> boost::asio::awaitable<void>
+        {
+            conet::TraceSpan span("spawned", trace_context);
+            co_await traced_wait();
+        }, boost::asio::detached);
+}
+
+struct BeginEvent
+{
+    std::string trace_id;
+    std::uint64_t span_id;
+    std::uint64_t parent_span_id;
+};
+
+// the begin events of a chrome trace by span name
+std::multimap<std::string, BeginEvent> parse_begin_events(const std::string &json)
+{
+    std::multimap<std::string, BeginEvent> ret;
+    std::regex begin_regex("\\{\"name\":\"([^\"]+)\",\"cat\":\"conet\",\"ph\":\"b\",\"id\":\"([^\"]+)\"[^{]*\\{\"span_id\":([0-9]+),\"parent_span_id\":([0-9]+)");
+    for (std::sregex_iterator it(json.begin(), json.end(), begin_regex), end; it!=end; ++it)
+    {
+        ret.emplace((*it)[1], BeginEvent{(*it)[2], std::stoull((*it)[3]), std::stoull((*it)[4])});
+    }
+    return ret;
+}
+
+} // namespace
+
+TEST(TraceTest, Disabled)
+{
+    conet::Tracer::global().disable();
+    EXPECT_FALSE(conet::Tracer::global().sample());
+
+    conet::TraceContext parent;
+    parent.trace_id = 1;
+    conet::TraceSpan span("disabled", parent);
+    EXPECT_FALSE(span.context());
+    EXPECT_FALSE(conet::Tracer::current());
+}
+
+TEST(TraceTest, Sample)
+{
+    auto &tracer = conet::Tracer::global();
+    conet::TraceOptions options;
+    options.sample_every = 4;
+    tracer.enable(options);
+
+    int sampled_number = 0;
+    for (int i=0; i<100; ++i)
+    {
+        if (tracer.sample())
+            ++sampled_number;
+    }
+    EXPECT_EQ(sampled_number, 25);
+
+    // a span without a sampled parent records nothing
+    conet::TraceSpan span("unsampled");
+    EXPECT_FALSE(span.context());
+
+    tracer.disable();
+}
+
+TEST(TraceTest, ChromeTrace)
+{
+    auto &tracer = conet::Tracer::global();
+    tracer.clear();
+    tracer.enable();
+
+    boost::asio::io_context io_context;
+    boost::asio::co_spawn(io_context, traced_request(io_context), boost::asio::detached);
+    io_context.run();
+    tracer.disable();
+    EXPECT_FALSE(conet::Tracer::current());
+
+    auto json = tracer.chrome_trace();
+    EXPECT_EQ(json.find("{\"traceEvents\":[{\"name\":\"request\",\"cat\":\"conet\",\"ph\":\"b\""), 0) << json;
+    for (auto name : {"\"traced_wait\"", "\"spawned\"", "\"suspend\"", "\"resume\""})
+    {
+        EXPECT_NE(json.find(name), std::string::npos) << name;
+    }
+
+    // every span of the request shares its trace id, the spawned coroutine included
+    auto id_pos = json.find("\"id\":\"");
+    ASSERT_NE(id_pos, std::string::npos);
+    auto id = json.substr(id_pos, json.find('"', id_pos + 6) - id_pos + 1);
+    std::size_t begin_number = 0;
+    for (auto pos = json.find("\"ph\":\"b\",\"id\""); pos != std::string::npos; pos = json.find("\"ph\":\"b\",\"id\"", pos + 1))
+    {
+        ++begin_number;
+        EXPECT_EQ(json.compare(pos + 9, id.size(), id), 0) << json;
+    }
+    EXPECT_EQ(begin_number, 4);
+
+    tracer.clear();
+    EXPECT_EQ(tracer.chrome_trace(), "{\"traceEvents\":[],\"displayTimeUnit\":\"ms\"}");
+}
+
+TEST(TraceTest, InterleavedRequests)
+{
+    using boost::beast::http::verb;
+
+    auto &tracer = conet::Tracer::global();
+    tracer.clear();
+    tracer.enable();
+
+    boost::asio::io_context io_context;
+    conet::HttpServer http_server(io_context);
+    // waits on an untraced timer while the other request runs
+    EXPECT_TRUE(http_server.route(verb::get, "/slow",
+        [&io_context] (const conet::HttpServerRequest &req, conet::HttpServerResponse &rsp, const conet::HttpRouteParams &params) -> boost::asio::awaitable<conet::result<void>>
+        {
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(30));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            conet::TraceSpan span("slow_child", params.trace_context());
+            co_return RESULT_SUCCESS;
+        }));
+    EXPECT_TRUE(http_server.route(verb::get, "/fast",
+        [] (const conet::HttpServerRequest &req, conet::HttpServerResponse &rsp, const conet::HttpRouteParams &params) -> boost::asio::awaitable<conet::result<void>>
+        {
+            EXPECT_FALSE(conet::Tracer::current());
+            conet::TraceSpan span("fast_child", params.trace_context());
+            co_await traced_wait();
+            co_return RESULT_SUCCESS;
+        }));
+    ASSERT_TRUE(http_server.listen("127.0.0.1", 0));
+    http_server.start();
+
+    conet::HttpClient http_client(io_context);
+    auto url = "127.0.0.1:" + std::to_string(http_server.port());
+    int finished_number = 0;
+    auto get = [&] (std::string path) -> boost::asio::awaitable<void>
+        {
+            auto get_result = co_await http_client.co_get(url + path);
+            EXPECT_TRUE(get_result) << get_result.error_info();
+            if (++finished_number == 2)
+            {
+                http_client.connection_pool().close();
+                http_server.close();
+            }
+        };
+
+    boost::asio::co_spawn(io_context, get("/slow"), boost::asio::detached);
+    boost::asio::co_spawn(io_context, [&] () -> boost::asio::awaitable<void>
+        {
+            boost::asio::steady_timer timer(io_context, std::chrono::milliseconds(10));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            // the slow request is waiting, its span is not the current one of the thread
+            EXPECT_FALSE(conet::Tracer::current());
+            co_await get("/fast");
+        }, boost::asio::detached);
+    io_context.run();
+    tracer.disable();
+
+    EXPECT_EQ(finished_number, 2);
+    EXPECT_FALSE(conet::Tracer::current());
+
+    // the spans of each request are children of its own root, nothing else joined a trace
+    auto json = tracer.chrome_trace();
+    auto begin_events = parse_begin_events(json);
+    ASSERT_EQ(begin_events.size(), 5) << json;
+    ASSERT_EQ(begin_events.count("HttpServer::handle"), 2) << json;
+    ASSERT_EQ(begin_events.count("slow_child"), 1) << json;
+    ASSERT_EQ(begin_events.count("fast_child"), 1) << json;
+    ASSERT_EQ(begin_events.count("traced_wait"), 1) << json;
+
+    auto slow_child = begin_events.find("slow_child")->second;
+    auto fast_child = begin_events.find("fast_child")->second;
+    auto traced_wait_event = begin_events.find("traced_wait")->second;
+    EXPECT_NE(slow_child.trace_id, fast_child.trace_id);
+    EXPECT_EQ(traced_wait_event.trace_id, fast_child.trace_id);
+    EXPECT_EQ(traced_wait_event.parent_span_id, fast_child.span_id);
+    auto range = begin_events.equal_range("HttpServer::handle");
+    for (auto it=range.first; it!=range.second; ++it)
+    {
+        const auto &root = it->second;
+        EXPECT_EQ(root.parent_span_id, 0);
+        const auto &child = root.trace_id == slow_child.trace_id ? slow_child : fast_child;
+        EXPECT_EQ(child.parent_span_id, root.span_id);
+    }
+
+    tracer.clear();
+}
@@ -1,4 +1,5 @@
 #include <memory>
+#include <regex>
 
 #include <gtest/gtest.h>
 
@@ -69,3 +70,57 @@ TEST(UrlParserTest, HttpIpPort)
     EXPECT_EQ(url_parser.path(), "/");
     EXPECT_EQ(url_parser.service(), "45678");
 }
+
+TEST(UrlParserTest, Ipv6UserinfoQueryFragment)
+{
+    conet::UrlParser url_parser;
+    auto result = url_parser.parse("https://user:pass@[::1]:8443/a/b?x=1&y=2#top");
+
+    EXPECT_FALSE(result.has_error());
+    EXPECT_EQ(url_parser.protocol(), "https");
+    EXPECT_EQ(url_parser.userinfo(), "user:pass");
+    EXPECT_EQ(url_parser.host(), "::1");
+    EXPECT_EQ(url_parser.port(), "8443");
+    EXPECT_EQ(url_parser.path(), "/a/b?x=1&y=2");
+    EXPECT_EQ(url_parser.query(), "x=1&y=2");
+    EXPECT_EQ(url_parser.fragment(), "top");
+    EXPECT_EQ(url_parser.service(), "8443");
+
+    EXPECT_FALSE(url_parser.parse("[fe80::1]?q").has_error());
+    EXPECT_EQ(url_parser.host(), "fe80::1");
+    EXPECT_EQ(url_parser.path(), "?q");
+    EXPECT_EQ(url_parser.query(), "q");
+    EXPECT_EQ(url_parser.service(), "80");
+}
+
+TEST(UrlParserTest, Invalid)
+{
+    conet::UrlParser url_parser;
+    for (auto url : {"", "http://", "http:///path", ":80", "host:http", "host:80:81", "[::1", "[::1]x", "user@"})
+    {
+        EXPECT_TRUE(url_parser.parse(url).has_error()) << url;
+    }
+}
+
+// the regex the parser replaced, on urls without the newer syntax
+TEST(UrlParserTest, RegexParity)
+{
+    std::regex regex(R"##((?:(\w+):\/\/)?([^:\/]+):?(\d+)?(\/.*)?)##");
+    for (std::string url : {"localhost", "localhost:", "example.com:8080/", "mysql://db.internal:3306",
+        "http://example.com/a/b/c?d=e&f=g", "a_b://h:1/x:y/z", "http:/x", "host//path", "http://h:/p", "h:12a", "/path"})
+    {
+        std::smatch smatch;
+        bool is_regex_match = std::regex_match(url, smatch, regex);
+
+        conet::UrlParser url_parser;
+        auto result = url_parser.parse(url);
+        EXPECT_EQ(is_regex_match, !result.has_error()) << url;
+        if (!is_regex_match || result.has_error())
+            continue;
+
+        EXPECT_EQ(url_parser.protocol(), smatch[1].str()) << url;
+        EXPECT_EQ(url_parser.host(), smatch[2].str()) << url;
+        EXPECT_EQ(url_parser.port(), smatch[3].str()) << url;
+        EXPECT_EQ(url_parser.path(), smatch[4].length() > 0 ? smatch[4].str() : "/") << url;
+    }
+}